@@ -92,9 +92,10 @@ struct DIObjectKeyView {
 };
 struct DIObjectKeyViewHash {
   size_t operator()(const DIObjectKeyView& id) const noexcept {
-    size_t h1 = std::hash<std::string_view>()(id.name);
-    size_t h2 = id.id;
-    return h1 ^ h2;
+    size_t h = std::hash<std::string_view>()(id.name);
+    // mix the type id into all bits, a plain xor only flips the low bits and makes same name keys collide
+    h ^= static_cast<size_t>(id.id) * 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
     // absl::Hash<DIObjectKeyView> h;
     // return h(id);
   }
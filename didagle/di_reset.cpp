@@ -28,4 +28,4 @@
  */
 #include "didagle/di_reset.h"
 
-// DEFINE_bool(didagle_reuse_proto_obj, false, "Reuse protobuf objs for didagle.");
+DEFINE_bool(didagle_reuse_proto_obj, false, "Reuse protobuf objs for didagle.");
@@ -33,13 +33,14 @@
 #include <unordered_map>
 #include <vector>
 
+#include "gflags/gflags.h"
+#include "google/protobuf/arena.h"
 #include "google/protobuf/message.h"
 #include "google/protobuf/repeated_field.h"
 
-// #include "ispine/flags.h"
-// #include "ispine/pool/obj_pool/obj_pool.h"
+#include "didagle/didagle_obj_pool.h"
 
-// DECLARE_bool(didagle_reuse_proto_obj);
+DECLARE_bool(didagle_reuse_proto_obj);
 
 namespace didagle {
 template <typename>
@@ -59,13 +60,11 @@ struct Reset {
   inline void operator()(T& t) {
     if constexpr (std::is_base_of_v<::google::protobuf::Message, T> || is_pb_repeated_ptr<T>::value ||
                   is_pb_repeated<T>::value) {
-      // if (FLAGS_didagle_reuse_proto_obj) {
-      //   t.Clear();
-      //   T* empty = new T;
-      //   t.Swap(empty);
-      //   ispine::ObjPool<T>::GetInstance()->RecycleRaw(empty);
-      //   return;
-      // }
+      if (FLAGS_didagle_reuse_proto_obj) {
+        // the output member lives in a pooled processor, 'Clear' keeps its allocated capacity for next request
+        t.Clear();
+        return;
+      }
     }
     t = {};
   }
@@ -91,4 +90,29 @@ struct Prepare {
   }
 };
 
+/**
+ * @brief create/destroy the message of 'GRAPH_OP_ARENA_OUTPUT', messages without protobuf arena are taken from &
+ * recycled to the object pool if 'didagle_reuse_proto_obj' is enabled.
+ */
+template <typename T>
+inline T* NewArenaMessage(google::protobuf::Arena* arena) {
+  if (nullptr == arena && FLAGS_didagle_reuse_proto_obj) {
+    return ObjPool<T>::GetInstance()->GetRaw();
+  }
+  return google::protobuf::Arena::CreateMessage<T>(arena);
+}
+
+template <typename T>
+inline void DeleteArenaMessage(T* msg) {
+  if (nullptr == msg || nullptr != msg->GetArena()) {
+    return;
+  }
+  if (FLAGS_didagle_reuse_proto_obj) {
+    msg->Clear();
+    ObjPool<T>::GetInstance()->RecycleRaw(msg);
+    return;
+  }
+  delete msg;
+}
+
 }  // namespace didagle
\ No newline at end of file
@@ -0,0 +1,132 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "didagle/didagle_arena.h"
+
+namespace didagle {
+
+GraphArena::GraphArena(size_t block_size) : _block_size(block_size) {}
+
+GraphArena::~GraphArena() {
+  Reset();
+  Block* current = _current.load();
+  if (nullptr != current) {
+    current->~Block();
+    ::operator delete(current);
+  }
+}
+
+GraphArena::Block* GraphArena::NewBlock(size_t size) {
+  void* mem = ::operator new(sizeof(Block) + size);
+  Block* block = new (mem) Block;
+  block->size = size;
+  _block_count.fetch_add(1, std::memory_order_relaxed);
+  return block;
+}
+
+void* GraphArena::TryBumpAlloc(Block* block, size_t bytes, size_t alignment) {
+  size_t need = bytes + alignment - 1;
+  size_t offset = block->used.fetch_add(need, std::memory_order_relaxed);
+  if (offset + need > block->size) {
+    return nullptr;
+  }
+  uintptr_t p = reinterpret_cast<uintptr_t>(block->Data() + offset);
+  p = (p + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+  return reinterpret_cast<void*>(p);
+}
+
+void* GraphArena::do_allocate(size_t bytes, size_t alignment) {
+  if (0 == bytes) {
+    bytes = 1;
+  }
+  _bytes_allocated.fetch_add(bytes, std::memory_order_relaxed);
+  if (bytes + alignment > _block_size / 4) {
+    // large allocation gets a dedicated block instead of wasting the rest of current block
+    Block* block = NewBlock(bytes + alignment);
+    void* p = TryBumpAlloc(block, bytes, alignment);
+    std::lock_guard<std::mutex> guard(_grow_mutex);
+    block->next = _retired;
+    _retired = block;
+    return p;
+  }
+  while (true) {
+    Block* current = _current.load(std::memory_order_acquire);
+    if (nullptr != current) {
+      void* p = TryBumpAlloc(current, bytes, alignment);
+      if (nullptr != p) {
+        return p;
+      }
+    }
+    std::lock_guard<std::mutex> guard(_grow_mutex);
+    if (_current.load(std::memory_order_relaxed) != current) {
+      // another thread already switched the block
+      continue;
+    }
+    Block* block = NewBlock(_block_size);
+    if (nullptr != current) {
+      current->next = _retired;
+      _retired = current;
+    }
+    _current.store(block, std::memory_order_release);
+  }
+}
+
+void GraphArena::AddCleanup(void* obj, void (*cleanup)(void*)) {
+  Cleanup* c = static_cast<Cleanup*>(allocate(sizeof(Cleanup), alignof(Cleanup)));
+  c->obj = obj;
+  c->func = cleanup;
+  c->next = _cleanups.load(std::memory_order_relaxed);
+  while (!_cleanups.compare_exchange_weak(c->next, c, std::memory_order_release, std::memory_order_relaxed)) {
+  }
+}
+
+void GraphArena::Reset() {
+  // destruct in reverse order of construction
+  Cleanup* c = _cleanups.exchange(nullptr, std::memory_order_acquire);
+  while (nullptr != c) {
+    Cleanup* next = c->next;
+    c->func(c->obj);
+    c = next;
+  }
+  Block* block = _retired;
+  while (nullptr != block) {
+    Block* next = block->next;
+    block->~Block();
+    ::operator delete(block);
+    _block_count.fetch_sub(1, std::memory_order_relaxed);
+    block = next;
+  }
+  _retired = nullptr;
+  Block* current = _current.load(std::memory_order_relaxed);
+  if (nullptr != current) {
+    current->used.store(0, std::memory_order_relaxed);
+  }
+  _bytes_allocated.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace didagle
@@ -0,0 +1,108 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace didagle {
+
+/**
+ * @brief Thread safe monotonic arena for the objects of one graph execution, allocation is a lock free pointer bump
+ * in the current block, 'deallocate' is a no-op and all memory is released in one shot by 'Reset'.
+ * 'Reset' keeps the current block so that a pooled context reuses it for the next request.
+ * It's a 'std::pmr::memory_resource', pmr containers could use it directly.
+ */
+class GraphArena : public std::pmr::memory_resource {
+ public:
+  static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+  explicit GraphArena(size_t block_size = kDefaultBlockSize);
+  GraphArena(const GraphArena&) = delete;
+  GraphArena& operator=(const GraphArena&) = delete;
+  ~GraphArena();
+
+  /**
+   * @brief construct an object in arena, its destructor is invoked by 'Reset' if it's not trivially destructible.
+   */
+  template <typename T, typename... Args>
+  T* New(Args&&... args) {
+    void* p = allocate(sizeof(T), alignof(T));
+    T* obj = new (p) T(std::forward<Args>(args)...);
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      AddCleanup(obj, [](void* o) { static_cast<T*>(o)->~T(); });
+    }
+    return obj;
+  }
+  void AddCleanup(void* obj, void (*cleanup)(void*));
+
+  // only invoked when no one is allocating, i.e. the graph execution is done.
+  void Reset();
+  size_t BytesAllocated() const { return _bytes_allocated.load(std::memory_order_relaxed); }
+  size_t BlockCount() const { return _block_count.load(std::memory_order_relaxed); }
+
+ protected:
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {}
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+ private:
+  struct Block {
+    Block* next = nullptr;
+    size_t size = 0;
+    std::atomic<size_t> used{0};
+    char* Data() { return reinterpret_cast<char*>(this + 1); }
+  };
+  struct Cleanup {
+    void* obj;
+    void (*func)(void*);
+    Cleanup* next;
+  };
+
+  size_t _block_size;
+  std::atomic<Block*> _current{nullptr};
+  // all blocks except '_current', include the dedicated blocks of large allocations
+  Block* _retired = nullptr;
+  std::mutex _grow_mutex;
+  std::atomic<Cleanup*> _cleanups{nullptr};
+  std::atomic<size_t> _bytes_allocated{0};
+  std::atomic<size_t> _block_count{0};
+
+  Block* NewBlock(size_t size);
+  static void* TryBumpAlloc(Block* block, size_t bytes, size_t alignment);
+};
+
+}  // namespace didagle
@@ -0,0 +1,139 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "didagle/didagle_memo.h"
+
+#include <functional>
+
+namespace didagle {
+
+static inline uint64_t mix64(uint64_t v) {
+  v ^= v >> 33;
+  v *= 0xff51afd7ed558ccdULL;
+  v ^= v >> 33;
+  v *= 0xc4ceb9fe1a85ec53ULL;
+  v ^= v >> 33;
+  return v;
+}
+
+void MemoHasher::Update(std::string_view bytes) {
+  // std::hash & FNV-1a are independent, a collision of both is practically impossible
+  _key.hash = mix64(_key.hash ^ std::hash<std::string_view>()(bytes)) + bytes.size();
+  uint64_t fnv = 0xcbf29ce484222325ULL;
+  for (unsigned char c : bytes) {
+    fnv ^= c;
+    fnv *= 0x100000001b3ULL;
+  }
+  _key.check = mix64(_key.check + fnv) ^ bytes.size();
+}
+
+void MemoHasher::Update(uint64_t v) {
+  _key.hash = mix64(_key.hash ^ v) + 0x9e3779b97f4a7c15ULL;
+  _key.check = mix64(_key.check + v * 0x100000001b3ULL) ^ 0x85ebca6bULL;
+}
+
+MemoCache::MemoCache(size_t capacity, size_t shard_num) {
+  if (0 == shard_num) {
+    shard_num = 1;
+  }
+  size_t shard_capacity = (capacity + shard_num - 1) / shard_num;
+  if (0 == shard_capacity) {
+    shard_capacity = 1;
+  }
+  for (size_t i = 0; i < shard_num; i++) {
+    auto shard = std::make_unique<Shard>();
+    shard->capacity = shard_capacity;
+    _shards.emplace_back(std::move(shard));
+  }
+}
+
+MemoEntryPtr MemoCache::Get(const MemoKey& key) {
+  Shard& shard = GetShard(key);
+  {
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    auto found = shard.index.find(key.hash);
+    if (found != shard.index.end() && found->second->first == key) {
+      shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+      _hits.fetch_add(1, std::memory_order_relaxed);
+      return found->second->second;
+    }
+  }
+  _misses.fetch_add(1, std::memory_order_relaxed);
+  return nullptr;
+}
+
+void MemoCache::Put(const MemoKey& key, MemoEntryPtr entry) {
+  if (!entry) {
+    return;
+  }
+  Shard& shard = GetShard(key);
+  // the evicted entry is released out of the lock
+  MemoEntryPtr evicted;
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  auto found = shard.index.find(key.hash);
+  if (found != shard.index.end()) {
+    evicted = std::move(found->second->second);
+    found->second->first = key;
+    found->second->second = std::move(entry);
+    shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+    return;
+  }
+  shard.lru.emplace_front(key, std::move(entry));
+  shard.index.emplace(key.hash, shard.lru.begin());
+  if (shard.index.size() > shard.capacity) {
+    auto& last = shard.lru.back();
+    evicted = std::move(last.second);
+    shard.index.erase(last.first.hash);
+    shard.lru.pop_back();
+  }
+}
+
+size_t MemoCache::Size() const {
+  size_t n = 0;
+  for (const auto& shard : _shards) {
+    std::lock_guard<std::mutex> guard(shard->mutex);
+    n += shard->index.size();
+  }
+  return n;
+}
+
+void MemoCache::Clear() {
+  for (const auto& shard : _shards) {
+    Shard::EntryList entries;
+    {
+      std::lock_guard<std::mutex> guard(shard->mutex);
+      shard->index.clear();
+      entries.swap(shard->lru);
+    }
+  }
+  _hits = 0;
+  _misses = 0;
+}
+
+}  // namespace didagle
@@ -0,0 +1,250 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <stdint.h>
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "folly/FBString.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/message.h"
+
+namespace didagle {
+
+/**
+ * @brief 128 bits key of a memoized processor execution, 'hash' selects the cache slot and 'check' is computed by
+ * another hash function to detect collisions.
+ */
+struct MemoKey {
+  uint64_t hash = 0;
+  uint64_t check = 0;
+  bool operator==(const MemoKey& other) const { return hash == other.hash && check == other.check; }
+};
+
+class MemoHasher {
+ public:
+  void Update(std::string_view bytes);
+  void Update(uint64_t v);
+  const MemoKey& GetKey() const { return _key; }
+
+ private:
+  MemoKey _key = {0x84222325cbf29ce4ULL, 0x9e3779b97f4a7c15ULL};
+};
+
+/**
+ * @brief hashing hook of processor inputs used by vertexs with 'memoize = true', specialize it for custom input
+ * types, returns false if the value can not be hashed which disables the memoization of the execution.
+ */
+template <typename T, typename Enable = void>
+struct InputHasher {
+  bool operator()(const T& v, MemoHasher& h) const { return false; }
+};
+
+template <typename T>
+struct InputHasher<T, std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>>> {
+  bool operator()(const T& v, MemoHasher& h) const {
+    h.Update(std::string_view(reinterpret_cast<const char*>(&v), sizeof(v)));
+    return true;
+  }
+};
+
+template <typename T>
+struct InputHasher<T, std::enable_if_t<std::is_same_v<T, std::string> || std::is_same_v<T, folly::fbstring>>> {
+  bool operator()(const T& v, MemoHasher& h) const {
+    h.Update(std::string_view(v.data(), v.size()));
+    return true;
+  }
+};
+
+template <typename T>
+struct InputHasher<T, std::enable_if_t<std::is_base_of_v<::google::protobuf::Message, T>>> {
+  bool operator()(const T& v, MemoHasher& h) const {
+    std::string buf;
+    {
+      google::protobuf::io::StringOutputStream stream(&buf);
+      google::protobuf::io::CodedOutputStream output(&stream);
+      output.SetSerializationDeterministic(true);
+      if (!v.SerializeToCodedStream(&output)) {
+        return false;
+      }
+    }
+    h.Update(buf);
+    return true;
+  }
+};
+
+template <typename T>
+struct InputHasher<std::shared_ptr<T>> {
+  bool operator()(const std::shared_ptr<T>& v, MemoHasher& h) const {
+    if (!v) {
+      h.Update(uint64_t(0));
+      return true;
+    }
+    h.Update(uint64_t(1));
+    return InputHasher<std::remove_const_t<T>>()(*v, h);
+  }
+};
+
+template <typename T>
+struct InputHasher<std::vector<T>> {
+  bool operator()(const std::vector<T>& v, MemoHasher& h) const {
+    h.Update(uint64_t(v.size()));
+    for (const auto& e : v) {
+      if (!InputHasher<T>()(e, h)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+template <typename K, typename V>
+struct InputHasher<std::map<K, V>> {
+  bool operator()(const std::map<K, V>& v, MemoHasher& h) const {
+    h.Update(uint64_t(v.size()));
+    for (const auto& [key, value] : v) {
+      if (!InputHasher<K>()(key, h) || !InputHasher<V>()(value, h)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+/**
+ * @brief hash the injected value of an input field, a null field is hashed as a distinct value.
+ */
+template <typename T>
+inline bool HashInputField(const T* v, MemoHasher& h) {
+  if (nullptr == v) {
+    h.Update(uint64_t(0));
+    return true;
+  }
+  h.Update(uint64_t(1));
+  return InputHasher<std::remove_const_t<T>>()(*v, h);
+}
+template <typename T>
+inline bool HashInputField(const std::shared_ptr<T>& v, MemoHasher& h) {
+  return InputHasher<std::shared_ptr<T>>()(v, h);
+}
+template <typename T>
+inline bool HashInputField(const std::unique_ptr<T>& v, MemoHasher& h) {
+  return HashInputField(v.get(), h);
+}
+template <typename V>
+inline bool HashInputField(const std::map<std::string, V>& v, MemoHasher& h) {
+  h.Update(uint64_t(v.size()));
+  for (const auto& [name, value] : v) {
+    h.Update(name);
+    if (!HashInputField(value, h)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief copy of output fields stored in the memo cache, only copy assignable outputs could be memoized.
+ */
+template <typename T>
+struct MemoValue {
+  static constexpr bool kCopyable = std::is_default_constructible_v<T> && std::is_copy_assignable_v<T>;
+  static std::shared_ptr<void> Snapshot(const T* v) {
+    if constexpr (kCopyable) {
+      if (nullptr == v) {
+        return nullptr;
+      }
+      auto copy = std::make_shared<T>();
+      *copy = *v;
+      return copy;
+    } else {
+      return nullptr;
+    }
+  }
+  static bool Restore(const std::shared_ptr<void>& src, T* v) {
+    if constexpr (kCopyable) {
+      if (nullptr == v || !src) {
+        return false;
+      }
+      *v = *static_cast<const T*>(src.get());
+      return true;
+    } else {
+      return false;
+    }
+  }
+};
+
+struct MemoEntry {
+  // same order as the output fields of the processor
+  std::vector<std::shared_ptr<void>> outputs;
+};
+using MemoEntryPtr = std::shared_ptr<const MemoEntry>;
+
+/**
+ * @brief sharded concurrent LRU cache of processor execution results shared across requests, each shard has its
+ * own lock & evicts its least recently used entries when it holds more than 'capacity / shard_num' entries.
+ */
+class MemoCache {
+ public:
+  explicit MemoCache(size_t capacity, size_t shard_num = 16);
+  MemoEntryPtr Get(const MemoKey& key);
+  void Put(const MemoKey& key, MemoEntryPtr entry);
+  size_t Size() const;
+  uint64_t Hits() const { return _hits.load(std::memory_order_relaxed); }
+  uint64_t Misses() const { return _misses.load(std::memory_order_relaxed); }
+  void Clear();
+
+ private:
+  struct Shard {
+    typedef std::list<std::pair<MemoKey, MemoEntryPtr>> EntryList;
+    mutable std::mutex mutex;
+    EntryList lru;
+    std::unordered_map<uint64_t, EntryList::iterator> index;
+    size_t capacity = 0;
+  };
+  Shard& GetShard(const MemoKey& key) { return *_shards[(key.hash >> 32) % _shards.size()]; }
+
+  std::vector<std::unique_ptr<Shard>> _shards;
+  std::atomic<uint64_t> _hits{0};
+  std::atomic<uint64_t> _misses{0};
+};
+
+}  // namespace didagle
@@ -0,0 +1,81 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <stddef.h>
+
+#include <atomic>
+
+#include "concurrentqueue.h"
+
+namespace didagle {
+
+/**
+ * @brief Process wide pool of reusable objects, objects are usually recycled by the async reset worker and reused
+ * by executor threads, so a concurrent queue is used instead of thread local caches.
+ */
+template <typename T>
+class ObjPool {
+ public:
+  static constexpr size_t kDefaultMaxPooled = 4096;
+
+  static ObjPool* GetInstance() {
+    static ObjPool* instance = new ObjPool;
+    return instance;
+  }
+  void SetMaxPooled(size_t n) { _max_pooled.store(n, std::memory_order_relaxed); }
+  T* GetRaw() {
+    T* obj = nullptr;
+    if (_queue.try_dequeue(obj)) {
+      _pooled.fetch_sub(1, std::memory_order_relaxed);
+      return obj;
+    }
+    return new T;
+  }
+  // the object should be cleared by caller before recycling
+  void RecycleRaw(T* obj) {
+    if (nullptr == obj) {
+      return;
+    }
+    if (_pooled.fetch_add(1, std::memory_order_relaxed) >= _max_pooled.load(std::memory_order_relaxed)) {
+      _pooled.fetch_sub(1, std::memory_order_relaxed);
+      delete obj;
+      return;
+    }
+    _queue.enqueue(obj);
+  }
+  size_t Size() const { return _pooled.load(std::memory_order_relaxed); }
+
+ private:
+  moodycamel::ConcurrentQueue<T*> _queue;
+  std::atomic<size_t> _pooled{0};
+  std::atomic<size_t> _max_pooled{kDefaultMaxPooled};
+};
+
+}  // namespace didagle
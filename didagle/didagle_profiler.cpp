@@ -0,0 +1,177 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "didagle/didagle_profiler.h"
+
+#include <math.h>
+
+namespace didagle {
+
+LatencyHistogram::LatencyHistogram() { Clear(); }
+
+uint32_t LatencyHistogram::GetBucketIndex(uint64_t us) {
+  if (us < kSubBucketNum) {
+    return static_cast<uint32_t>(us);
+  }
+  uint32_t msb = 63 - __builtin_clzll(us);
+  uint32_t shift = msb - kSubBucketBits;
+  return (msb - kSubBucketBits + 1) * kSubBucketNum + static_cast<uint32_t>((us >> shift) & (kSubBucketNum - 1));
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(uint32_t idx) {
+  if (idx < kSubBucketNum) {
+    return idx;
+  }
+  uint32_t shift = idx / kSubBucketNum - 1;
+  uint64_t lower = static_cast<uint64_t>(kSubBucketNum + idx % kSubBucketNum) << shift;
+  return lower + ((1ULL << shift) - 1);
+}
+
+void LatencyHistogram::Record(uint64_t us) {
+  _buckets[GetBucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+  _count.fetch_add(1, std::memory_order_relaxed);
+  _sum.fetch_add(us, std::memory_order_relaxed);
+  uint64_t max = _max.load(std::memory_order_relaxed);
+  while (us > max && !_max.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t LatencyHistogram::Percentile(double p) const {
+  // sum buckets instead of '_count' since they are updated separately by concurrent writers
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < kBucketNum; i++) {
+    total += _buckets[i].load(std::memory_order_relaxed);
+  }
+  if (0 == total) {
+    return 0;
+  }
+  if (p < 0) {
+    p = 0;
+  } else if (p > 100) {
+    p = 100;
+  }
+  uint64_t rank = static_cast<uint64_t>(ceil(p / 100.0 * total));
+  if (rank == 0) {
+    rank = 1;
+  }
+  uint64_t max = Max();
+  uint64_t acc = 0;
+  for (uint32_t i = 0; i < kBucketNum; i++) {
+    acc += _buckets[i].load(std::memory_order_relaxed);
+    if (acc >= rank) {
+      uint64_t upper = GetBucketUpperBound(i);
+      return (max > 0 && upper > max) ? max : upper;
+    }
+  }
+  return max;
+}
+
+void LatencyHistogram::Clear() {
+  for (uint32_t i = 0; i < kBucketNum; i++) {
+    _buckets[i].store(0, std::memory_order_relaxed);
+  }
+  _count.store(0, std::memory_order_relaxed);
+  _sum.store(0, std::memory_order_relaxed);
+  _max.store(0, std::memory_order_relaxed);
+}
+
+GraphProfile::GraphProfile(DAGProfiler* profiler, const std::string& cluster, const std::string& graph)
+    : _profiler(profiler), _cluster(cluster), _graph(graph) {}
+
+VertexProfile* GraphProfile::GetVertexProfile(const std::string& id) {
+  std::lock_guard<std::mutex> guard(_vertexes_mutex);
+  auto& profile = _vertexes[id];
+  if (!profile) {
+    profile = std::make_unique<VertexProfile>();
+    profile->id = id;
+  }
+  return profile.get();
+}
+
+const VertexProfile* GraphProfile::FindVertexProfile(const std::string& id) const {
+  std::lock_guard<std::mutex> guard(_vertexes_mutex);
+  auto found = _vertexes.find(id);
+  if (found == _vertexes.end()) {
+    return nullptr;
+  }
+  return found->second.get();
+}
+
+bool GraphProfile::IsCritical(const std::string& id) const {
+  const VertexProfile* profile = FindVertexProfile(id);
+  uint64_t requests = request_count.load(std::memory_order_relaxed);
+  if (nullptr == profile || 0 == requests) {
+    return false;
+  }
+  return profile->critical_count.load(std::memory_order_relaxed) * 2 >= requests;
+}
+
+void GraphProfile::OnGraphDone(const CriticalPath& path) {
+  request_count.fetch_add(1, std::memory_order_relaxed);
+  total.Record(path.end_ustime > path.start_ustime ? path.end_ustime - path.start_ustime : 0);
+  if (_profiler->_critical_path_reporter) {
+    _profiler->_critical_path_reporter(path);
+  }
+}
+
+GraphProfile* DAGProfiler::GetGraphProfile(const std::string& cluster, const std::string& graph) {
+  std::lock_guard<std::mutex> guard(_graphs_mutex);
+  auto& profile = _graphs[std::make_pair(cluster, graph)];
+  if (!profile) {
+    profile = std::make_unique<GraphProfile>(this, cluster, graph);
+  }
+  return profile.get();
+}
+
+const GraphProfile* DAGProfiler::FindGraphProfile(const std::string& cluster, const std::string& graph) const {
+  std::lock_guard<std::mutex> guard(_graphs_mutex);
+  auto found = _graphs.find(std::make_pair(cluster, graph));
+  if (found == _graphs.end()) {
+    return nullptr;
+  }
+  return found->second.get();
+}
+
+void DAGProfiler::Clear() {
+  std::lock_guard<std::mutex> guard(_graphs_mutex);
+  for (auto& [_, graph] : _graphs) {
+    graph->total.Clear();
+    graph->request_count = 0;
+    std::lock_guard<std::mutex> vertexes_guard(graph->_vertexes_mutex);
+    for (auto& [_, vertex] : graph->_vertexes) {
+      vertex->sched_delay.Clear();
+      vertex->prepare.Clear();
+      vertex->execute.Clear();
+      vertex->critical_count = 0;
+      vertex->speculation_count = 0;
+      vertex->speculation_wasted = 0;
+      vertex->speculation_waste.Clear();
+    }
+  }
+}
+}  // namespace didagle
@@ -0,0 +1,157 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace didagle {
+
+/**
+ * @brief Lock free latency histogram in microseconds with log-linear buckets(8 sub buckets for each power of 2),
+ * the relative error of percentiles is less than 12.5%.
+ */
+class LatencyHistogram {
+ public:
+  static constexpr uint32_t kSubBucketBits = 3;
+  static constexpr uint32_t kSubBucketNum = 1 << kSubBucketBits;
+  static constexpr uint32_t kBucketNum = (64 - kSubBucketBits + 1) * kSubBucketNum;
+
+  LatencyHistogram();
+  void Record(uint64_t us);
+  // upper bound of the bucket which contains the 'p'(0-100) percentile, 0 if empty.
+  uint64_t Percentile(double p) const;
+  uint64_t Count() const { return _count.load(std::memory_order_relaxed); }
+  uint64_t Sum() const { return _sum.load(std::memory_order_relaxed); }
+  uint64_t Max() const { return _max.load(std::memory_order_relaxed); }
+  uint64_t Avg() const {
+    uint64_t n = Count();
+    return 0 == n ? 0 : Sum() / n;
+  }
+  void Clear();
+
+  static uint32_t GetBucketIndex(uint64_t us);
+  static uint64_t GetBucketUpperBound(uint32_t idx);
+
+ private:
+  std::atomic<uint64_t> _buckets[kBucketNum];
+  std::atomic<uint64_t> _count;
+  std::atomic<uint64_t> _sum;
+  std::atomic<uint64_t> _max;
+};
+
+struct VertexProfile {
+  std::string id;
+  LatencyHistogram sched_delay;  // from ready to start executing
+  LatencyHistogram prepare;      // processor 'Prepare' & inputs injection
+  LatencyHistogram execute;      // processor/subgraph execution
+  std::atomic<uint64_t> critical_count{0};
+  // speculative branch vertexs only, 'speculation_waste' is the execute latency of discarded executions
+  std::atomic<uint64_t> speculation_count{0};
+  std::atomic<uint64_t> speculation_wasted{0};
+  LatencyHistogram speculation_waste;
+};
+
+struct CriticalPathNode {
+  std::string_view id;
+  uint64_t ready_ustime = 0;
+  uint64_t start_ustime = 0;
+  uint64_t end_ustime = 0;
+};
+
+/**
+ * @brief The chain of vertexes which bound the latency of one graph execution, each vertex is readied by the
+ * previous one(its last finished dependency), the last one is the last finished vertex of the graph.
+ */
+struct CriticalPath {
+  std::string_view cluster;
+  std::string_view graph;
+  uint64_t start_ustime = 0;
+  uint64_t end_ustime = 0;
+  std::vector<CriticalPathNode> nodes;
+};
+using CriticalPathReporter = std::function<void(const CriticalPath&)>;
+
+class DAGProfiler;
+class GraphProfile {
+ private:
+  DAGProfiler* _profiler = nullptr;
+  std::string _cluster;
+  std::string _graph;
+  mutable std::mutex _vertexes_mutex;
+  std::map<std::string, std::unique_ptr<VertexProfile>> _vertexes;
+
+  friend class DAGProfiler;
+
+ public:
+  LatencyHistogram total;
+  std::atomic<uint64_t> request_count{0};
+
+  GraphProfile(DAGProfiler* profiler, const std::string& cluster, const std::string& graph);
+  const std::string& GetCluster() const { return _cluster; }
+  const std::string& GetGraph() const { return _graph; }
+  // returned profile is valid until the profiler is destroyed, resolved once when context setup.
+  VertexProfile* GetVertexProfile(const std::string& id);
+  const VertexProfile* FindVertexProfile(const std::string& id) const;
+  // vertex appears in the critical path of at least half of the requests
+  bool IsCritical(const std::string& id) const;
+  // records the end to end latency and reports the critical path, 'critical_count' of the vertexes in the path
+  // are already counted by the executor.
+  void OnGraphDone(const CriticalPath& path);
+};
+
+/**
+ * @brief Latency profiles aggregated across requests for each (cluster, graph, vertex), profiles are keyed by name
+ * so that they are kept across graph cluster reloading.
+ */
+class DAGProfiler {
+ private:
+  mutable std::mutex _graphs_mutex;
+  std::map<std::pair<std::string, std::string>, std::unique_ptr<GraphProfile>> _graphs;
+  CriticalPathReporter _critical_path_reporter;
+
+  friend class GraphProfile;
+
+ public:
+  void SetCriticalPathReporter(CriticalPathReporter&& f) { _critical_path_reporter = std::move(f); }
+  GraphProfile* GetGraphProfile(const std::string& cluster, const std::string& graph);
+  const GraphProfile* FindGraphProfile(const std::string& cluster, const std::string& graph) const;
+  void Clear();
+};
+
+}  // namespace didagle
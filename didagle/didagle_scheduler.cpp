@@ -0,0 +1,448 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "didagle/didagle_scheduler.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+namespace didagle {
+static constexpr int kIdleSpinRounds = 64;
+
+struct WorkStealingScheduler::Worker {
+  WorkStealingScheduler* scheduler = nullptr;
+  size_t idx = 0;
+  ChaseLevDeque<SchedTask> deque;
+  // continuation, only accessed by the owner thread
+  SchedTask* lifo_slot = nullptr;
+  uint32_t seed = 0;
+  std::thread thread;
+};
+
+static thread_local WorkStealingScheduler::Worker* tls_worker = nullptr;
+
+namespace {
+class ClosureTask : public SchedTask {
+ private:
+  std::function<void(void)> _func;
+
+ public:
+  explicit ClosureTask(std::function<void(void)>&& f) : _func(std::move(f)) {}
+  void RunTask() override {
+    _func();
+    delete this;
+  }
+};
+}  // namespace
+
+WorkStealingScheduler::WorkStealingScheduler(size_t thread_num)
+    : WorkStealingScheduler(thread_num, std::vector<int>{}) {}
+
+WorkStealingScheduler::WorkStealingScheduler(size_t thread_num, const std::vector<int>& cpus, bool pin_cores)
+    : _cpus(cpus), _pin_cores(pin_cores) {
+  if (0 == thread_num && !_cpus.empty()) {
+    thread_num = _cpus.size();
+  }
+  if (0 == thread_num) {
+    thread_num = std::thread::hardware_concurrency();
+    if (0 == thread_num) {
+      thread_num = 1;
+    }
+  }
+  for (size_t i = 0; i < thread_num; i++) {
+    std::unique_ptr<Worker> w(new Worker);
+    w->scheduler = this;
+    w->idx = i;
+    w->seed = static_cast<uint32_t>(i * 2654435761u + 1);
+    _workers.emplace_back(std::move(w));
+  }
+  // start threads after all workers created since they steal from each other
+  for (auto& w : _workers) {
+    Worker* p = w.get();
+    w->thread = std::thread([this, p]() { WorkerLoop(p); });
+  }
+}
+
+WorkStealingScheduler::Worker* WorkStealingScheduler::CurrentWorker() const {
+  if (nullptr != tls_worker && tls_worker->scheduler == this) {
+    return tls_worker;
+  }
+  return nullptr;
+}
+
+void WorkStealingScheduler::WakeupIdle() {
+  // pairs with the fence in 'WorkerLoop' before re-checking pending tasks
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (_sleeping.load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> guard(_sleep_mutex);
+    _sleep_cv.notify_one();
+  }
+}
+
+void WorkStealingScheduler::Schedule(SchedTask* task) {
+  if (_stopped.load(std::memory_order_acquire)) {
+    task->RunTask();
+    return;
+  }
+  Worker* w = CurrentWorker();
+  if (nullptr != w) {
+    w->deque.Push(task);
+  } else {
+    _injection.enqueue(task);
+  }
+  WakeupIdle();
+}
+
+void WorkStealingScheduler::ScheduleNext(SchedTask* task) {
+  Worker* w = CurrentWorker();
+  if (nullptr == w) {
+    Schedule(task);
+    return;
+  }
+  SchedTask* prev = w->lifo_slot;
+  w->lifo_slot = task;
+  if (nullptr != prev) {
+    w->deque.Push(prev);
+    WakeupIdle();
+  }
+}
+
+void WorkStealingScheduler::Post(std::function<void(void)>&& func) { Schedule(new ClosureTask(std::move(func))); }
+
+bool WorkStealingScheduler::HasPendingTask() const {
+  if (_injection.size_approx() > 0) {
+    return true;
+  }
+  for (const auto& w : _workers) {
+    if (!w->deque.Empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t WorkStealingScheduler::PendingTasks() const {
+  size_t n = _injection.size_approx();
+  for (const auto& w : _workers) {
+    n += w->deque.SizeApprox();
+  }
+  return n;
+}
+
+SchedTask* WorkStealingScheduler::FindTask(Worker* w) {
+  SchedTask* task = w->lifo_slot;
+  if (nullptr != task) {
+    w->lifo_slot = nullptr;
+    return task;
+  }
+  task = w->deque.Pop();
+  if (nullptr != task) {
+    return task;
+  }
+  if (_injection.try_dequeue(task)) {
+    return task;
+  }
+  // steal only when idle, start from a random victim
+  size_t n = _workers.size();
+  w->seed = w->seed * 1103515245 + 12345;
+  size_t start = (w->seed >> 16) % n;
+  for (size_t i = 0; i < n; i++) {
+    Worker* victim = _workers[(start + i) % n].get();
+    if (victim == w) {
+      continue;
+    }
+    task = victim->deque.Steal();
+    if (nullptr != task) {
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+void WorkStealingScheduler::BindWorker(Worker* w) {
+#if defined(__linux__)
+  if (_cpus.empty()) {
+    return;
+  }
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  if (_pin_cores) {
+    CPU_SET(_cpus[w->idx % _cpus.size()], &cpuset);
+  } else {
+    for (int cpu : _cpus) {
+      CPU_SET(cpu, &cpuset);
+    }
+  }
+  // it's fine to run unbound if the cpus are not allowed, e.g. in a restricted cgroup
+  pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+#endif
+}
+
+void WorkStealingScheduler::WorkerLoop(Worker* w) {
+  BindWorker(w);
+  tls_worker = w;
+  int idle_rounds = 0;
+  while (_running.load(std::memory_order_acquire)) {
+    SchedTask* task = FindTask(w);
+    if (nullptr != task) {
+      idle_rounds = 0;
+      task->RunTask();
+      continue;
+    }
+    if (idle_rounds < kIdleSpinRounds) {
+      idle_rounds++;
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(_sleep_mutex);
+    _sleeping.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_running.load(std::memory_order_acquire) && !HasPendingTask()) {
+      _sleep_cv.wait(lock);
+    }
+    _sleeping.fetch_sub(1, std::memory_order_relaxed);
+    idle_rounds = 0;
+  }
+  tls_worker = nullptr;
+}
+
+void WorkStealingScheduler::Stop() {
+  if (!_running.exchange(false)) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(_sleep_mutex);
+    _sleep_cv.notify_all();
+  }
+  for (auto& w : _workers) {
+    if (w->thread.joinable()) {
+      w->thread.join();
+    }
+  }
+  // tasks left in the queues are not dropped, they run on the calling thread so that the graphs they belong to
+  // still complete, tasks scheduled from now on are run inline.
+  _stopped.store(true, std::memory_order_release);
+  DrainTasks();
+}
+
+void WorkStealingScheduler::DrainTasks() {
+  bool drained = false;
+  while (!drained) {
+    drained = true;
+    SchedTask* task = nullptr;
+    while (_injection.try_dequeue(task)) {
+      task->RunTask();
+      drained = false;
+    }
+    // workers are joined, their deques are only accessed by the calling thread now
+    for (auto& w : _workers) {
+      task = w->lifo_slot;
+      if (nullptr != task) {
+        w->lifo_slot = nullptr;
+        task->RunTask();
+        drained = false;
+      }
+      while (nullptr != (task = w->deque.Pop())) {
+        task->RunTask();
+        drained = false;
+      }
+    }
+  }
+}
+
+WorkStealingScheduler::~WorkStealingScheduler() { Stop(); }
+
+std::vector<int> NumaTopology::ParseCpuList(const std::string& s) {
+  std::vector<int> cpus;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (item.empty()) {
+      continue;
+    }
+    size_t sep = item.find('-');
+    try {
+      int first = std::stoi(item.substr(0, sep));
+      int last = sep == std::string::npos ? first : std::stoi(item.substr(sep + 1));
+      for (int cpu = first; cpu <= last; cpu++) {
+        cpus.emplace_back(cpu);
+      }
+    } catch (...) {
+      return {};
+    }
+  }
+  return cpus;
+}
+
+NumaTopology NumaTopology::Detect() {
+  NumaTopology topology;
+  // node ids may be sparse, stop after a run of missing nodes
+  for (int node = 0, missing = 0; missing < 8; node++) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    if (!file.is_open()) {
+      missing++;
+      continue;
+    }
+    missing = 0;
+    std::string line;
+    std::getline(file, line);
+    std::vector<int> cpus = ParseCpuList(line);
+    // memory only nodes have no cpus
+    if (!cpus.empty()) {
+      topology.node_cpus.emplace_back(std::move(cpus));
+    }
+  }
+  if (topology.node_cpus.empty()) {
+    std::vector<int> cpus;
+    unsigned int n = std::thread::hardware_concurrency();
+    for (unsigned int i = 0; i < (n > 0 ? n : 1); i++) {
+      cpus.emplace_back(static_cast<int>(i));
+    }
+    topology.node_cpus.emplace_back(std::move(cpus));
+  }
+  return topology;
+}
+
+const NumaTopology& NumaTopology::Get() {
+  static NumaTopology topology = Detect();
+  return topology;
+}
+
+int NumaTopology::NodeOfCpu(int cpu) const {
+  for (size_t i = 0; i < node_cpus.size(); i++) {
+    for (int c : node_cpus[i]) {
+      if (c == cpu) {
+        return static_cast<int>(i);
+      }
+    }
+  }
+  return 0;
+}
+
+int NumaTopology::CurrentNode() const {
+#if defined(__linux__)
+  int cpu = sched_getcpu();
+  if (cpu >= 0) {
+    return NodeOfCpu(cpu);
+  }
+#endif
+  return 0;
+}
+
+ScopedCpuAffinity::ScopedCpuAffinity(const std::vector<int>& cpus) {
+#if defined(__linux__)
+  if (cpus.empty()) {
+    return;
+  }
+  if (0 != pthread_getaffinity_np(pthread_self(), sizeof(_prev), &_prev)) {
+    return;
+  }
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  for (int cpu : cpus) {
+    CPU_SET(cpu, &cpuset);
+  }
+  _bound = 0 == pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+#endif
+}
+
+ScopedCpuAffinity::~ScopedCpuAffinity() {
+#if defined(__linux__)
+  if (_bound) {
+    pthread_setaffinity_np(pthread_self(), sizeof(_prev), &_prev);
+  }
+#endif
+}
+
+NumaScheduler::NumaScheduler(const NumaSchedulerOptions& options) : NumaScheduler(NumaTopology::Get(), options) {}
+
+NumaScheduler::NumaScheduler(const NumaTopology& topology, const NumaSchedulerOptions& options)
+    : _topology(topology), _options(options) {
+  if (_topology.node_cpus.empty()) {
+    _topology = NumaTopology::Detect();
+  }
+  _loads.reset(new NodeLoad[_topology.NodeNum()]);
+  for (const auto& cpus : _topology.node_cpus) {
+    _schedulers.emplace_back(new WorkStealingScheduler(_options.threads_per_node, cpus, _options.pin_cores));
+  }
+}
+
+int NumaScheduler::LocalNode() const {
+  // nested requests started by a worker stay on the worker's node
+  for (size_t i = 0; i < _schedulers.size(); i++) {
+    if (_schedulers[i]->InWorkerThread()) {
+      return static_cast<int>(i);
+    }
+  }
+  return _topology.CurrentNode();
+}
+
+int NumaScheduler::BeginRequest() {
+  int node = LocalNode();
+  int64_t local_running = _loads[node].running.load(std::memory_order_relaxed);
+  int least = node;
+  int64_t least_running = local_running;
+  for (size_t i = 0; i < _schedulers.size(); i++) {
+    int64_t running = _loads[i].running.load(std::memory_order_relaxed);
+    if (running < least_running) {
+      least = static_cast<int>(i);
+      least_running = running;
+    }
+  }
+  if (least != node && local_running - least_running >= _options.spill_threshold) {
+    node = least;
+    _spilled.fetch_add(1, std::memory_order_relaxed);
+  }
+  _loads[node].running.fetch_add(1, std::memory_order_relaxed);
+  return node;
+}
+
+size_t NumaScheduler::PendingTasks() const {
+  size_t n = 0;
+  for (const auto& scheduler : _schedulers) {
+    n += scheduler->PendingTasks();
+  }
+  return n;
+}
+
+void NumaScheduler::EndRequest(int node) { _loads[node].running.fetch_sub(1, std::memory_order_relaxed); }
+
+void NumaScheduler::Stop() {
+  for (auto& scheduler : _schedulers) {
+    scheduler->Stop();
+  }
+}
+
+NumaScheduler::~NumaScheduler() { Stop(); }
+}  // namespace didagle
@@ -0,0 +1,285 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <stdint.h>
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrentqueue.h"
+
+namespace didagle {
+
+/**
+ * @brief Chase-Lev work stealing deque, 'Push'/'Pop' are only called by the owner thread at the bottom
+ * end, other threads 'Steal' from the top end.
+ */
+template <typename T>
+class ChaseLevDeque {
+ private:
+  struct Array {
+    int64_t capacity;
+    int64_t mask;
+    std::unique_ptr<std::atomic<T*>[]> buffer;
+    explicit Array(int64_t c) : capacity(c), mask(c - 1), buffer(new std::atomic<T*>[c]) {}
+    inline T* Get(int64_t i) const { return buffer[i & mask].load(std::memory_order_relaxed); }
+    inline void Put(int64_t i, T* v) { buffer[i & mask].store(v, std::memory_order_relaxed); }
+    Array* Grow(int64_t top, int64_t bottom) const {
+      Array* bigger = new Array(capacity * 2);
+      for (int64_t i = top; i < bottom; i++) {
+        bigger->Put(i, Get(i));
+      }
+      return bigger;
+    }
+  };
+  alignas(64) std::atomic<int64_t> _top{0};
+  alignas(64) std::atomic<int64_t> _bottom{0};
+  alignas(64) std::atomic<Array*> _array;
+  // replaced arrays may still be read by thieves, they are released with the deque.
+  std::vector<std::unique_ptr<Array>> _retired;
+
+ public:
+  // 'capacity' must be power of 2
+  explicit ChaseLevDeque(int64_t capacity = 256) { _array.store(new Array(capacity), std::memory_order_relaxed); }
+  ChaseLevDeque(const ChaseLevDeque&) = delete;
+  ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+  ~ChaseLevDeque() { delete _array.load(std::memory_order_relaxed); }
+
+  void Push(T* item) {
+    int64_t b = _bottom.load(std::memory_order_relaxed);
+    int64_t t = _top.load(std::memory_order_acquire);
+    Array* a = _array.load(std::memory_order_relaxed);
+    if (b - t > a->capacity - 1) {
+      Array* bigger = a->Grow(t, b);
+      _retired.emplace_back(a);
+      _array.store(bigger, std::memory_order_release);
+      a = bigger;
+    }
+    a->Put(b, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    _bottom.store(b + 1, std::memory_order_relaxed);
+  }
+  T* Pop() {
+    int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+    Array* a = _array.load(std::memory_order_relaxed);
+    _bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = _top.load(std::memory_order_relaxed);
+    if (t > b) {
+      _bottom.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    T* item = a->Get(b);
+    if (t == b) {
+      // last item, race with thieves
+      if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        item = nullptr;
+      }
+      _bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+  T* Steal() {
+    int64_t t = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = _bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+      return nullptr;
+    }
+    Array* a = _array.load(std::memory_order_acquire);
+    T* item = a->Get(t);
+    if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return item;
+  }
+  bool Empty() const { return _bottom.load(std::memory_order_relaxed) <= _top.load(std::memory_order_relaxed); }
+  // approximate number of items, only for statistics
+  size_t SizeApprox() const {
+    int64_t n = _bottom.load(std::memory_order_relaxed) - _top.load(std::memory_order_relaxed);
+    return n > 0 ? static_cast<size_t>(n) : 0;
+  }
+};
+
+class SchedTask {
+ public:
+  virtual void RunTask() = 0;
+  virtual ~SchedTask() = default;
+};
+
+/**
+ * @brief Built-in work stealing scheduler, could be used instead of 'concurrent_executor'.
+ * Each worker thread owns a Chase-Lev deque for tasks scheduled on it, the continuation task is kept in a
+ * LIFO slot of the worker and runs right after the current task on the same core; idle workers steal from
+ * the top of other workers' deques. Tasks scheduled from non worker threads go into a shared injection queue.
+ */
+class WorkStealingScheduler {
+ public:
+  struct Worker;
+
+ private:
+  std::vector<std::unique_ptr<Worker>> _workers;
+  // workers are bound to these cpus if it's not empty
+  std::vector<int> _cpus;
+  bool _pin_cores = false;
+  moodycamel::ConcurrentQueue<SchedTask*> _injection;
+  std::atomic<bool> _running{true};
+  // set once 'Stop' drained the queues, tasks scheduled after that are run inline
+  std::atomic<bool> _stopped{false};
+  std::atomic<int32_t> _sleeping{0};
+  std::mutex _sleep_mutex;
+  std::condition_variable _sleep_cv;
+
+  Worker* CurrentWorker() const;
+  SchedTask* FindTask(Worker* w);
+  bool HasPendingTask() const;
+  void WakeupIdle();
+  void WorkerLoop(Worker* w);
+  void BindWorker(Worker* w);
+  // runs the tasks left in the queues on the calling thread after the workers are joined
+  void DrainTasks();
+
+ public:
+  // 'thread_num' = 0 means 'std::thread::hardware_concurrency()'
+  explicit WorkStealingScheduler(size_t thread_num = 0);
+  /**
+   * @brief workers are bound to 'cpus', 'thread_num' = 0 means one worker per cpu. Each worker is pinned to a
+   * single core(round robin) if 'pin_cores' is true, or else it may migrate among 'cpus'.
+   */
+  WorkStealingScheduler(size_t thread_num, const std::vector<int>& cpus, bool pin_cores = false);
+  WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+  WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+  // schedule task to the current worker's deque, or the injection queue if not in a worker thread.
+  void Schedule(SchedTask* task);
+  // schedule task as the continuation of the running task, the previous continuation is pushed to deque.
+  void ScheduleNext(SchedTask* task);
+  // closure task is allocated & released after run.
+  void Post(std::function<void(void)>&& func);
+  bool InWorkerThread() const { return nullptr != CurrentWorker(); }
+  size_t ThreadNum() const { return _workers.size(); }
+  // approximate number of scheduled tasks which are not started yet, only for statistics
+  size_t PendingTasks() const;
+  // joins the workers, the tasks not started yet are run on the calling thread instead of being dropped.
+  void Stop();
+  ~WorkStealingScheduler();
+};
+
+/**
+ * @brief NUMA nodes & their cpus, read from '/sys/devices/system/node', all cpus are in one node if the
+ * topology is not available.
+ */
+struct NumaTopology {
+  std::vector<std::vector<int>> node_cpus;
+
+  static const NumaTopology& Get();
+  static NumaTopology Detect();
+  // parses cpu list like '0-3,8,10-11'
+  static std::vector<int> ParseCpuList(const std::string& s);
+  size_t NodeNum() const { return node_cpus.size(); }
+  int NodeOfCpu(int cpu) const;
+  // node of the cpu which the calling thread is running on
+  int CurrentNode() const;
+};
+
+/**
+ * @brief binds the calling thread to 'cpus' within the scope, e.g. objects allocated & first touched in the
+ * scope are placed on the memory of these cpus' node.
+ */
+class ScopedCpuAffinity {
+ private:
+#if defined(__linux__)
+  cpu_set_t _prev;
+#endif
+  bool _bound = false;
+
+ public:
+  explicit ScopedCpuAffinity(const std::vector<int>& cpus);
+  ScopedCpuAffinity(const ScopedCpuAffinity&) = delete;
+  ScopedCpuAffinity& operator=(const ScopedCpuAffinity&) = delete;
+  ~ScopedCpuAffinity();
+};
+
+struct NumaSchedulerOptions {
+  // workers per node, 0 means one worker per cpu of the node.
+  size_t threads_per_node = 0;
+  // pin each worker to a single core instead of the whole node.
+  bool pin_cores = false;
+  // a request spills to the least loaded node only if the local node has 'spill_threshold' more running
+  // requests than it.
+  int64_t spill_threshold = 16;
+};
+
+/**
+ * @brief Built-in NUMA aware scheduler, could be used instead of 'scheduler' & 'concurrent_executor'.
+ * There is a work stealing scheduler bound to the cpus of each node, a request is pinned to one node: all
+ * its vertexs run on that node's workers and its context comes from that node's pool, so that the data &
+ * processor states are not moved across sockets. Workers never steal across nodes.
+ */
+class NumaScheduler {
+ private:
+  struct alignas(64) NodeLoad {
+    std::atomic<int64_t> running{0};
+  };
+  NumaTopology _topology;
+  NumaSchedulerOptions _options;
+  std::vector<std::unique_ptr<WorkStealingScheduler>> _schedulers;
+  std::unique_ptr<NodeLoad[]> _loads;
+  std::atomic<uint64_t> _spilled{0};
+
+  int LocalNode() const;
+
+ public:
+  explicit NumaScheduler(const NumaSchedulerOptions& options = NumaSchedulerOptions());
+  NumaScheduler(const NumaTopology& topology, const NumaSchedulerOptions& options);
+  NumaScheduler(const NumaScheduler&) = delete;
+  NumaScheduler& operator=(const NumaScheduler&) = delete;
+  size_t NodeNum() const { return _schedulers.size(); }
+  const NumaTopology& GetTopology() const { return _topology; }
+  WorkStealingScheduler* GetScheduler(int node) { return _schedulers[node].get(); }
+  // selects the node of a new request & counts it as running on that node until 'EndRequest'.
+  int BeginRequest();
+  void EndRequest(int node);
+  int64_t RunningRequests(int node) const { return _loads[node].running.load(std::memory_order_relaxed); }
+  // requests which are not executed on the local node
+  uint64_t SpilledRequests() const { return _spilled.load(std::memory_order_relaxed); }
+  size_t PendingTasks() const;
+  void Stop();
+  ~NumaScheduler();
+};
+}  // namespace didagle
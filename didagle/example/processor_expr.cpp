@@ -1,6 +1,11 @@
 // Copyright (c) 2020, Tencent Inc.
 // All rights reserved.
 
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "didagle/didagle_log.h"
 #include "didagle/graph_processor_api.h"
 #include "expr.h"
@@ -8,26 +13,41 @@
 #include "spirit_expression.h"
 
 GRAPH_OP_BEGIN(expr_phase)
+// dynamic var of the expression, compiled once in setup
+struct DynamicVar {
+  std::string name;
+  didagle::ParamsPath path;
+};
 std::string _cond;  // NOLINT
+std::vector<std::unique_ptr<DynamicVar>> _vars;
+// keys of the literal 'has_param' args interned in setup, passed to 'has_param' as handles by the expression
+std::vector<const didagle::ParamsKey*> _param_keys;
 ssexpr::SpiritExpression _expr;
 int OnSetup(const didagle::Params& args) override {
+  _vars.clear();
+  _param_keys.clear();
   ssexpr::ExprOptions opt;
-  opt.dynamic_var_access = [this](const void* root, const std::vector<std::string>& args) -> ssexpr::Value {
-    if (args.size() == 1) {
-      if (args[0].empty()) {
+  opt.dynamic_var_compile = [this](const std::vector<std::string>& args) -> const void* {
+    std::unique_ptr<DynamicVar> var(new DynamicVar);
+    folly::join(".", args, var->name);
+    var->path = didagle::ParamsPath(args);
+    _vars.emplace_back(std::move(var));
+    return _vars.back().get();
+  };
+  opt.dynamic_handle_access = [this](const void* root, const void* handle) -> ssexpr::Value {
+    const DynamicVar* var = reinterpret_cast<const DynamicVar*>(handle);
+    if (var->path.Size() == 1) {
+      if (var->name.empty()) {
         return root;
       }
-      const bool* bv = GetDataContext().Get<bool>(args[0]);
+      const bool* bv = GetDataContext().Get<bool>(var->name);
       if (nullptr != bv) {
         bool rv = *bv;
         return rv;
       }
     }
 
-    const didagle::Params* dynamic_vars = (const didagle::Params*)root;
-    for (const std::string& name : args) {
-      dynamic_vars = &((*dynamic_vars)[name]);
-    }
+    const didagle::Params* dynamic_vars = &(((const didagle::Params*)root)->GetVar(var->path));
     ssexpr::Value r;
     if (dynamic_vars->IsInt()) {
       r = dynamic_vars->Int();
@@ -35,7 +55,7 @@ int OnSetup(const didagle::Params& args) override {
       r = dynamic_vars->Double();
     } else if (dynamic_vars->IsBool()) {
       r = dynamic_vars->Bool();
-      DIDAGLE_DEBUG("####{} {}", args[0], dynamic_vars->Bool());
+      DIDAGLE_DEBUG("####{} {}", var->name, dynamic_vars->Bool());
     } else if (dynamic_vars->IsString()) {
       r = dynamic_vars->String();
     } else {
@@ -44,14 +64,19 @@ int OnSetup(const didagle::Params& args) override {
       } else {
         bool rv = false;
         r = rv;
-        std::string full_args;
-        folly::join(".", args, full_args);
-        DIDAGLE_ERROR("Param:{} is not exist, use 'false' as param value.", full_args);
+        DIDAGLE_ERROR("Param:{} is not exist, use 'false' as param value.", var->name);
       }
     }
     return r;
   };
-  opt.functions["has_param"] = [](const std::vector<ssexpr::Value>& args) {
+  opt.function_arg_compile = [this](const std::string& func, size_t idx, const std::string& arg) -> const void* {
+    if (func != "has_param" || idx != 1) {
+      return nullptr;
+    }
+    _param_keys.emplace_back(didagle::ParamsKeyTable::Global().Intern(arg));
+    return _param_keys.back();
+  };
+  opt.functions["has_param"] = [this](const std::vector<ssexpr::Value>& args) {
     ssexpr::Value r;
     if (args.size() < 2) {
       r = false;
@@ -64,9 +89,20 @@ int OnSetup(const didagle::Params& args) override {
         return r;
       }
       const didagle::Params* params = reinterpret_cast<const didagle::Params*>(v);
+      if (const void* const* handle = std::get_if<const void*>(&args[1])) {
+        // an object given by a dynamic var is not a key
+        const didagle::ParamsKey* key = reinterpret_cast<const didagle::ParamsKey*>(*handle);
+        r = std::find(_param_keys.begin(), _param_keys.end(), key) != _param_keys.end() && params->Contains(*key);
+        return r;
+      }
+      // key not given as a literal, which is not interned since it may be different in each evaluation
       std::string_view param_key = std::get<std::string_view>(args[1]);
-      folly::fbstring param_key_str(param_key.data(), param_key.size());
-      r = params->Contains(param_key_str);
+      const didagle::ParamsKey* key = didagle::ParamsKeyTable::Global().Find(param_key);
+      if (nullptr != key) {
+        r = params->Contains(*key);
+      } else {
+        r = params->Contains(didagle::ParamsString(param_key.data(), param_key.size()));
+      }
     } catch (std::exception& e) {
       r = false;
     }
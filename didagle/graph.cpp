@@ -4,6 +4,10 @@
 
 #include <sys/time.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
 #include <iostream>
 #include <regex>
 #include <set>
@@ -12,6 +16,7 @@
 
 #include "didagle/didagle_background.h"
 #include "didagle/didagle_log.h"
+#include "folly/futures/Future.h"
 
 namespace didagle {
 static inline uint64_t ustime() {
@@ -109,6 +114,7 @@ int Graph::Build() {
         }
       }
       Vertex* cond_vertex = generated_cond_nodes[n.expect];
+      cond_vertex->speculative = cond_vertex->speculative || n.speculative;
       n.deps_on_ok.insert(cond_vertex->id);
     }
     if (_nodes.find(n.id) != _nodes.end()) {
@@ -194,12 +200,54 @@ int Graph::Build() {
     DIDAGLE_ERROR("Empty graph:{} with none vertex", name);
     return -1;
   }
+  BuildStaticLevels();
+  for (auto& pair : _nodes) {
+    pair.second->_setup_signature = pair.second->GetSetupSignature();
+  }
   return 0;
 }
-int Graph::DumpDot(std::string& s) {
+void Graph::BuildStaticLevels() {
+  // level of vertex is the longest path from start vertexs, graph is verified acyclic before
+  std::unordered_map<Vertex*, size_t> levels;
+  std::function<size_t(Vertex*)> get_level = [&](Vertex* v) -> size_t {
+    auto found = levels.find(v);
+    if (found != levels.end()) {
+      return found->second;
+    }
+    size_t level = 0;
+    for (auto& pair : v->_deps_idx) {
+      level = std::max(level, get_level(pair.first) + 1);
+    }
+    levels[v] = level;
+    return level;
+  };
+  _static_levels.clear();
+  for (auto& pair : _nodes) {
+    size_t level = get_level(pair.second);
+    if (level >= _static_levels.size()) {
+      _static_levels.resize(level + 1);
+    }
+    _static_levels[level].emplace_back(pair.second);
+  }
+  for (auto& group : _static_levels) {
+    std::sort(group.begin(), group.end(), [](const Vertex* a, const Vertex* b) { return a->id < b->id; });
+  }
+}
+int Graph::DumpDot(std::string& s, const DAGProfiler* profiler) {
+  const GraphProfile* profile = nullptr != profiler ? profiler->FindGraphProfile(_cluster->_name, name) : nullptr;
   s.append("  subgraph cluster_").append(name).append("{\n");
   s.append("    style = rounded;\n");
-  s.append("    label = \"").append(name).append("\";\n");
+  if (nullptr != profile && profile->total.Count() > 0) {
+    s.append("    label = \"")
+        .append(name)
+        .append("\\np50=")
+        .append(std::to_string(profile->total.Percentile(50)))
+        .append("us p99=")
+        .append(std::to_string(profile->total.Percentile(99)))
+        .append("us\";\n");
+  } else {
+    s.append("    label = \"").append(name).append("\";\n");
+  }
   s.append("    ")
       .append(name + "__START__")
       .append(
@@ -212,7 +260,7 @@ int Graph::DumpDot(std::string& s) {
           "label=\"STOP\"];\n");
   for (auto& pair : _nodes) {
     Vertex* v = pair.second;
-    v->DumpDotDefine(s);
+    v->DumpDotDefine(s, profile);
   }
   std::set<std::string> cfg_setting_vars;
   for (auto& config_setting : _cluster->config_setting) {
@@ -226,7 +274,7 @@ int Graph::DumpDot(std::string& s) {
   }
   for (auto& pair : _nodes) {
     Vertex* v = pair.second;
-    v->DumpDotEdge(s);
+    v->DumpDotEdge(s, profile);
   }
   s.append("};\n");
   return 0;
@@ -279,26 +327,121 @@ int GraphCluster::Build() {
       }
     }
   }
+  size_t node_num = 1;
+  if (nullptr != _graph_manager && _graph_manager->GetGraphExecuteOptions().numa_scheduler) {
+    node_num = _graph_manager->GetGraphExecuteOptions().numa_scheduler->NodeNum();
+  }
+  _context_pools.clear();
+  for (size_t node = 0; node < node_num; node++) {
+    _context_pools.emplace_back(new ContextPool);
+  }
   if (strict_dsl) {
-    GraphClusterContext ctx;
-    if (0 != ctx.Setup(this)) {
+    // the verified context is pooled, so that its processors are not wasted
+    GraphClusterContext* ctx = new GraphClusterContext;
+    if (0 != ctx->Setup(this)) {
+      delete ctx;
       return -1;
     }
-    ctx.Reset();
-  }
-  for (int i = 0; i < default_context_pool_size; i++) {
-    GraphClusterContext* ctx = new GraphClusterContext;
-    ctx->Setup(this);
-    _graph_cluster_context_pool.enqueue(ctx);
+    ctx->Reset();
+    _context_pools[0]->enqueue(ctx);
   }
   _builded = true;
   return 0;
 }
-int GraphCluster::DumpDot(std::string& s) {
+void GraphCluster::HarvestProcessors(GraphCluster* retired) {
+  // the retired cluster gets no new request after the swap, only its idle contexts are taken, running requests
+  // return their contexts to the retired pools which are deleted with it.
+  folly::F14FastSet<uint64_t> signatures;
+  for (auto& pair : _graphs) {
+    for (auto& node : pair.second->_nodes) {
+      signatures.insert(node.second->_setup_signature);
+    }
+  }
+  ReusableProcessorTable released;
+  GraphClusterContext* ctx = nullptr;
+  int64_t harvested = 0;
+  for (auto& pool : retired->_context_pools) {
+    while (harvested < default_context_pool_size && pool->try_dequeue(ctx)) {
+      ctx->ReleaseProcessors(released);
+      delete ctx;
+      harvested++;
+    }
+  }
+  std::lock_guard<std::mutex> guard(_reusable_mutex);
+  for (auto& pair : released) {
+    if (signatures.count(pair.first) == 0) {
+      // vertex changed or removed
+      for (Processor* p : pair.second) {
+        delete p;
+      }
+      continue;
+    }
+    _reload_stats.reused_processors += pair.second.size();
+    std::vector<Processor*>& processors = _reusable_processors[pair.first];
+    processors.insert(processors.end(), pair.second.begin(), pair.second.end());
+  }
+  _has_reusable.store(!_reusable_processors.empty(), std::memory_order_release);
+}
+void GraphCluster::Prewarm() {
+  uint64_t prewarm_start_ustime = ustime();
+  NumaScheduler* numa_scheduler =
+      nullptr != _graph_manager ? _graph_manager->GetGraphExecuteOptions().numa_scheduler.get() : nullptr;
+  size_t node_num = _context_pools.size();
+  // the pool size is shared by all nodes, contexts are setup on the cpus of their node for local memory.
+  int64_t pooled = strict_dsl ? 1 : 0;
+  for (size_t node = 0; node < node_num; node++) {
+    int64_t node_pool_size = default_context_pool_size / node_num +
+                             (static_cast<int64_t>(node) < default_context_pool_size % static_cast<int64_t>(node_num));
+    ScopedCpuAffinity affinity(nullptr != numa_scheduler ? numa_scheduler->GetTopology().node_cpus[node]
+                                                         : std::vector<int>{});
+    for (int64_t i = 0 == node ? pooled : 0; i < node_pool_size; i++) {
+      GraphClusterContext* ctx = new GraphClusterContext;
+      ctx->SetNumaNode(static_cast<int>(node));
+      ctx->Setup(this);
+      _context_pools[node]->enqueue(ctx);
+      pooled++;
+    }
+  }
+  _prewarmed.store(true, std::memory_order_release);
+  _reload_stats.prewarm_us = ustime() - prewarm_start_ustime;
+  _reload_stats.prewarm_contexts = pooled;
+}
+Processor* GraphCluster::AcquireProcessor(const Vertex& v, const std::string& name, bool& reused) {
+  reused = false;
+  if (_has_reusable.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> guard(_reusable_mutex);
+    auto found = _reusable_processors.find(v._setup_signature);
+    if (found != _reusable_processors.end()) {
+      Processor* p = found->second.back();
+      found->second.pop_back();
+      if (found->second.empty()) {
+        _reusable_processors.erase(found);
+        _has_reusable.store(!_reusable_processors.empty(), std::memory_order_release);
+      }
+      reused = true;
+      return p;
+    }
+  }
+  Processor* p = ProcessorFactory::GetProcessor(name);
+  // only the processors created by the build & the prewarm are counted, which are done by the loading thread
+  if (nullptr != p && !_prewarmed.load(std::memory_order_relaxed)) {
+    _reload_stats.created_processors++;
+  }
+  return p;
+}
+void GraphCluster::ClearReusableProcessors() {
+  for (auto& pair : _reusable_processors) {
+    for (Processor* p : pair.second) {
+      delete p;
+    }
+  }
+  _reusable_processors.clear();
+}
+int GraphCluster::DumpDot(std::string& s, const DAGProfiler* profiler) {
   s.append("digraph G {\n");
   s.append("    rankdir=LR;\n");
   for (auto& f : graph) {
-    f.DumpDot(s);
+    f.DumpDot(s, profiler);
   }
   s.append("}\n");
 
@@ -313,25 +456,38 @@ Graph* GraphCluster::FindGraphByName(const std::string& name) {
 }
 bool GraphCluster::Exists(const std::string& graph) { return FindGraphByName(graph) != nullptr; }
 
-GraphClusterContext* GraphCluster::GetContext() {
+GraphClusterContext* GraphCluster::GetContext(int node) {
+  if (node < 0 || static_cast<size_t>(node) >= _context_pools.size()) {
+    node = 0;
+  }
   GraphClusterContext* ctx = nullptr;
-  if (_graph_cluster_context_pool.try_dequeue(ctx)) {
+  if (!_context_pools.empty() && _context_pools[node]->try_dequeue(ctx)) {
     return ctx;
   }
+  // not taken from other nodes, the new context is setup by the caller which is usually on that node.
   ctx = new GraphClusterContext;
+  ctx->SetNumaNode(node);
   ctx->Setup(this);
   return ctx;
 }
 void GraphCluster::ReleaseContext(GraphClusterContext* p) {
   p->Reset();
-  _graph_cluster_context_pool.enqueue(p);
+  size_t node = static_cast<size_t>(p->GetNumaNode());
+  if (node >= _context_pools.size()) {
+    delete p;
+    return;
+  }
+  _context_pools[node]->enqueue(p);
 }
 
 GraphCluster::~GraphCluster() {
   DIDAGLE_DEBUG("Destory GraphCluster");
+  ClearReusableProcessors();
   GraphClusterContext* ctx = nullptr;
-  while (_graph_cluster_context_pool.try_dequeue(ctx)) {
-    delete ctx;
+  for (auto& pool : _context_pools) {
+    while (pool->try_dequeue(ctx)) {
+      delete ctx;
+    }
   }
 }
 
@@ -350,6 +506,7 @@ static std::string get_basename(const std::string& filename) {
 }
 GraphManager::GraphManager(const GraphExecuteOptions& options) : _exec_options(options) {}
 std::shared_ptr<GraphCluster> GraphManager::Load(const std::string& file) {
+  uint64_t load_start_ustime = ustime();
   std::shared_ptr<GraphCluster> g(new GraphCluster);
   bool v = kcfg::ParseFromTomlFile(file, *g);
   if (!v) {
@@ -363,9 +520,30 @@ std::shared_ptr<GraphCluster> GraphManager::Load(const std::string& file) {
     DIDAGLE_ERROR("Failed to build toml script:{}", file);
     return nullptr;
   }
+  // the pools are filled before the swap, so that requests never setup contexts inline after it.
+  g->Prewarm();
+  std::shared_ptr<GraphCluster> retired;
   {
     std::lock_guard<std::mutex> guard(_graphs_mutex);
-    _graphs[std::move(name)].store(g);
+    auto& slot = _graphs[name];
+    retired = slot.load();
+    slot.store(g);
+  }
+  // processors of unchanged vertexs are moved from the idle contexts of the retired version once it gets no new
+  // request, they are reused by the contexts created beyond the pools. the retired version is never touched if
+  // the new version fails to build.
+  if (retired) {
+    g->HarvestProcessors(retired.get());
+  }
+  ClusterReloadStats& stats = g->_reload_stats;
+  stats.cluster = name;
+  stats.reload = nullptr != retired;
+  stats.total_us = ustime() - load_start_ustime;
+  DIDAGLE_INFO("Load cluster:{} cost {}us, prewarm {} contexts cost {}us, reused/created processors:{}/{}", name,
+               stats.total_us, stats.prewarm_contexts, stats.prewarm_us, stats.reused_processors,
+               stats.created_processors);
+  if (_exec_options.reload_reporter) {
+    _exec_options.reload_reporter(stats);
   }
   // _graphs.insert_or_assign(std::move(name), g);
   // auto &&[itr, success] = _graphs.emplace(std::move(name), g);
@@ -375,6 +553,14 @@ std::shared_ptr<GraphCluster> GraphManager::Load(const std::string& file) {
   // }
   return g;
 }
+void GraphManager::AsyncLoad(const std::string& file, std::function<void(std::shared_ptr<GraphCluster>)>&& done) {
+  AsyncResetWorker::GetInstance()->Post([this, file, done = std::move(done)]() {
+    std::shared_ptr<GraphCluster> c = Load(file);
+    if (done) {
+      done(c);
+    }
+  });
+}
 std::shared_ptr<GraphCluster> GraphManager::FindGraphClusterByName(const std::string& name) {
   std::lock_guard<std::mutex> guard(_graphs_mutex);
   auto found = _graphs.find(name);
@@ -383,12 +569,12 @@ std::shared_ptr<GraphCluster> GraphManager::FindGraphClusterByName(const std::st
   }
   return nullptr;
 }
-GraphClusterContext* GraphManager::GetGraphClusterContext(const std::string& cluster) {
+GraphClusterContext* GraphManager::GetGraphClusterContext(const std::string& cluster, int numa_node) {
   std::shared_ptr<GraphCluster> c = FindGraphClusterByName(cluster);
   if (!c) {
     return nullptr;
   }
-  GraphClusterContext* ctx = c->GetContext();
+  GraphClusterContext* ctx = c->GetContext(numa_node);
   ctx->SetRunningCluster(c);
   return ctx;
 }
@@ -403,8 +589,8 @@ bool GraphManager::Exists(const std::string& cluster, const std::string& graph)
 
 int GraphManager::Execute(GraphDataContextPtr& data_ctx, const std::string& cluster, const std::string& graph,
                           const Params* params, DoneClosure&& done, uint64_t time_out_ms) {
-  if (!_exec_options.concurrent_executor) {
-    DIDAGLE_ERROR("Empty concurrent executor");
+  if (!_exec_options.concurrent_executor && !_exec_options.scheduler && !_exec_options.numa_scheduler) {
+    DIDAGLE_ERROR("Empty concurrent executor & scheduler");
     done(-1);
     return -1;
   }
@@ -413,20 +599,82 @@ int GraphManager::Execute(GraphDataContextPtr& data_ctx, const std::string& clus
     done(-1);
     return -1;
   }
-  GraphClusterContext* ctx = GetGraphClusterContext(cluster);
+  // the whole request is pinned to one NUMA node
+  NumaScheduler* numa_scheduler = _exec_options.numa_scheduler.get();
+  int numa_node = nullptr != numa_scheduler ? numa_scheduler->BeginRequest() : 0;
+  GraphClusterContext* ctx = GetGraphClusterContext(cluster, numa_node);
   if (!ctx) {
     DIDAGLE_ERROR("Find graph cluster {} failed.", cluster);
+    if (nullptr != numa_scheduler) {
+      numa_scheduler->EndRequest(numa_node);
+    }
     done(-1);
     return -1;
   }
   ctx->SetExternGraphDataContext(data_ctx.get());
-  ctx->SetExecuteParams(params);
+  // shared by the deadline timer and the graph completion, whichever comes first wins the state & calls 'done'.
+  struct GraphDeadline {
+    enum State { kRunning = 0, kFinished, kTimeout };
+    std::atomic<int> state{kRunning};
+    // cancelled & released by the graph completion, which also breaks the reference from the timer callback.
+    folly::Future<folly::Unit> timer = folly::Future<folly::Unit>::makeEmpty();
+    DoneClosure done;
+    // copy of the caller's params & its parent chain, running vertices may still read them after 'done'.
+    std::vector<Params> params;
+  };
+  std::shared_ptr<GraphDeadline> deadline;
   if (time_out_ms != 0) {
+    deadline = std::make_shared<GraphDeadline>();
+    deadline->done = std::move(done);
+    size_t chain_len = 0;
+    for (const Params* p = params; nullptr != p; p = p->GetParent()) {
+      chain_len++;
+    }
+    // reserved, the copies point to each other
+    deadline->params.reserve(chain_len);
+    for (const Params* p = params; nullptr != p; p = p->GetParent()) {
+      deadline->params.emplace_back(*p);
+      deadline->params.back().SetParent(nullptr);
+    }
+    for (size_t i = 1; i < deadline->params.size(); i++) {
+      deadline->params[i - 1].SetParent(&deadline->params[i]);
+    }
+    params = deadline->params.empty() ? nullptr : &deadline->params.front();
     ctx->SetEndTime(ustime() + time_out_ms * 1000);
+    folly::CancellationSource cancel_source = ctx->EnableCancellation();
+    // the timer only holds the cancel source & the state, the cluster context is never touched by the timer.
+    deadline->timer = folly::futures::sleep(std::chrono::milliseconds(time_out_ms))
+                          .toUnsafeFuture()
+                          .thenValue([cancel_source, deadline](folly::Unit) {
+                            int running = GraphDeadline::kRunning;
+                            if (deadline->state.compare_exchange_strong(running, GraphDeadline::kTimeout)) {
+                              cancel_source.requestCancellation();
+                              // the caller is not held by the running vertices which may ignore the
+                              // cancellation, they only access the copied params & the shared contexts.
+                              deadline->done(ERR_GRAPH_TIMEOUT);
+                            }
+                          });
   }
-  auto graph_done = [this, ctx, done](int code) mutable {
-    done(code);
-    AsyncResetWorker::GetInstance()->Post([this, ctx]() {
+  ctx->SetExecuteParams(params);
+  // pending vertices are skipped & running ones are cancelled on timeout, the completion of a timed out request
+  // is dropped since 'done' had been called by the timer, only the cluster context is released.
+  auto graph_done = [this, ctx, deadline, done = std::move(done), data_ctx, numa_scheduler,
+                     numa_node](int code) mutable {
+    if (nullptr != numa_scheduler) {
+      numa_scheduler->EndRequest(numa_node);
+    }
+    if (deadline) {
+      int running = GraphDeadline::kRunning;
+      bool in_time = deadline->state.compare_exchange_strong(running, GraphDeadline::kFinished);
+      deadline->timer.cancel();
+      deadline->timer = folly::Future<folly::Unit>::makeEmpty();
+      if (in_time) {
+        deadline->done(code);
+      }
+    } else {
+      done(code);
+    }
+    AsyncResetWorker::GetInstance()->Post([this, ctx, data_ctx, deadline]() {
       uint64_t start_exec_ustime = ustime();
       {
         std::shared_ptr<GraphCluster> runing_cluster = ctx->GetRunningCluster();
@@ -441,8 +689,100 @@ int GraphManager::Execute(GraphDataContextPtr& data_ctx, const std::string& clus
       }
     });
   };
+  if (nullptr != numa_scheduler && !numa_scheduler->GetScheduler(numa_node)->InWorkerThread()) {
+    // start on the node's workers, since config settings & sync vertexs of static plan run inline
+    numa_scheduler->GetScheduler(numa_node)->Post([ctx, graph, graph_done = std::move(graph_done)]() mutable {
+      GraphContext* graph_ctx = nullptr;
+      ctx->Execute(graph, std::move(graph_done), graph_ctx);
+    });
+    return 0;
+  }
   GraphContext* graph_ctx = nullptr;
   // ctx->SetExecuteOptions(&_exec_opt);
   return ctx->Execute(graph, graph_done, graph_ctx);
 }
+
+int GraphManager::ExecuteBatch(std::vector<GraphDataContextPtr>& data_ctxs, const std::string& cluster,
+                               const std::string& graph, const std::vector<const Params*>& params,
+                               DoneClosure&& done) {
+  if (!_exec_options.concurrent_executor && !_exec_options.scheduler && !_exec_options.numa_scheduler) {
+    DIDAGLE_ERROR("Empty concurrent executor & scheduler");
+    done(-1);
+    return -1;
+  }
+  if (data_ctxs.empty() || (!params.empty() && params.size() != data_ctxs.size())) {
+    DIDAGLE_ERROR("Invalid batch with {} data contexts & {} params", data_ctxs.size(), params.size());
+    done(-1);
+    return -1;
+  }
+  for (const auto& data_ctx : data_ctxs) {
+    if (!data_ctx) {
+      DIDAGLE_ERROR("Empty 'GraphDataContext'");
+      done(-1);
+      return -1;
+    }
+  }
+  // all requests of the batch use the same version of the cluster
+  std::shared_ptr<GraphCluster> c = FindGraphClusterByName(cluster);
+  if (!c) {
+    DIDAGLE_ERROR("Find graph cluster {} failed.", cluster);
+    done(-1);
+    return -1;
+  }
+  // the batch is pinned to one NUMA node as a request
+  NumaScheduler* numa_scheduler = _exec_options.numa_scheduler.get();
+  int numa_node = nullptr != numa_scheduler ? numa_scheduler->BeginRequest() : 0;
+  std::vector<GraphClusterContext*> ctxs;
+  std::vector<GraphContext*> graph_ctxs;
+  auto batch = std::make_shared<GraphBatchContext>();
+  for (size_t i = 0; i < data_ctxs.size(); i++) {
+    GraphClusterContext* ctx = c->GetContext(numa_node);
+    ctx->SetRunningCluster(c);
+    ctx->SetExternGraphDataContext(data_ctxs[i].get());
+    ctx->SetExecuteParams(params.empty() ? nullptr : params[i]);
+    ctxs.emplace_back(ctx);
+    GraphContext* graph_ctx = ctx->PrepareExecute(graph);
+    if (nullptr == graph_ctx) {
+      break;
+    }
+    graph_ctxs.emplace_back(graph_ctx);
+  }
+  if (graph_ctxs.size() != data_ctxs.size() || 0 != batch->Setup(graph_ctxs)) {
+    DIDAGLE_ERROR("Failed to setup batch execution of graph:{} in cluster:{}", graph, cluster);
+    for (GraphClusterContext* ctx : ctxs) {
+      c->ReleaseContext(ctx);
+    }
+    if (nullptr != numa_scheduler) {
+      numa_scheduler->EndRequest(numa_node);
+    }
+    done(-1);
+    return -1;
+  }
+  auto batch_done = [this, c, ctxs, batch, data_ctxs, numa_scheduler, numa_node,
+                     done = std::move(done)](int code) mutable {
+    if (nullptr != numa_scheduler) {
+      numa_scheduler->EndRequest(numa_node);
+    }
+    done(code);
+    AsyncResetWorker::GetInstance()->Post([this, c, ctxs, batch, data_ctxs]() {
+      uint64_t start_exec_ustime = ustime();
+      for (GraphClusterContext* ctx : ctxs) {
+        c->ReleaseContext(ctx);
+      }
+      if (_exec_options.event_reporter) {
+        DAGEvent event;
+        event.start_ustime = start_exec_ustime;
+        event.end_ustime = ustime();
+        event.phase = PhaseType::DAG_PHASE_GRAPH_ASYNC_RESET;
+        _exec_options.event_reporter(std::move(event));
+      }
+    });
+  };
+  if (nullptr != numa_scheduler && !numa_scheduler->GetScheduler(numa_node)->InWorkerThread()) {
+    numa_scheduler->GetScheduler(numa_node)->Post(
+        [batch, batch_done = std::move(batch_done)]() mutable { batch->Execute(std::move(batch_done)); });
+    return 0;
+  }
+  return batch->Execute(std::move(batch_done));
+}
 }  // namespace didagle
@@ -10,6 +10,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -19,6 +20,7 @@
 #include "concurrentqueue.h"
 #include "folly/concurrency/AtomicSharedPtr.h"
 #include "folly/container/F14Map.h"
+#include "folly/container/F14Set.h"
 
 #include "didagle/graph_executor.h"
 #include "didagle/graph_vertex.h"
@@ -32,6 +34,8 @@ struct Graph {
   std::vector<Vertex> vertex;
   std::string expect_version = "";
   int priority = -1;
+  // execute by a precomputed topological plan if all vertexs are sync processors
+  bool static_schedule = false;
 
   typedef std::unordered_map<std::string, Vertex*> VertexTable;
   std::vector<std::shared_ptr<Vertex>> _gen_vertex;
@@ -39,15 +43,19 @@ struct Graph {
   VertexTable _data_mapping_table;
   int64_t _idx = 0;
   GraphCluster* _cluster = nullptr;
+  // vertexs of the same level only depend on vertexs of previous levels, sorted by id,
+  // used by the static schedule & the batch execution.
+  std::vector<std::vector<Vertex*>> _static_levels;
 
-  KCFG_TOML_DEFINE_FIELDS(name, vertex, expect_version, priority)
+  KCFG_TOML_DEFINE_FIELDS(name, vertex, expect_version, priority, static_schedule)
   std::string generateNodeId();
   Vertex* geneatedCondVertex(const std::string& cond);
   Vertex* FindVertexByData(const std::string& data);
   Vertex* FindVertexById(const std::string& id);
 
   int Build();
-  int DumpDot(std::string& s);
+  void BuildStaticLevels();
+  int DumpDot(std::string& s, const DAGProfiler* profiler = nullptr);
   bool TestCircle();
   ~Graph();
 };
@@ -69,14 +77,36 @@ struct GraphCluster {
   bool _builded = false;
 
   // tbb::concurrent_queue<GraphClusterContext *> _graph_cluster_context_pool;
-  moodycamel::ConcurrentQueue<GraphClusterContext*> _graph_cluster_context_pool;
+  typedef moodycamel::ConcurrentQueue<GraphClusterContext*> ContextPool;
+  // node local pools if 'numa_scheduler' is set, or else only one pool
+  std::vector<std::unique_ptr<ContextPool>> _context_pools;
   KCFG_TOML_DEFINE_FIELDS(desc, strict_dsl, default_expr_processor, default_context_pool_size, graph, config_setting)
 
+  // processors harvested from the retired version of this cluster after the swap, reused by the contexts created
+  // beyond the pools. requests may setup contexts concurrently, so it's guarded by the mutex.
+  ReusableProcessorTable _reusable_processors;
+  std::mutex _reusable_mutex;
+  std::atomic<bool> _has_reusable{false};
+  std::atomic<bool> _prewarmed{false};
+  ClusterReloadStats _reload_stats;
+
+  // builds graphs & creates the empty context pools, the pools are filled by 'Prewarm'.
   int Build();
+  // moves processors of unchanged vertexs out of the idle contexts of 'retired', which has been swapped out by this
+  // cluster, the others are deleted.
+  void HarvestProcessors(GraphCluster* retired);
+  // fills the context pools before the cluster is swapped in.
+  void Prewarm();
+  // reuses a harvested processor with the same setup signature if there is any, 'reused' processors are setup.
+  Processor* AcquireProcessor(const Vertex& v, const std::string& name, bool& reused);
+  void ClearReusableProcessors();
   bool ContainsConfigSetting(const std::string& name);
-  int DumpDot(std::string& s);
+  // annotate vertexes with p50/p99 execute latency & highlight critical path if 'profiler' is not null
+  int DumpDot(std::string& s, const DAGProfiler* profiler = nullptr);
   Graph* FindGraphByName(const std::string& name);
-  GraphClusterContext* GetContext();
+  // the context is taken from the pool of NUMA 'node', or created for that node if the pool is empty.
+  GraphClusterContext* GetContext(int node = 0);
+  // the context is returned to the pool of its node.
   void ReleaseContext(GraphClusterContext* p);
   inline const GraphManager* GetGraphManager() const { return _graph_manager; }
   bool Exists(const std::string& graph);
@@ -98,10 +128,19 @@ class GraphManager {
   explicit GraphManager(const GraphExecuteOptions& options);
   inline const GraphExecuteOptions& GetGraphExecuteOptions() const { return _exec_options; }
   std::shared_ptr<GraphCluster> Load(const std::string& file);
+  // loads(or reloads) in background, the new cluster is swapped in once it's built & its contexts are prewarmed
+  // with the processors of the retired version, 'done' is called with nullptr if it's failed.
+  void AsyncLoad(const std::string& file, std::function<void(std::shared_ptr<GraphCluster>)>&& done);
   std::shared_ptr<GraphCluster> FindGraphClusterByName(const std::string& name);
-  GraphClusterContext* GetGraphClusterContext(const std::string& cluster);
+  GraphClusterContext* GetGraphClusterContext(const std::string& cluster, int numa_node = 0);
   int Execute(GraphDataContextPtr& data_ctx, const std::string& cluster, const std::string& graph, const Params* params,
               DoneClosure&& done, uint64_t = 0);
+  /**
+   * @brief executes the graph over a batch of requests together, 'params' is empty or has the same size as
+   * 'data_ctxs', 'done' is called once all requests finished.
+   */
+  int ExecuteBatch(std::vector<GraphDataContextPtr>& data_ctxs, const std::string& cluster, const std::string& graph,
+                   const std::vector<const Params*>& params, DoneClosure&& done);
   bool Exists(const std::string& cluster, const std::string& graph);
 };
 }  // namespace didagle
\ No newline at end of file
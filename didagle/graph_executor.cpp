@@ -6,6 +6,8 @@
 #include <sys/time.h>
 #include <time.h>
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <regex>
@@ -17,6 +19,8 @@
 #include "didagle/graph.h"
 #include "didagle/graph_processor.h"
 #include "folly/executors/InlineExecutor.h"
+#include "folly/experimental/coro/WithCancellation.h"
+#include "folly/futures/Future.h"
 
 namespace didagle {
 static inline uint64_t ustime() {
@@ -43,9 +47,11 @@ int VertexContext::Setup(GraphContext* g, Vertex* v) {
   _graph_ctx = g;
   _vertex = v;
   // todo get processor
+  bool processor_reused = false;
+  GraphCluster* cluster = _graph_ctx->GetGraphCluster();
   if (!_vertex->graph.empty()) {
     if (!_vertex->while_cluster.empty()) {
-      _processor = ProcessorFactory::GetProcessor(kDefaultWhileOperatorName);
+      _processor = cluster->AcquireProcessor(*_vertex, kDefaultWhileOperatorName, processor_reused);
     } else {
       // get subgraph at runtime
       // remove suffix
@@ -58,7 +64,7 @@ int VertexContext::Setup(GraphContext* g, Vertex* v) {
       _full_graph_name.append("_").append(_vertex->graph);
     }
   } else {
-    _processor = ProcessorFactory::GetProcessor(_vertex->processor);
+    _processor = cluster->AcquireProcessor(*_vertex, _vertex->processor, processor_reused);
     if (_processor) {
       _processor->id_ = _vertex->id;
     }
@@ -70,6 +76,9 @@ int VertexContext::Setup(GraphContext* g, Vertex* v) {
     }
   }
   _params = _vertex->args;
+  if (nullptr != _graph_ctx->GetProfile()) {
+    _profile = _graph_ctx->GetProfile()->GetVertexProfile(_vertex->id);
+  }
 
   for (const auto& select : _vertex->select_args) {
     SelectCondParamsContext select_ctx;
@@ -100,6 +109,13 @@ int VertexContext::Setup(GraphContext* g, Vertex* v) {
     if (0 != _processor_di->PrepareOutputs(_vertex->output)) {
       return -1;
     }
+    const GraphManager* manager = _graph_ctx->GetGraphCluster()->GetGraphManager();
+    if (_vertex->memoize && _vertex->graph.empty() && nullptr != manager) {
+      _memo_cache = manager->GetGraphExecuteOptions().memo_cache.get();
+    }
+  }
+  if (nullptr != _processor) {
+    _spec_cond_idx = _vertex->GetSpeculativeCondIndex();
   }
   Reset();
   if (nullptr != _processor) {
@@ -112,18 +128,40 @@ int VertexContext::Setup(GraphContext* g, Vertex* v) {
       _params[kWhileExecGraphParamKey].SetString(_vertex->graph);
       _params[kWhileAsyncExecParamKey].SetBool(_vertex->while_async);
     }
+    if (processor_reused) {
+      return 0;
+    }
     return _processor->Setup(_params);
   }
   return 0;
 }
 
+void VertexContext::ReleaseProcessor(ReusableProcessorTable& processors) {
+  if (nullptr == _processor) {
+    return;
+  }
+  processors[_vertex->_setup_signature].emplace_back(_processor);
+  _processor = nullptr;
+}
+
 void VertexContext::Reset() {
   _exec_start_ustime = 0;
+  _ready_by = nullptr;
+  _ready_ustime = 0;
+  _start_ustime = 0;
+  _end_ustime = 0;
   _result = V_RESULT_INVALID;
   _code = V_CODE_INVALID;
   _exec_rc = INT_MAX;
+  _memo_pending = false;
   _deps_results.assign(_vertex->_deps_idx.size(), V_RESULT_INVALID);
-  _waiting_num = _vertex->_deps_idx.size();
+  _speculative = _spec_cond_idx >= 0;
+  _spec_gate = 2;
+  _spec_cond_result = V_RESULT_INVALID;
+  _spec_code = 0;
+  _spec_end_ustime = 0;
+  // speculative branch is not readied by the condition vertex
+  _waiting_num = _vertex->_deps_idx.size() - (_speculative ? 1 : 0);
   if (nullptr != _processor) {
     _processor->Reset();
   }
@@ -142,6 +180,11 @@ void VertexContext::Reset() {
   _params.SetParent(nullptr);
   _exec_params = nullptr;
   _exec_mathced_cond = "";
+  CancelTimeoutTimer();
+  _exec_cancel_token = folly::CancellationToken();
+  if (nullptr != _processor) {
+    _processor->SetCancellationToken(nullptr);
+  }
 }
 
 VertexContext::VertexContext() { _waiting_num = 0; }
@@ -160,13 +203,82 @@ void VertexContext::SetupSuccessors() {
   }
 }
 
+void VertexContext::SetupStaticDeps() {
+  _dep_ctxs.assign(_vertex->_deps_idx.size(), nullptr);
+  for (auto& pair : _vertex->_deps_idx) {
+    _dep_ctxs[pair.second] = _graph_ctx->FindVertexContext(pair.first);
+  }
+}
+
+void VertexContext::PrepareStaticDeps() {
+  for (size_t i = 0; i < _dep_ctxs.size(); i++) {
+    _deps_results[i] = _dep_ctxs[i]->GetResult();
+  }
+  if (nullptr != _profile) {
+    // the last finished dependency readies the vertex as in dynamic scheduling, the critical path follows it
+    for (VertexContext* dep : _dep_ctxs) {
+      if (nullptr == _ready_by || dep->_end_ustime > _ready_by->_end_ustime) {
+        _ready_by = dep;
+      }
+    }
+    _ready_ustime = ustime();
+  }
+}
+
 void VertexContext::FinishVertexProcess(int code) {
+  CancelTimeoutTimer();
+  if (_speculative) {
+    _spec_code = code;
+    _spec_end_ustime = ustime();
+    if (1 != _spec_gate.fetch_sub(1)) {
+      // the condition vertex is still running
+      return;
+    }
+    code = CommitSpeculation();
+  }
+  CompleteVertexProcess(code);
+}
+
+void VertexContext::OnSpeculativeCondDone(VertexResult r) {
+  _spec_cond_result.store(r);
+  if (1 == _spec_gate.fetch_sub(1)) {
+    CompleteVertexProcess(CommitSpeculation());
+  }
+}
+
+int VertexContext::CommitSpeculation() {
+  VertexResult r = static_cast<VertexResult>(_spec_cond_result.load());
+  _deps_results[_spec_cond_idx] = r;
+  bool matched = 0 != (r & _vertex->_deps_expected_results[_spec_cond_idx]);
+  bool executed = 0 != _exec_start_ustime;
+  if (nullptr != _profile && executed) {
+    _profile->speculation_count.fetch_add(1, std::memory_order_relaxed);
+    if (!matched) {
+      _profile->speculation_wasted.fetch_add(1, std::memory_order_relaxed);
+      _profile->speculation_waste.Record(_spec_end_ustime - _exec_start_ustime);
+    }
+  }
+  if (matched) {
+    return _spec_code;
+  }
+  // the outputs are left in the processor & never collected
+  DIDAGLE_DEBUG("Vertex:{} discard speculative execution", _vertex->GetDotLable());
+  return V_CODE_SKIP;
+}
+
+void VertexContext::CompleteVertexProcess(int code) {
   _code = (VertexErrCode)code;
   DAGEventTracker* tracker = _graph_ctx->GetGraphDataContextRef().GetEventTracker();
   if (_exec_rc == INT_MAX) {
     _exec_rc = _code;
   }
-  auto exec_end_ustime = ustime();
+  auto exec_end_ustime = 0 != _spec_end_ustime ? _spec_end_ustime : ustime();
+  if (nullptr != _profile) {
+    _end_ustime = exec_end_ustime;
+    if (0 != _exec_start_ustime) {
+      _profile->execute.Record(exec_end_ustime - _exec_start_ustime);
+    }
+  }
   if (0 != _code) {
     _result = V_RESULT_ERR;
     if (nullptr != _processor_di) {
@@ -174,6 +286,9 @@ void VertexContext::FinishVertexProcess(int code) {
     }
   } else {
     _result = V_RESULT_OK;
+    if (_memo_pending) {
+      StoreMemoized();
+    }
     if (nullptr != _processor_di) {
       uint64_t post_exec_start_ustime = ustime();
       _processor_di->CollectOutputs(_graph_ctx->GetGraphDataContextRef(), _exec_params);
@@ -206,6 +321,59 @@ void VertexContext::FinishVertexProcess(int code) {
   }
   _graph_ctx->OnVertexDone(this);
 }
+void VertexContext::PrepareCancellation() {
+  const folly::CancellationToken& request_token = _graph_ctx->GetGraphClusterContext()->GetCancellationToken();
+  if (_vertex->timeout_ms <= 0) {
+    _exec_cancel_token = request_token;
+    return;
+  }
+  folly::CancellationSource vertex_source;
+  _exec_cancel_token = folly::CancellationToken::merge(request_token, vertex_source.getToken());
+  _exec_timer = folly::futures::sleep(std::chrono::milliseconds(_vertex->timeout_ms))
+                    .toUnsafeFuture()
+                    .thenValue([vertex_source](folly::Unit) { vertex_source.requestCancellation(); });
+}
+void VertexContext::CancelTimeoutTimer() {
+  if (!_exec_timer.valid()) {
+    return;
+  }
+  // the interrupt removes the timer from the timekeeper, a timer already fired is not affected.
+  _exec_timer.cancel();
+  _exec_timer = folly::Future<folly::Unit>::makeEmpty();
+}
+
+bool VertexContext::ExecuteMemoized() {
+  MemoHasher hasher;
+  if (!_processor->HashInputs(*_exec_params, hasher)) {
+    DIDAGLE_DEBUG("Vertex:{} has unhashable inputs, skip memoization", _vertex->GetDotLable());
+    return false;
+  }
+  _memo_key = hasher.GetKey();
+  MemoEntryPtr entry = _memo_cache->Get(_memo_key);
+  if (!entry || !_processor->RestoreOutputs(entry->outputs)) {
+    _memo_pending = true;
+    return false;
+  }
+  _exec_start_ustime = ustime();
+  _exec_rc = 0;
+  FinishVertexProcess(0);
+  return true;
+}
+
+void VertexContext::StoreMemoized() {
+  _memo_pending = false;
+  // failed executions may be transient(timeout, cancellation), only successful results are cached.
+  if (0 != _exec_rc) {
+    return;
+  }
+  auto entry = std::make_shared<MemoEntry>();
+  if (!_processor->SnapshotOutputs(entry->outputs)) {
+    DIDAGLE_DEBUG("Vertex:{} has uncopyable outputs, skip memoization", _vertex->GetDotLable());
+    return;
+  }
+  _memo_cache->Put(_memo_key, std::move(entry));
+}
+
 const Params* VertexContext::GetExecParams(std::string_view* matched_cond) {
   Params* exec_params = nullptr;
   const Params* cluster_exec_params = _graph_ctx->GetGraphClusterContext()->GetExecuteParams();
@@ -254,7 +422,7 @@ const Params* VertexContext::GetExecParams(std::string_view* matched_cond) {
   return exec_params;
 }
 
-int VertexContext::ExecuteProcessor() {
+bool VertexContext::PrepareProcessor() {
   DIDAGLE_DEBUG("Vertex:{} begin execute", _vertex->GetDotLable());
   auto prepare_start_us = ustime();
   _processor->SetDataContext(_graph_ctx->GetGraphDataContext());
@@ -263,7 +431,7 @@ int VertexContext::ExecuteProcessor() {
   if (0 != _processor_di->InjectInputs(_graph_ctx->GetGraphDataContextRef(), _exec_params)) {
     DIDAGLE_DEBUG("Vertex:{} inject inputs failed", _vertex->GetDotLable());
     FinishVertexProcess(V_CODE_SKIP);
-    return 0;
+    return false;
   }
   auto prepare_end_ustime = ustime();
   DAGEventTracker* tracker = _graph_ctx->GetGraphDataContextRef().GetEventTracker();
@@ -274,42 +442,56 @@ int VertexContext::ExecuteProcessor() {
     event->phase = PhaseType::DAG_PHASE_OP_PREPARE_EXECUTE;
     tracker->Add(std::move(event));
   }
+  if (nullptr != _profile) {
+    _profile->prepare.Record(prepare_end_ustime - prepare_start_us);
+  }
+  // a cache hit short-circuits to collecting the restored outputs
+  if (nullptr != _memo_cache && ExecuteMemoized()) {
+    return false;
+  }
+  PrepareCancellation();
+  _processor->SetCancellationToken(&_exec_cancel_token);
   _exec_start_ustime = ustime();
+  return true;
+}
+
+void VertexContext::FinishProcessorExecute(int rc) {
+  _exec_rc = rc;
+  FinishVertexProcess((_vertex->ignore_processor_execute_error && !_vertex->IsCondVertex()) ? 0 : _exec_rc);
+}
+
+int VertexContext::ExecuteProcessor() {
+  if (!PrepareProcessor()) {
+    return 0;
+  }
   switch (_processor->GetExecMode()) {
     case Processor::ExecMode::EXEC_ASYNC_FUTURE: {
       try {
-        _processor->FutureExecute(*_exec_params).thenValue([this](int rc) {
-          _exec_rc = rc;
-          FinishVertexProcess((_vertex->ignore_processor_execute_error && !_vertex->IsCondVertex()) ? 0 : _exec_rc);
-        });
+        _processor->FutureExecute(*_exec_params).thenValue([this](int rc) { FinishProcessorExecute(rc); });
       } catch (std::exception& ex) {
         DIDAGLE_ERROR("Vertex:{} execute with caught excetion:{} ", _vertex->GetDotLable(), ex.what());
-        _exec_rc = V_CODE_ERR;
-        FinishVertexProcess((_vertex->ignore_processor_execute_error && !_vertex->IsCondVertex()) ? 0 : _exec_rc);
+        FinishProcessorExecute(V_CODE_ERR);
       } catch (...) {
         DIDAGLE_ERROR("Vertex:{} execute with caught unknown excetion.", _vertex->GetDotLable());
-        _exec_rc = V_CODE_ERR;
-        FinishVertexProcess((_vertex->ignore_processor_execute_error && !_vertex->IsCondVertex()) ? 0 : _exec_rc);
+        FinishProcessorExecute(V_CODE_ERR);
       }
       break;
     }
 #if ISPINE_HAS_COROUTINES
     case Processor::ExecMode::EXEC_STD_COROUTINE: {
       folly::QueuedImmediateExecutor* ex = &(folly::QueuedImmediateExecutor::instance());
-      ispine::coro_spawn(ex, _processor->CoroExecute(*_exec_params)).via(ex).thenValue([this](int rc) {
-        _exec_rc = rc;
-        FinishVertexProcess((_vertex->ignore_processor_execute_error && !_vertex->IsCondVertex()) ? 0 : _exec_rc);
-      });
+      ispine::coro_spawn(ex, folly::coro::co_withCancellation(_exec_cancel_token, _processor->CoroExecute(*_exec_params)))
+          .via(ex)
+          .thenValue([this](int rc) { FinishProcessorExecute(rc); });
       break;
     }
 #endif
     case Processor::ExecMode::EXEC_ADAPTIVE: {
 #if ISPINE_HAS_COROUTINES
       folly::QueuedImmediateExecutor* ex = &(folly::QueuedImmediateExecutor::instance());
-      ispine::coro_spawn(ex, _processor->AExecute(*_exec_params)).via(ex).thenValue([this](int rc) {
-        _exec_rc = rc;
-        FinishVertexProcess((_vertex->ignore_processor_execute_error && !_vertex->IsCondVertex()) ? 0 : _exec_rc);
-      });
+      ispine::coro_spawn(ex, folly::coro::co_withCancellation(_exec_cancel_token, _processor->AExecute(*_exec_params)))
+          .via(ex)
+          .thenValue([this](int rc) { FinishProcessorExecute(rc); });
 #else
       try {
         _exec_rc = _processor->AExecute(*_exec_params);
@@ -320,7 +502,7 @@ int VertexContext::ExecuteProcessor() {
         DIDAGLE_ERROR("Vertex:{} execute with caught unknown excetion.", _vertex->GetDotLable());
         _exec_rc = V_CODE_ERR;
       }
-      FinishVertexProcess((_vertex->ignore_processor_execute_error && !_vertex->IsCondVertex()) ? 0 : _exec_rc);
+      FinishProcessorExecute(_exec_rc);
 #endif
       break;
     }
@@ -334,7 +516,7 @@ int VertexContext::ExecuteProcessor() {
         DIDAGLE_ERROR("Vertex:{} execute with caught unknown excetion.", _vertex->GetDotLable());
         _exec_rc = V_CODE_ERR;
       }
-      FinishVertexProcess((_vertex->ignore_processor_execute_error && !_vertex->IsCondVertex()) ? 0 : _exec_rc);
+      FinishProcessorExecute(_exec_rc);
       break;
     }
   }
@@ -347,6 +529,8 @@ int VertexContext::ExecuteSubGraph() {
   }
   _exec_start_ustime = ustime();
   _exec_params = GetExecParams(&_exec_mathced_cond);
+  PrepareCancellation();
+  _subgraph_cluster->SetCancellationToken(_exec_cancel_token);
   _subgraph_cluster->SetExternGraphDataContext(_graph_ctx->GetGraphDataContext());
   _subgraph_cluster->SetExecuteParams(_exec_params);
   // succeed end time
@@ -355,18 +539,31 @@ int VertexContext::ExecuteSubGraph() {
       _vertex->graph, [this](int code) { FinishVertexProcess(code); }, _subgraph_ctx);
   return 0;
 }
-int VertexContext::Execute() {
+bool VertexContext::CheckExecute() {
+  if (nullptr != _profile) {
+    _start_ustime = ustime();
+    _profile->sched_delay.Record(_start_ustime > _ready_ustime ? _start_ustime - _ready_ustime : 0);
+  }
   bool match_dep_expected_result = true;
   if (!_vertex->cluster.empty() && nullptr != _vertex->_graph->_cluster->_graph_manager &&
       nullptr == _subgraph_cluster) {
-    _subgraph_cluster = _vertex->_graph->_cluster->_graph_manager->GetGraphClusterContext(_vertex->cluster);
+    _subgraph_cluster = _vertex->_graph->_cluster->_graph_manager->GetGraphClusterContext(
+        _vertex->cluster, _graph_ctx->GetGraphClusterContext()->GetNumaNode());
   }
   if (nullptr == _processor && nullptr == _subgraph_cluster) {
     match_dep_expected_result = false;
     DIDAGLE_DEBUG("Vertex:{} has empty processor and empty subgraph context.", _vertex->GetDotLable());
   } else {
     for (size_t i = 0; i < _deps_results.size(); i++) {
-      if (V_RESULT_INVALID == _deps_results[i] || (0 == (_deps_results[i] & _vertex->_deps_expected_results[i]))) {
+      VertexResult dep_result = _deps_results[i];
+      if (_speculative && static_cast<int>(i) == _spec_cond_idx) {
+        // skip the speculation if the condition is finished already & not matched
+        dep_result = static_cast<VertexResult>(_spec_cond_result.load());
+        if (V_RESULT_INVALID == dep_result) {
+          continue;
+        }
+      }
+      if (V_RESULT_INVALID == dep_result || (0 == (dep_result & _vertex->_deps_expected_results[i]))) {
         match_dep_expected_result = false;
         break;
       }
@@ -398,31 +595,59 @@ int VertexContext::Execute() {
     }
   }
 
-  if (!match_dep_expected_result || (_graph_ctx->GetGraphClusterContext()->GetEndTime() != 0 &&
-                                     ustime() >= _graph_ctx->GetGraphClusterContext()->GetEndTime())) {
+  GraphClusterContext* cluster_ctx = _graph_ctx->GetGraphClusterContext();
+  if (!match_dep_expected_result || cluster_ctx->GetCancellationToken().isCancellationRequested() ||
+      (cluster_ctx->GetEndTime() != 0 && ustime() >= cluster_ctx->GetEndTime())) {
     _result = V_RESULT_ERR;
     _code = V_CODE_SKIP;
     // no need to exec this
     FinishVertexProcess(_code);
+    return false;
+  }
+  return true;
+}
+
+int VertexContext::Execute() {
+  if (!CheckExecute()) {
+    return 0;
+  }
+  if (nullptr != _processor) {
+    ExecuteProcessor();
   } else {
-    if (nullptr != _processor) {
-      ExecuteProcessor();
-    } else {
-      ExecuteSubGraph();
-    }
+    ExecuteSubGraph();
   }
   return 0;
 }
 
+void VertexContext::RunTask() {
+  if (0 != _sched_ustime) {
+    DAGEventTracker* tracker = _graph_ctx->GetGraphDataContextRef().GetEventTracker();
+    if (nullptr != tracker) {
+      auto event = std::make_unique<DAGEvent>();
+      event->start_ustime = _sched_ustime;
+      event->end_ustime = ustime();
+      event->phase = PhaseType::DAG_PHASE_CONCURRENT_SCHED;
+      tracker->Add(std::move(event));
+    }
+    _sched_ustime = 0;
+  }
+  Execute();
+}
+
 GraphContext::GraphContext() : _cluster(nullptr), _graph(nullptr), _children_count(0) {
   _join_vertex_num = 0;
   // _data_ctx.reset(new GraphDataContext);
   _data_ctx = GraphDataContext::New();
+  _data_ctx->EnableMemArena();
 }
 
 int GraphContext::Setup(GraphClusterContext* c, Graph* g) {
   _cluster = c;
   _graph = g;
+  const GraphManager* manager = _cluster->GetCluster()->GetGraphManager();
+  if (nullptr != manager && manager->GetGraphExecuteOptions().profiler) {
+    _profile = manager->GetGraphExecuteOptions().profiler->GetGraphProfile(g->_cluster->_name, g->name);
+  }
 
   size_t child_idx = 0;
   std::set<DIObjectKey> all_output_ids;
@@ -473,7 +698,28 @@ int GraphContext::Setup(GraphClusterContext* c, Graph* g) {
             return -1;
           }
         }
-        if (!entry.info.flags.is_extern) {
+        // resolve every static data name to a dense slot, injection is then plain array indexing
+        if (nullptr != data && !data->aggregate.empty()) {
+          entry.aggregate_idxs.clear();
+          entry.aggregate_var_paths.clear();
+          for (const std::string& aggregate_id : data->aggregate) {
+            int32_t idx = -1;
+            ParamsPath var_path;
+            if (!aggregate_id.empty() && aggregate_id[0] == '$') {
+              var_path = ParamsPath(std::string_view(aggregate_id).substr(1));
+            }
+            entry.aggregate_var_paths.emplace_back(std::move(var_path));
+            if (!entry.info.flags.is_extern && !aggregate_id.empty() && aggregate_id[0] != '$') {
+              DIObjectKey aggregate_key;
+              aggregate_key.name = aggregate_id;
+              aggregate_key.id = key.id;
+              idx = static_cast<int32_t>(_data_ctx->RegisterData(aggregate_key));
+            }
+            entry.aggregate_idxs.emplace_back(idx);
+          }
+        } else if (!key.name.empty() && key.name[0] == '$') {
+          entry.var_path = ParamsPath(std::string_view(key.name).substr(1));
+        } else if (!entry.info.flags.is_extern) {
           entry.idx = static_cast<int32_t>(_data_ctx->RegisterData(key));
         }
         //_all_input_ids.insert(key);
@@ -489,22 +735,124 @@ int GraphContext::Setup(GraphClusterContext* c, Graph* g) {
         const DIObjectKey& key = entry.info;
         if (key.name[0] != '$') {
           entry.idx = static_cast<int32_t>(_data_ctx->RegisterData(key));
+        } else {
+          entry.var_path = ParamsPath(std::string_view(key.name).substr(1));
         }
       }
     }
   }
 
+  // only local data has slot, 'move_from_when_skipped' may come from parent context
+  for (auto& pair : _vertex_context_table) {
+    ProcessorDI* di = pair.second->GetProcessorDI();
+    if (nullptr == di) {
+      continue;
+    }
+    for (auto& entry : di->GetOutputIds()) {
+      if (nullptr != entry.data && !entry.data->move_from_when_skipped.empty()) {
+        DIObjectKey from_key;
+        from_key.name = entry.data->move_from_when_skipped;
+        from_key.id = entry.info.id;
+        entry.move_from_idx = _data_ctx->FindDataIndex(from_key);
+      }
+    }
+  }
+
   for (auto& pair : _vertex_context_table) {
     std::shared_ptr<VertexContext>& ctx = pair.second;
     if (ctx->Ready()) {
       _start_ctxs.emplace_back(ctx.get());
     }
   }
+  if (0 != SetupStaticPlan()) {
+    return -1;
+  }
 
   Reset();
   return 0;
 }
 
+int GraphContext::SetupStaticPlan() {
+  _static_levels.clear();
+  _use_static_plan = false;
+  if (!_graph->static_schedule || _graph->_static_levels.empty()) {
+    return 0;
+  }
+  for (const auto& group : _graph->_static_levels) {
+    for (Vertex* v : group) {
+      VertexContext* ctx = FindVertexContext(v);
+      if (nullptr == ctx) {
+        DIDAGLE_ERROR("Graph:{} has no context for vertex:{}.", _graph->name, v->GetDotLable());
+        return -1;
+      }
+      Processor* p = ctx->GetProcessor();
+      // subgraph/async/IO/speculative vertexs need the dynamic executor
+      if (nullptr == p || !v->cluster.empty() || p->GetExecMode() != Processor::ExecMode::EXEC_SYNC ||
+          p->isIOProcessor() || ctx->_spec_cond_idx >= 0) {
+        DIDAGLE_DEBUG("Graph:{} use dynamic executor since vertex:{} is not a sync processor or speculative.",
+                      _graph->name, v->GetDotLable());
+        _static_levels.clear();
+        return 0;
+      }
+    }
+  }
+  for (size_t level = 0; level < _graph->_static_levels.size(); level++) {
+    const auto& group = _graph->_static_levels[level];
+    std::vector<VertexContext*> ctxs;
+    for (Vertex* v : group) {
+      VertexContext* ctx = FindVertexContext(v);
+      ctx->SetupStaticDeps();
+      ctx->_static_level = level;
+      ctx->_static_parallel = group.size() > 1;
+      ctxs.emplace_back(ctx);
+    }
+    _static_levels.emplace_back(std::move(ctxs));
+  }
+  _use_static_plan = true;
+  return 0;
+}
+
+void GraphContext::RunStaticPlan(size_t level) {
+  for (; level < _static_levels.size(); level++) {
+    std::vector<VertexContext*>& group = _static_levels[level];
+    if (group.size() == 1) {
+      // sequential segment, the sync vertex is finished when 'Execute' returns
+      group[0]->PrepareStaticDeps();
+      group[0]->Execute();
+      continue;
+    }
+    // parallel group, the last finished vertex of this level continues the plan
+    _static_pending.store(group.size());
+    for (VertexContext* ctx : group) {
+      ctx->PrepareStaticDeps();
+    }
+    WorkStealingScheduler* scheduler = GetScheduler();
+    for (size_t i = 1; i < group.size(); i++) {
+      VertexContext* ctx = group[i];
+      if (nullptr != scheduler) {
+        scheduler->Schedule(ctx);
+      } else {
+        const auto& exec_opts = _cluster->GetCluster()->GetGraphManager()->GetGraphExecuteOptions();
+        exec_opts.concurrent_executor([ctx]() { ctx->Execute(); });
+      }
+    }
+    group[0]->Execute();
+    return;
+  }
+  if (nullptr != _profile && !_static_levels.empty()) {
+    OnGraphProfileDone(GetLastFinished(_static_levels.back()));
+  }
+  if (_done) {
+    _done(0);
+  }
+}
+
+void GraphContext::OnStaticVertexDone(VertexContext* vertex) {
+  if (vertex->_static_parallel && 1 == _static_pending.fetch_sub(1)) {
+    RunStaticPlan(vertex->_static_level + 1);
+  }
+}
+
 VertexContext* GraphContext::FindVertexContext(Vertex* v) {
   auto found = _vertex_context_table.find(v);
   if (found == _vertex_context_table.end()) {
@@ -514,17 +862,47 @@ VertexContext* GraphContext::FindVertexContext(Vertex* v) {
 }
 void GraphContext::Reset() {
   _join_vertex_num = _vertex_context_table.size();
+  _batch = nullptr;
   for (auto& pair : _vertex_context_table) {
     std::shared_ptr<VertexContext>& ctx = pair.second;
     ctx->Reset();
   }
   _data_ctx->Reset();
 }
+void GraphContext::ReleaseProcessors(ReusableProcessorTable& processors) {
+  for (auto& pair : _vertex_context_table) {
+    pair.second->ReleaseProcessor(processors);
+  }
+}
+WorkStealingScheduler* GraphContext::GetScheduler() {
+  const GraphManager* manager = _cluster->GetCluster()->GetGraphManager();
+  if (nullptr == manager) {
+    return nullptr;
+  }
+  const GraphExecuteOptions& exec_opts = manager->GetGraphExecuteOptions();
+  if (exec_opts.numa_scheduler) {
+    return exec_opts.numa_scheduler->GetScheduler(_cluster->GetNumaNode());
+  }
+  return exec_opts.scheduler.get();
+}
 void GraphContext::ExecuteReadyVertexs(std::vector<VertexContext*>& ready_vertexs) {
   DIDAGLE_DEBUG("ExecuteReadyVertexs with {} vertexs.", ready_vertexs.size());
   if (ready_vertexs.empty()) {
     return;
   }
+  WorkStealingScheduler* scheduler = GetScheduler();
+  if (nullptr != scheduler) {
+    uint64_t sched_start_ustime = nullptr != _data_ctx->GetEventTracker() ? ustime() : 0;
+    for (size_t i = 0; i < ready_vertexs.size(); i++) {
+      ready_vertexs[i]->_sched_ustime = sched_start_ustime;
+      if (i == ready_vertexs.size() - 1) {
+        scheduler->ScheduleNext(ready_vertexs[i]);
+      } else {
+        scheduler->Schedule(ready_vertexs[i]);
+      }
+    }
+    return;
+  }
   if (ready_vertexs.size() == 1) {
     // inplace run
     ready_vertexs[0]->Execute();
@@ -569,14 +947,48 @@ void GraphContext::ExecuteReadyVertexs(std::vector<VertexContext*>& ready_vertex
   }
 }
 void GraphContext::OnVertexDone(VertexContext* vertex) {
+  if (nullptr != _batch) {
+    _batch->OnVertexDone(vertex);
+    return;
+  }
+  if (_use_static_plan) {
+    OnStaticVertexDone(vertex);
+    return;
+  }
   DIDAGLE_DEBUG("[{}]OnVertexDone while _join_vertex_num:{}.", vertex->GetVertex()->id, _join_vertex_num.load());
   if (1 == _join_vertex_num.fetch_sub(1)) {  // last vertex
+    if (nullptr != _profile) {
+      OnGraphProfileDone(vertex);
+    }
     if (_done) {
       _done(0);
     }
     return;
   }
+  WorkStealingScheduler* scheduler = GetScheduler();
+  if (nullptr != scheduler) {
+    // the most recently readied successor continues on this worker, others are pushed to its deque.
+    uint64_t sched_start_ustime = (nullptr != _data_ctx->GetEventTracker() || nullptr != _profile) ? ustime() : 0;
+    VertexContext* next = nullptr;
+    for (size_t i = 0; i < vertex->_successor_ctxs.size(); i++) {
+      VertexContext* successor_ctx = vertex->_successor_ctxs[i];
+      if (1 == successor_ctx->SetDependencyResult(vertex->_successor_dep_idxs[i], vertex->GetResult())) {
+        successor_ctx->_sched_ustime = sched_start_ustime;
+        successor_ctx->_ready_by = vertex;
+        successor_ctx->_ready_ustime = sched_start_ustime;
+        if (nullptr != next) {
+          scheduler->Schedule(next);
+        }
+        next = successor_ctx;
+      }
+    }
+    if (nullptr != next) {
+      scheduler->ScheduleNext(next);
+    }
+    return;
+  }
   std::vector<VertexContext*> ready_successors;
+  uint64_t ready_ustime = nullptr != _profile ? ustime() : 0;
   size_t successor_num = vertex->_successor_ctxs.size();
   for (size_t i = 0; i < successor_num; i++) {
     // VertexContext* successor_ctx = FindVertexContext(successor);
@@ -590,6 +1002,9 @@ void GraphContext::OnVertexDone(VertexContext* vertex) {
     // DIDAGLE_DEBUG("[{}]Successor:{} wait_num:{}.", vertex->GetVertex()->id, successor->id, wait_num);
     //  last dependency
     if (1 == wait_num) {
+      // the last finished dependency readies the successor, which is the predecessor on critical path
+      successor_ctx->_ready_by = vertex;
+      successor_ctx->_ready_ustime = ready_ustime;
       if (i == successor_num - 1 && ready_successors.empty()) {
         ExecuteReadyVertex(successor_ctx);
         return;
@@ -600,6 +1015,33 @@ void GraphContext::OnVertexDone(VertexContext* vertex) {
   }
   ExecuteReadyVertexs(ready_successors);
 }
+VertexContext* GraphContext::GetLastFinished(const std::vector<VertexContext*>& level) {
+  VertexContext* last = nullptr;
+  for (VertexContext* v : level) {
+    if (nullptr == last || v->_end_ustime > last->_end_ustime) {
+      last = v;
+    }
+  }
+  return last;
+}
+void GraphContext::OnGraphProfileDone(VertexContext* last_vertex) {
+  CriticalPath path;
+  path.cluster = _graph->_cluster->_name;
+  path.graph = _graph->name;
+  path.start_ustime = _exec_start_ustime;
+  path.end_ustime = ustime();
+  for (VertexContext* v = last_vertex; nullptr != v; v = v->_ready_by) {
+    CriticalPathNode node;
+    node.id = v->_vertex->id;
+    node.ready_ustime = v->_ready_ustime;
+    node.start_ustime = v->_start_ustime;
+    node.end_ustime = v->_end_ustime;
+    path.nodes.emplace_back(node);
+    v->_profile->critical_count.fetch_add(1, std::memory_order_relaxed);
+  }
+  std::reverse(path.nodes.begin(), path.nodes.end());
+  _profile->OnGraphDone(path);
+}
 GraphCluster* GraphContext::GetGraphCluster() { return _graph->_cluster; }
 // GraphDataContext* GraphContext::GetGraphDataContext() { return _data_ctx.get(); }
 void GraphContext::SetGraphDataContext(GraphDataContext* p) { _data_ctx->SetParent(p); }
@@ -632,9 +1074,175 @@ int GraphContext::Execute(DoneClosure&& done) {
   //     ready_successors.emplace_back(ctx.get());
   //   }
   // }
+  if (nullptr != _profile) {
+    _exec_start_ustime = ustime();
+    for (VertexContext* ctx : _start_ctxs) {
+      ctx->_ready_ustime = _exec_start_ustime;
+    }
+  }
+  if (_use_static_plan) {
+    RunStaticPlan(0);
+    return 0;
+  }
   ExecuteReadyVertexs(_start_ctxs);
   return 0;
 }
+int GraphBatchContext::Setup(const std::vector<GraphContext*>& graph_ctxs) {
+  _graph_ctxs = graph_ctxs;
+  _levels.clear();
+  if (_graph_ctxs.empty()) {
+    return -1;
+  }
+  Graph* graph = _graph_ctxs[0]->GetGraph();
+  for (const auto& group : graph->_static_levels) {
+    std::vector<std::vector<VertexContext*>> vertexs;
+    for (Vertex* v : group) {
+      std::vector<VertexContext*> batch;
+      for (GraphContext* g : _graph_ctxs) {
+        if (g->GetGraph() != graph) {
+          DIDAGLE_ERROR("Batch requests execute different graphs:{}/{}.", graph->name, g->GetGraph()->name);
+          return -1;
+        }
+        VertexContext* ctx = g->FindVertexContext(v);
+        if (nullptr == ctx) {
+          DIDAGLE_ERROR("Graph:{} has no context for vertex:{}.", graph->name, v->GetDotLable());
+          return -1;
+        }
+        if (ctx->_dep_ctxs.empty()) {
+          ctx->SetupStaticDeps();
+        }
+        // all dependencies are finished in previous levels
+        ctx->_speculative = false;
+        batch.emplace_back(ctx);
+      }
+      vertexs.emplace_back(std::move(batch));
+    }
+    _levels.emplace_back(std::move(vertexs));
+  }
+  for (GraphContext* g : _graph_ctxs) {
+    g->_batch = this;
+  }
+  return 0;
+}
+
+void GraphBatchContext::ExecuteBatchVertex(std::vector<VertexContext*>& batch) {
+  VertexContext* first = batch[0];
+  Processor* p = first->GetProcessor();
+  // subgraph/async/IO vertexs are executed request by request
+  bool batchable = nullptr != p && first->GetVertex()->cluster.empty() &&
+                   p->GetExecMode() == Processor::ExecMode::EXEC_SYNC && !p->isIOProcessor();
+  if (!batchable) {
+    // requests are independent, the first one runs inline while the others run on the executor
+    for (size_t i = 1; i < batch.size(); i++) {
+      VertexContext* ctx = batch[i];
+      Dispatch([ctx]() {
+        ctx->PrepareStaticDeps();
+        ctx->Execute();
+      });
+    }
+    batch[0]->PrepareStaticDeps();
+    batch[0]->Execute();
+    return;
+  }
+  std::vector<BatchExecuteItem> items;
+  std::vector<VertexContext*> running;
+  for (VertexContext* ctx : batch) {
+    ctx->PrepareStaticDeps();
+    if (!ctx->CheckExecute() || !ctx->PrepareProcessor()) {
+      continue;
+    }
+    BatchExecuteItem item;
+    item.processor = ctx->GetProcessor();
+    item.args = ctx->_exec_params;
+    item.data_ctx = ctx->_graph_ctx->GetGraphDataContext();
+    items.emplace_back(item);
+    running.emplace_back(ctx);
+  }
+  if (items.empty()) {
+    return;
+  }
+  try {
+    items[0].processor->BatchExecute(folly::Range<BatchExecuteItem*>(items.data(), items.size()));
+  } catch (std::exception& ex) {
+    DIDAGLE_ERROR("Vertex:{} batch execute with caught excetion:{} ", first->GetVertex()->GetDotLable(), ex.what());
+    for (auto& item : items) {
+      item.rc = V_CODE_ERR;
+    }
+  } catch (...) {
+    DIDAGLE_ERROR("Vertex:{} batch execute with caught unknown excetion.", first->GetVertex()->GetDotLable());
+    for (auto& item : items) {
+      item.rc = V_CODE_ERR;
+    }
+  }
+  for (size_t i = 0; i < running.size(); i++) {
+    running[i]->FinishProcessorExecute(items[i].rc);
+  }
+}
+
+void GraphBatchContext::RunLevel(size_t level) {
+  for (; level < _levels.size(); level++) {
+    auto& group = _levels[level];
+    _running_level = level;
+    // each vertex of the level holds one more pending count until its batch is dispatched, so that vertexs finished
+    // inline neither recurse nor finish the level while a batch is still being dispatched.
+    _pending.store(group.size() * (_graph_ctxs.size() + 1));
+    for (size_t i = 1; i < group.size(); i++) {
+      std::vector<VertexContext*>* batch = &group[i];
+      Dispatch([this, batch]() {
+        ExecuteBatchVertex(*batch);
+        OnVertexDone(nullptr);
+      });
+    }
+    ExecuteBatchVertex(group[0]);
+    if (1 != _pending.fetch_sub(1)) {
+      // the last finished async vertex continues
+      return;
+    }
+  }
+  for (size_t i = 0; i < _graph_ctxs.size() && !_levels.empty(); i++) {
+    if (nullptr != _graph_ctxs[i]->_profile) {
+      std::vector<VertexContext*> last_level;
+      for (auto& batch : _levels.back()) {
+        last_level.emplace_back(batch[i]);
+      }
+      _graph_ctxs[i]->OnGraphProfileDone(GraphContext::GetLastFinished(last_level));
+    }
+  }
+  DoneClosure done = std::move(_done);
+  if (done) {
+    done(0);
+  }
+}
+
+void GraphBatchContext::Dispatch(std::function<void(void)>&& f) {
+  GraphContext* g = _graph_ctxs[0];
+  WorkStealingScheduler* scheduler = g->GetScheduler();
+  if (nullptr != scheduler) {
+    scheduler->Post(std::move(f));
+    return;
+  }
+  const auto& exec_opts = g->_cluster->GetCluster()->GetGraphManager()->GetGraphExecuteOptions();
+  exec_opts.concurrent_executor([f = std::move(f)]() { f(); });
+}
+
+void GraphBatchContext::OnVertexDone(VertexContext* vertex) {
+  if (1 == _pending.fetch_sub(1)) {
+    RunLevel(_running_level + 1);
+  }
+}
+
+int GraphBatchContext::Execute(DoneClosure&& done) {
+  _done = std::move(done);
+  uint64_t start_ustime = ustime();
+  for (GraphContext* g : _graph_ctxs) {
+    if (nullptr != g->_profile) {
+      g->_exec_start_ustime = start_ustime;
+    }
+  }
+  RunLevel(0);
+  return 0;
+}
+
 GraphContext* GraphClusterContext::GetRunGraph(const std::string& name) {
   if (nullptr != _running_graph) {
     return _running_graph;
@@ -653,8 +1261,14 @@ GraphContext* GraphClusterContext::GetRunGraph(const std::string& name) {
   _running_graph->SetGraphDataContext(_extern_data_ctx);
   return _running_graph;
 }
+folly::CancellationSource GraphClusterContext::EnableCancellation() {
+  folly::CancellationSource source;
+  _cancel_token = source.getToken();
+  return source;
+}
 void GraphClusterContext::Reset() {
   _end_ustime = 0;
+  _cancel_token = folly::CancellationToken();
   _exec_params = nullptr;
   if (nullptr != _running_graph) {
     _running_graph->Reset();
@@ -667,6 +1281,11 @@ void GraphClusterContext::Reset() {
   _extern_data_ctx = nullptr;
   _running_cluster.reset();
 }
+void GraphClusterContext::ReleaseProcessors(ReusableProcessorTable& processors) {
+  for (auto& pair : _graph_context_table) {
+    pair.second->ReleaseProcessors(processors);
+  }
+}
 int GraphClusterContext::Setup(GraphCluster* c) {
   _cluster = c;
   if (!_cluster) {
@@ -701,17 +1320,12 @@ int GraphClusterContext::Setup(GraphCluster* c) {
   }
   return 0;
 }
-int GraphClusterContext::Execute(const std::string& graph, DoneClosure&& done, GraphContext*& graph_ctx) {
+GraphContext* GraphClusterContext::PrepareExecute(const std::string& graph) {
   uint64_t start_exec_ustime = ustime();
-  graph_ctx = nullptr;
   GraphContext* g = GetRunGraph(graph);
   if (nullptr == g) {
-    if (done) {
-      done(-1);
-    }
-    return 0;
+    return nullptr;
   }
-  graph_ctx = g;
   GraphDataContext& data_ctx = g->GetGraphDataContextRef();
   DIDAGLE_DEBUG("config setting size = {}", _config_settings.size());
   for (size_t i = 0; i < _config_settings.size(); i++) {
@@ -747,7 +1361,17 @@ int GraphClusterContext::Execute(const std::string& graph, DoneClosure&& done, G
     event->phase = PhaseType::DAG_GRAPH_GRAPH_PREPARE_EXECUTE;
     tracker->Add(std::move(event));
   }
-  return g->Execute(std::move(done));
+  return g;
+}
+int GraphClusterContext::Execute(const std::string& graph, DoneClosure&& done, GraphContext*& graph_ctx) {
+  graph_ctx = PrepareExecute(graph);
+  if (nullptr == graph_ctx) {
+    if (done) {
+      done(-1);
+    }
+    return 0;
+  }
+  return graph_ctx->Execute(std::move(done));
 }
 
 GraphClusterContext::~GraphClusterContext() {
@@ -16,8 +16,12 @@
 #include <unordered_set>
 #include <vector>
 
+#include "folly/CancellationToken.h"
 #include "folly/container/F14Map.h"
 
+#include "didagle/didagle_memo.h"
+#include "didagle/didagle_profiler.h"
+#include "didagle/didagle_scheduler.h"
 #include "didagle/graph_processor_api.h"
 #include "didagle/graph_processor_di.h"
 #include "didagle/graph_vertex.h"
@@ -28,11 +32,34 @@ typedef std::function<void(void)> AnyClosure;
 typedef std::function<void(AnyClosure&&)> ConcurrentExecutor;
 using EventReporter = std::function<void(DAGEvent)>;
 
+struct ClusterReloadStats {
+  std::string cluster;
+  bool reload = false;
+  uint64_t total_us = 0;    // parse, build, prewarm & swap
+  uint64_t prewarm_us = 0;  // setup of pooled contexts
+  size_t prewarm_contexts = 0;
+  size_t reused_processors = 0;  // harvested from the previous version, no 'Setup' needed
+  size_t created_processors = 0;
+};
+// processors keyed by 'Vertex::_setup_signature'
+using ReusableProcessorTable = folly::F14FastMap<uint64_t, std::vector<Processor*>>;
+
 struct GraphExecuteOptions {
   ConcurrentExecutor concurrent_executor;
+  // built-in work stealing scheduler, used instead of 'concurrent_executor' if it's set.
+  std::shared_ptr<WorkStealingScheduler> scheduler;
+  // built-in NUMA aware scheduler, each request is pinned to one node, used instead of 'scheduler' &
+  // 'concurrent_executor' if it's set.
+  std::shared_ptr<NumaScheduler> numa_scheduler;
+  // aggregates per vertex latency histograms & critical paths if it's set.
+  std::shared_ptr<DAGProfiler> profiler;
+  // results of vertexs with 'memoize = true' are cached across requests if it's set.
+  std::shared_ptr<MemoCache> memo_cache;
   std::shared_ptr<Params> params;
   EventReporter event_reporter;
   std::function<bool(const std::string&)> check_version;
+  // called after a cluster is loaded or reloaded.
+  std::function<void(const ClusterReloadStats&)> reload_reporter;
 };
 
 struct SelectCondParamsContext {
@@ -42,7 +69,7 @@ struct SelectCondParamsContext {
 
 class GraphContext;
 class GraphClusterContext;
-class VertexContext {
+class VertexContext : public SchedTask {
  private:
   GraphContext* _graph_ctx = nullptr;
   Vertex* _vertex = nullptr;
@@ -58,17 +85,60 @@ class VertexContext {
   Params _params;
   std::vector<SelectCondParamsContext> _select_contexts;
   uint64_t _exec_start_ustime = 0;
+  uint64_t _sched_ustime = 0;
   size_t _child_idx = (size_t)-1;
   const Params* _exec_params = nullptr;
+  folly::CancellationToken _exec_cancel_token;
+  // pending 'timeout_ms' timer of the running execution, cancelled once the vertex finishes
+  folly::Future<folly::Unit> _exec_timer = folly::Future<folly::Unit>::makeEmpty();
   std::string_view _exec_mathced_cond;
   int _exec_rc = INT_MAX;
 
+  // only set for vertexs with 'memoize = true'
+  MemoCache* _memo_cache = nullptr;
+  MemoKey _memo_key;
+  bool _memo_pending = false;
+
+  // only updated when profiling
+  VertexProfile* _profile = nullptr;
+  VertexContext* _ready_by = nullptr;
+  uint64_t _ready_ustime = 0;
+  uint64_t _start_ustime = 0;
+  uint64_t _end_ustime = 0;
+
   std::vector<VertexContext*> _successor_ctxs;
   std::vector<int> _successor_dep_idxs;
 
+  // speculative branch of a condition vertex, the finish is deferred until both the condition & itself are done
+  int _spec_cond_idx = -1;
+  bool _speculative = false;
+  std::atomic<uint32_t> _spec_gate{0};
+  std::atomic<int> _spec_cond_result{V_RESULT_INVALID};
+  int _spec_code = 0;
+  uint64_t _spec_end_ustime = 0;
+
+  // static schedule, dependencies are all finished in previous levels
+  std::vector<VertexContext*> _dep_ctxs;
+  size_t _static_level = 0;
+  bool _static_parallel = false;
+
   void SetupSuccessors();
+  void SetupStaticDeps();
+  void PrepareStaticDeps();
+  void PrepareCancellation();
+  void CancelTimeoutTimer();
+  bool ExecuteMemoized();
+  void StoreMemoized();
+  // returns false if the vertex is skipped(or restored from memo cache) & already finished.
+  bool CheckExecute();
+  bool PrepareProcessor();
+  void FinishProcessorExecute(int rc);
+  void CompleteVertexProcess(int code);
+  void OnSpeculativeCondDone(VertexResult r);
+  int CommitSpeculation();
 
   friend class GraphContext;
+  friend class GraphBatchContext;
 
  public:
   VertexContext();
@@ -82,6 +152,11 @@ class VertexContext {
   int ExecuteProcessor();
   int ExecuteSubGraph();
   inline uint32_t SetDependencyResult(int idx, VertexResult r) {
+    if (FOLLY_UNLIKELY(_speculative && idx == _spec_cond_idx)) {
+      OnSpeculativeCondDone(r);
+      // never readied by the condition vertex
+      return UINT32_MAX;
+    }
     // int idx = _vertex->GetDependencyIndex(v);
     VertexResult last_result_val = _deps_results[idx];
     _deps_results[idx] = r;
@@ -95,6 +170,8 @@ class VertexContext {
   int Setup(GraphContext* g, Vertex* v);
   void Reset();
   int Execute();
+  void RunTask() override;
+  void ReleaseProcessor(ReusableProcessorTable& processors);
   ~VertexContext();
 };
 
@@ -113,18 +190,42 @@ class GraphContext {
 
   std::vector<VertexContext*> _start_ctxs;
 
+  GraphProfile* _profile = nullptr;
+  uint64_t _exec_start_ustime = 0;
+
+  // precomputed topological levels, used instead of the dynamic executor if all vertexs are sync processors.
+  std::vector<std::vector<VertexContext*>> _static_levels;
+  bool _use_static_plan = false;
+  std::atomic<uint32_t> _static_pending{0};
+
+  // set if the graph is executed as one request of a batch
+  GraphBatchContext* _batch = nullptr;
+
+  // walks the critical path back from 'last_vertex' by '_ready_by', which is set by all schedule modes.
+  void OnGraphProfileDone(VertexContext* last_vertex);
+  // the vertex finished last in a level of static/batch plan, only valid with profiler
+  static VertexContext* GetLastFinished(const std::vector<VertexContext*>& level);
+  int SetupStaticPlan();
+  void RunStaticPlan(size_t level);
+  void OnStaticVertexDone(VertexContext* vertex);
+
+  friend class GraphBatchContext;
+
  public:
   GraphContext();
 
   inline Graph* GetGraph() { return _graph; }
   GraphCluster* GetGraphCluster();
   inline GraphClusterContext* GetGraphClusterContext() { return _cluster; }
+  inline GraphProfile* GetProfile() { return _profile; }
 
   VertexContext* FindVertexContext(Vertex* v);
   void OnVertexDone(VertexContext* vertex);
+  WorkStealingScheduler* GetScheduler();
 
   int Setup(GraphClusterContext* c, Graph* g);
   void Reset();
+  void ReleaseProcessors(ReusableProcessorTable& processors);
   void ExecuteReadyVertexs(std::vector<VertexContext*>& ready_vertexs);
   inline void ExecuteReadyVertex(VertexContext* v) { v->Execute(); }
   int Execute(DoneClosure&& done);
@@ -133,6 +234,31 @@ class GraphContext {
   void SetGraphDataContext(GraphDataContext* p);
 };
 
+/**
+ * @brief executes one graph over a batch of requests, each request has its own graph context & processors while all
+ * requests advance through the precomputed topological levels together, so the sync processors of a vertex are
+ * executed once by 'Processor::BatchExecute' for all requests. independent vertexs of a level, and the requests of a
+ * vertex which could not be batched, run in parallel on the executor.
+ */
+class GraphBatchContext {
+ private:
+  std::vector<GraphContext*> _graph_ctxs;
+  // level -> vertex -> request
+  std::vector<std::vector<std::vector<VertexContext*>>> _levels;
+  std::atomic<uint32_t> _pending{0};
+  size_t _running_level = 0;
+  DoneClosure _done;
+
+  void RunLevel(size_t level);
+  void ExecuteBatchVertex(std::vector<VertexContext*>& batch);
+  void Dispatch(std::function<void(void)>&& f);
+
+ public:
+  int Setup(const std::vector<GraphContext*>& graph_ctxs);
+  void OnVertexDone(VertexContext* vertex);
+  int Execute(DoneClosure&& done);
+};
+
 struct ConfigSettingContext {
   Processor* eval_proc = nullptr;
   uint8_t result = 0;
@@ -150,11 +276,21 @@ class GraphClusterContext {
   DoneClosure _done;
   GraphDataContext* _extern_data_ctx = nullptr;
   uint64_t _end_ustime = 0;
+  folly::CancellationToken _cancel_token;
+  // NUMA node of the pool which this context belongs to
+  int _numa_node = 0;
 
  public:
+  void SetNumaNode(int node) { _numa_node = node; }
+  int GetNumaNode() const { return _numa_node; }
   void SetExternGraphDataContext(GraphDataContext* p) { _extern_data_ctx = p; }
   uint64_t GetEndTime() { return _end_ustime; }
   void SetEndTime(const uint64_t end_ustime) { _end_ustime = end_ustime; }
+  // request level cancellation, returns the source to cancel the token of this context.
+  folly::CancellationSource EnableCancellation();
+  // subgraph inherits the cancellation token of parent vertex
+  void SetCancellationToken(const folly::CancellationToken& token) { _cancel_token = token; }
+  const folly::CancellationToken& GetCancellationToken() const { return _cancel_token; }
   void SetExecuteParams(const Params* p) { _exec_params = p; }
   const Params* GetExecuteParams() const { return _exec_params; }
   inline GraphCluster* GetCluster() { return _cluster; }
@@ -163,6 +299,10 @@ class GraphClusterContext {
   std::shared_ptr<GraphCluster> GetRunningCluster() { return _running_cluster; }
   int Setup(GraphCluster* c);
   void Reset();
+  // moves processors of the idle context out, the context should be deleted after that.
+  void ReleaseProcessors(ReusableProcessorTable& processors);
+  // evaluates config settings & returns the graph context to execute, nullptr if the graph is not found.
+  GraphContext* PrepareExecute(const std::string& graph);
   int Execute(const std::string& graph, DoneClosure&& done, GraphContext*& graph_ctx);
   void Execute(GraphDataContext& session_ctx, std::vector<uint8_t>& eval_results);
   ~GraphClusterContext();
@@ -27,6 +27,10 @@
  *THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <boost/algorithm/string.hpp>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
 
 #include "didagle/graph_params.h"
 #include "kcfg_toml.h"
@@ -159,6 +163,16 @@ const Params& Params::Get(const ParamsString& name) const {
   static Params default_value(true);
   return default_value;
 }
+const Params& Params::Get(const ParamsKey& key) const {
+  for (const Params* p = this; nullptr != p; p = p->parent) {
+    ParamValueTable::const_iterator it = p->params.find(key.token, key.name);
+    if (it != p->params.end()) {
+      return it->second;
+    }
+  }
+  static Params default_value(true);
+  return default_value;
+}
 const Params& Params::operator[](const ParamsString& name) const { return Get(name); }
 Params& Params::operator[](const ParamsString& name) {
   const Params& p = Get(name);
@@ -222,6 +236,14 @@ bool Params::Contains(const ParamsString& name) const {
   }
   return false;
 }
+bool Params::Contains(const ParamsKey& key) const {
+  for (const Params* p = this; nullptr != p; p = p->parent) {
+    if (p->params.find(key.token, key.name) != p->params.end()) {
+      return true;
+    }
+  }
+  return false;
+}
 void Params::Insert(const Params& other) {
   _param_type = PARAM_OBJECT;
   for (auto& kv : other.Members()) {
@@ -256,10 +278,128 @@ const Params& Params::GetVar(const ParamsString& name) const {
     } else {
       auto part = var_name.substr(0, pos);
       var_params = &(var_params->Get(part));
-      var_name = var_name.substr(pos);
+      var_name = var_name.substr(pos + 1);
     }
   }
   return *var_params;
 }
+const Params& Params::GetVar(const ParamsPath& path) const {
+  if (path.Empty()) {
+    static Params default_value(true);
+    return default_value;
+  }
+  const Params* var_params = this;
+  for (size_t i = 0; i < path.Size(); i++) {
+    var_params = &(var_params->Get(path[i]));
+  }
+  return *var_params;
+}
+
+ParamsKeyTable& ParamsKeyTable::Global() {
+  static ParamsKeyTable table;
+  return table;
+}
+const ParamsKey* ParamsKeyTable::Intern(std::string_view name) {
+  {
+    std::shared_lock<std::shared_mutex> guard(_mutex);
+    auto found = _keys.find(name);
+    if (found != _keys.end()) {
+      return &(found->second);
+    }
+  }
+  std::unique_lock<std::shared_mutex> guard(_mutex);
+  auto [it, inserted] = _keys.try_emplace(std::string(name));
+  if (inserted) {
+    // tokens only depend on the hasher, an empty table is enough to compute them
+    static const Params::ParamValueTable hash_table;
+    it->second.name = ParamsString(name.data(), name.size());
+    it->second.id = static_cast<uint32_t>(_keys.size() - 1);
+    it->second.token = hash_table.prehash(it->second.name);
+  }
+  return &(it->second);
+}
+const ParamsKey* ParamsKeyTable::Find(std::string_view name) const {
+  std::shared_lock<std::shared_mutex> guard(_mutex);
+  auto found = _keys.find(name);
+  return found != _keys.end() ? &(found->second) : nullptr;
+}
+size_t ParamsKeyTable::Size() const {
+  std::shared_lock<std::shared_mutex> guard(_mutex);
+  return _keys.size();
+}
+
+ParamsPath::ParamsPath(std::string_view path) {
+  while (true) {
+    size_t pos = path.find('.');
+    _keys.emplace_back(ParamsKeyTable::Global().Intern(path.substr(0, pos)));
+    if (pos == std::string_view::npos) {
+      break;
+    }
+    path.remove_prefix(pos + 1);
+  }
+}
+ParamsPath::ParamsPath(const std::vector<std::string>& names) {
+  for (const auto& name : names) {
+    _keys.emplace_back(ParamsKeyTable::Global().Intern(name));
+  }
+}
+std::string ParamsPath::ToString() const {
+  std::string s;
+  for (size_t i = 0; i < _keys.size(); i++) {
+    if (i > 0) {
+      s.append(".");
+    }
+    s.append(_keys[i]->name.data(), _keys[i]->name.size());
+  }
+  return s;
+}
+
+static inline uint64_t hash_combine(uint64_t seed, uint64_t v) {
+  return seed ^ (v + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+uint64_t Params::Hash() const {
+  uint64_t h = hash_combine(static_cast<uint64_t>(_param_type), invalid ? 1 : 0);
+  switch (_param_type) {
+    case PARAM_STRING: {
+      return hash_combine(h, std::hash<std::string_view>()(std::string_view(str.data(), str.size())));
+    }
+    case PARAM_INT: {
+      return hash_combine(h, std::hash<int64_t>()(iv));
+    }
+    case PARAM_DOUBLE: {
+      return hash_combine(h, std::hash<double>()(dv));
+    }
+    case PARAM_BOOL: {
+      return hash_combine(h, bv ? 1 : 0);
+    }
+    case PARAM_OBJECT: {
+      // members are unordered, sum the member hashes
+      uint64_t members = 0;
+      for (const auto& [name, value] : params) {
+        members += hash_combine(std::hash<std::string_view>()(std::string_view(name.data(), name.size())),
+                                value.Hash());
+      }
+      return hash_combine(hash_combine(h, params.size()), members);
+    }
+    case PARAM_ARRAY: {
+      h = hash_combine(h, param_array.size());
+      for (const auto& value : param_array) {
+        h = hash_combine(h, value.Hash());
+      }
+      return h;
+    }
+    default: {
+      return h;
+    }
+  }
+}
+uint64_t Params::HashWithParents() const {
+  uint64_t h = Hash();
+  for (const Params* p = parent; nullptr != p; p = p->parent) {
+    h = hash_combine(h, p->Hash());
+  }
+  return h;
+}
 
 }  // namespace didagle
\ No newline at end of file
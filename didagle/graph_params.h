@@ -30,7 +30,9 @@
 #pragma once
 #include <stdint.h>
 #include <map>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "folly/FBString.h"
 #include "folly/container/F14Map.h"
@@ -38,6 +40,14 @@
 
 namespace didagle {
 typedef folly::fbstring ParamsString;
+
+struct ParamsKey {
+  ParamsString name;
+  uint32_t id = 0;
+  // hash of the name, valid for all params member tables
+  folly::F14HashToken token;
+};
+class ParamsPath;
 class Params {
  public:
   // typedef std::map<ParamsString, Params> ParamValueTable;
@@ -69,6 +79,7 @@ class Params {
  public:
   explicit Params(bool invalid_ = false);
   void SetParent(const Params* p);
+  const Params* GetParent() const { return parent; }
   bool Valid() const;
   bool IsBool() const;
   bool IsString() const;
@@ -104,6 +115,50 @@ class Params {
   void BuildFromString(const std::string& v);
   void ParseFromString(const std::string& v);
   const Params& GetVar(const ParamsString& name) const;
+  // same as the string versions with pre-resolved keys, no split, allocation or rehash of the names.
+  const Params& Get(const ParamsKey& key) const;
+  bool Contains(const ParamsKey& key) const;
+  const Params& GetVar(const ParamsPath& path) const;
+  // hash of the value which is independent of the order of object members, the parent is not included.
+  uint64_t Hash() const;
+  // hash of the value and all its parents(e.g. the cluster exec params of a request), which 'Get'
+  // falls back to.
+  uint64_t HashWithParents() const;
+};
+
+/**
+ * @brief Interned param keys shared by all clusters, entries are never removed so that the keys referenced by
+ * 'ParamsPath' are stable.
+ */
+class ParamsKeyTable {
+ private:
+  folly::F14NodeMap<std::string, ParamsKey> _keys;
+  mutable std::shared_mutex _mutex;
+
+ public:
+  static ParamsKeyTable& Global();
+  const ParamsKey* Intern(std::string_view name);
+  // lookup only, returns nullptr if the name was never interned, the table never grows.
+  const ParamsKey* Find(std::string_view name) const;
+  size_t Size() const;
+};
+
+/**
+ * @brief Dotted params path like 'EXP.field1' compiled once(e.g. in processor setup) into interned keys, then
+ * resolved by 'Params::GetVar(const ParamsPath&)' with pointer hops only.
+ */
+class ParamsPath {
+ private:
+  std::vector<const ParamsKey*> _keys;
+
+ public:
+  ParamsPath() = default;
+  explicit ParamsPath(std::string_view path);
+  explicit ParamsPath(const std::vector<std::string>& names);
+  bool Empty() const { return _keys.empty(); }
+  size_t Size() const { return _keys.size(); }
+  const ParamsKey& operator[](size_t idx) const { return *_keys[idx]; }
+  std::string ToString() const;
 };
 
 }  // namespace didagle
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include "didagle/didagle_log.h"
 #include "didagle/graph_processor_api.h"
 #include "didagle/graph_processor_di.h"
+#include "didagle/graph_vertex.h"
 
 namespace didagle {
 
@@ -40,6 +41,25 @@ void GraphDataContext::SetArena(std::unique_ptr<google::protobuf::Arena>&& arena
   own_arena_ = std::move(arena);
   arena_ = own_arena_.get();
 }
+void GraphDataContext::SetMemArena(GraphArena* arena) {
+  _mem_arena = arena;
+  _own_mem_arena.reset();
+}
+void GraphDataContext::EnableMemArena(size_t block_size) {
+  if (!_own_mem_arena) {
+    _own_mem_arena = std::make_unique<GraphArena>(block_size);
+  }
+  _mem_arena = _own_mem_arena.get();
+}
+GraphArena* GraphDataContext::GetMemArena() const {
+  if (_mem_arena) {
+    return _mem_arena;
+  }
+  if (_parent) {
+    return _parent->GetMemArena();
+  }
+  return nullptr;
+}
 google::protobuf::Arena* GraphDataContext::GetArena() const {
   if (arena_) {
     return arena_;
@@ -56,6 +76,9 @@ void GraphDataContext::Reset() {
     data->Reset();
   }
   _event_tracker.reset();
+  if (_own_mem_arena) {
+    _own_mem_arena->Reset();
+  }
   // _parent.reset();
   _parent = nullptr;
   for (size_t i = 0; i < _executed_childrens.size(); i++) {
@@ -70,10 +93,10 @@ DataValue* GraphDataContext::GetValue(const DIObjectKeyView& key, GraphDataGetOp
   if (found != _data_table.end()) {
     return found->second.get();
   }
-  std::unique_ptr<ExcludeGraphDataContextSet> empty_execludes = std::make_unique<ExcludeGraphDataContextSet>();
+  ExcludeGraphDataContextSet empty_execludes;
   ExcludeGraphDataContextSet* new_excludes = excludes;
   if (nullptr == new_excludes) {
-    new_excludes = empty_execludes.get();
+    new_excludes = &empty_execludes;
   }
   DataValue* r = nullptr;
   new_excludes->insert(this);
@@ -106,11 +129,17 @@ DataValue* GraphDataContext::GetValue(const DIObjectKeyView& key, GraphDataGetOp
   return nullptr;
 }
 
-int GraphDataContext::Move(const DIObjectKey& from, const DIObjectKey& to) {
+int GraphDataContext::Move(const DIObjectKey& from, const DIObjectKey& to, int32_t from_idx, int32_t to_idx) {
   DIObjectKeyView from_key{from.name, from.id};
   DIObjectKeyView to_key{to.name, to.id};
-  DataValue* from_value = GetValue(from_key);
-  DataValue* to_value = GetValue(to_key);
+  DataValue* from_value = GetDataValue(from_key, from_idx);
+  if (nullptr == from_value) {
+    from_value = GetValue(from_key);
+  }
+  DataValue* to_value = GetDataValue(to_key, to_idx);
+  if (nullptr == to_value) {
+    to_value = GetValue(to_key);
+  }
   if (nullptr == from_value || nullptr == to_value) {
     return -1;
   }
@@ -143,6 +172,19 @@ uint32_t GraphDataContext::RegisterData(const DIObjectKey& id) {
     return found->second->_idx;
   }
 }
+int32_t GraphDataContext::FindDataIndex(const DIObjectKey& id) const {
+  DIObjectKeyView key = {id.name, id.id};
+  auto found = _data_table.find(key);
+  if (found == _data_table.end()) {
+    return -1;
+  }
+  // entries created by 'Set' have no slot
+  uint32_t idx = found->second->_idx;
+  if (idx >= _data_array.size() || _data_array[idx] != found->second.get()) {
+    return -1;
+  }
+  return static_cast<int32_t>(idx);
+}
 ProcessorFactory g_processor_factory;
 Processor::~Processor() {}
 int Processor::Setup(const Params& args) { return OnSetup(args); }
@@ -166,6 +208,29 @@ int Processor::Execute(const Params& args) {
   return OnExecute(args);
 }
 
+void Processor::BatchExecute(folly::Range<BatchExecuteItem*> batch) {
+  for (auto& item : batch) {
+    for (auto& f : item.processor->_params_settings) {
+      f(*item.args);
+    }
+  }
+  OnBatchExecute(batch);
+}
+
+void Processor::OnBatchExecute(folly::Range<BatchExecuteItem*> batch) {
+  for (auto& item : batch) {
+    try {
+      item.rc = item.processor->OnExecute(*item.args);
+    } catch (std::exception& ex) {
+      DIDAGLE_ERROR("[{}]batch execute with caught excetion:{} ", Name(), ex.what());
+      item.rc = V_CODE_ERR;
+    } catch (...) {
+      DIDAGLE_ERROR("[{}]batch execute with caught unknown excetion.", Name());
+      item.rc = V_CODE_ERR;
+    }
+  }
+}
+
 #if ISPINE_HAS_COROUTINES
 ispine::Awaitable<int> Processor::CoroExecute(const Params& args) {
   for (auto& f : _params_settings) {
@@ -201,6 +266,57 @@ size_t Processor::RegisterParam(const std::string& name, const std::string& type
   return _params.size();
 }
 
+size_t Processor::SetInputHashFunc(HashFunc&& f) {
+  _input_ids.back().hash = std::move(f);
+  return _input_ids.size();
+}
+size_t Processor::SetOutputMemoFuncs(SnapshotFunc&& snapshot, RestoreFunc&& restore) {
+  _output_ids.back().snapshot = std::move(snapshot);
+  _output_ids.back().restore = std::move(restore);
+  return _output_ids.size();
+}
+bool Processor::HashInputs(const Params& args, MemoHasher& hasher) {
+  hasher.Update(Name());
+  // params missing in vertex args are read from the parents(request exec params)
+  hasher.Update(args.HashWithParents());
+  for (auto& field : _input_ids) {
+    if (!field.hash) {
+      return false;
+    }
+    hasher.Update(field.name);
+    if (!field.hash(hasher)) {
+      return false;
+    }
+  }
+  return true;
+}
+bool Processor::SnapshotOutputs(std::vector<std::shared_ptr<void>>& outputs) {
+  outputs.clear();
+  outputs.reserve(_output_ids.size());
+  for (auto& field : _output_ids) {
+    if (!field.snapshot) {
+      return false;
+    }
+    std::shared_ptr<void> v = field.snapshot();
+    if (!v) {
+      return false;
+    }
+    outputs.emplace_back(std::move(v));
+  }
+  return true;
+}
+bool Processor::RestoreOutputs(const std::vector<std::shared_ptr<void>>& outputs) {
+  if (outputs.size() != _output_ids.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < outputs.size(); i++) {
+    if (!_output_ids[i].restore || !_output_ids[i].restore(outputs[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
 size_t Processor::AddResetFunc(ResetFunc&& f) {
   _reset_funcs.emplace_back(f);
   return _reset_funcs.size();
@@ -235,6 +351,10 @@ void ProcessorFactory::Register(std::string_view name, const ProcessorCreator& c
   std::string name_str(name.data(), name.size());
   GetCreatorTable().emplace(std::make_pair(name_str, creator));
 }
+void ProcessorFactory::Override(std::string_view name, const ProcessorCreator& creator) {
+  std::string name_str(name.data(), name.size());
+  GetCreatorTable()[name_str] = creator;
+}
 Processor* ProcessorFactory::GetProcessor(const std::string& name) {
   auto found = GetCreatorTable().find(name);
   if (found != GetCreatorTable().end()) {
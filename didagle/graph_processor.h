@@ -27,6 +27,8 @@ struct ProcessorMeta {
 class ProcessorFactory {
  public:
   static void Register(std::string_view name, const ProcessorCreator& creator);
+  // replaces the creator registered with the same name, registers it if not exist
+  static void Override(std::string_view name, const ProcessorCreator& creator);
   static Processor* GetProcessor(const std::string& name);
   static void GetAllMetas(std::vector<ProcessorMeta>& metas);
   static int DumpAllMetas(const std::string& file = "all_processors.json");
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <fmt/core.h>
+#include <algorithm>
 #include <atomic>
 #include <functional>
 #include <map>
@@ -26,19 +27,25 @@
 
 #include "didagle/di_container.h"
 #include "didagle/di_reset.h"
+#include "didagle/didagle_arena.h"
 #include "didagle/didagle_event.h"
+#include "didagle/didagle_memo.h"
 #include "didagle/graph_data.h"
 
+#include "folly/CancellationToken.h"
 #include "folly/FBVector.h"
 #include "folly/Likely.h"
+#include "folly/Range.h"
 #include "folly/container/F14Map.h"
 #include "folly/container/F14Set.h"
 #include "folly/futures/Future.h"
+#include "folly/small_vector.h"
 
 #include "ispine/coro/coroutine.h"
 
 #define ERR_UNIMPLEMENTED -7890
 #define ERR_COROUTINE_EXCEPTION -7891
+#define ERR_GRAPH_TIMEOUT -7892
 
 namespace didagle {
 
@@ -101,7 +108,18 @@ class GraphDataContext;
 using GraphDataContextPtr = std::shared_ptr<GraphDataContext>;
 class GraphDataContext {
  public:
-  using ExcludeGraphDataContextSet = folly::F14ValueSet<const GraphDataContext*>;
+  // contexts already visited by one lookup, the parent/children chain is short so a linear scan on stack is used
+  // instead of a heap allocated hash set.
+  class ExcludeGraphDataContextSet {
+   private:
+    folly::small_vector<const GraphDataContext*, 8> _ctxs;
+
+   public:
+    inline void insert(const GraphDataContext* ctx) { _ctxs.push_back(ctx); }
+    inline size_t count(const GraphDataContext* ctx) const {
+      return std::find(_ctxs.begin(), _ctxs.end(), ctx) != _ctxs.end() ? 1 : 0;
+    }
+  };
 
  private:
   GraphDataContext() = default;
@@ -115,6 +133,8 @@ class GraphDataContext {
   std::vector<const GraphDataContext*> _executed_childrens;
   google::protobuf::Arena* arena_ = nullptr;
   std::unique_ptr<google::protobuf::Arena> own_arena_;
+  GraphArena* _mem_arena = nullptr;
+  std::unique_ptr<GraphArena> _own_mem_arena;
   bool _disable_entry_creation = false;
 
   DataValue* GetValue(const DIObjectKeyView& key, GraphDataGetOptions opt = {},
@@ -155,8 +175,12 @@ class GraphDataContext {
   void ReserveChildCapacity(size_t n);
   void SetChild(const GraphDataContext* c, size_t idx);
 
+  // returns the dense slot index of the data, which is resolved once when graph context setup and passed to
+  // 'Get/Move/Set' to skip the hash lookup.
   uint32_t RegisterData(const DIObjectKey& id);
-  int Move(const DIObjectKey& from, const DIObjectKey& to);
+  // -1 if the data is not registered
+  int32_t FindDataIndex(const DIObjectKey& id) const;
+  int Move(const DIObjectKey& from, const DIObjectKey& to, int32_t from_idx = -1, int32_t to_idx = -1);
 
   void DisableEntryCreation() { _disable_entry_creation = true; }
 
@@ -175,6 +199,11 @@ class GraphDataContext {
   void SetArena(std::unique_ptr<google::protobuf::Arena>&& arena);
   google::protobuf::Arena* GetArena() const;
 
+  // per request arena for non-protobuf objects, an owned arena is released in one shot by 'Reset'.
+  void SetMemArena(GraphArena* arena);
+  void EnableMemArena(size_t block_size = GraphArena::kDefaultBlockSize);
+  GraphArena* GetMemArena() const;
+
   void Reset();
   template <typename T>
   inline typename DIObjectTypeHelper<T>::read_type Get(const std::string_view& name, int32_t idx = -1,
@@ -204,10 +233,10 @@ class GraphDataContext {
         }
       }
     }
-    auto empty_execludes = std::make_unique<ExcludeGraphDataContextSet>();
+    ExcludeGraphDataContextSet empty_execludes;
     ExcludeGraphDataContextSet* new_excludes = excludes;
     if (nullptr == new_excludes) {
-      new_excludes = empty_execludes.get();
+      new_excludes = &empty_execludes;
     }
     new_excludes->insert(this);
     GetValueType r = {};
@@ -264,10 +293,10 @@ class GraphDataContext {
         }
       }
     }
-    auto empty_execludes = std::make_unique<ExcludeGraphDataContextSet>();
+    ExcludeGraphDataContextSet empty_execludes;
     ExcludeGraphDataContextSet* new_excludes = excludes;
     if (nullptr == new_excludes) {
-      new_excludes = empty_execludes.get();
+      new_excludes = &empty_execludes;
     }
     new_excludes->insert(this);
     if (opt.with_parent && _parent) {
@@ -355,6 +384,9 @@ constexpr char* kDefaultWhileOperatorName = "ispine_while_processor";
 
 using InjectFunc = std::function<int(GraphDataContext&, int32_t, const std::string_view&, bool)>;
 using EmitFunc = std::function<int(GraphDataContext&, int32_t, const std::string_view&)>;
+using HashFunc = std::function<bool(MemoHasher&)>;
+using SnapshotFunc = std::function<std::shared_ptr<void>(void)>;
+using RestoreFunc = std::function<bool(const std::shared_ptr<void>&)>;
 
 struct FieldInfo : public DIObjectKey {
   std::string type;
@@ -362,11 +394,25 @@ struct FieldInfo : public DIObjectKey {
 
   InjectFunc inject;
   EmitFunc emit;
+  // memoization hooks, empty if the field could not be memoized.
+  HashFunc hash;
+  SnapshotFunc snapshot;
+  RestoreFunc restore;
   KCFG_DEFINE_FIELDS(type, name, id, flags)
 };
 
+class Processor;
+struct BatchExecuteItem {
+  // processor instance of the request with injected inputs, outputs are written to its fields
+  Processor* processor = nullptr;
+  const Params* args = nullptr;
+  GraphDataContext* data_ctx = nullptr;
+  int rc = 0;
+};
+
 class VertexContext;
 class GraphClusterContext;
+class GraphBatchContext;
 class Processor {
  public:
   enum class ExecMode : uint8_t {
@@ -403,6 +449,7 @@ class Processor {
   std::vector<ResetFunc> _reset_funcs;
   std::vector<PrepareFunc> _prepare_funcs;
   GraphDataContext* _data_ctx = nullptr;
+  const folly::CancellationToken* _cancel_token = nullptr;
   std::string id_;
 
   size_t RegisterParam(const std::string& name, const std::string& type, const std::string& deafult_value,
@@ -431,11 +478,30 @@ class Processor {
     //_field_emit_table.emplace(field, emit);
     return _output_ids.size();
   }
+  size_t SetInputHashFunc(HashFunc&& f);
+  size_t SetOutputMemoFuncs(SnapshotFunc&& snapshot, RestoreFunc&& restore);
   size_t AddResetFunc(ResetFunc&& f);
   size_t AddPrepareFunc(PrepareFunc&& f);
 
   GraphDataContext& GetDataContext() { return *_data_ctx; }
   google::protobuf::Arena* GetArena() { return _data_ctx->GetArena(); }
+  GraphArena* GetMemArena() { return _data_ctx->GetMemArena(); }
+  // the object is destructed when the graph context is reset, nullptr if there is no arena.
+  template <typename T, typename... Args>
+  T* NewObject(Args&&... args) {
+    GraphArena* arena = GetMemArena();
+    if (nullptr == arena) {
+      return nullptr;
+    }
+    return arena->New<T>(std::forward<Args>(args)...);
+  }
+  // cancellation is requested when the request deadline or the vertex 'timeout_ms' is reached,
+  // long running processors should check it or pass it to cancellable calls.
+  const folly::CancellationToken& GetCancellationToken() const {
+    static const folly::CancellationToken empty_token;
+    return nullptr != _cancel_token ? *_cancel_token : empty_token;
+  }
+  bool IsCancelled() const { return nullptr != _cancel_token && _cancel_token->isCancellationRequested(); }
 
   const std::string& GetID() const { return id_; }
 
@@ -448,12 +514,20 @@ class Processor {
 #endif
   virtual folly::Future<int> OnFutureExecute(const Params& args) { return folly::makeFuture<int>(ERR_UNIMPLEMENTED); }
   virtual ispine::AdaptiveWait<int> OnAExecute(const Params& args) { co_return ERR_UNIMPLEMENTED; }
+  /**
+   * @brief executes the same vertex of several requests in batch execution mode, all processors in 'batch' are
+   * instances of this processor class, the result of each request is set to 'rc'. The default implementation calls
+   * 'OnExecute' of each request, override it to merge backend calls(model inference, cache lookup...).
+   */
+  virtual void OnBatchExecute(folly::Range<BatchExecuteItem*> batch);
 
   friend class VertexContext;
   friend class GraphClusterContext;
+  friend class GraphBatchContext;
 
  public:
   inline void SetDataContext(GraphDataContext* p) { _data_ctx = p; }
+  inline void SetCancellationToken(const folly::CancellationToken* p) { _cancel_token = p; }
   virtual std::string_view Desc() const { return ""; }
   virtual std::string_view Name() const = 0;
   virtual ExecMode GetExecMode() const { return ExecMode::EXEC_SYNC; }
@@ -467,7 +541,14 @@ class Processor {
   int Setup(const Params& args);
   int Prepare(const Params& args);
   void Reset();
+  // hash the processor name, params(with parents) & injected inputs, returns false if any input is not
+  // hashable.
+  bool HashInputs(const Params& args, MemoHasher& hasher);
+  // copy/restore all outputs for memoization, returns false if any output is not copyable.
+  bool SnapshotOutputs(std::vector<std::shared_ptr<void>>& outputs);
+  bool RestoreOutputs(const std::vector<std::shared_ptr<void>>& outputs);
   int Execute(const Params& args);
+  void BatchExecute(folly::Range<BatchExecuteItem*> batch);
 #if ISPINE_HAS_COROUTINES
   ispine::Awaitable<int> CoroExecute(const Params& args);
 #endif
@@ -537,6 +618,8 @@ struct ProcessorRegister {
                    return (!NAME) ? -1 : 0;                                                                     \
                  },                                                                                             \
                  BOOST_PP_REMOVE_PARENS(FLAGS));                                                                \
+  size_t __hash_##NAME##_code =                                                                                 \
+      SetInputHashFunc([this](didagle::MemoHasher& h) { return didagle::HashInputField(NAME, h); });            \
   size_t __reset_##NAME##_code = AddResetFunc([this]() { NAME = {}; });
 
 #define GRAPH_OP_INPUT(TYPE, NAME) __GRAPH_OP_INPUT(TYPE, NAME, ({0, 0, 0}))
@@ -563,6 +646,8 @@ struct ProcessorRegister {
                                   return 0;                                                                       \
                                 },                                                                                \
                                 {0, 1, 0});                                                                       \
+  size_t __hash_##NAME##_code =                                                                                   \
+      SetInputHashFunc([this](didagle::MemoHasher& h) { return didagle::HashInputField(NAME, h); });              \
   size_t __reset_##NAME##_code = AddResetFunc([this]() { NAME = {}; });
 
 #define GRAPH_OP_OUTPUT(TYPE, NAME)                                                                                 \
@@ -573,6 +658,9 @@ struct ProcessorRegister {
                                   ctx.Set(data, &(this->NAME), idx);                                                \
                                   return 0;                                                                         \
                                 });                                                                                 \
+  size_t __memo_##NAME##_code = SetOutputMemoFuncs(                                                                 \
+      [this]() { return didagle::MemoValue<decltype(NAME)>::Snapshot(&NAME); },                                     \
+      [this](const std::shared_ptr<void>& v) { return didagle::MemoValue<decltype(NAME)>::Restore(v, &NAME); });    \
   size_t __reset_##NAME##_code = AddResetFunc([this]() {                                                            \
     didagle::Reset<decltype(NAME)> reset;                                                                           \
     reset(NAME);                                                                                                    \
@@ -590,14 +678,17 @@ struct ProcessorRegister {
                                   ctx.Set(data, this->NAME, idx);                                                   \
                                   return 0;                                                                         \
                                 });                                                                                 \
+  size_t __memo_##NAME##_code = SetOutputMemoFuncs(                                                                 \
+      [this]() { return didagle::MemoValue<BOOST_PP_REMOVE_PARENS(TYPE)>::Snapshot(NAME); },                        \
+      [this](const std::shared_ptr<void>& v) {                                                                      \
+        return didagle::MemoValue<BOOST_PP_REMOVE_PARENS(TYPE)>::Restore(v, NAME);                                  \
+      });                                                                                                           \
   size_t __reset_##NAME##_code = AddResetFunc([this]() {                                                            \
-    if (nullptr != NAME && nullptr == NAME->GetArena()) {                                                           \
-      delete NAME;                                                                                                  \
-    }                                                                                                               \
+    didagle::DeleteArenaMessage(NAME);                                                                              \
     NAME = nullptr;                                                                                                 \
   });                                                                                                               \
-  size_t __prepare_##NAME##_code = AddPrepareFunc(                                                                  \
-      [this]() { NAME = google::protobuf::Arena::CreateMessage<BOOST_PP_REMOVE_PARENS(TYPE)>(GetArena()); });
+  size_t __prepare_##NAME##_code =                                                                                  \
+      AddPrepareFunc([this]() { NAME = didagle::NewArenaMessage<BOOST_PP_REMOVE_PARENS(TYPE)>(GetArena()); });
 
 #define __GRAPH_OP_IN_OUT(TYPE, NAME, FLAGS)                                                                        \
   typename didagle::DIObjectTypeHelper<BOOST_PP_REMOVE_PARENS(TYPE)>::read_write_type NAME = {};                    \
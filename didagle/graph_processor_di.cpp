@@ -61,15 +61,17 @@ int ProcessorDI::InjectInputs(GraphDataContext& ctx, const Params* params) {
     }
     int rc = 0;
     if (nullptr != graph_data && !graph_data->aggregate.empty()) {
-      for (const std::string& aggregate_id : graph_data->aggregate) {
+      for (size_t i = 0; i < graph_data->aggregate.size(); i++) {
+        const std::string& aggregate_id = graph_data->aggregate[i];
         if (!aggregate_id.empty() && aggregate_id[0] == '$' && nullptr != params) {
-          ParamsString var_name = aggregate_id.substr(1);
-          const Params& var_value = params->GetVar(var_name);
+          const Params& var_value = i < entry.aggregate_var_paths.size() && !entry.aggregate_var_paths[i].Empty()
+                                        ? params->GetVar(entry.aggregate_var_paths[i])
+                                        : params->GetVar(ParamsString(aggregate_id.substr(1)));
           DIDAGLE_DEBUG("Get Var value:{} for {}", var_value.String(), aggregate_id);
           if (!var_value.String().empty()) {
             std::string_view data_name(var_value.String().data(), var_value.String().size());
             // rc = _proc->InjectInputField(ctx, field, data_name, graph_data->move);
-            rc = entry.info.inject(ctx, entry.idx, data_name, graph_data->move);
+            rc = entry.info.inject(ctx, -1, data_name, graph_data->move);
           } else {
             rc = -1;
             // 需要的时候，打印error日志； 不需要的时候，打印info日志;
@@ -78,9 +80,11 @@ int ProcessorDI::InjectInputs(GraphDataContext& ctx, const Params* params) {
             else
               DIDAGLE_DEBUG("[{}]inject {} failed with var aggregate_id:{}", _proc->Name(), field, aggregate_id);
           }
+        } else {
+          // rc = _proc->InjectInputField(ctx, field, aggregate_id, graph_data->move);
+          int32_t idx = i < entry.aggregate_idxs.size() ? entry.aggregate_idxs[i] : -1;
+          rc = entry.info.inject(ctx, idx, aggregate_id, graph_data->move);
         }
-        // rc = _proc->InjectInputField(ctx, field, aggregate_id, graph_data->move);
-        rc = entry.info.inject(ctx, entry.idx, aggregate_id, graph_data->move);
         if (0 != rc && required) {
           break;
         }
@@ -93,13 +97,13 @@ int ProcessorDI::InjectInputs(GraphDataContext& ctx, const Params* params) {
         move_data = entry.info.flags.is_in_out;
       }
       if (!data.name.empty() && data.name[0] == '$' && nullptr != params) {
-        ParamsString var_name = data.name.substr(1);
-        const Params& var_value = params->GetVar(var_name);
+        const Params& var_value =
+            !entry.var_path.Empty() ? params->GetVar(entry.var_path) : params->GetVar(ParamsString(data.name.substr(1)));
         DIDAGLE_DEBUG("Get Var value:{} for {}", var_value.String(), data.name);
         if (!var_value.String().empty()) {
           std::string_view data_name(var_value.String().data(), var_value.String().size());
           // rc = _proc->InjectInputField(ctx, field, data_name, move_data);
-          rc = entry.info.inject(ctx, entry.idx, data_name, move_data);
+          rc = entry.info.inject(ctx, -1, data_name, move_data);
         } else {
           rc = -1;
           if (required) {
@@ -137,22 +141,22 @@ int ProcessorDI::CollectOutputs(GraphDataContext& ctx, const Params* params) {
     const std::string& field = entry.name;
     const DIObjectKey& data = entry.info;
     if (!data.name.empty() && data.name[0] == '$' && nullptr != params) {
-      ParamsString var_name = data.name.substr(1);
-      const Params& var_value = params->GetVar(var_name);
+      const Params& var_value =
+          !entry.var_path.Empty() ? params->GetVar(entry.var_path) : params->GetVar(ParamsString(data.name.substr(1)));
       DIDAGLE_DEBUG("Get Var value:{} for {}", var_value.String(), data.name);
       if (!var_value.String().empty()) {
         std::string_view data_name(var_value.String().data(), var_value.String().size());
         DIDAGLE_DEBUG("[{}]Collect output for field {}:{} with actual name:{}", _proc->Name(), field, data.name,
                       data_name);
         // int rc = _proc->EmitOutputField(ctx, field, data_name);
-        int rc = entry.info.emit(ctx, entry.idx, data_name);
+        int rc = entry.info.emit(ctx, -1, data_name);
         if (0 != rc) {
           DIDAGLE_ERROR("[{}]Collect output for field {}:{} failed with actual name:{}", _proc->Name(), field,
                         data.name, data_name);
         }
       } else {
         DIDAGLE_ERROR("[{}]Collect output for field {}:{} failed with var name:{}", _proc->Name(), field, data.name,
-                      var_name);
+                      data.name.substr(1));
       }
       continue;
     }
@@ -175,7 +179,7 @@ int ProcessorDI::MoveDataWhenSkipped(GraphDataContext& ctx) {
       DIObjectKey from;
       from.id = field_info.id;
       from.name = data->move_from_when_skipped;
-      int rc = ctx.Move(from, field_info);
+      int rc = ctx.Move(from, field_info, entry.move_from_idx, entry.idx);
       if (0 != rc) {
         DIDAGLE_ERROR("[{}]Filed:{} move {} to {} when skipped failed.", _proc->Name(), field,
                       data->move_from_when_skipped, field_info.name);
@@ -9,6 +9,7 @@
 #include <utility>
 #include <vector>
 
+#include "didagle/graph_params.h"
 #include "didagle/graph_processor.h"
 #include "folly/FBVector.h"
 namespace didagle {
@@ -18,7 +19,14 @@ class ProcessorDI {
     std::string name;
     FieldInfo info;
     const GraphData* data = nullptr;
+    // dense slot indexes in graph data context resolved when graph context setup, -1 if the name is
+    // dynamic('$' var) or extern.
     int32_t idx = -1;
+    std::vector<int32_t> aggregate_idxs;
+    int32_t move_from_idx = -1;
+    // params paths of '$' var names resolved when graph context setup, empty if the name is not a var.
+    ParamsPath var_path;
+    std::vector<ParamsPath> aggregate_var_paths;
     FieldData(const FieldInfo& id) {
       name = id.name;
       info = id;
@@ -5,6 +5,8 @@
 #include <set>
 #include <string>
 #include "didagle/didagle_log.h"
+#include "didagle/didagle_memo.h"
+#include "didagle/didagle_profiler.h"
 #include "didagle/graph.h"
 #include "didagle/graph_processor.h"
 namespace didagle {
@@ -128,9 +130,20 @@ std::string Vertex::GetDotLable() const {
   }
   return "unknown";
 }
-int Vertex::DumpDotDefine(std::string& s) {
-  s.append("    ").append(GetDotId()).append(" [label=\"").append(GetDotLable()).append("\"");
-  if (!cond.empty()) {
+int Vertex::DumpDotDefine(std::string& s, const GraphProfile* profile) {
+  s.append("    ").append(GetDotId()).append(" [label=\"").append(GetDotLable());
+  const VertexProfile* vertex_profile = nullptr != profile ? profile->FindVertexProfile(id) : nullptr;
+  if (nullptr != vertex_profile && vertex_profile->execute.Count() > 0) {
+    s.append("\\np50=")
+        .append(std::to_string(vertex_profile->execute.Percentile(50)))
+        .append("us p99=")
+        .append(std::to_string(vertex_profile->execute.Percentile(99)))
+        .append("us");
+  }
+  s.append("\"");
+  if (nullptr != profile && profile->IsCritical(id)) {
+    s.append(" color=red penwidth=3 fillcolor=lightpink style=filled");
+  } else if (!cond.empty()) {
     s.append(" shape=diamond color=black fillcolor=aquamarine style=filled");
   } else if (!graph.empty()) {
     s.append(" shape=box3d, color=blue fillcolor=aquamarine style=filled");
@@ -140,7 +153,8 @@ int Vertex::DumpDotDefine(std::string& s) {
   s.append("];\n");
   return 0;
 }
-int Vertex::DumpDotEdge(std::string& s) {
+int Vertex::DumpDotEdge(std::string& s, const GraphProfile* profile) {
+  bool critical = nullptr != profile && profile->IsCritical(id);
   if (!expect_config.empty()) {
     std::string expect_config_id = _graph->name + "_" + std::regex_replace(expect_config, std::regex("!"), "");
     // std::string expect_config_name =
@@ -165,6 +179,10 @@ int Vertex::DumpDotEdge(std::string& s) {
     VertexResult expected = _deps_expected_results[pair.second];
     const Vertex* dep = pair.first;
     s.append("    ").append(dep->GetDotId()).append(" -> ").append(GetDotId());
+    if (critical && profile->IsCritical(dep->id)) {
+      s.append(" [color=red penwidth=3];\n");
+      continue;
+    }
     switch (expected) {
       case V_RESULT_OK: {
         s.append(" [style=dashed label=\"ok\"];\n");
@@ -191,6 +209,49 @@ void Vertex::Depend(Vertex* v, VertexResult expected) {
     _deps_expected_results[idx] = expected;
   }
 }
+uint64_t Vertex::GetSetupSignature() const {
+  MemoHasher hasher;
+  hasher.Update(processor);
+  hasher.Update(args.Hash());
+  hasher.Update(cond);
+  hasher.Update(cluster);
+  hasher.Update(graph);
+  hasher.Update(while_cluster);
+  hasher.Update(uint64_t(while_async));
+  hasher.Update(uint64_t(select_args.size()));
+  for (const auto& select : select_args) {
+    hasher.Update(select.match);
+    hasher.Update(select.args.Hash());
+  }
+  return hasher.GetKey().hash;
+}
+int Vertex::GetSpeculativeCondIndex() const {
+  // subgraphs & moved inputs have side effects which could not be discarded
+  if (!graph.empty() || !cluster.empty()) {
+    return -1;
+  }
+  for (const auto& data : input) {
+    if (data.move || data._is_in_out) {
+      return -1;
+    }
+  }
+  for (const auto& [dep, idx] : _deps_idx) {
+    if (!dep->speculative || !dep->IsCondVertex() || V_RESULT_ALL == _deps_expected_results[idx]) {
+      continue;
+    }
+    bool read_cond_output = false;
+    for (const auto& data : input) {
+      if (_graph->FindVertexByData(data.id) == dep) {
+        read_cond_output = true;
+        break;
+      }
+    }
+    if (!read_cond_output) {
+      return idx;
+    }
+  }
+  return -1;
+}
 int Vertex::BuildSuccessors(const std::set<std::string>& sucessor, VertexResult expected) {
   for (const std::string& id : sucessor) {
     Vertex* successor_vertex = _graph->FindVertexById(id);
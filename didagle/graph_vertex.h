@@ -49,6 +49,7 @@ struct CondParams {
 };
 
 struct Graph;
+class GraphProfile;
 struct Vertex {
   std::string id;
 
@@ -84,6 +85,14 @@ struct Vertex {
   std::vector<GraphData> output;
 
   bool ignore_processor_execute_error = true;
+  // request cancellation of the running processor after 'timeout_ms', 0 means no timeout.
+  int64_t timeout_ms = 0;
+  // reuse outputs of previous executions with the same params & inputs if 'GraphExecuteOptions::memo_cache' is set,
+  // only for pure processors whose inputs are all hashable & outputs are all copyable.
+  bool memoize = false;
+  // for condition vertexs, start the processors of 'if'/'else' branches without waiting for the condition,
+  // outputs of the branch which does not match the condition result are discarded.
+  bool speculative = false;
 
   std::unordered_set<Vertex*> _successor_vertex;
   std::vector<VertexResult> _deps_expected_results;
@@ -92,18 +101,25 @@ struct Vertex {
   Graph* _vertex_graph = nullptr;
   bool _is_id_generated = false;
   bool _is_cond_processor = false;
+  // vertexs with the same signature setup their processors identically, see 'GetSetupSignature'
+  uint64_t _setup_signature = 0;
 
   KCFG_TOML_DEFINE_FIELD_MAPPING(({"consequent", "if"}, {"alternative", "else"}, {"is_start", "start"},
                                   {"while_cluster", "while"}, {"while_async", "async"}))
 
   KCFG_TOML_DEFINE_FIELDS(id, processor, args, cond, expect, expect_deps, expect_config, is_start, select_args, cluster,
                           graph, while_cluster, while_async, successor, successor_on_ok, successor_on_err, consequent,
-                          alternative, deps, deps_on_ok, deps_on_err, input, output, ignore_processor_execute_error)
+                          alternative, deps, deps_on_ok, deps_on_err, input, output, ignore_processor_execute_error,
+                          timeout_ms, memoize, speculative)
   Vertex();
   bool IsCondVertex() const;
   void MergeSuccessor();
   bool FindVertexInSuccessors(Vertex* v) const;
   int FillInputOutput();
+  // hash of everything the processor setup depends on, used to reuse processors across reloads.
+  uint64_t GetSetupSignature() const;
+  // index of the speculative condition vertex in deps which this vertex could run ahead of, -1 if none.
+  int GetSpeculativeCondIndex() const;
   void SetGeneratedId(const std::string& id);
   bool IsSuccessorsEmpty();
   bool IsDepsEmpty();
@@ -114,8 +130,9 @@ struct Vertex {
   int Build();
   std::string GetDotLable() const;
   std::string GetDotId() const;
-  int DumpDotDefine(std::string& s);
-  int DumpDotEdge(std::string& s);
+  // annotated with latencies & critical path if 'profile' is not null
+  int DumpDotDefine(std::string& s, const GraphProfile* profile = nullptr);
+  int DumpDotEdge(std::string& s, const GraphProfile* profile = nullptr);
   int GetDependencyIndex(Vertex* v);
 };
 
@@ -0,0 +1,103 @@
+// Copyright (c) 2021, Tencent Inc.
+// All rights reserved.
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory_resource>
+#include <string>
+#include <thread>
+#include <vector>
+#include "didagle/didagle_arena.h"
+#include "didagle/didagle_obj_pool.h"
+using namespace didagle;
+
+TEST(ArenaUT, AllocAndReset) {
+  GraphArena arena(4096);
+  std::vector<char*> ptrs;
+  for (size_t align : {1, 8, 16, 64}) {
+    void* p = arena.allocate(24, align);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(p) % align);
+    ptrs.emplace_back(static_cast<char*>(p));
+  }
+  // large allocation gets a dedicated block
+  void* large = arena.allocate(64 * 1024, 16);
+  memset(large, 0, 64 * 1024);
+  EXPECT_EQ(2, arena.BlockCount());
+  for (int i = 0; i < 1000; i++) {
+    ptrs.emplace_back(static_cast<char*>(arena.allocate(100, 8)));
+  }
+  EXPECT_GT(arena.BlockCount(), 2);
+  arena.Reset();
+  EXPECT_EQ(1, arena.BlockCount());
+  EXPECT_EQ(0, arena.BytesAllocated());
+  // the kept block is reused after reset
+  EXPECT_NE(nullptr, arena.allocate(24, 1));
+  EXPECT_EQ(1, arena.BlockCount());
+}
+
+TEST(ArenaUT, NewAndCleanup) {
+  static int destructed = 0;
+  struct Obj {
+    std::string s;
+    explicit Obj(const std::string& v) : s(v) {}
+    ~Obj() { destructed++; }
+  };
+  GraphArena arena;
+  Obj* a = arena.New<Obj>("hello");
+  Obj* b = arena.New<Obj>(std::string(100, 'x'));
+  int64_t* i = arena.New<int64_t>(101);
+  EXPECT_EQ("hello", a->s);
+  EXPECT_EQ(100, b->s.size());
+  EXPECT_EQ(101, *i);
+  std::pmr::vector<int> vec(&arena);
+  for (int k = 0; k < 10000; k++) {
+    vec.push_back(k);
+  }
+  EXPECT_EQ(9999, vec.back());
+  EXPECT_EQ(0, destructed);
+  arena.Reset();
+  EXPECT_EQ(2, destructed);
+}
+
+TEST(ArenaUT, ConcurrentAlloc) {
+  GraphArena arena(8192);
+  const int kThreads = 8;
+  const int kAllocs = 10000;
+  std::vector<std::vector<uint64_t*>> results(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int k = 0; k < kAllocs; k++) {
+        uint64_t* p = arena.New<uint64_t>(static_cast<uint64_t>(t) * kAllocs + k);
+        results[t].emplace_back(p);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (int t = 0; t < kThreads; t++) {
+    for (int k = 0; k < kAllocs; k++) {
+      ASSERT_EQ(static_cast<uint64_t>(t) * kAllocs + k, *results[t][k]);
+    }
+  }
+  arena.Reset();
+  EXPECT_EQ(1, arena.BlockCount());
+}
+
+TEST(ArenaUT, ObjPool) {
+  struct PoolObj {
+    int v = 0;
+  };
+  ObjPool<PoolObj>* pool = ObjPool<PoolObj>::GetInstance();
+  pool->SetMaxPooled(1);
+  PoolObj* a = pool->GetRaw();
+  PoolObj* b = pool->GetRaw();
+  pool->RecycleRaw(a);
+  pool->RecycleRaw(b);
+  EXPECT_EQ(1, pool->Size());
+  EXPECT_EQ(a, pool->GetRaw());
+  EXPECT_EQ(0, pool->Size());
+  delete a;
+}
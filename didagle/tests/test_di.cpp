@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <string>
 #include "didagle/di_container.h"
+#include "didagle/graph_processor_api.h"
 using namespace didagle;
 struct TestPOD {
   int a = 101;
@@ -106,3 +107,32 @@ TEST(DIContainer, DepInject) {
   EXPECT_EQ(303, p->pod33->a);
   EXPECT_EQ("sptest", p->pod33->id);
 }
+
+TEST(GraphDataContext, SlotIndex) {
+  auto parent = GraphDataContext::New();
+  auto ctx = GraphDataContext::New();
+  ctx->SetParent(parent.get());
+  DIObjectKey a_key;
+  a_key.name = "a";
+  a_key.id = DIContainer::GetTypeId<TestPOD3>();
+  DIObjectKey b_key = a_key;
+  b_key.name = "b";
+  int32_t a_idx = static_cast<int32_t>(ctx->RegisterData(a_key));
+  int32_t b_idx = static_cast<int32_t>(ctx->RegisterData(b_key));
+  EXPECT_NE(a_idx, b_idx);
+  EXPECT_EQ(a_idx, static_cast<int32_t>(ctx->RegisterData(a_key)));
+  EXPECT_EQ(b_idx, ctx->FindDataIndex(b_key));
+
+  TestPOD3 local;
+  local.a = 1;
+  TestPOD3 from_parent;
+  from_parent.a = 2;
+  EXPECT_TRUE(ctx->Set("a", &local, a_idx));
+  EXPECT_TRUE(parent->Set("b", &from_parent));
+  EXPECT_EQ(-1, parent->FindDataIndex(b_key));
+  EXPECT_EQ(1, ctx->Get<TestPOD3>("a", a_idx)->a);
+  // empty local slot falls back to parent
+  EXPECT_EQ(2, ctx->Get<TestPOD3>("b", b_idx)->a);
+  ctx->Reset();
+  EXPECT_EQ(nullptr, ctx->Get<TestPOD3>("a", a_idx));
+}
@@ -0,0 +1,963 @@
+// Copyright (c) 2024, Tencent Inc.
+// All rights reserved.
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "didagle/graph.h"
+#include "didagle/graph_processor_api.h"
+#include "folly/synchronization/Latch.h"
+
+using namespace didagle;
+
+static std::atomic<int> g_reload_setup_count{0};
+
+GRAPH_OP_BEGIN(reload_a)
+GRAPH_OP_OUTPUT(int, reload_a)
+int OnSetup(const Params& args) override {
+  g_reload_setup_count++;
+  return 0;
+}
+int OnExecute(const Params& args) override {
+  reload_a = 1;
+  return 0;
+}
+GRAPH_OP_END
+
+GRAPH_OP_BEGIN(reload_b)
+GRAPH_OP_INPUT(int, reload_a)
+GRAPH_OP_OUTPUT(int, reload_b)
+int OnSetup(const Params& args) override {
+  g_reload_setup_count++;
+  return 0;
+}
+int OnExecute(const Params& args) override {
+  reload_b = nullptr != reload_a ? *reload_a + 1 : 0;
+  return 0;
+}
+GRAPH_OP_END
+
+static std::string write_cluster(const std::string& name, const std::string& content) {
+  std::string path = "/tmp/" + name;
+  std::ofstream(path) << content;
+  return path;
+}
+
+static std::string reload_cluster(int64_t b_arg, const std::string& b_processor = "reload_b") {
+  return "strict_dsl = true\n"
+         "default_context_pool_size = 4\n"
+         "[[graph]]\n"
+         "name = \"main\"\n"
+         "[[graph.vertex]]\n"
+         "processor = \"reload_a\"\n"
+         "[[graph.vertex]]\n"
+         "processor = \"" +
+         b_processor +
+         "\"\n"
+         "args = { x = " +
+         std::to_string(b_arg) + " }\n";
+}
+
+TEST(GraphReload, ReuseProcessors) {
+  std::string name = "didagle_test_reload_" + std::to_string(getpid()) + ".toml";
+  GraphExecuteOptions options;
+  options.concurrent_executor = [](AnyClosure&& r) { r(); };
+  ClusterReloadStats stats;
+  options.reload_reporter = [&stats](const ClusterReloadStats& s) { stats = s; };
+  GraphManager graphs(options);
+
+  std::string path = write_cluster(name, reload_cluster(1));
+  ASSERT_TRUE(graphs.Load(path) != nullptr);
+  EXPECT_FALSE(stats.reload);
+  EXPECT_EQ(4, stats.prewarm_contexts);
+  EXPECT_EQ(0, stats.reused_processors);
+  EXPECT_EQ(8, stats.created_processors);
+  EXPECT_EQ(8, g_reload_setup_count.load());
+
+  // unchanged, the new version is prewarmed before the swap, processors of the idle contexts of the retired version
+  // are harvested after it
+  std::shared_ptr<GraphCluster> first = graphs.FindGraphClusterByName(name);
+  std::atomic<size_t> pooled_at_swap{0};
+  std::thread watcher([&]() {
+    std::shared_ptr<GraphCluster> c;
+    while ((c = graphs.FindGraphClusterByName(name)) == first) {
+      std::this_thread::yield();
+    }
+    pooled_at_swap = c->_context_pools[0]->size_approx();
+  });
+  std::shared_ptr<GraphCluster> prev = graphs.Load(path);
+  watcher.join();
+  ASSERT_TRUE(prev != nullptr);
+  EXPECT_EQ(4, pooled_at_swap.load());
+  EXPECT_TRUE(stats.reload);
+  EXPECT_EQ(8, stats.reused_processors);
+  EXPECT_EQ(8, stats.created_processors);
+  EXPECT_EQ(16, g_reload_setup_count.load());
+  first.reset();
+
+  // contexts created beyond the pool reuse the harvested processors
+  std::vector<GraphClusterContext*> ctxs;
+  for (int i = 0; i < 6; i++) {
+    ctxs.emplace_back(graphs.GetGraphClusterContext(name));
+  }
+  EXPECT_EQ(16, g_reload_setup_count.load());
+  for (GraphClusterContext* ctx : ctxs) {
+    prev->ReleaseContext(ctx);
+  }
+
+  // new build fails, the serving cluster & its pool are untouched
+  write_cluster(name, reload_cluster(1, "reload_not_exist"));
+  EXPECT_TRUE(graphs.Load(path) == nullptr);
+  EXPECT_EQ(prev, graphs.FindGraphClusterByName(name));
+
+  // args of 'reload_b' changed, only the processors of 'reload_a' are harvested
+  write_cluster(name, reload_cluster(2));
+  ASSERT_TRUE(graphs.Load(path) != nullptr);
+  EXPECT_EQ(4, stats.reused_processors);
+  EXPECT_EQ(8, stats.created_processors);
+  unlink(path.c_str());
+}
+
+static std::atomic<bool> g_slow_cancelled{false};
+static std::atomic<bool> g_slow_finished{false};
+static std::atomic<int> g_after_slow_count{0};
+static folly::CancellationToken g_fast_token;
+
+// waits for the cancellation at most 2s
+GRAPH_OP_BEGIN(timeout_slow)
+int OnExecute(const Params& args) override {
+  for (int i = 0; i < 2000 && !IsCancelled(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  g_slow_cancelled = IsCancelled();
+  g_slow_finished = true;
+  return g_slow_cancelled ? -1 : 0;
+}
+GRAPH_OP_END
+
+GRAPH_OP_BEGIN(timeout_after_slow)
+int OnExecute(const Params& args) override {
+  g_after_slow_count++;
+  return 0;
+}
+GRAPH_OP_END
+
+GRAPH_OP_BEGIN(timeout_fast)
+int OnExecute(const Params& args) override {
+  g_fast_token = GetCancellationToken();
+  return 0;
+}
+GRAPH_OP_END
+
+static const char* kTimeoutCluster = R"(
+[[graph]]
+name = "request"
+[[graph.vertex]]
+processor = "timeout_slow"
+[[graph.vertex]]
+processor = "timeout_after_slow"
+deps = ["timeout_slow"]
+
+[[graph]]
+name = "fast"
+[[graph.vertex]]
+processor = "timeout_fast"
+
+[[graph]]
+name = "vertex"
+[[graph.vertex]]
+processor = "timeout_slow"
+timeout_ms = 20
+[[graph.vertex]]
+processor = "timeout_fast"
+timeout_ms = 30
+)";
+
+static void reset_timeout_state() {
+  g_slow_cancelled = false;
+  g_slow_finished = false;
+  g_after_slow_count = 0;
+  g_fast_token = folly::CancellationToken();
+}
+
+// returns the code passed to 'done', 'slow_finished' is whether 'timeout_slow' had finished when 'done' was called.
+static int execute_graph(GraphManager& graphs, const std::string& cluster, const std::string& graph,
+                         uint64_t timeout_ms, bool* slow_finished = nullptr) {
+  auto root = GraphDataContext::New();
+  Params params;
+  folly::Latch latch(1);
+  int rc = 0;
+  graphs.Execute(
+      root, cluster, graph, &params,
+      [&](int code) {
+        rc = code;
+        if (nullptr != slow_finished) {
+          *slow_finished = g_slow_finished.load();
+        }
+        latch.count_down();
+      },
+      timeout_ms);
+  latch.wait();
+  return rc;
+}
+
+TEST(GraphTimeout, RequestTimeout) {
+  std::string name = "didagle_test_timeout_" + std::to_string(getpid()) + ".toml";
+  std::string path = write_cluster(name, kTimeoutCluster);
+  GraphExecuteOptions options;
+  options.concurrent_executor = [](AnyClosure&& r) { r(); };
+  GraphManager graphs(options);
+  ASSERT_TRUE(graphs.Load(path) != nullptr);
+
+  reset_timeout_state();
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(ERR_GRAPH_TIMEOUT, execute_graph(graphs, name, "request", 20));
+  auto cost = std::chrono::steady_clock::now() - start;
+  EXPECT_LT(cost, std::chrono::milliseconds(1000));
+  // the running vertex is cancelled, the pending one is skipped
+  EXPECT_TRUE(g_slow_cancelled.load());
+  EXPECT_EQ(0, g_after_slow_count.load());
+
+  // finished in time, the deadline timer is cancelled & never cancels the request
+  reset_timeout_state();
+  EXPECT_EQ(0, execute_graph(graphs, name, "fast", 30));
+  std::this_thread::sleep_for(std::chrono::milliseconds(80));
+  EXPECT_FALSE(g_fast_token.isCancellationRequested());
+  unlink(path.c_str());
+}
+
+TEST(GraphTimeout, VertexTimeout) {
+  std::string name = "didagle_test_vertex_timeout_" + std::to_string(getpid()) + ".toml";
+  std::string path = write_cluster(name, kTimeoutCluster);
+  GraphExecuteOptions options;
+  options.concurrent_executor = [](AnyClosure&& r) { r(); };
+  GraphManager graphs(options);
+  ASSERT_TRUE(graphs.Load(path) != nullptr);
+
+  reset_timeout_state();
+  auto start = std::chrono::steady_clock::now();
+  bool slow_finished = false;
+  execute_graph(graphs, name, "vertex", 0, &slow_finished);
+  auto cost = std::chrono::steady_clock::now() - start;
+  EXPECT_LT(cost, std::chrono::milliseconds(1000));
+  EXPECT_TRUE(g_slow_cancelled.load());
+  EXPECT_TRUE(slow_finished);
+  // the vertex timer of 'timeout_fast' is cancelled once it finished, its token is never cancelled
+  std::this_thread::sleep_for(std::chrono::milliseconds(80));
+  EXPECT_FALSE(g_fast_token.isCancellationRequested());
+  unlink(path.c_str());
+}
+
+static std::atomic<bool> g_stubborn_finished{false};
+
+// never checks the cancellation
+GRAPH_OP_BEGIN(timeout_stubborn)
+int OnExecute(const Params& args) override {
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  g_stubborn_finished = true;
+  return 0;
+}
+GRAPH_OP_END
+
+TEST(GraphTimeout, IgnoreCancellation) {
+  std::string name = "didagle_test_stubborn_timeout_" + std::to_string(getpid()) + ".toml";
+  std::string path = write_cluster(name, R"(
+[[graph]]
+name = "main"
+[[graph.vertex]]
+processor = "timeout_stubborn"
+)");
+  GraphExecuteOptions options;
+  options.concurrent_executor = [](AnyClosure&& r) { std::thread(std::move(r)).detach(); };
+  GraphManager graphs(options);
+  ASSERT_TRUE(graphs.Load(path) != nullptr);
+
+  std::atomic<int> done_count{0};
+  folly::Latch latch(1);
+  int rc = 0;
+  bool stubborn_finished = true;
+  auto start = std::chrono::steady_clock::now();
+  {
+    auto root = GraphDataContext::New();
+    // destroyed once 'done' is called, the request runs with its own copy
+    Params params;
+    Params parent;
+    parent.Put("a", (int64_t)1);
+    params.SetParent(&parent);
+    graphs.Execute(
+        root, name, "main", &params,
+        [&](int code) {
+          rc = code;
+          stubborn_finished = g_stubborn_finished.load();
+          done_count++;
+          latch.count_down();
+        },
+        20);
+    latch.wait();
+  }
+  auto cost = std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(ERR_GRAPH_TIMEOUT, rc);
+  // 'done' is not held by the vertex ignoring the cancellation
+  EXPECT_LT(cost, std::chrono::milliseconds(200));
+  EXPECT_FALSE(stubborn_finished);
+
+  // the late completion is dropped, the context is released after the vertex finished
+  while (!g_stubborn_finished.load()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(1, done_count.load());
+  unlink(path.c_str());
+}
+
+static std::atomic<bool> g_spec_cond_ok{true};
+static std::atomic<int> g_spec_cond_delay_ms{0};
+static std::atomic<int> g_spec_branch_delay_ms{0};
+static std::atomic<int> g_spec_then_count{0};
+static std::atomic<int> g_spec_else_count{0};
+static std::atomic<int> g_spec_then_next{0};
+static std::atomic<int> g_spec_else_next{0};
+// value of the branch outputs seen by a successor depending on both branches, -1 if not collected
+static std::atomic<int> g_spec_then_out{0};
+static std::atomic<int> g_spec_else_out{0};
+
+static void spec_sleep(int ms) {
+  if (ms > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+}
+
+// the 'cond' of the condition vertex is passed as setup args, the result is controlled by the test
+GRAPH_OP_BEGIN(spec_expr)
+int OnExecute(const Params& args) override {
+  spec_sleep(g_spec_cond_delay_ms.load());
+  return g_spec_cond_ok.load() ? 0 : -1;
+}
+GRAPH_OP_END
+
+GRAPH_OP_BEGIN(spec_then)
+GRAPH_OP_OUTPUT(int, spec_then_out)
+int OnExecute(const Params& args) override {
+  g_spec_then_count++;
+  spec_sleep(g_spec_branch_delay_ms.load());
+  spec_then_out = 1;
+  return 0;
+}
+GRAPH_OP_END
+
+GRAPH_OP_BEGIN(spec_else)
+GRAPH_OP_OUTPUT(int, spec_else_out)
+int OnExecute(const Params& args) override {
+  g_spec_else_count++;
+  spec_sleep(g_spec_branch_delay_ms.load());
+  spec_else_out = 2;
+  return 0;
+}
+GRAPH_OP_END
+
+GRAPH_OP_BEGIN(spec_then_next)
+GRAPH_OP_INPUT(int, spec_then_out)
+int OnExecute(const Params& args) override {
+  g_spec_then_next = nullptr != spec_then_out ? *spec_then_out : -1;
+  return 0;
+}
+GRAPH_OP_END
+
+GRAPH_OP_BEGIN(spec_else_next)
+GRAPH_OP_INPUT(int, spec_else_out)
+int OnExecute(const Params& args) override {
+  g_spec_else_next = nullptr != spec_else_out ? *spec_else_out : -1;
+  return 0;
+}
+GRAPH_OP_END
+
+GRAPH_OP_BEGIN(spec_collect)
+GRAPH_OP_INPUT(int, spec_then_out)
+GRAPH_OP_INPUT(int, spec_else_out)
+int OnExecute(const Params& args) override {
+  g_spec_then_out = nullptr != spec_then_out ? *spec_then_out : -1;
+  g_spec_else_out = nullptr != spec_else_out ? *spec_else_out : -1;
+  return 0;
+}
+GRAPH_OP_END
+
+static const char* kSpeculationCluster = R"(
+default_expr_processor = "spec_expr"
+[[graph]]
+name = "spec"
+[[graph.vertex]]
+cond = "spec"
+if = ["spec_then"]
+else = ["spec_else"]
+speculative = true
+[[graph.vertex]]
+processor = "spec_then"
+[[graph.vertex]]
+processor = "spec_else"
+[[graph.vertex]]
+processor = "spec_then_next"
+deps_on_ok = ["spec_then"]
+[[graph.vertex]]
+processor = "spec_else_next"
+deps_on_ok = ["spec_else"]
+[[graph.vertex]]
+processor = "spec_collect"
+)";
+
+struct SpeculationCase {
+  bool cond_ok;
+  // the branches finish before the condition if true, otherwise they start before & finish after the condition
+  bool branch_first;
+};
+
+TEST(GraphSpeculation, CommitBeforeAndAfterCond) {
+  std::string name = "didagle_test_speculation_" + std::to_string(getpid()) + ".toml";
+  std::string path = write_cluster(name, kSpeculationCluster);
+  GraphExecuteOptions options;
+  // vertexs run on their own threads, so that the branches really overlap with the condition
+  options.concurrent_executor = [](AnyClosure&& r) { std::thread([r = std::move(r)]() mutable { r(); }).detach(); };
+  std::shared_ptr<DAGProfiler> profiler = std::make_shared<DAGProfiler>();
+  options.profiler = profiler;
+  GraphManager graphs(options);
+  ASSERT_TRUE(graphs.Load(path) != nullptr);
+
+  uint64_t then_count = 0, then_wasted = 0, else_count = 0, else_wasted = 0;
+  for (SpeculationCase c : {SpeculationCase{true, true}, SpeculationCase{true, false}, SpeculationCase{false, true},
+                            SpeculationCase{false, false}}) {
+    SCOPED_TRACE(fmt::format("cond_ok:{} branch_first:{}", c.cond_ok, c.branch_first));
+    g_spec_cond_ok = c.cond_ok;
+    g_spec_cond_delay_ms = c.branch_first ? 50 : 20;
+    g_spec_branch_delay_ms = c.branch_first ? 0 : 60;
+    g_spec_then_count = 0;
+    g_spec_else_count = 0;
+    g_spec_then_next = 0;
+    g_spec_else_next = 0;
+    g_spec_then_out = 0;
+    g_spec_else_out = 0;
+    EXPECT_EQ(0, execute_graph(graphs, name, "spec", 0));
+
+    // both branches are executed ahead of the condition
+    EXPECT_EQ(1, g_spec_then_count.load());
+    EXPECT_EQ(1, g_spec_else_count.load());
+    // only the outputs of the matched branch are collected, successors of the other one stay skipped
+    EXPECT_EQ(c.cond_ok ? 1 : -1, g_spec_then_out.load());
+    EXPECT_EQ(c.cond_ok ? -1 : 2, g_spec_else_out.load());
+    EXPECT_EQ(c.cond_ok ? 1 : 0, g_spec_then_next.load());
+    EXPECT_EQ(c.cond_ok ? 0 : 2, g_spec_else_next.load());
+
+    const GraphProfile* graph_profile = profiler->FindGraphProfile(name, "spec");
+    ASSERT_TRUE(graph_profile != nullptr);
+    const VertexProfile* then_profile = graph_profile->FindVertexProfile("spec_then");
+    const VertexProfile* else_profile = graph_profile->FindVertexProfile("spec_else");
+    ASSERT_TRUE(then_profile != nullptr);
+    ASSERT_TRUE(else_profile != nullptr);
+    then_count++;
+    else_count++;
+    then_wasted += c.cond_ok ? 0 : 1;
+    else_wasted += c.cond_ok ? 1 : 0;
+    EXPECT_EQ(then_count, then_profile->speculation_count.load());
+    EXPECT_EQ(then_wasted, then_profile->speculation_wasted.load());
+    EXPECT_EQ(then_wasted, then_profile->speculation_waste.Count());
+    EXPECT_EQ(else_count, else_profile->speculation_count.load());
+    EXPECT_EQ(else_wasted, else_profile->speculation_wasted.load());
+    EXPECT_EQ(else_wasted, else_profile->speculation_waste.Count());
+  }
+  unlink(path.c_str());
+}
+
+// per request results written by the processors of the 'batch' graph
+struct BatchResult {
+  int in = 0;
+  int async = 0;
+  int async_next = 0;
+  int io = 0;
+  int sub = 0;
+  int throw_next = 0;
+  int throw_err = 0;
+};
+typedef std::shared_ptr<BatchResult> BatchResultPtr;
+
+#define BATCH_RESULT() GetDataContext().Get<BatchResultPtr>("batch_result")
+
+GRAPH_OP_BEGIN(batch_src)
+GRAPH_OP_OUTPUT(int, batch_a)
+int OnExecute(const Params& args) override {
+  batch_a = BATCH_RESULT()->in * 2;
+  return 0;
+}
+GRAPH_OP_END
+
+GRAPH_FUTURE_OP_BEGIN(batch_async)
+GRAPH_OP_INPUT(int, batch_a)
+folly::Future<int> OnFutureExecute(const Params& args) override {
+  BatchResultPtr r = BATCH_RESULT();
+  if (r->in % 4 == 1) {
+    throw std::runtime_error("batch_async");
+  }
+  int v = *batch_a + 1;
+  return folly::futures::sleep(std::chrono::milliseconds(1)).toUnsafeFuture().thenValue([r, v](folly::Unit) {
+    r->async = v;
+    return 0;
+  });
+}
+GRAPH_OP_END
+
+GRAPH_OP_BEGIN(batch_async_next)
+int OnExecute(const Params& args) override {
+  BATCH_RESULT()->async_next = 1;
+  return 0;
+}
+GRAPH_OP_END
+
+GRAPH_OP_BEGIN(batch_io)
+GRAPH_OP_INPUT(int, batch_a)
+bool isIOProcessor() const override { return true; }
+int OnExecute(const Params& args) override {
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  BATCH_RESULT()->io = *batch_a * 3;
+  return 0;
+}
+GRAPH_OP_END
+
+GRAPH_OP_BEGIN(batch_sub_op)
+GRAPH_OP_INPUT(int, batch_a)
+int OnExecute(const Params& args) override {
+  BATCH_RESULT()->sub = nullptr != batch_a ? *batch_a + 100 : -1;
+  return 0;
+}
+GRAPH_OP_END
+
+GRAPH_OP_BEGIN(batch_throw)
+GRAPH_OP_INPUT(int, batch_a)
+int OnExecute(const Params& args) override {
+  if (BATCH_RESULT()->in % 3 == 0) {
+    throw std::runtime_error("batch_throw");
+  }
+  return 0;
+}
+GRAPH_OP_END
+
+GRAPH_OP_BEGIN(batch_throw_next)
+int OnExecute(const Params& args) override {
+  BATCH_RESULT()->throw_next = 1;
+  return 0;
+}
+GRAPH_OP_END
+
+GRAPH_OP_BEGIN(batch_throw_err)
+int OnExecute(const Params& args) override {
+  BATCH_RESULT()->throw_err = 1;
+  return 0;
+}
+GRAPH_OP_END
+
+static const char* kBatchCluster = R"(
+[[graph]]
+name = "batch"
+[[graph.vertex]]
+processor = "batch_src"
+[[graph.vertex]]
+processor = "batch_async"
+[[graph.vertex]]
+processor = "batch_async_next"
+deps_on_ok = ["batch_async"]
+[[graph.vertex]]
+processor = "batch_io"
+[[graph.vertex]]
+id = "batch_subgraph"
+cluster = "."
+graph = "batch_sub"
+deps = ["batch_src"]
+[[graph.vertex]]
+processor = "batch_throw"
+[[graph.vertex]]
+processor = "batch_throw_next"
+deps_on_ok = ["batch_throw"]
+[[graph.vertex]]
+processor = "batch_throw_err"
+deps_on_err = ["batch_throw"]
+
+[[graph]]
+name = "batch_sub"
+[[graph.vertex]]
+processor = "batch_sub_op"
+input = [{ field = "batch_a", extern = true }]
+)";
+
+static void thread_executor(AnyClosure&& r) {
+  std::thread([r = std::move(r)]() mutable { r(); }).detach();
+}
+
+static std::vector<BatchResultPtr> new_batch_results(int n) {
+  std::vector<BatchResultPtr> results;
+  for (int i = 0; i < n; i++) {
+    results.emplace_back(std::make_shared<BatchResult>());
+    results.back()->in = i;
+  }
+  return results;
+}
+
+TEST(GraphBatch, MatchesExecute) {
+  std::string name = "didagle_test_batch_" + std::to_string(getpid()) + ".toml";
+  std::string path = write_cluster(name, kBatchCluster);
+  GraphExecuteOptions options;
+  options.concurrent_executor = thread_executor;
+  GraphManager graphs(options);
+  ASSERT_TRUE(graphs.Load(path) != nullptr);
+
+  const int n = 12;
+  std::vector<BatchResultPtr> expected = new_batch_results(n);
+  for (int i = 0; i < n; i++) {
+    auto root = GraphDataContext::New();
+    root->Set("batch_result", &expected[i]);
+    folly::Latch latch(1);
+    graphs.Execute(root, name, "batch", nullptr, [&](int code) { latch.count_down(); });
+    latch.wait();
+  }
+
+  std::vector<BatchResultPtr> results = new_batch_results(n);
+  std::vector<GraphDataContextPtr> batch;
+  for (int i = 0; i < n; i++) {
+    batch.emplace_back(GraphDataContext::New());
+    batch.back()->Set("batch_result", &results[i]);
+  }
+  folly::Latch latch(1);
+  int rc = -1;
+  graphs.ExecuteBatch(batch, name, "batch", {}, [&](int code) {
+    rc = code;
+    latch.count_down();
+  });
+  latch.wait();
+  EXPECT_EQ(0, rc);
+
+  for (int i = 0; i < n; i++) {
+    SCOPED_TRACE(fmt::format("request:{}", i));
+    const BatchResult& e = *expected[i];
+    const BatchResult& r = *results[i];
+    // per request execution as reference
+    bool async_throw = i % 4 == 1;
+    bool sync_throw = i % 3 == 0;
+    EXPECT_EQ(async_throw ? 0 : i * 2 + 1, e.async);
+    EXPECT_EQ(async_throw ? 0 : 1, e.async_next);
+    EXPECT_EQ(i * 6, e.io);
+    EXPECT_EQ(i * 2 + 100, e.sub);
+    EXPECT_EQ(sync_throw ? 0 : 1, e.throw_next);
+    EXPECT_EQ(sync_throw ? 1 : 0, e.throw_err);
+
+    EXPECT_EQ(e.async, r.async);
+    EXPECT_EQ(e.async_next, r.async_next);
+    EXPECT_EQ(e.io, r.io);
+    EXPECT_EQ(e.sub, r.sub);
+    EXPECT_EQ(e.throw_next, r.throw_next);
+    EXPECT_EQ(e.throw_err, r.throw_err);
+  }
+  unlink(path.c_str());
+}
+
+// vertexs executed by one request of the 'dyn'/'static' graphs
+struct ScheduleResult {
+  int in = 0;
+  std::mutex mutex;
+  std::set<std::string> executed;
+};
+typedef std::shared_ptr<ScheduleResult> ScheduleResultPtr;
+
+static void mark_executed(const GraphDataContext& ctx, const std::string& id) {
+  ScheduleResultPtr r = ctx.Get<ScheduleResultPtr>("schedule_result");
+  std::lock_guard<std::mutex> guard(r->mutex);
+  r->executed.insert(id);
+}
+
+// condition vertex, true for odd requests
+GRAPH_OP_BEGIN(schedule_expr)
+int OnExecute(const Params& args) override {
+  mark_executed(GetDataContext(), GetID());
+  return GetDataContext().Get<ScheduleResultPtr>("schedule_result")->in % 2 == 1 ? 0 : -1;
+}
+GRAPH_OP_END
+
+// fails the requests which are multiples of 'fail_mod'
+GRAPH_OP_BEGIN(schedule_mark)
+int OnExecute(const Params& args) override {
+  mark_executed(GetDataContext(), GetID());
+  int64_t fail_mod = args["fail_mod"].Int();
+  if (fail_mod > 0 && GetDataContext().Get<ScheduleResultPtr>("schedule_result")->in % fail_mod == 0) {
+    return -1;
+  }
+  return 0;
+}
+GRAPH_OP_END
+
+static std::string schedule_graph(const std::string& name, bool static_schedule) {
+  return "[[graph]]\n"
+         "name = \"" +
+         name + "\"\n" + (static_schedule ? "static_schedule = true\n" : "") + R"(
+[[graph.vertex]]
+id = "src"
+processor = "schedule_mark"
+[[graph.vertex]]
+id = "odd"
+cond = "odd"
+deps = ["src"]
+if = ["if_v"]
+else = ["else_v"]
+[[graph.vertex]]
+id = "if_v"
+processor = "schedule_mark"
+[[graph.vertex]]
+id = "else_v"
+processor = "schedule_mark"
+[[graph.vertex]]
+id = "after_if"
+processor = "schedule_mark"
+deps_on_ok = ["if_v"]
+[[graph.vertex]]
+id = "fail"
+processor = "schedule_mark"
+args = { fail_mod = 3 }
+deps = ["src"]
+[[graph.vertex]]
+id = "on_ok"
+processor = "schedule_mark"
+deps_on_ok = ["fail"]
+[[graph.vertex]]
+id = "on_err"
+processor = "schedule_mark"
+deps_on_err = ["fail"]
+[[graph.vertex]]
+id = "join"
+processor = "schedule_mark"
+deps = ["after_if", "else_v", "on_ok", "on_err"]
+)";
+}
+
+static ScheduleResultPtr execute_schedule(GraphManager& graphs, const std::string& cluster, const std::string& graph,
+                                          int in) {
+  ScheduleResultPtr r = std::make_shared<ScheduleResult>();
+  r->in = in;
+  auto root = GraphDataContext::New();
+  root->Set("schedule_result", &r);
+  folly::Latch latch(1);
+  graphs.Execute(root, cluster, graph, nullptr, [&](int code) { latch.count_down(); });
+  latch.wait();
+  return r;
+}
+
+TEST(GraphStaticSchedule, MatchesDynamic) {
+  std::string name = "didagle_test_static_" + std::to_string(getpid()) + ".toml";
+  std::string path = write_cluster(name, "default_expr_processor = \"schedule_expr\"\n" +
+                                             schedule_graph("dyn", false) + schedule_graph("static", true));
+  GraphExecuteOptions options;
+  options.concurrent_executor = thread_executor;
+  std::shared_ptr<DAGProfiler> profiler = std::make_shared<DAGProfiler>();
+  std::mutex paths_mutex;
+  std::vector<std::vector<std::string>> static_paths;
+  profiler->SetCriticalPathReporter([&](const CriticalPath& path) {
+    if (path.graph != "static") {
+      return;
+    }
+    std::vector<std::string> ids;
+    for (const auto& node : path.nodes) {
+      ids.emplace_back(node.id);
+    }
+    std::lock_guard<std::mutex> guard(paths_mutex);
+    static_paths.emplace_back(std::move(ids));
+  });
+  options.profiler = profiler;
+  GraphManager graphs(options);
+  ASSERT_TRUE(graphs.Load(path) != nullptr);
+
+  const int n = 12;
+  for (int i = 0; i < n; i++) {
+    SCOPED_TRACE(fmt::format("request:{}", i));
+    ScheduleResultPtr dyn = execute_schedule(graphs, name, "dyn", i);
+    ScheduleResultPtr st = execute_schedule(graphs, name, "static", i);
+    EXPECT_EQ(dyn->executed, st->executed);
+    // cond edges & skip propagation
+    EXPECT_EQ(i % 2 == 1, st->executed.count("if_v") > 0);
+    EXPECT_EQ(i % 2 == 1, st->executed.count("after_if") > 0);
+    EXPECT_EQ(i % 2 == 0, st->executed.count("else_v") > 0);
+    // ok/err edges
+    EXPECT_EQ(i % 3 != 0, st->executed.count("on_ok") > 0);
+    EXPECT_EQ(i % 3 == 0, st->executed.count("on_err") > 0);
+    EXPECT_EQ(1, st->executed.count("join"));
+  }
+
+  // batch mode follows the static levels
+  std::vector<ScheduleResultPtr> results;
+  std::vector<GraphDataContextPtr> batch;
+  for (int i = 0; i < n; i++) {
+    results.emplace_back(std::make_shared<ScheduleResult>());
+    results.back()->in = i;
+    batch.emplace_back(GraphDataContext::New());
+    batch.back()->Set("schedule_result", &results.back());
+  }
+  folly::Latch latch(1);
+  graphs.ExecuteBatch(batch, name, "static", {}, [&](int code) { latch.count_down(); });
+  latch.wait();
+  for (int i = 0; i < n; i++) {
+    ScheduleResultPtr dyn = execute_schedule(graphs, name, "dyn", i);
+    EXPECT_EQ(dyn->executed, results[i]->executed);
+  }
+
+  // critical paths of static & batch executions are walked back to the start vertex
+  std::lock_guard<std::mutex> guard(paths_mutex);
+  EXPECT_EQ(static_cast<size_t>(2 * n), static_paths.size());
+  for (const auto& ids : static_paths) {
+    ASSERT_GE(ids.size(), 3u);
+    EXPECT_EQ("src", ids.front());
+    EXPECT_EQ("join", ids.back());
+  }
+  unlink(path.c_str());
+}
+
+TEST(GraphScheduler, MatchesConcurrentExecutor) {
+  std::string name = "didagle_test_scheduler_" + std::to_string(getpid()) + ".toml";
+  std::string path =
+      write_cluster(name, "default_expr_processor = \"schedule_expr\"\n" + schedule_graph("dyn", false));
+  GraphExecuteOptions reference_options;
+  reference_options.concurrent_executor = thread_executor;
+  GraphManager reference(reference_options);
+  ASSERT_TRUE(reference.Load(path) != nullptr);
+  GraphExecuteOptions options;
+  options.scheduler = std::make_shared<WorkStealingScheduler>(4);
+  GraphManager graphs(options);
+  ASSERT_TRUE(graphs.Load(path) != nullptr);
+
+  const int n = 12;
+  std::vector<ScheduleResultPtr> expected;
+  for (int i = 0; i < n; i++) {
+    SCOPED_TRACE(fmt::format("request:{}", i));
+    expected.emplace_back(execute_schedule(reference, name, "dyn", i));
+    EXPECT_EQ(expected[i]->executed, execute_schedule(graphs, name, "dyn", i)->executed);
+  }
+
+  // concurrent requests started outside the workers
+  const int concurrent = n * 8;
+  std::vector<ScheduleResultPtr> results;
+  // the contexts refer to the elements
+  results.reserve(concurrent);
+  folly::Latch latch(concurrent);
+  for (int i = 0; i < concurrent; i++) {
+    results.emplace_back(std::make_shared<ScheduleResult>());
+    results.back()->in = i % n;
+    auto root = GraphDataContext::New();
+    root->Set("schedule_result", &results.back());
+    graphs.Execute(root, name, "dyn", nullptr, [&](int code) { latch.count_down(); });
+  }
+  latch.wait();
+  for (int i = 0; i < concurrent; i++) {
+    SCOPED_TRACE(fmt::format("request:{}", i));
+    EXPECT_EQ(expected[i % n]->executed, results[i]->executed);
+  }
+  unlink(path.c_str());
+}
+
+// NUMA nodes which the vertexs of one request ran on, -1 if not on a node's worker
+struct NumaResult {
+  std::mutex mutex;
+  std::set<int> nodes;
+};
+typedef std::shared_ptr<NumaResult> NumaResultPtr;
+static NumaScheduler* g_numa_scheduler = nullptr;
+
+GRAPH_OP_BEGIN(numa_mark)
+int OnExecute(const Params& args) override {
+  int node = -1;
+  for (size_t i = 0; i < g_numa_scheduler->NodeNum(); i++) {
+    if (g_numa_scheduler->GetScheduler(static_cast<int>(i))->InWorkerThread()) {
+      node = static_cast<int>(i);
+    }
+  }
+  // keeps requests running concurrently so that they spill to the other node
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  NumaResultPtr r = GetDataContext().Get<NumaResultPtr>("numa_result");
+  std::lock_guard<std::mutex> guard(r->mutex);
+  r->nodes.insert(node);
+  return 0;
+}
+GRAPH_OP_END
+
+TEST(GraphNuma, ExecuteOnOneNode) {
+  std::string name = "didagle_test_numa_" + std::to_string(getpid()) + ".toml";
+  std::string path = write_cluster(name, R"(
+default_context_pool_size = 4
+[[graph]]
+name = "main"
+[[graph.vertex]]
+id = "src"
+processor = "numa_mark"
+[[graph.vertex]]
+id = "left"
+processor = "numa_mark"
+deps = ["src"]
+[[graph.vertex]]
+id = "right"
+processor = "numa_mark"
+deps = ["src"]
+[[graph.vertex]]
+id = "join"
+processor = "numa_mark"
+deps = ["left", "right"]
+)");
+  // two fake nodes sharing all cpus, so that the workers are not restricted
+  NumaTopology topology;
+  topology.node_cpus.emplace_back(NumaTopology::Get().node_cpus[0]);
+  topology.node_cpus.emplace_back(NumaTopology::Get().node_cpus[0]);
+  NumaSchedulerOptions numa_options;
+  numa_options.threads_per_node = 2;
+  numa_options.spill_threshold = 1;
+  GraphExecuteOptions options;
+  options.numa_scheduler = std::make_shared<NumaScheduler>(topology, numa_options);
+  g_numa_scheduler = options.numa_scheduler.get();
+  GraphManager graphs(options);
+  std::shared_ptr<GraphCluster> cluster = graphs.Load(path);
+  ASSERT_TRUE(cluster != nullptr);
+  // the pool size is split among the node local pools
+  ASSERT_EQ(2u, cluster->_context_pools.size());
+  EXPECT_EQ(2u, cluster->_context_pools[0]->size_approx());
+  EXPECT_EQ(2u, cluster->_context_pools[1]->size_approx());
+
+  const int n = 32;
+  std::vector<NumaResultPtr> results;
+  // the contexts refer to the elements
+  results.reserve(n);
+  folly::Latch latch(n);
+  for (int i = 0; i < n; i++) {
+    results.emplace_back(std::make_shared<NumaResult>());
+    auto root = GraphDataContext::New();
+    root->Set("numa_result", &results.back());
+    graphs.Execute(root, name, "main", nullptr, [&](int code) { latch.count_down(); });
+  }
+  latch.wait();
+  std::set<int> used_nodes;
+  for (int i = 0; i < n; i++) {
+    SCOPED_TRACE(fmt::format("request:{}", i));
+    // all vertexs of a request run on the workers of one node
+    ASSERT_EQ(1u, results[i]->nodes.size());
+    EXPECT_NE(-1, *results[i]->nodes.begin());
+    used_nodes.insert(*results[i]->nodes.begin());
+  }
+  EXPECT_EQ(2u, used_nodes.size());
+  EXPECT_GT(g_numa_scheduler->SpilledRequests(), 0u);
+  EXPECT_EQ(0, g_numa_scheduler->RunningRequests(0));
+  EXPECT_EQ(0, g_numa_scheduler->RunningRequests(1));
+
+  // contexts are released in background & returned to the pools of their nodes
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_GE(cluster->_context_pools[0]->size_approx(), 2u);
+  EXPECT_GE(cluster->_context_pools[1]->size_approx(), 2u);
+  g_numa_scheduler = nullptr;
+  unlink(path.c_str());
+}
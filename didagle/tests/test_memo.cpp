@@ -0,0 +1,113 @@
+// Copyright (c) 2021, Tencent Inc.
+// All rights reserved.
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "didagle/didagle_memo.h"
+
+using namespace didagle;
+
+template <typename T>
+static MemoKey hash_value(const T& v) {
+  MemoHasher h;
+  EXPECT_TRUE(HashInputField(&v, h));
+  return h.GetKey();
+}
+
+static MemoKey make_key(uint64_t v) {
+  MemoHasher h;
+  h.Update(v);
+  return h.GetKey();
+}
+
+static MemoEntryPtr make_entry(int v) {
+  auto entry = std::make_shared<MemoEntry>();
+  entry->outputs.emplace_back(MemoValue<int>::Snapshot(&v));
+  return entry;
+}
+
+struct Unhashable {
+  int v = 0;
+};
+
+TEST(MemoHasher, InputFields) {
+  EXPECT_TRUE(hash_value(std::string("abc")) == hash_value(std::string("abc")));
+  EXPECT_FALSE(hash_value(std::string("abc")) == hash_value(std::string("abd")));
+  EXPECT_FALSE(hash_value(1) == hash_value(2));
+  std::vector<std::string> v0 = {"a", "bc"};
+  std::vector<std::string> v1 = {"ab", "c"};
+  EXPECT_FALSE(hash_value(v0) == hash_value(v1));
+  std::map<std::string, int64_t> m = {{"a", 1}};
+  EXPECT_TRUE(hash_value(m) == hash_value(std::map<std::string, int64_t>{{"a", 1}}));
+
+  MemoHasher null_hasher;
+  EXPECT_TRUE(HashInputField(static_cast<const std::string*>(nullptr), null_hasher));
+  EXPECT_FALSE(null_hasher.GetKey() == hash_value(std::string("")));
+
+  Unhashable u;
+  MemoHasher h;
+  EXPECT_FALSE(HashInputField(&u, h));
+}
+
+TEST(MemoValue, SnapshotRestore) {
+  std::map<std::string, std::string> v = {{"k", "v"}};
+  auto snapshot = MemoValue<std::map<std::string, std::string>>::Snapshot(&v);
+  ASSERT_TRUE(snapshot != nullptr);
+  v.clear();
+  std::map<std::string, std::string> restored;
+  EXPECT_TRUE((MemoValue<std::map<std::string, std::string>>::Restore(snapshot, &restored)));
+  EXPECT_EQ(restored["k"], "v");
+
+  std::unique_ptr<int> p;
+  EXPECT_TRUE(MemoValue<std::unique_ptr<int>>::Snapshot(&p) == nullptr);
+}
+
+TEST(MemoCache, LRUEviction) {
+  MemoCache cache(2, 1);
+  cache.Put(make_key(1), make_entry(1));
+  cache.Put(make_key(2), make_entry(2));
+  ASSERT_TRUE(cache.Get(make_key(1)) != nullptr);
+  cache.Put(make_key(3), make_entry(3));
+  EXPECT_EQ(cache.Size(), 2);
+  EXPECT_TRUE(cache.Get(make_key(2)) == nullptr);
+  auto entry = cache.Get(make_key(1));
+  ASSERT_TRUE(entry != nullptr);
+  EXPECT_EQ(*static_cast<const int*>(entry->outputs[0].get()), 1);
+  EXPECT_EQ(cache.Hits(), 2);
+  EXPECT_EQ(cache.Misses(), 1);
+
+  // same slot with a different check hash is a miss
+  MemoKey collided = make_key(3);
+  collided.check++;
+  EXPECT_TRUE(cache.Get(collided) == nullptr);
+  cache.Clear();
+  EXPECT_EQ(cache.Size(), 0);
+}
+
+TEST(MemoCache, Concurrent) {
+  MemoCache cache(1024);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&cache]() {
+      for (int i = 0; i < 10000; i++) {
+        MemoKey key = make_key(i % 2048);
+        auto entry = cache.Get(key);
+        if (entry) {
+          EXPECT_EQ(*static_cast<const int*>(entry->outputs[0].get()), i % 2048);
+        } else {
+          cache.Put(key, make_entry(i % 2048));
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_LE(cache.Size(), 1024);
+  EXPECT_EQ(cache.Hits() + cache.Misses(), 40000);
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2021, Tencent Inc.
+// All rights reserved.
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "didagle/graph_params.h"
+using namespace didagle;
+
+TEST(ParamsUT, GetVar) {
+  Params params;
+  params["x"].SetInt(1);
+  params["EXP"]["field1"].SetInt(1221);
+  params["EXP"]["sub"]["name"].SetString("abc");
+  EXPECT_EQ(1, params.GetVar("x").Int());
+  EXPECT_EQ(1221, params.GetVar("EXP.field1").Int());
+  EXPECT_EQ("abc", params.GetVar("EXP.sub.name").String());
+  EXPECT_FALSE(params.GetVar("EXP.none").Valid());
+}
+
+TEST(ParamsUT, ParamsPath) {
+  Params parent;
+  parent["EXP"]["field1"].SetInt(1221);
+  parent["expid"].SetInt(1000);
+  Params params;
+  params["x"].SetInt(1);
+  params.SetParent(&parent);
+
+  ParamsPath field1("EXP.field1");
+  ASSERT_EQ(2, field1.Size());
+  EXPECT_EQ("EXP.field1", field1.ToString());
+  EXPECT_EQ(1221, params.GetVar(field1).Int());
+  EXPECT_EQ(1000, params.GetVar(ParamsPath(std::vector<std::string>{"expid"})).Int());
+  EXPECT_EQ(1, params.GetVar(ParamsPath("x")).Int());
+  EXPECT_FALSE(params.GetVar(ParamsPath("EXP.none")).Valid());
+  EXPECT_FALSE(params.GetVar(ParamsPath()).Valid());
+
+  // keys are interned once & shared
+  const ParamsKey* key = ParamsKeyTable::Global().Intern("expid");
+  EXPECT_EQ(key, ParamsKeyTable::Global().Intern(std::string("expid")));
+  EXPECT_EQ(key->id, ParamsPath("expid")[0].id);
+  EXPECT_TRUE(params.Contains(*key));
+  EXPECT_FALSE(params.Contains(*ParamsKeyTable::Global().Intern("none")));
+
+  // lookup only
+  EXPECT_EQ(key, ParamsKeyTable::Global().Find("expid"));
+  size_t table_size = ParamsKeyTable::Global().Size();
+  EXPECT_TRUE(ParamsKeyTable::Global().Find("never_interned_key") == nullptr);
+  EXPECT_EQ(table_size, ParamsKeyTable::Global().Size());
+}
+
+TEST(ParamsUT, HashWithParents) {
+  Params request;
+  request["expid"].SetInt(1000);
+  Params args;
+  args["x"].SetInt(1);
+  args.SetParent(&request);
+  uint64_t hash = args.HashWithParents();
+  EXPECT_NE(args.Hash(), hash);
+
+  // same vertex args with another request level param
+  Params other_request;
+  other_request["expid"].SetInt(1001);
+  Params other_args;
+  other_args["x"].SetInt(1);
+  other_args.SetParent(&other_request);
+  EXPECT_EQ(args.Hash(), other_args.Hash());
+  EXPECT_NE(hash, other_args.HashWithParents());
+  other_request["expid"].SetInt(1000);
+  EXPECT_EQ(hash, other_args.HashWithParents());
+
+  other_args.SetParent(nullptr);
+  EXPECT_EQ(other_args.Hash(), other_args.HashWithParents());
+}
@@ -3,6 +3,16 @@
 
 #include <benchmark/benchmark.h>
 #include <sys/time.h>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "boost/asio/post.hpp"
+#include "boost/asio/thread_pool.hpp"
+#include "didagle/didagle_scheduler.h"
+#include "didagle/graph.h"
 #include "didagle/graph_processor.h"
 #include "didagle/graph_processor_api.h"
 using namespace didagle;
@@ -33,7 +43,132 @@ static void BM_test_proc_run(benchmark::State& state) {
     run_processor(*ctx, "test_phase");
   }
 }
+GRAPH_OP_BEGIN(bench_phase)
+int OnSetup(const Params& args) override { return 0; }
+int OnExecute(const Params& args) override {
+  uint64_t v = 0;
+  for (int i = 0; i < 200; i++) {
+    v += i * i;
+  }
+  benchmark::DoNotOptimize(v);
+  return 0;
+}
+GRAPH_OP_END
+
+static const int kGraphWidth = 64;
+static const int kGraphDepth = 64;
+
+// wide: start -> 64 parallel vertexs -> merge;  deep: a chain of 64 vertexs; small: a 4 vertexs diamond.
+// '*_static' graphs are the same graphs executed by the precomputed static schedule.
+static std::string write_bench_graphs() {
+  std::string file = "/tmp/didagle_bench_graphs.toml";
+  std::ofstream os(file);
+  os << "name = \"bench\"\nstrict_dsl = false\n";
+  for (bool static_schedule : {false, true}) {
+    std::string suffix = static_schedule ? "_static" : "";
+    std::string schedule = static_schedule ? "static_schedule = true\n" : "";
+    os << "[[graph]]\nname = \"wide" << suffix << "\"\n" << schedule;
+    os << "[[graph.vertex]]\nid = \"start\"\nprocessor = \"bench_phase\"\nstart = true\n";
+    for (int i = 0; i < kGraphWidth; i++) {
+      os << "[[graph.vertex]]\nid = \"w" << i << "\"\nprocessor = \"bench_phase\"\ndeps = [\"start\"]\n";
+    }
+    os << "[[graph.vertex]]\nid = \"merge\"\nprocessor = \"bench_phase\"\ndeps = [";
+    for (int i = 0; i < kGraphWidth; i++) {
+      os << (i > 0 ? ", " : "") << "\"w" << i << "\"";
+    }
+    os << "]\n";
+    os << "[[graph]]\nname = \"deep" << suffix << "\"\n" << schedule;
+    os << "[[graph.vertex]]\nid = \"d0\"\nprocessor = \"bench_phase\"\nstart = true\n";
+    for (int i = 1; i < kGraphDepth; i++) {
+      os << "[[graph.vertex]]\nid = \"d" << i << "\"\nprocessor = \"bench_phase\"\ndeps = [\"d" << (i - 1)
+         << "\"]\n";
+    }
+    os << "[[graph]]\nname = \"small" << suffix << "\"\n" << schedule;
+    os << "[[graph.vertex]]\nid = \"s0\"\nprocessor = \"bench_phase\"\nstart = true\n";
+    os << "[[graph.vertex]]\nid = \"s1\"\nprocessor = \"bench_phase\"\ndeps = [\"s0\"]\n";
+    os << "[[graph.vertex]]\nid = \"s2\"\nprocessor = \"bench_phase\"\ndeps = [\"s0\"]\n";
+    os << "[[graph.vertex]]\nid = \"s3\"\nprocessor = \"bench_phase\"\ndeps = [\"s1\", \"s2\"]\n";
+  }
+  return file;
+}
+
+static void run_bench_graph(benchmark::State& state, GraphManager& graphs, const std::string& graph) {
+  std::string file = write_bench_graphs();
+  if (!graphs.Load(file)) {
+    state.SkipWithError("Failed to load bench graphs");
+    return;
+  }
+  auto root = GraphDataContext::New();
+  std::mutex mutex;
+  std::condition_variable cv;
+  for (auto _ : state) {
+    bool done = false;
+    graphs.Execute(root, "didagle_bench_graphs.toml", graph, nullptr, [&](int) {
+      std::lock_guard<std::mutex> guard(mutex);
+      done = true;
+      cv.notify_one();
+    });
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&]() { return done; });
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_graph_executor(benchmark::State& state, const std::string& graph) {
+  boost::asio::thread_pool pool(8);
+  GraphExecuteOptions exec_opt;
+  exec_opt.concurrent_executor = [&pool](AnyClosure&& r) { boost::asio::post(pool, r); };
+  GraphManager graphs(exec_opt);
+  run_bench_graph(state, graphs, graph);
+}
+static void BM_graph_scheduler(benchmark::State& state, const std::string& graph) {
+  GraphExecuteOptions exec_opt;
+  exec_opt.scheduler = std::make_shared<WorkStealingScheduler>(8);
+  GraphManager graphs(exec_opt);
+  run_bench_graph(state, graphs, graph);
+}
+
+static const int kBatchSize = 32;
+// one 'ExecuteBatch' call over 'kBatchSize' requests per iteration, compare the items rate with 'BM_graph_executor'.
+static void BM_graph_batch(benchmark::State& state, const std::string& graph) {
+  boost::asio::thread_pool pool(8);
+  GraphExecuteOptions exec_opt;
+  exec_opt.concurrent_executor = [&pool](AnyClosure&& r) { boost::asio::post(pool, r); };
+  GraphManager graphs(exec_opt);
+  if (!graphs.Load(write_bench_graphs())) {
+    state.SkipWithError("Failed to load bench graphs");
+    return;
+  }
+  std::vector<GraphDataContextPtr> batch;
+  for (int i = 0; i < kBatchSize; i++) {
+    batch.emplace_back(GraphDataContext::New());
+  }
+  std::mutex mutex;
+  std::condition_variable cv;
+  for (auto _ : state) {
+    bool done = false;
+    graphs.ExecuteBatch(batch, "didagle_bench_graphs.toml", graph, {}, [&](int) {
+      std::lock_guard<std::mutex> guard(mutex);
+      done = true;
+      cv.notify_one();
+    });
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&]() { return done; });
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
 // Register the function as a benchmark
 BENCHMARK(BM_test_proc_run);
+BENCHMARK_CAPTURE(BM_graph_executor, wide, std::string("wide"))->UseRealTime();
+BENCHMARK_CAPTURE(BM_graph_scheduler, wide, std::string("wide"))->UseRealTime();
+BENCHMARK_CAPTURE(BM_graph_executor, deep, std::string("deep"))->UseRealTime();
+BENCHMARK_CAPTURE(BM_graph_scheduler, deep, std::string("deep"))->UseRealTime();
+BENCHMARK_CAPTURE(BM_graph_executor, deep_static, std::string("deep_static"))->UseRealTime();
+BENCHMARK_CAPTURE(BM_graph_executor, wide_static, std::string("wide_static"))->UseRealTime();
+BENCHMARK_CAPTURE(BM_graph_executor, small, std::string("small"))->UseRealTime();
+BENCHMARK_CAPTURE(BM_graph_executor, small_static, std::string("small_static"))->UseRealTime();
+BENCHMARK_CAPTURE(BM_graph_batch, small, std::string("small"))->UseRealTime();
+BENCHMARK_CAPTURE(BM_graph_batch, deep, std::string("deep"))->UseRealTime();
 // Run the benchmark
 BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,99 @@
+// Copyright (c) 2021, Tencent Inc.
+// All rights reserved.
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include "didagle/didagle_profiler.h"
+using namespace didagle;
+
+TEST(ProfilerUT, HistogramBucket) {
+  uint32_t last_idx = 0;
+  for (uint64_t v = 0; v < 100000; v++) {
+    uint32_t idx = LatencyHistogram::GetBucketIndex(v);
+    EXPECT_GE(idx, last_idx);
+    EXPECT_LE(idx, last_idx + 1);
+    EXPECT_LE(v, LatencyHistogram::GetBucketUpperBound(idx));
+    if (idx > 0) {
+      EXPECT_GT(v, LatencyHistogram::GetBucketUpperBound(idx - 1));
+    }
+    last_idx = idx;
+  }
+  EXPECT_EQ(LatencyHistogram::kBucketNum - 1, LatencyHistogram::GetBucketIndex(UINT64_MAX));
+  EXPECT_EQ(UINT64_MAX, LatencyHistogram::GetBucketUpperBound(LatencyHistogram::kBucketNum - 1));
+}
+
+TEST(ProfilerUT, HistogramPercentile) {
+  LatencyHistogram hist;
+  EXPECT_EQ(0, hist.Percentile(50));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&hist]() {
+      for (uint64_t v = 1; v <= 1000; v++) {
+        hist.Record(v);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(4000, hist.Count());
+  EXPECT_EQ(1000, hist.Max());
+  EXPECT_EQ(500, hist.Avg());
+  uint64_t p50 = hist.Percentile(50);
+  uint64_t p99 = hist.Percentile(99);
+  EXPECT_GE(p50, 500);
+  EXPECT_LE(p50, 500 * 1.125);
+  EXPECT_GE(p99, 990);
+  EXPECT_LE(p99, 1000);
+  EXPECT_EQ(1000, hist.Percentile(100));
+  hist.Clear();
+  EXPECT_EQ(0, hist.Count());
+  EXPECT_EQ(0, hist.Percentile(99));
+}
+
+TEST(ProfilerUT, CriticalPath) {
+  DAGProfiler profiler;
+  std::vector<std::string> reported;
+  profiler.SetCriticalPathReporter([&reported](const CriticalPath& path) {
+    for (const auto& node : path.nodes) {
+      reported.emplace_back(node.id);
+    }
+  });
+  GraphProfile* graph = profiler.GetGraphProfile("cluster.toml", "main");
+  EXPECT_EQ(graph, profiler.GetGraphProfile("cluster.toml", "main"));
+  EXPECT_EQ(graph, profiler.FindGraphProfile("cluster.toml", "main"));
+  EXPECT_EQ(nullptr, profiler.FindGraphProfile("cluster.toml", "other"));
+  VertexProfile* a = graph->GetVertexProfile("a");
+  VertexProfile* b = graph->GetVertexProfile("b");
+  EXPECT_EQ(a, graph->GetVertexProfile("a"));
+
+  for (int i = 0; i < 3; i++) {
+    CriticalPath path;
+    path.start_ustime = 100;
+    path.end_ustime = 200;
+    CriticalPathNode node;
+    node.id = "a";
+    path.nodes.emplace_back(node);
+    a->critical_count++;
+    if (i == 0) {
+      node.id = "b";
+      path.nodes.emplace_back(node);
+      b->critical_count++;
+    }
+    graph->OnGraphDone(path);
+  }
+  EXPECT_EQ(3, graph->request_count.load());
+  EXPECT_EQ(3, graph->total.Count());
+  EXPECT_EQ(100, graph->total.Max());
+  EXPECT_TRUE(graph->IsCritical("a"));
+  EXPECT_FALSE(graph->IsCritical("b"));
+  EXPECT_FALSE(graph->IsCritical("c"));
+  EXPECT_EQ(std::vector<std::string>({"a", "b", "a", "a"}), reported);
+
+  profiler.Clear();
+  EXPECT_EQ(0, graph->request_count.load());
+  EXPECT_EQ(0, a->critical_count.load());
+  EXPECT_FALSE(graph->IsCritical("a"));
+}
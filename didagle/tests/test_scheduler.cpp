@@ -0,0 +1,197 @@
+// Copyright (c) 2021, Tencent Inc.
+// All rights reserved.
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "didagle/didagle_scheduler.h"
+using namespace didagle;
+
+TEST(SchedulerUT, ChaseLevDeque) {
+  struct Item {
+    std::atomic<int> taken{0};
+  };
+  const int kItems = 100000;
+  std::vector<Item> items(kItems);
+  ChaseLevDeque<Item> deque(4);
+  std::atomic<bool> done{false};
+  std::atomic<int> stolen{0};
+  std::vector<std::thread> thieves;
+  for (int i = 0; i < 4; i++) {
+    thieves.emplace_back([&]() {
+      while (!done.load()) {
+        Item* item = deque.Steal();
+        if (nullptr != item) {
+          item->taken++;
+          stolen++;
+        }
+      }
+    });
+  }
+  int popped = 0;
+  for (int i = 0; i < kItems; i++) {
+    deque.Push(&items[i]);
+    if (i % 3 == 0) {
+      Item* item = deque.Pop();
+      if (nullptr != item) {
+        item->taken++;
+        popped++;
+      }
+    }
+  }
+  while (Item* item = deque.Pop()) {
+    item->taken++;
+    popped++;
+  }
+  done = true;
+  for (auto& t : thieves) {
+    t.join();
+  }
+  EXPECT_EQ(kItems, popped + stolen.load());
+  for (auto& item : items) {
+    EXPECT_EQ(1, item.taken.load());
+  }
+}
+
+TEST(SchedulerUT, FanOutFanIn) {
+  WorkStealingScheduler scheduler(4);
+  std::mutex mutex;
+  std::condition_variable cv;
+  const int kTasks = 10000;
+  std::atomic<int> count{0};
+  std::atomic<int> in_worker{0};
+  // every task posts a child task from the worker thread until depth 10
+  std::function<void(int)> spawn;
+  spawn = [&](int depth) {
+    if (scheduler.InWorkerThread()) {
+      in_worker++;
+    }
+    if (++count == kTasks) {
+      std::lock_guard<std::mutex> guard(mutex);
+      cv.notify_all();
+    }
+    if (depth < 9) {
+      scheduler.Post([&spawn, depth]() { spawn(depth + 1); });
+    }
+  };
+  for (int i = 0; i < kTasks / 10; i++) {
+    scheduler.Post([&spawn]() { spawn(0); });
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&]() { return count.load() == kTasks; });
+  EXPECT_EQ(kTasks, in_worker.load());
+}
+
+TEST(SchedulerUT, StopRunsQueuedTasks) {
+  WorkStealingScheduler scheduler(1);
+  std::atomic<bool> blocked{false};
+  std::atomic<int> count{0};
+  // keeps the only worker busy so that the following tasks are still queued when stopping
+  scheduler.Post([&]() {
+    blocked = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  });
+  while (!blocked.load()) {
+    std::this_thread::yield();
+  }
+  const int kTasks = 100;
+  for (int i = 0; i < kTasks; i++) {
+    scheduler.Post([&]() {
+      // continuations scheduled by the drained tasks run too
+      scheduler.Post([&]() { count++; });
+    });
+  }
+  scheduler.Stop();
+  EXPECT_EQ(kTasks, count.load());
+  EXPECT_EQ(0, scheduler.PendingTasks());
+  scheduler.Post([&]() { count++; });
+  EXPECT_EQ(kTasks + 1, count.load());
+}
+
+TEST(SchedulerUT, ParseCpuList) {
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 8, 10, 11}), NumaTopology::ParseCpuList("0-3,8,10-11"));
+  EXPECT_EQ(std::vector<int>({5}), NumaTopology::ParseCpuList("5"));
+  EXPECT_TRUE(NumaTopology::ParseCpuList("").empty());
+  EXPECT_TRUE(NumaTopology::ParseCpuList("a-b").empty());
+  EXPECT_FALSE(NumaTopology::Get().node_cpus.empty());
+}
+
+TEST(SchedulerUT, ScopedCpuAffinity) {
+  cpu_set_t prev;
+  ASSERT_EQ(0, pthread_getaffinity_np(pthread_self(), sizeof(prev), &prev));
+  int cpu = -1;
+  for (int i = 0; i < CPU_SETSIZE && cpu < 0; i++) {
+    if (CPU_ISSET(i, &prev)) {
+      cpu = i;
+    }
+  }
+  ASSERT_GE(cpu, 0);
+  {
+    ScopedCpuAffinity affinity({cpu});
+    EXPECT_EQ(cpu, sched_getcpu());
+  }
+  // restored once out of the scope
+  cpu_set_t restored;
+  ASSERT_EQ(0, pthread_getaffinity_np(pthread_self(), sizeof(restored), &restored));
+  EXPECT_TRUE(CPU_EQUAL(&prev, &restored));
+}
+
+TEST(SchedulerUT, NumaSpill) {
+  // two fake nodes sharing all cpus, so that the workers are not restricted
+  NumaTopology topology;
+  topology.node_cpus.emplace_back(NumaTopology::Get().node_cpus[0]);
+  topology.node_cpus.emplace_back(NumaTopology::Get().node_cpus[0]);
+  NumaSchedulerOptions options;
+  options.threads_per_node = 2;
+  options.spill_threshold = 4;
+  NumaScheduler scheduler(topology, options);
+  ASSERT_EQ(2, scheduler.NodeNum());
+  int local = scheduler.BeginRequest();
+  std::vector<int> nodes{local};
+  for (int i = 0; i < 3; i++) {
+    nodes.emplace_back(scheduler.BeginRequest());
+    EXPECT_EQ(local, nodes.back());
+  }
+  // local node has 4 more running requests than the other one
+  nodes.emplace_back(scheduler.BeginRequest());
+  EXPECT_NE(local, nodes.back());
+  EXPECT_EQ(1, scheduler.SpilledRequests());
+  EXPECT_EQ(4, scheduler.RunningRequests(local));
+  for (int node : nodes) {
+    scheduler.EndRequest(node);
+  }
+  EXPECT_EQ(0, scheduler.RunningRequests(0));
+  EXPECT_EQ(0, scheduler.RunningRequests(1));
+
+  // tasks of a node run on the workers of that node, nested requests stay local
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::atomic<int> count{0};
+  std::atomic<int> local_count{0};
+  const int kTasks = 100;
+  for (int i = 0; i < kTasks; i++) {
+    int node = i % 2;
+    WorkStealingScheduler* node_scheduler = scheduler.GetScheduler(node);
+    node_scheduler->Post([&, node, node_scheduler]() {
+      int nested = scheduler.BeginRequest();
+      if (node_scheduler->InWorkerThread() && nested == node) {
+        local_count++;
+      }
+      scheduler.EndRequest(nested);
+      if (++count == kTasks) {
+        std::lock_guard<std::mutex> guard(mutex);
+        cv.notify_all();
+      }
+    });
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&]() { return count.load() == kTasks; });
+  EXPECT_EQ(kTasks, local_count.load());
+}
@@ -0,0 +1,541 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <fmt/core.h>
+#include <gflags/gflags.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "boost/asio/post.hpp"
+#include "boost/asio/thread_pool.hpp"
+#include "boost/filesystem.hpp"
+#include "folly/Singleton.h"
+#include "folly/container/F14Map.h"
+#include "folly/futures/Future.h"
+#include "kcfg_json.h"
+#include "spdlog/spdlog.h"
+
+#include "didagle/didagle_profiler.h"
+#include "didagle/didagle_scheduler.h"
+#include "didagle/graph.h"
+#include "didagle/graph_processor.h"
+
+DEFINE_string(script, "", "comma separated cluster toml files, the first one is replayed");
+DEFINE_string(graph, "", "graph to replay, overridden by the 'graph' of a recorded request");
+DEFINE_string(trace, "", "recorded requests, one json object per line");
+DEFINE_string(stub, "missing", "stub processors: 'all', 'missing'(not linked into this binary) or 'none'");
+DEFINE_string(simulate, "auto",
+              "how stub processors simulate the recorded latency: 'timer'(async, the worker thread is released "
+              "like io processors), 'spin'(occupies the worker thread like cpu bound processors) or 'auto'(spin "
+              "for linked sync cpu bound processors, timer for the others)");
+DEFINE_int64(default_latency_us, 0, "latency of stub processors without recorded latency");
+DEFINE_int32(concurrency, 16, "max in-flight requests");
+DEFINE_double(qps, 0, "request rate, 0 means closed loop with 'concurrency' clients");
+DEFINE_int64(requests, 0, "requests to replay, 0 means each recorded request once");
+DEFINE_int64(warmup, 0, "leading requests excluded from the report");
+DEFINE_string(executor, "pool", "'pool'(concurrent_executor over a thread pool), 'scheduler' or 'numa'");
+DEFINE_int32(threads, 8, "executor threads, threads per node for 'numa'(0 means one per cpu)");
+DEFINE_int32(sample_interval_us, 1000, "interval to sample the executor queue depth");
+DEFINE_string(report, "", "also write the report as json into this file if it's not empty");
+
+using namespace didagle;
+
+namespace {
+// allocations are counted by sharded counters, so that the counting does not serialize the replay
+struct alignas(64) AllocCounter {
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> bytes{0};
+};
+constexpr size_t kAllocCounterNum = 64;
+AllocCounter g_alloc_counters[kAllocCounterNum];
+std::atomic<uint32_t> g_alloc_counter_idx{0};
+
+inline void count_alloc(size_t n) {
+  thread_local uint32_t idx = g_alloc_counter_idx.fetch_add(1, std::memory_order_relaxed) % kAllocCounterNum;
+  g_alloc_counters[idx].count.fetch_add(1, std::memory_order_relaxed);
+  g_alloc_counters[idx].bytes.fetch_add(n, std::memory_order_relaxed);
+}
+void get_alloc_stats(uint64_t& count, uint64_t& bytes) {
+  count = 0;
+  bytes = 0;
+  for (const auto& counter : g_alloc_counters) {
+    count += counter.count.load(std::memory_order_relaxed);
+    bytes += counter.bytes.load(std::memory_order_relaxed);
+  }
+}
+}  // namespace
+
+void* operator new(size_t n) {
+  count_alloc(n);
+  void* p = malloc(0 == n ? 1 : n);
+  if (nullptr == p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace {
+static const char* kReplayRequestName = "__didagle_replay_request";
+
+static uint64_t ustime() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return ((uint64_t)tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+struct ReplayVertexRecord {
+  // vertex id, or processor name which matches all vertexs of the processor
+  std::string id;
+  int64_t latency_us = 0;
+  int rc = 0;
+  KCFG_DEFINE_FIELDS(id, latency_us, rc)
+};
+
+struct ReplayRequest {
+  std::string graph;
+  // 'a.b = 1' is set as params["a"]["b"], numbers & booleans are converted
+  std::map<std::string, std::string> params;
+  // extern string inputs of the graph
+  std::map<std::string, std::string> inputs;
+  std::vector<ReplayVertexRecord> vertexs;
+  KCFG_DEFINE_FIELDS(graph, params, inputs, vertexs)
+
+  Params _params;
+  folly::F14FastMap<std::string, const ReplayVertexRecord*> _records;
+
+  void Build() {
+    for (const auto& pair : params) {
+      std::vector<std::string> path;
+      boost::split(path, pair.first, boost::is_any_of("."));
+      Params* p = &_params;
+      for (const auto& name : path) {
+        p = &((*p)[name]);
+      }
+      const std::string& v = pair.second;
+      size_t pos = 0;
+      try {
+        int64_t iv = std::stoll(v, &pos);
+        if (pos == v.size()) {
+          p->SetInt(iv);
+          continue;
+        }
+        double dv = std::stod(v, &pos);
+        if (pos == v.size()) {
+          p->SetDouble(dv);
+          continue;
+        }
+      } catch (...) {
+      }
+      if (v == "true" || v == "false") {
+        p->SetBool(v == "true");
+      } else {
+        p->SetString(v);
+      }
+    }
+    for (const auto& record : vertexs) {
+      _records[record.id] = &record;
+    }
+  }
+  const ReplayVertexRecord* Find(const std::string& vertex, const std::string& processor) const {
+    auto found = _records.find(vertex);
+    if (found == _records.end()) {
+      found = _records.find(processor);
+    }
+    return found == _records.end() ? nullptr : found->second;
+  }
+};
+
+// simulates the recorded latency & return code of the vertex in the replayed request.
+// io stubs wait on a timer without occupying the worker thread, others spin on it.
+class ReplayStubProcessor : public Processor {
+ private:
+  std::string _name;
+  bool _io;
+
+  const ReplayVertexRecord* FindRecord() {
+    const ReplayRequest* req = GetDataContext().Get<ReplayRequest>(kReplayRequestName);
+    return nullptr != req ? req->Find(GetID(), _name) : nullptr;
+  }
+
+ public:
+  ReplayStubProcessor(const std::string& name, bool io) : _name(name), _io(io) {}
+  std::string_view Name() const override { return _name; }
+  ExecMode GetExecMode() const override { return _io ? ExecMode::EXEC_ASYNC_FUTURE : ExecMode::EXEC_SYNC; }
+  bool isIOProcessor() const override { return _io; }
+  int OnExecute(const Params& args) override {
+    const ReplayVertexRecord* record = FindRecord();
+    int64_t latency_us = nullptr != record ? record->latency_us : FLAGS_default_latency_us;
+    if (latency_us > 0) {
+      uint64_t end_ustime = ustime() + latency_us;
+      while (ustime() < end_ustime) {
+      }
+    }
+    return nullptr != record ? record->rc : 0;
+  }
+  folly::Future<int> OnFutureExecute(const Params& args) override {
+    const ReplayVertexRecord* record = FindRecord();
+    int64_t latency_us = nullptr != record ? record->latency_us : FLAGS_default_latency_us;
+    int rc = nullptr != record ? record->rc : 0;
+    if (latency_us <= 0) {
+      return folly::makeFuture<int>(rc);
+    }
+    return folly::futures::sleep(std::chrono::microseconds(latency_us)).toUnsafeFuture().thenValue([rc](folly::Unit) {
+      return rc;
+    });
+  }
+};
+
+// relaxed scripts are written into a temporary dir which is removed on exit
+struct ReplayTmpDir {
+  std::string path;
+  ~ReplayTmpDir() {
+    if (!path.empty()) {
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(path, ec);
+    }
+  }
+};
+
+struct ReplayReport {
+  std::string executor;
+  int threads = 0;
+  int concurrency = 0;
+  double qps = 0;
+  uint64_t requests = 0;
+  uint64_t errors = 0;
+  double duration_s = 0;
+  double throughput = 0;
+  uint64_t latency_avg_us = 0;
+  uint64_t latency_p50_us = 0;
+  uint64_t latency_p90_us = 0;
+  uint64_t latency_p99_us = 0;
+  uint64_t latency_p999_us = 0;
+  uint64_t latency_max_us = 0;
+  uint64_t queue_depth_avg = 0;
+  uint64_t queue_depth_p99 = 0;
+  uint64_t queue_depth_max = 0;
+  double allocs_per_request = 0;
+  double alloc_bytes_per_request = 0;
+  KCFG_DEFINE_FIELDS(executor, threads, concurrency, qps, requests, errors, duration_s, throughput, latency_avg_us,
+                     latency_p50_us, latency_p90_us, latency_p99_us, latency_p999_us, latency_max_us,
+                     queue_depth_avg, queue_depth_p99, queue_depth_max, allocs_per_request,
+                     alloc_bytes_per_request)
+};
+
+static std::string get_basename(const std::string& filename) {
+  std::string::size_type pos = filename.rfind('/');
+  return pos != std::string::npos ? filename.substr(pos + 1) : filename;
+}
+
+static bool load_trace(const std::string& file, std::vector<std::unique_ptr<ReplayRequest>>& trace) {
+  std::ifstream is(file);
+  if (!is.is_open()) {
+    fmt::print("Failed to open trace:{}\n", file);
+    return false;
+  }
+  std::string line;
+  size_t lineno = 0;
+  while (std::getline(is, line)) {
+    lineno++;
+    boost::algorithm::trim(line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::unique_ptr<ReplayRequest> req(new ReplayRequest);
+    if (!kcfg::ParseFromJsonString(line, *req)) {
+      fmt::print("Failed to parse trace:{} at line:{}\n", file, lineno);
+      return false;
+    }
+    req->Build();
+    trace.emplace_back(std::move(req));
+  }
+  return !trace.empty();
+}
+
+// registers stubs for processors used by the clusters, returns the number of registered stubs.
+static int register_stubs(const std::vector<std::string>& scripts) {
+  std::set<std::string> names;
+  for (const auto& script : scripts) {
+    GraphCluster cluster;
+    if (!kcfg::ParseFromTomlFile(script, cluster)) {
+      fmt::print("Failed to parse cluster:{}\n", script);
+      return -1;
+    }
+    if (!cluster.default_expr_processor.empty()) {
+      names.insert(cluster.default_expr_processor);
+    }
+    for (const auto& cfg : cluster.config_setting) {
+      names.insert(cfg.processor);
+    }
+    for (const auto& g : cluster.graph) {
+      for (const auto& v : g.vertex) {
+        names.insert(v.processor);
+      }
+    }
+  }
+  int n = 0;
+  for (const auto& name : names) {
+    if (name.empty()) {
+      continue;
+    }
+    std::unique_ptr<Processor> linked(ProcessorFactory::GetProcessor(name));
+    if (linked && FLAGS_stub == "missing") {
+      continue;
+    }
+    bool io = FLAGS_simulate == "timer";
+    if (FLAGS_simulate == "auto") {
+      io = !linked || linked->isIOProcessor() || linked->GetExecMode() != Processor::ExecMode::EXEC_SYNC;
+    }
+    // linked processors are replaced by stubs with 'all'
+    ProcessorFactory::Override(name, [name, io]() -> Processor* { return new ReplayStubProcessor(name, io); });
+    n++;
+  }
+  return n;
+}
+
+// stubs have no declared inputs/outputs, so that the clusters are loaded with 'strict_dsl = false'
+static std::string write_relaxed_script(const std::string& script, const std::string& dir) {
+  std::ifstream is(script);
+  std::string relaxed = dir + "/" + get_basename(script);
+  std::ofstream os(relaxed);
+  os << "strict_dsl = false\n";
+  std::string line;
+  bool in_table = false;
+  while (std::getline(is, line)) {
+    std::string trimmed = boost::algorithm::trim_copy(line);
+    in_table = in_table || (!trimmed.empty() && trimmed[0] == '[');
+    if (!in_table && boost::algorithm::starts_with(trimmed, "strict_dsl")) {
+      continue;
+    }
+    os << line << "\n";
+  }
+  return relaxed;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, false);
+  folly::SingletonVault::singleton()->registrationComplete();
+  spdlog::set_level(spdlog::level::err);
+
+  std::vector<std::string> scripts;
+  boost::split(scripts, FLAGS_script, boost::is_any_of(","));
+  std::vector<std::unique_ptr<ReplayRequest>> trace;
+  if (FLAGS_script.empty() || !load_trace(FLAGS_trace, trace)) {
+    fmt::print("Usage: {} --script=<cluster.toml> --graph=<graph> --trace=<requests.jsonl>\n", argv[0]);
+    return -1;
+  }
+  int stubs = FLAGS_stub == "none" ? 0 : register_stubs(scripts);
+  if (stubs < 0) {
+    return -1;
+  }
+  ReplayTmpDir tmp_dir;
+  if (stubs > 0) {
+    tmp_dir.path = "/tmp/didagle_replay_" + std::to_string(getpid());
+    boost::filesystem::create_directories(tmp_dir.path);
+    for (auto& script : scripts) {
+      script = write_relaxed_script(script, tmp_dir.path);
+    }
+  }
+
+  GraphExecuteOptions exec_opt;
+  std::unique_ptr<boost::asio::thread_pool> pool;
+  std::atomic<int64_t> pool_queued{0};
+  std::function<size_t()> queue_depth;
+  if (FLAGS_executor == "scheduler") {
+    exec_opt.scheduler = std::make_shared<WorkStealingScheduler>(FLAGS_threads);
+    queue_depth = [&exec_opt]() { return exec_opt.scheduler->PendingTasks(); };
+  } else if (FLAGS_executor == "numa") {
+    NumaSchedulerOptions numa_opt;
+    numa_opt.threads_per_node = FLAGS_threads;
+    exec_opt.numa_scheduler = std::make_shared<NumaScheduler>(numa_opt);
+    queue_depth = [&exec_opt]() { return exec_opt.numa_scheduler->PendingTasks(); };
+  } else {
+    pool.reset(new boost::asio::thread_pool(FLAGS_threads));
+    exec_opt.concurrent_executor = [&pool, &pool_queued](AnyClosure&& r) {
+      pool_queued.fetch_add(1, std::memory_order_relaxed);
+      boost::asio::post(*pool, [&pool_queued, r = std::move(r)]() {
+        pool_queued.fetch_sub(1, std::memory_order_relaxed);
+        r();
+      });
+    };
+    queue_depth = [&pool_queued]() {
+      int64_t n = pool_queued.load(std::memory_order_relaxed);
+      return n > 0 ? static_cast<size_t>(n) : 0;
+    };
+  }
+
+  ReplayReport report;
+  {
+    GraphManager graphs(exec_opt);
+    for (const auto& script : scripts) {
+      if (!graphs.Load(script)) {
+        fmt::print("Failed to load cluster:{}\n", script);
+        return -1;
+      }
+    }
+    std::string cluster = get_basename(scripts[0]);
+    int64_t total = FLAGS_requests > 0 ? FLAGS_requests : static_cast<int64_t>(trace.size());
+    int64_t concurrency = FLAGS_concurrency > 0 ? FLAGS_concurrency : 1;
+
+    LatencyHistogram latency;
+    LatencyHistogram depth;
+    std::atomic<uint64_t> errors{0};
+    std::atomic<bool> sampling{true};
+    std::thread sampler([&]() {
+      while (sampling.load()) {
+        depth.Record(queue_depth());
+        std::this_thread::sleep_for(std::chrono::microseconds(FLAGS_sample_interval_us));
+      }
+    });
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    int64_t inflight = 0;
+    int64_t finished = 0;
+    uint64_t measure_start_ustime = ustime();
+    uint64_t alloc_count_start = 0;
+    uint64_t alloc_bytes_start = 0;
+    get_alloc_stats(alloc_count_start, alloc_bytes_start);
+    uint64_t replay_start_ustime = ustime();
+    for (int64_t i = 0; i < total; i++) {
+      // open loop requests are measured from the scheduled time, so that the queueing is not hidden
+      uint64_t start_ustime = ustime();
+      if (FLAGS_qps > 0) {
+        uint64_t scheduled_ustime = replay_start_ustime + static_cast<uint64_t>(i * 1000000 / FLAGS_qps);
+        if (scheduled_ustime > start_ustime) {
+          std::this_thread::sleep_for(std::chrono::microseconds(scheduled_ustime - start_ustime));
+        }
+        start_ustime = scheduled_ustime;
+      }
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return inflight < concurrency; });
+        inflight++;
+      }
+      if (i == FLAGS_warmup) {
+        measure_start_ustime = ustime();
+        get_alloc_stats(alloc_count_start, alloc_bytes_start);
+      }
+      const ReplayRequest* req = trace[i % trace.size()].get();
+      auto root = GraphDataContext::New();
+      root->Set(kReplayRequestName, req);
+      for (const auto& pair : req->inputs) {
+        root->Set(pair.first, &pair.second);
+      }
+      bool measured = i >= FLAGS_warmup;
+      if (FLAGS_qps <= 0) {
+        start_ustime = ustime();
+      }
+      const std::string& graph = req->graph.empty() ? FLAGS_graph : req->graph;
+      graphs.Execute(root, cluster, graph, &req->_params, [&, root, measured, start_ustime](int rc) {
+        if (measured) {
+          latency.Record(ustime() - start_ustime);
+          if (0 != rc) {
+            errors.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+        std::lock_guard<std::mutex> guard(mutex);
+        inflight--;
+        finished++;
+        cv.notify_all();
+      });
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&]() { return finished == total; });
+    }
+    uint64_t measure_end_ustime = ustime();
+    uint64_t alloc_count_end = 0;
+    uint64_t alloc_bytes_end = 0;
+    get_alloc_stats(alloc_count_end, alloc_bytes_end);
+    sampling = false;
+    sampler.join();
+
+    report.executor = FLAGS_executor;
+    report.threads = FLAGS_threads;
+    report.concurrency = static_cast<int>(concurrency);
+    report.qps = FLAGS_qps;
+    report.requests = latency.Count();
+    report.errors = errors.load();
+    report.duration_s = (measure_end_ustime - measure_start_ustime) / 1000000.0;
+    report.throughput = report.duration_s > 0 ? report.requests / report.duration_s : 0;
+    report.latency_avg_us = latency.Avg();
+    report.latency_p50_us = latency.Percentile(50);
+    report.latency_p90_us = latency.Percentile(90);
+    report.latency_p99_us = latency.Percentile(99);
+    report.latency_p999_us = latency.Percentile(99.9);
+    report.latency_max_us = latency.Max();
+    report.queue_depth_avg = depth.Avg();
+    report.queue_depth_p99 = depth.Percentile(99);
+    report.queue_depth_max = depth.Max();
+    if (report.requests > 0) {
+      report.allocs_per_request = static_cast<double>(alloc_count_end - alloc_count_start) / report.requests;
+      report.alloc_bytes_per_request = static_cast<double>(alloc_bytes_end - alloc_bytes_start) / report.requests;
+    }
+  }
+  if (pool) {
+    pool->join();
+  }
+
+  fmt::print("executor:{} threads:{} concurrency:{} qps:{} stubs:{}\n", report.executor, report.threads,
+             report.concurrency, report.qps, stubs);
+  fmt::print("requests:{} errors:{} duration:{:.3f}s throughput:{:.1f}/s\n", report.requests, report.errors,
+             report.duration_s, report.throughput);
+  fmt::print("latency(us) avg:{} p50:{} p90:{} p99:{} p999:{} max:{}\n", report.latency_avg_us,
+             report.latency_p50_us, report.latency_p90_us, report.latency_p99_us, report.latency_p999_us,
+             report.latency_max_us);
+  fmt::print("queue depth avg:{} p99:{} max:{}\n", report.queue_depth_avg, report.queue_depth_p99,
+             report.queue_depth_max);
+  fmt::print("allocations per request:{:.1f} bytes:{:.1f}\n", report.allocs_per_request,
+             report.alloc_bytes_per_request);
+  if (!FLAGS_report.empty()) {
+    std::string content;
+    kcfg::WriteToJsonString(report, content, true);
+    std::ofstream os(FLAGS_report);
+    os << content << "\n";
+  }
+  return 0;
+}
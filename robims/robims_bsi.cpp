@@ -30,7 +30,9 @@
 #include <limits.h>
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include <cstdint>
+#include <unordered_map>
 #include "robims_cache.h"
 #include "robims_common.h"
 #include "robims_log.h"
@@ -138,8 +140,112 @@ int BitSliceIndex::Init(const FieldMeta& meta) {
     p->NewCRoaringBitmap();
     _bitmaps.push_back(std::move(p));
   }
+  _values_enabled = true;
   return 0;
 }
+void BitSliceIndex::BuildValues() {
+  _values.clear();
+  _min_tracker.clear();
+  _values_enabled = !_bitmaps[0]->IsReadonly();
+  if (!_values_enabled) {
+    return;
+  }
+  const roaring_bitmap_t* exist = _bitmaps[0]->bitmap.get();
+  if (roaring_bitmap_is_empty(exist)) {
+    return;
+  }
+  _values.resize(roaring_bitmap_maximum(exist) + 1, 0);
+  for (int32_t i = 0; i < _bit_depth; i++) {
+    uint64_t bit = 1ull << i;
+    iterate_bitmap(
+        [&](uint32_t id) {
+          if (id < _values.size()) {
+            _values[id] |= bit;
+          }
+          return true;
+        },
+        _bitmaps[1 + i]->bitmap.get());
+  }
+  if (_options.LimitTopK() > 0) {
+    iterate_bitmap(
+        [&](uint32_t id) {
+          _min_tracker.emplace(_values[id], id);
+          return true;
+        },
+        exist);
+  }
+}
+void BitSliceIndex::BuildDenseChunks() {
+  // slices absent in a chunk are all zero.
+  alignas(32) static const uint64_t kZeroWords[kChunkWords] = {0};
+  _dense_chunks.clear();
+  _dense_ranges.reset();
+  if (_bitmaps.empty() || !_bitmaps[0]->IsReadonly()) {
+    return;
+  }
+  uint32_t depth = std::min<uint32_t>(_bit_depth, _bitmaps.size() - 1);
+  std::vector<FrozenBitsetContainer> exist_bitsets;
+  std::vector<uint16_t> other_keys;
+  if (!_bitmaps[0]->GetFrozenBitsets(exist_bitsets, other_keys) || exist_bitsets.empty()) {
+    return;
+  }
+  std::vector<DenseChunk> chunks(exist_bitsets.size());
+  std::unordered_map<uint16_t, size_t> chunk_idx;
+  for (size_t i = 0; i < exist_bitsets.size(); i++) {
+    chunks[i].key = exist_bitsets[i].key;
+    chunks[i].exist = exist_bitsets[i].words;
+    chunks[i].slices.assign(depth, kZeroWords);
+    chunk_idx[exist_bitsets[i].key] = i;
+  }
+  std::vector<bool> valid(chunks.size(), true);
+  for (uint32_t i = 0; i < depth; i++) {
+    std::vector<FrozenBitsetContainer> bitsets;
+    other_keys.clear();
+    if (!_bitmaps[1 + i]->GetFrozenBitsets(bitsets, other_keys)) {
+      return;
+    }
+    for (const auto& c : bitsets) {
+      auto found = chunk_idx.find(c.key);
+      if (found != chunk_idx.end()) {
+        chunks[found->second].slices[i] = c.words;
+      }
+    }
+    // array/run containers can not be fed into the kernel
+    for (uint16_t key : other_keys) {
+      auto found = chunk_idx.find(key);
+      if (found != chunk_idx.end()) {
+        valid[found->second] = false;
+      }
+    }
+  }
+  CRoaringBitmapPtr ranges(roaring_bitmap_create());
+  for (size_t i = 0; i < chunks.size(); i++) {
+    if (!valid[i]) {
+      continue;
+    }
+    uint64_t base = (uint64_t)chunks[i].key << 16;
+    roaring_bitmap_add_range(ranges.get(), base, base + 65536);
+    _dense_chunks.emplace_back(std::move(chunks[i]));
+  }
+  if (!_dense_chunks.empty()) {
+    _dense_ranges = std::move(ranges);
+  }
+}
+void BitSliceIndex::SetValue(uint32_t id, uint64_t val, bool existed, uint64_t old_val) {
+  if (!_values_enabled) {
+    return;
+  }
+  if (id >= _values.size()) {
+    _values.resize(id + 1, 0);
+  }
+  _values[id] = val;
+  if (_options.LimitTopK() > 0) {
+    if (existed) {
+      _min_tracker.erase(std::make_pair(old_val, id));
+    }
+    _min_tracker.emplace(val, id);
+  }
+}
 const roaring_bitmap_t* BitSliceIndex::GetExistBitmap() { return _bitmaps[0]->bitmap.get(); }
 int BitSliceIndex::DoGetMax(roaring_bitmap_t* input_filter, uint64_t& max_val, int64_t& count) {
   max_val = 0;
@@ -217,7 +323,7 @@ int BitSliceIndex::DoGetMin(roaring_bitmap_t* input_filter, uint64_t& min_val, i
   return 0;
 }
 
-int BitSliceIndex::DoRangeLT(uint64_t expect_val, bool allow_eq, roaring_bitmap_t* out) {
+int BitSliceIndex::SliceRangeLT(uint64_t expect_val, bool allow_eq, roaring_bitmap_t* out) {
   if (roaring_bitmap_is_empty(out)) {
     roaring_bitmap_overwrite(out, _bitmaps[0]->bitmap.get());
   } else {
@@ -275,7 +381,7 @@ int BitSliceIndex::DoRangeLT(uint64_t expect_val, bool allow_eq, roaring_bitmap_
   return 0;
 }
 
-int BitSliceIndex::DoRangeGT(uint64_t expect_val, bool allow_eq, roaring_bitmap_t* out) {
+int BitSliceIndex::SliceRangeGT(uint64_t expect_val, bool allow_eq, roaring_bitmap_t* out) {
   BitMapCacheGuard guard;
   if (roaring_bitmap_is_empty(out)) {
     roaring_bitmap_overwrite(out, _bitmaps[0]->bitmap.get());
@@ -322,7 +428,7 @@ int BitSliceIndex::DoRangeGT(uint64_t expect_val, bool allow_eq, roaring_bitmap_
   }
   return 0;
 }
-int BitSliceIndex::DoRangeEQ(uint64_t expect_val, roaring_bitmap_t* out) {
+int BitSliceIndex::SliceRangeEQ(uint64_t expect_val, roaring_bitmap_t* out) {
   if (roaring_bitmap_is_empty(out)) {
     roaring_bitmap_overwrite(out, _bitmaps[0]->bitmap.get());
   } else {
@@ -339,18 +445,116 @@ int BitSliceIndex::DoRangeEQ(uint64_t expect_val, roaring_bitmap_t* out) {
   return 0;
 }
 
+int BitSliceIndex::SliceRange(BSICompareOp op, uint64_t v1, uint64_t v2, roaring_bitmap_t* out) {
+  switch (op) {
+    case BSI_CMP_EQ:
+      return SliceRangeEQ(v1, out);
+    case BSI_CMP_LT:
+      return SliceRangeLT(v1, false, out);
+    case BSI_CMP_LE:
+      return SliceRangeLT(v1, true, out);
+    case BSI_CMP_GT:
+      return SliceRangeGT(v1, false, out);
+    case BSI_CMP_GE:
+      return SliceRangeGT(v1, true, out);
+    default:
+      return SliceRangeBetween(v1, v2, out);
+  }
+}
+
+bool BitSliceIndex::FusedRange(BSICompareOp op, uint64_t v1, uint64_t v2, roaring_bitmap_t* out) {
+  if (_dense_chunks.empty()) {
+    return false;
+  }
+  const roaring_bitmap_t* exist = _bitmaps[0]->bitmap.get();
+  bool has_filter = !roaring_bitmap_is_empty(out);
+  BitMapCacheGuard guard;
+  // ids outside dense chunks still go through the slice bitmap operations.
+  roaring_bitmap_t* sparse = acquire_bitmap();
+  roaring_bitmap_t* dense = acquire_bitmap();
+  guard.Add(sparse);
+  guard.Add(dense);
+  roaring_bitmap_overwrite(sparse, has_filter ? out : exist);
+  roaring_bitmap_andnot_inplace(sparse, _dense_ranges.get());
+
+  uint32_t depth = _dense_chunks[0].slices.size();
+  alignas(32) uint64_t words[kChunkWords];
+  std::vector<uint32_t> ids;
+  for (const auto& chunk : _dense_chunks) {
+    uint32_t base = (uint32_t)chunk.key << 16;
+    if (has_filter && !roaring_bitmap_intersect_with_range(out, base, (uint64_t)base + 65536)) {
+      continue;
+    }
+    bsi_compare_chunk(chunk.exist, chunk.slices.data(), depth, op, v1, v2, words);
+    ids.clear();
+    for (uint32_t w = 0; w < kChunkWords; w++) {
+      uint64_t word = words[w];
+      while (word) {
+        ids.emplace_back(base + w * 64 + __builtin_ctzll(word));
+        word &= word - 1;
+      }
+    }
+    roaring_bitmap_add_many(dense, ids.size(), ids.data());
+  }
+  if (has_filter) {
+    roaring_bitmap_and_inplace(dense, out);
+  }
+  if (!roaring_bitmap_is_empty(sparse)) {
+    SliceRange(op, v1, v2, sparse);
+    roaring_bitmap_or_inplace(dense, sparse);
+  }
+  roaring_bitmap_overwrite(out, dense);
+  return true;
+}
+
+int BitSliceIndex::DoRangeLT(uint64_t expect_val, bool allow_eq, roaring_bitmap_t* out) {
+  BSICompareOp op = allow_eq ? BSI_CMP_LE : BSI_CMP_LT;
+  if (FusedRange(op, expect_val, 0, out)) {
+    return 0;
+  }
+  return SliceRange(op, expect_val, 0, out);
+}
+int BitSliceIndex::DoRangeGT(uint64_t expect_val, bool allow_eq, roaring_bitmap_t* out) {
+  BSICompareOp op = allow_eq ? BSI_CMP_GE : BSI_CMP_GT;
+  if (FusedRange(op, expect_val, 0, out)) {
+    return 0;
+  }
+  return SliceRange(op, expect_val, 0, out);
+}
+int BitSliceIndex::DoRangeEQ(uint64_t expect_val, roaring_bitmap_t* out) {
+  if (FusedRange(BSI_CMP_EQ, expect_val, 0, out)) {
+    return 0;
+  }
+  return SliceRangeEQ(expect_val, out);
+}
+int BitSliceIndex::DoRangeBetween(uint64_t expect_min, uint64_t expect_max,
+                                  roaring_bitmap_t* filter) {
+  if (FusedRange(BSI_CMP_BETWEEN, expect_min, expect_max, filter)) {
+    return 0;
+  }
+  return SliceRangeBetween(expect_min, expect_max, filter);
+}
+
 int BitSliceIndex::DoRangeNEQ(uint64_t expect, roaring_bitmap_t* out) {
+  if (roaring_bitmap_is_empty(out)) {
+    roaring_bitmap_overwrite(out, _bitmaps[0]->bitmap.get());
+  } else {
+    roaring_bitmap_and_inplace(out, _bitmaps[0]->bitmap.get());
+    if (roaring_bitmap_is_empty(out)) {
+      return 0;
+    }
+  }
   BitMapCacheGuard guard;
-  roaring_bitmap_overwrite(out, _bitmaps[0]->bitmap.get());
   auto eq = acquire_bitmap();
   guard.Add(eq);
+  roaring_bitmap_overwrite(eq, out);
   DoRangeEQ(expect, eq);
   roaring_bitmap_andnot_inplace(out, eq);
   return 0;
 }
 
-int BitSliceIndex::DoRangeBetween(uint64_t expect_min, uint64_t expect_max,
-                                  roaring_bitmap_t* filter) {
+int BitSliceIndex::SliceRangeBetween(uint64_t expect_min, uint64_t expect_max,
+                                     roaring_bitmap_t* filter) {
   if (roaring_bitmap_is_empty(filter)) {
     roaring_bitmap_overwrite(filter, _bitmaps[0]->bitmap.get());
   } else {
@@ -457,6 +661,14 @@ int BitSliceIndex::TopK(uint32_t k, roaring_bitmap_t* out) {
 }
 
 uint64_t BitSliceIndex::DoRemoveMin() {
+  if (_values_enabled && _options.LimitTopK() > 0) {
+    if (_min_tracker.empty()) {
+      return 0;
+    }
+    auto min_item = *_min_tracker.begin();
+    DoRemove(min_item.second, min_item.first);
+    return min_item.first;
+  }
   int64_t min_count = 0;
   uint64_t min_val = 0;
   BitMapCacheGuard guard;
@@ -474,7 +686,16 @@ uint64_t BitSliceIndex::DoRemoveMin() {
   return 0;
 }
 void BitSliceIndex::DoRemove(uint32_t id, uint64_t val) {
-  roaring_bitmap_remove(_bitmaps[0]->bitmap.get(), id);
+  if (!roaring_bitmap_remove_checked(_bitmaps[0]->bitmap.get(), id)) {
+    return;
+  }
+  if (_values_enabled) {
+    // stored value is always right, clear exactly the bits set before.
+    val = _values[id];
+    if (_options.LimitTopK() > 0) {
+      _min_tracker.erase(std::make_pair(val, id));
+    }
+  }
   uint64_t set_val = val;
   for (int32_t i = 0; i < _bit_depth; i++) {
     if (set_val & (1ull << i)) {
@@ -490,10 +711,11 @@ bool BitSliceIndex::DoPut(uint32_t id, uint64_t val, uint64_t& old_val) {
     for (int32_t i = 0; i < _bit_depth; i++) {
       if (set_val & (1ull << i)) {
         roaring_bitmap_add(_bitmaps[i + 1]->bitmap.get(), id);
-      } else {
+      } else if (!_values_enabled) {
         roaring_bitmap_remove(_bitmaps[i + 1]->bitmap.get(), id);
       }
     }
+    SetValue(id, val, false, 0);
     if (_options.LimitTopK() > 0) {
       uint64_t count = roaring_bitmap_get_cardinality(_bitmaps[0]->bitmap.get());
       if (count > _options.LimitTopK()) {
@@ -502,26 +724,98 @@ bool BitSliceIndex::DoPut(uint32_t id, uint64_t val, uint64_t& old_val) {
     }
     return false;
   } else {
-    old_val = 0;
-    uint64_t set_val = val;
+    DoGet(id, old_val);
+    // only touch slices whose bit changed
+    uint64_t diff = old_val ^ val;
     for (int32_t i = 0; i < _bit_depth; i++) {
-      if (roaring_bitmap_contains(_bitmaps[1 + i]->bitmap.get(), id)) {
-        old_val += (1ull << i);
+      if (0 == (diff & (1ull << i))) {
+        continue;
       }
-      if (set_val & (1ull << i)) {
+      if (val & (1ull << i)) {
         roaring_bitmap_add(_bitmaps[i + 1]->bitmap.get(), id);
       } else {
         roaring_bitmap_remove(_bitmaps[i + 1]->bitmap.get(), id);
       }
     }
+    SetValue(id, val, true, old_val);
     return true;
   }
 }
 
+void BitSliceIndex::DoPutMany(std::vector<std::pair<uint32_t, uint64_t>>& id_vals) {
+  if (!_values_enabled) {
+    uint64_t old_val;
+    for (const auto& id_val : id_vals) {
+      DoPut(id_val.first, id_val.second, old_val);
+    }
+    return;
+  }
+  // sorted ids make roaring bulk add append to the same containers, last value wins for same id.
+  std::stable_sort(id_vals.begin(), id_vals.end(),
+                   [](const auto& a, const auto& b) { return a.first < b.first; });
+  size_t n = 0;
+  for (size_t i = 0; i < id_vals.size(); i++) {
+    if (i + 1 < id_vals.size() && id_vals[i + 1].first == id_vals[i].first) {
+      continue;
+    }
+    id_vals[n++] = id_vals[i];
+  }
+  id_vals.resize(n);
+
+  std::vector<uint32_t> ids(n);
+  std::vector<uint64_t> old_vals(n, 0);
+  std::vector<uint8_t> existed(n, 0);
+  for (size_t i = 0; i < n; i++) {
+    ids[i] = id_vals[i].first;
+    existed[i] = DoGet(ids[i], old_vals[i]) ? 1 : 0;
+  }
+  roaring_bitmap_add_many(_bitmaps[0]->bitmap.get(), n, ids.data());
+
+  std::vector<uint32_t> add_ids;
+  std::vector<uint32_t> remove_ids;
+  for (int32_t i = 0; i < _bit_depth; i++) {
+    uint64_t bit = 1ull << i;
+    add_ids.clear();
+    remove_ids.clear();
+    for (size_t j = 0; j < n; j++) {
+      bool old_set = existed[j] && (old_vals[j] & bit);
+      bool new_set = (id_vals[j].second & bit) > 0;
+      if (new_set && !old_set) {
+        add_ids.push_back(ids[j]);
+      } else if (!new_set && old_set) {
+        remove_ids.push_back(ids[j]);
+      }
+    }
+    roaring_bitmap_t* row = _bitmaps[1 + i]->bitmap.get();
+    if (!add_ids.empty()) {
+      roaring_bitmap_add_many(row, add_ids.size(), add_ids.data());
+    }
+    if (!remove_ids.empty()) {
+      roaring_bitmap_t* remove_bitmap = roaring_bitmap_of_ptr(remove_ids.size(), remove_ids.data());
+      roaring_bitmap_andnot_inplace(row, remove_bitmap);
+      roaring_bitmap_free(remove_bitmap);
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    SetValue(ids[i], id_vals[i].second, existed[i], old_vals[i]);
+  }
+  if (_options.LimitTopK() > 0) {
+    uint64_t count = roaring_bitmap_get_cardinality(_bitmaps[0]->bitmap.get());
+    while (count > _options.LimitTopK()) {
+      DoRemoveMin();
+      count--;
+    }
+  }
+}
+
 bool BitSliceIndex::DoGet(uint32_t id, uint64_t& val) {
   if (!roaring_bitmap_contains(_bitmaps[0]->bitmap.get(), id)) {
     return false;
   }
+  if (_values_enabled) {
+    val = _values[id];
+    return true;
+  }
   val = 0;
   for (int32_t i = 0; i < _bit_depth; i++) {
     if (roaring_bitmap_contains(_bitmaps[1 + i]->bitmap.get(), id)) {
@@ -531,11 +825,32 @@ bool BitSliceIndex::DoGet(uint32_t id, uint64_t& val) {
   return true;
 }
 
+int BitSliceIndex::DoSum(const roaring_bitmap_t* filter, unsigned __int128& sum,
+                         int64_t& count) {
+  sum = 0;
+  BitMapCacheGuard guard;
+  auto exist = acquire_bitmap();
+  guard.Add(exist);
+  roaring_bitmap_overwrite(exist, filter);
+  roaring_bitmap_and_inplace(exist, _bitmaps[0]->bitmap.get());
+  count = roaring_bitmap_get_cardinality(exist);
+  if (0 == count) {
+    return 0;
+  }
+  for (int32_t i = 0; i < _bit_depth; i++) {
+    uint64_t n = roaring_bitmap_and_cardinality(exist, _bitmaps[1 + i]->bitmap.get());
+    sum += ((unsigned __int128)n) << i;
+  }
+  return 0;
+}
+
 int BitSliceIndex::Load(FILE* fp) {
   uint32_t n = 0;
   if (0 != file_read_uint32(fp, n)) {
     return -1;
   }
+  // drop the empty slices created by 'Init'
+  _bitmaps.clear();
   for (uint32_t i = 0; i < n; i++) {
     RoaringBitmapPtr p(new RoaringBitmap);
     _bitmaps.emplace_back(std::move(p));
@@ -544,6 +859,8 @@ int BitSliceIndex::Load(FILE* fp) {
     }
     // ROBIMS_ERROR("[{}]Load n={}", i, roaring_bitmap_get_cardinality(_bitmaps[i]->bitmap.get()));
   }
+  BuildValues();
+  BuildDenseChunks();
   return 0;
 }
 int BitSliceIndex::Save(FILE* fp, bool readonly) {
@@ -602,6 +919,14 @@ void BitSliceIntIndex::Put(uint32_t id, int64_t val) {
   uint64_t old_val;
   DoPut(id, _options.ToLocalVal(val), old_val);
 }
+void BitSliceIntIndex::PutMany(const std::vector<uint32_t>& ids,
+                               const std::vector<int64_t>& vals) {
+  std::vector<std::pair<uint32_t, uint64_t>> id_vals(std::min(ids.size(), vals.size()));
+  for (size_t i = 0; i < id_vals.size(); i++) {
+    id_vals[i] = std::make_pair(ids[i], _options.ToLocalVal(vals[i]));
+  }
+  DoPutMany(id_vals);
+}
 
 bool BitSliceIntIndex::Get(uint32_t id, int64_t& val) {
   uint64_t local_val;
@@ -612,6 +937,13 @@ bool BitSliceIntIndex::Get(uint32_t id, int64_t& val) {
   return true;
 }
 
+int BitSliceIntIndex::Sum(const roaring_bitmap_t* filter, double& sum, int64_t& count) {
+  unsigned __int128 local_sum = 0;
+  DoSum(filter, local_sum, count);
+  sum = (double)local_sum + (double)_options.GetActualIntVal(0) * count;
+  return 0;
+}
+
 int64_t BitSliceIntIndex::RemoveMin() {
   uint64_t local_Val = DoRemoveMin();
   return _options.GetActualIntVal(local_Val);
@@ -666,6 +998,14 @@ bool BitSliceFloatIndex::Put(uint32_t id, float val, float& old_val) {
   }
   return false;
 }
+void BitSliceFloatIndex::PutMany(const std::vector<uint32_t>& ids,
+                                 const std::vector<float>& vals) {
+  std::vector<std::pair<uint32_t, uint64_t>> id_vals(std::min(ids.size(), vals.size()));
+  for (size_t i = 0; i < id_vals.size(); i++) {
+    id_vals[i] = std::make_pair(ids[i], _options.ToLocalVal(vals[i]));
+  }
+  DoPutMany(id_vals);
+}
 
 bool BitSliceFloatIndex::Get(uint32_t id, float& val) {
   uint64_t local_val;
@@ -676,6 +1016,28 @@ bool BitSliceFloatIndex::Get(uint32_t id, float& val) {
   return true;
 }
 
+int BitSliceFloatIndex::Sum(const roaring_bitmap_t* filter, double& sum, int64_t& count) {
+  // float values are encoded as ordered bit patterns, slices can not be summed directly.
+  sum = 0;
+  count = 0;
+  BitMapCacheGuard guard;
+  auto exist = acquire_bitmap();
+  guard.Add(exist);
+  roaring_bitmap_overwrite(exist, filter);
+  roaring_bitmap_and_inplace(exist, _bitmaps[0]->bitmap.get());
+  iterate_bitmap(
+      [&](uint32_t id) {
+        float v = 0;
+        if (Get(id, v)) {
+          sum += v;
+          count++;
+        }
+        return true;
+      },
+      exist);
+  return 0;
+}
+
 double BitSliceFloatIndex::RemoveMin() {
   uint64_t local_Val = DoRemoveMin();
   return _options.GetActualFloatVal(local_Val);
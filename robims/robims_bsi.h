@@ -29,9 +29,12 @@
 
 #pragma once
 #include <stdint.h>
+#include <utility>
 #include <vector>
+#include "absl/container/btree_set.h"
 #include "roaring/roaring.h"
 #include "robims.pb.h"
+#include "robims_bsi_kernel.h"
 #include "robims_common.h"
 
 namespace robims {
@@ -66,6 +69,31 @@ class BitSliceIndex {
   BitSliceIndexCreateOptions _options;
   std::vector<RoaringBitmapPtr> _bitmaps;
   uint8_t _bit_depth = 0;
+  // local value indexed by id, make Get/update O(1) instead of probing every slice.
+  // it's not built for readonly slices which can NOT be updated.
+  std::vector<uint64_t> _values;
+  bool _values_enabled = false;
+  // (local value, id) of all ids, only maintained with 'topk_limit' to remove min in O(log n).
+  absl::btree_set<std::pair<uint64_t, uint32_t>> _min_tracker;
+  // 2^16 chunks of readonly slices whose exist & slice containers are all bitsets, these chunks are
+  // evaluated by the fused 'bsi_compare_chunk' kernel instead of per slice bitmap operations.
+  struct DenseChunk {
+    uint16_t key = 0;
+    const uint64_t* exist = nullptr;
+    std::vector<const uint64_t*> slices;
+  };
+  std::vector<DenseChunk> _dense_chunks;
+  CRoaringBitmapPtr _dense_ranges;
+
+  void BuildValues();
+  void BuildDenseChunks();
+  bool FusedRange(BSICompareOp op, uint64_t v1, uint64_t v2, roaring_bitmap_t* out);
+  int SliceRange(BSICompareOp op, uint64_t v1, uint64_t v2, roaring_bitmap_t* out);
+  int SliceRangeLT(uint64_t expect, bool allow_eq, roaring_bitmap_t* out);
+  int SliceRangeGT(uint64_t expect, bool allow_eq, roaring_bitmap_t* out);
+  int SliceRangeEQ(uint64_t expect, roaring_bitmap_t* out);
+  int SliceRangeBetween(uint64_t min, uint64_t max, roaring_bitmap_t* out);
+  void SetValue(uint32_t id, uint64_t val, bool existed, uint64_t old_val);
   int DoGetMax(roaring_bitmap_t* filter, uint64_t& max, int64_t& count);
   int DoGetMin(roaring_bitmap_t* filter, uint64_t& min, int64_t& count);
   int DoRangeLT(uint64_t expect, bool allow_eq, roaring_bitmap_t* out);
@@ -76,7 +104,9 @@ class BitSliceIndex {
   uint64_t DoRemoveMin();
   void DoRemove(uint32_t id, uint64_t val);
   bool DoPut(uint32_t id, uint64_t val, uint64_t& old_val);
+  void DoPutMany(std::vector<std::pair<uint32_t, uint64_t>>& id_vals);
   bool DoGet(uint32_t id, uint64_t& val);
+  int DoSum(const roaring_bitmap_t* filter, unsigned __int128& sum, int64_t& count);
 
   int DoInit(const FieldMeta& meta);
 
@@ -100,7 +130,10 @@ class BitSliceIntIndex : public BitSliceIndex {
   int RangeNEQ(int64_t expect, roaring_bitmap_t* out);
   void Remove(uint32_t id, int64_t val);
   void Put(uint32_t id, int64_t val);
+  // batch put, the last value wins for duplicate ids.
+  void PutMany(const std::vector<uint32_t>& ids, const std::vector<int64_t>& vals);
   bool Get(uint32_t id, int64_t& val);
+  int Sum(const roaring_bitmap_t* filter, double& sum, int64_t& count);
   int64_t RemoveMin();
 };
 
@@ -119,7 +152,9 @@ class BitSliceFloatIndex : public BitSliceIndex {
   double RemoveMin();
   void Remove(uint32_t id, float val);
   bool Put(uint32_t id, float val, float& old_val);
+  void PutMany(const std::vector<uint32_t>& ids, const std::vector<float>& vals);
   bool Get(uint32_t id, float& val);
+  int Sum(const roaring_bitmap_t* filter, double& sum, int64_t& count);
 };
 typedef std::unique_ptr<BitSliceFloatIndex> BitSliceFloatIndexPtr;
 
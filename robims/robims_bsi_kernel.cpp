@@ -0,0 +1,156 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "robims_bsi_kernel.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace robims {
+// bits of compared value as all-zero/all-one masks, so that per slice update is branch free:
+//   lt |= eq & ~s & m;  eq &= ~(s ^ m)
+static inline uint64_t bit_mask(uint64_t v, uint32_t i) { return ((v >> i) & 0x1) ? ~0ull : 0; }
+
+static inline uint64_t combine_result(BSICompareOp op, uint64_t e, uint64_t lt1, uint64_t eq1,
+                                      uint64_t lt2, uint64_t eq2) {
+  switch (op) {
+    case BSI_CMP_EQ:
+      return eq1;
+    case BSI_CMP_LT:
+      return lt1;
+    case BSI_CMP_LE:
+      return lt1 | eq1;
+    case BSI_CMP_GT:
+      return e & ~(lt1 | eq1);
+    case BSI_CMP_GE:
+      return e & ~lt1;
+    default:
+      return (e & ~lt1) & (lt2 | eq2);
+  }
+}
+
+void bsi_compare_chunk_scalar(const uint64_t* exist, const uint64_t* const* slices, uint32_t depth,
+                              BSICompareOp op, uint64_t v1, uint64_t v2, uint64_t* out) {
+  uint64_t masks1[64], masks2[64];
+  for (uint32_t i = 0; i < depth; i++) {
+    masks1[i] = bit_mask(v1, i);
+    masks2[i] = bit_mask(v2, i);
+  }
+  bool between = (BSI_CMP_BETWEEN == op);
+  for (uint32_t w = 0; w < kChunkWords; w++) {
+    uint64_t e = exist[w];
+    uint64_t lt1 = 0, eq1 = e, lt2 = 0, eq2 = e;
+    for (int32_t i = depth - 1; i >= 0; i--) {
+      uint64_t s = slices[i][w];
+      lt1 |= eq1 & ~s & masks1[i];
+      eq1 &= ~(s ^ masks1[i]);
+      if (between) {
+        lt2 |= eq2 & ~s & masks2[i];
+        eq2 &= ~(s ^ masks2[i]);
+      }
+    }
+    out[w] = combine_result(op, e, lt1, eq1, lt2, eq2);
+  }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2"))) static void bsi_compare_chunk_avx2(
+    const uint64_t* exist, const uint64_t* const* slices, uint32_t depth, BSICompareOp op,
+    uint64_t v1, uint64_t v2, uint64_t* out) {
+  __m256i masks1[64], masks2[64];
+  for (uint32_t i = 0; i < depth; i++) {
+    masks1[i] = _mm256_set1_epi64x(bit_mask(v1, i));
+    masks2[i] = _mm256_set1_epi64x(bit_mask(v2, i));
+  }
+  bool between = (BSI_CMP_BETWEEN == op);
+  for (uint32_t w = 0; w < kChunkWords; w += 4) {
+    __m256i e = _mm256_loadu_si256((const __m256i*)(exist + w));
+    __m256i lt1 = _mm256_setzero_si256(), eq1 = e;
+    __m256i lt2 = _mm256_setzero_si256(), eq2 = e;
+    for (int32_t i = depth - 1; i >= 0; i--) {
+      __m256i s = _mm256_loadu_si256((const __m256i*)(slices[i] + w));
+      // ~s & eq & m
+      lt1 = _mm256_or_si256(lt1, _mm256_and_si256(_mm256_andnot_si256(s, eq1), masks1[i]));
+      eq1 = _mm256_andnot_si256(_mm256_xor_si256(s, masks1[i]), eq1);
+      if (between) {
+        lt2 = _mm256_or_si256(lt2, _mm256_and_si256(_mm256_andnot_si256(s, eq2), masks2[i]));
+        eq2 = _mm256_andnot_si256(_mm256_xor_si256(s, masks2[i]), eq2);
+      }
+    }
+    __m256i r;
+    switch (op) {
+      case BSI_CMP_EQ: {
+        r = eq1;
+        break;
+      }
+      case BSI_CMP_LT: {
+        r = lt1;
+        break;
+      }
+      case BSI_CMP_LE: {
+        r = _mm256_or_si256(lt1, eq1);
+        break;
+      }
+      case BSI_CMP_GT: {
+        r = _mm256_andnot_si256(_mm256_or_si256(lt1, eq1), e);
+        break;
+      }
+      case BSI_CMP_GE: {
+        r = _mm256_andnot_si256(lt1, e);
+        break;
+      }
+      default: {
+        r = _mm256_and_si256(_mm256_andnot_si256(lt1, e), _mm256_or_si256(lt2, eq2));
+        break;
+      }
+    }
+    _mm256_storeu_si256((__m256i*)(out + w), r);
+  }
+}
+#endif
+
+bool bsi_kernel_avx2_supported() {
+#if defined(__x86_64__)
+  static bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+void bsi_compare_chunk(const uint64_t* exist, const uint64_t* const* slices, uint32_t depth,
+                       BSICompareOp op, uint64_t v1, uint64_t v2, uint64_t* out) {
+#if defined(__x86_64__)
+  if (bsi_kernel_avx2_supported()) {
+    bsi_compare_chunk_avx2(exist, slices, depth, op, v1, v2, out);
+    return;
+  }
+#endif
+  bsi_compare_chunk_scalar(exist, slices, depth, op, v1, v2, out);
+}
+}  // namespace robims
@@ -0,0 +1,55 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <stdint.h>
+
+namespace robims {
+// words of a 2^16 bits roaring bitset container
+static const uint32_t kChunkWords = 1024;
+
+enum BSICompareOp {
+  BSI_CMP_EQ = 0,
+  BSI_CMP_LT,
+  BSI_CMP_LE,
+  BSI_CMP_GT,
+  BSI_CMP_GE,
+  // v1 <= x <= v2
+  BSI_CMP_BETWEEN,
+};
+
+// evaluate the O'Neil comparison of one 2^16 chunk in a single pass, 'exist' and 'slices'(bit 0
+// first) point to 'kChunkWords' words each, matched bits are written into 'out'.
+// the avx2 kernel is used if the cpu supports it.
+void bsi_compare_chunk(const uint64_t* exist, const uint64_t* const* slices, uint32_t depth,
+                       BSICompareOp op, uint64_t v1, uint64_t v2, uint64_t* out);
+void bsi_compare_chunk_scalar(const uint64_t* exist, const uint64_t* const* slices, uint32_t depth,
+                              BSICompareOp op, uint64_t v1, uint64_t v2, uint64_t* out);
+bool bsi_kernel_avx2_supported();
+}  // namespace robims
@@ -0,0 +1,147 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "robims_column_filter.h"
+#include <algorithm>
+#include "robims_db_impl.h"
+#include "robims_err.h"
+#include "robims_field.h"
+#include "robims_log.h"
+#include "robims_table.h"
+
+namespace robims {
+static const uint32_t kFilterBatchSize = 256;
+
+// the row object passed to jit code is the local id, value of column 'names' is loaded by:
+//   rcx = id, rax = column data, rax/rdx = value/type as ssexpr2 field accessor does.
+ssexpr2::ValueAccessor RobimsColumnFilter::BuildColumnAccessor(
+    const std::vector<std::string>& names, std::shared_ptr<Xbyak::CodeGenerator> jit) {
+  ssexpr2::ValueAccessor accessor(jit);
+  if (names.size() != 2) {
+    ROBIMS_ERROR("Expected column with 2 string part but got {}", names.size());
+    return accessor;
+  }
+  RobimsTable* table = _db->GetTable(names[0]);
+  if (nullptr == table) {
+    ROBIMS_ERROR("Can NOT find table with name:{}", names[0]);
+    return accessor;
+  }
+  if (nullptr != _table && table != _table) {
+    ROBIMS_ERROR("Columns of filter must be in same table, but got {} and {}",
+                 _table->GetSchema().name(), names[0]);
+    return accessor;
+  }
+  RobimsField* field = table->GetField(names[1]);
+  if (nullptr == field || !is_column_field(field->GetFieldMeta().index_type())) {
+    ROBIMS_ERROR("Can NOT find column field with name:{}", names[1]);
+    return accessor;
+  }
+  RobimsColumnField* column = static_cast<RobimsColumnField*>(field);
+  _table = table;
+  if (std::find(_columns.begin(), _columns.end(), column) == _columns.end()) {
+    _columns.push_back(column);
+  }
+
+  accessor.BeginBuild();
+  Xbyak::CodeGenerator& code = accessor.GetJit();
+  code.mov(code.ecx, code.dword[code.rax]);
+  code.mov(code.rax, (size_t)(column->GetDataAddress()));
+  code.mov(code.rax, code.qword[code.rax]);
+  switch (field->GetFieldMeta().index_type()) {
+    case INT_COLUMN: {
+      code.mov(code.rax, code.qword[code.rax + code.rcx * 8]);
+      code.mov(code.rdx, ssexpr2::V_INT64_VALUE);
+      break;
+    }
+    case FLOAT_COLUMN: {
+      code.mov(code.rax, code.qword[code.rax + code.rcx * 8]);
+      code.mov(code.rdx, ssexpr2::V_DOUBLE_VALUE);
+      break;
+    }
+    default: {
+      code.imul(code.rcx, code.rcx, sizeof(std::string));
+      code.add(code.rax, code.rcx);
+      code.mov(code.rdx, ssexpr2::V_STD_STRING);
+      break;
+    }
+  }
+  code.mov(code.rdi, code.rax);
+  accessor.EndBuild();
+  return accessor;
+}
+
+int RobimsColumnFilter::Init(RobimsDBImpl* db, const std::string& expr) {
+  _db = db;
+  ssexpr2::ExprOptions options;
+  options.get_member_access = [this](const std::vector<std::string>& names,
+                                     std::shared_ptr<Xbyak::CodeGenerator> jit) {
+    return BuildColumnAccessor(names, jit);
+  };
+  int rc = _expr.Init(expr, options);
+  if (0 != rc) {
+    ROBIMS_ERROR("Failed to compile filter:{} with rc:{}", expr, rc);
+    return ROBIMS_QUERY_ERR_INVALID_FILTER_EXPR;
+  }
+  if (nullptr == _table) {
+    ROBIMS_ERROR("No column referenced in filter:{}", expr);
+    return ROBIMS_QUERY_ERR_INVALID_FILTER_EXPR;
+  }
+  return 0;
+}
+
+int RobimsColumnFilter::Apply(const roaring_bitmap_t* bitmap, roaring_bitmap_t* out) {
+  // columns cover all ids of table, the check is only a guard for ids outside of table
+  size_t rows = _columns[0]->Size();
+  for (RobimsColumnField* column : _columns) {
+    rows = std::min(rows, column->Size());
+  }
+  CRoaringBitmapPtr candidates(bitmap_copy_range(bitmap, _table->GetTableBitmap().bitmap.get()));
+  roaring_uint32_iterator_t iter;
+  roaring_init_iterator(candidates.get(), &iter);
+  uint32_t ids[kFilterBatchSize];
+  uint32_t matched[kFilterBatchSize];
+  while (iter.has_value) {
+    uint32_t n = roaring_read_uint32_iterator(&iter, ids, kFilterBatchSize);
+    uint32_t matched_count = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      if (ids[i] >= rows) {
+        continue;
+      }
+      ssexpr2::Value v = _expr.Eval(ids[i], _ctx);
+      if (v.Is<bool>() && v.Get<bool>()) {
+        matched[matched_count++] = ids[i];
+      }
+    }
+    roaring_bitmap_add_many(out, matched_count, matched);
+    if (0 == n) {
+      break;
+    }
+  }
+  return 0;
+}
+}  // namespace robims
@@ -0,0 +1,63 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "roaring/roaring.h"
+#include "robims_common.h"
+#include "spirit_jit_expression.h"
+
+namespace robims {
+class RobimsDBImpl;
+class RobimsTable;
+class RobimsColumnField;
+// residual predicate over column fields of one table, e.g. "test.price * test.count > 100", it's
+// compiled into native code by ssexpr2 and evaluated per id left by the bitmap part of a query:
+//   filter(test.city == "sz", "test.price * test.count > 100")
+class RobimsColumnFilter {
+ private:
+  ssexpr2::SpiritExpression _expr;
+  ssexpr2::JITEvalContext _ctx;
+  RobimsDBImpl* _db = nullptr;
+  RobimsTable* _table = nullptr;
+  std::vector<RobimsColumnField*> _columns;
+
+  ssexpr2::ValueAccessor BuildColumnAccessor(const std::vector<std::string>& names,
+                                             std::shared_ptr<Xbyak::CodeGenerator> jit);
+
+ public:
+  int Init(RobimsDBImpl* db, const std::string& expr);
+  RobimsTable* GetTable() const { return _table; }
+  // ids of 'bitmap' inside the table which satisfy the predicate are added into 'out'.
+  int Apply(const roaring_bitmap_t* bitmap, roaring_bitmap_t* out);
+};
+typedef std::shared_ptr<RobimsColumnFilter> RobimsColumnFilterPtr;
+}  // namespace robims
@@ -29,6 +29,7 @@
 #include "robims_common.h"
 #include <arpa/inet.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -46,6 +47,14 @@ void bitmap_extract_ids(const roaring_bitmap_t* out, std::vector<uint32_t>& ids)
   ids.resize(n);
   roaring_bitmap_to_uint32_array(out, &ids[0]);
 }
+roaring_bitmap_t* bitmap_copy_range(const roaring_bitmap_t* src, const roaring_bitmap_t* range) {
+  if (nullptr == range) {
+    roaring_bitmap_t* out = acquire_bitmap();
+    roaring_bitmap_overwrite(out, src);
+    return out;
+  }
+  return roaring_bitmap_and(src, range);
+}
 void bimap_get_ids(const BitmapOperation& op, std::vector<uint32_t>& ids) {
   BitMapCacheGuard guard;
   auto bitmap = acquire_bitmap();
@@ -77,17 +86,41 @@ void RoaringBitmap::NewCRoaringBitmap() {
 }
 bool RoaringBitmap::Put(uint32_t id) { return roaring_bitmap_add_checked(bitmap.get(), id); }
 bool RoaringBitmap::Remove(uint32_t id) { return roaring_bitmap_remove_checked(bitmap.get(), id); }
+int file_align(FILE* fp, bool write) {
+  long pos = ftell(fp);
+  if (pos < 0) {
+    return -1;
+  }
+  uint32_t padding = (kBitmapFrozenAlignment - pos % kBitmapFrozenAlignment) % kBitmapFrozenAlignment;
+  if (0 == padding) {
+    return 0;
+  }
+  if (!write) {
+    return fseek(fp, padding, SEEK_CUR);
+  }
+  char zeros[kBitmapFrozenAlignment] = {0};
+  if (fwrite(zeros, padding, 1, fp) != 1) {
+    return -1;
+  }
+  return 0;
+}
+
 int RoaringBitmap::Save(FILE* fp, bool readonly) {
   // off_t cur = ::lseek(fd, 0, SEEK_CUR);
-  roaring_bitmap_run_optimize(bitmap.get());
-  roaring_bitmap_shrink_to_fit(bitmap.get());
+  // frozen views are immutable(maybe inside a mmaped image), serialize them as is.
+  if (!_readonly) {
+    roaring_bitmap_run_optimize(bitmap.get());
+    roaring_bitmap_shrink_to_fit(bitmap.get());
+  }
   char* mbuf = nullptr;
   size_t data_len = 0;
+  uint8_t format = kBitmapPortableFormat;
   if (readonly) {
     size_t nbytes = roaring_bitmap_frozen_size_in_bytes(bitmap.get());
     mbuf = (char*)malloc(nbytes);
     roaring_bitmap_frozen_serialize(bitmap.get(), mbuf);
     data_len = nbytes;
+    format = kBitmapAlignedFrozenFormat;
   } else {
     size_t nbytes = roaring_bitmap_size_in_bytes(bitmap.get());
     mbuf = (char*)malloc(nbytes);
@@ -99,9 +132,14 @@ int RoaringBitmap::Save(FILE* fp, bool readonly) {
     free(mbuf);
     return rc;
   }
-  rc = fwrite(&readonly, sizeof(bool), 1, fp);
+  rc = fwrite(&format, sizeof(format), 1, fp);
   if (rc != 1) {
-    ROBIMS_ERROR("Failed to write bitmap readonly flag.");
+    ROBIMS_ERROR("Failed to write bitmap format flag.");
+    free(mbuf);
+    return -1;
+  }
+  if (kBitmapAlignedFrozenFormat == format && 0 != file_align(fp, true)) {
+    ROBIMS_ERROR("Failed to write bitmap alignment padding.");
     free(mbuf);
     return -1;
   }
@@ -122,21 +160,47 @@ int RoaringBitmap::Load(FILE* fp) {
     ROBIMS_ERROR("Failed to read bitmap buf len");
     return -1;
   }
-  bool readonly = false;
-  rc = fread(&readonly, sizeof(bool), 1, fp);
+  uint8_t format = kBitmapPortableFormat;
+  rc = fread(&format, sizeof(format), 1, fp);
   if (rc != 1) {
-    ROBIMS_ERROR("Failed to read bitmap readonly flag");
+    ROBIMS_ERROR("Failed to read bitmap format flag");
     return -1;
   }
-  _readonly = readonly;
-  char* mbuf = (char*)(::aligned_alloc(32, n));
+  _readonly = (kBitmapPortableFormat != format);
+  if (kBitmapAlignedFrozenFormat == format) {
+    if (0 != file_align(fp, false)) {
+      ROBIMS_ERROR("Failed to skip bitmap alignment padding");
+      return -1;
+    }
+    const RobimsImagePtr& image = RobimsImageScope::Current();
+    long pos = ftell(fp);
+    if (image && pos >= 0 && (size_t)pos + n <= image->GetSize()) {
+      const roaring_bitmap_t* b = roaring_bitmap_frozen_view(image->GetData() + pos, n);
+      if (nullptr == b) {
+        ROBIMS_ERROR("roaring_bitmap_frozen_view failed with {} at offset:{}", n, pos);
+        return -1;
+      }
+      CRoaringBitmapDeleter deleter(true);
+      CRoaringBitmapPtr tmp((const_cast<roaring_bitmap_t*>(b)), deleter);
+      bitmap = std::move(tmp);
+      _image = image;
+      _frozen_buf = image->GetData() + pos;
+      _frozen_len = n;
+      if (0 != fseek(fp, n, SEEK_CUR)) {
+        ROBIMS_ERROR("Failed to skip bitmap buf data");
+        return -1;
+      }
+      return 0;
+    }
+  }
+  char* mbuf = (char*)(::aligned_alloc(kBitmapFrozenAlignment, n));
   rc = fread(mbuf, n, 1, fp);
   if (rc != 1) {
     ROBIMS_ERROR("Failed to read bitmap buf data");
     std::free(mbuf);
     return -1;
   }
-  if (!readonly) {
+  if (!_readonly) {
     CRoaringBitmapPtr tmp(roaring_bitmap_deserialize(mbuf));
     bitmap = std::move(tmp);
     std::free(mbuf);
@@ -149,6 +213,8 @@ int RoaringBitmap::Load(FILE* fp) {
     CRoaringBitmapPtr tmp((const_cast<roaring_bitmap_t*>(b)), deleter);
     bitmap = std::move(tmp);
     _underly_buf = mbuf;
+    _frozen_buf = mbuf;
+    _frozen_len = n;
   }
   if (!bitmap) {
     ROBIMS_ERROR("bitmap init failed");
@@ -157,6 +223,106 @@ int RoaringBitmap::Load(FILE* fp) {
   return 0;
 }
 
+// the frozen layout is private to CRoaring(frozen_serialize in roaring.c), it has been stable
+// since 0.2, re-verify parse_frozen_bitsets against the new layout before raising the bound.
+static_assert(ROARING_VERSION_MAJOR < 5, "verify the CRoaring frozen layout parsed below");
+
+// frozen layout: bitset zone | run zone | array zone | keys | counts | typecodes | header
+static bool parse_frozen_bitsets(const char* buf, size_t len,
+                                 std::vector<FrozenBitsetContainer>& bitsets,
+                                 std::vector<uint16_t>& other_keys) {
+  static const uint32_t kFrozenCookie = 13766;
+  static const uint8_t kBitsetTypecode = 1;
+  static const size_t kBitsetBytes = 8192;
+  if (nullptr == buf || len < sizeof(uint32_t)) {
+    return false;
+  }
+  uint32_t header = 0;
+  memcpy(&header, buf + len - sizeof(uint32_t), sizeof(header));
+  if ((header & 0x7FFF) != kFrozenCookie) {
+    return false;
+  }
+  size_t n = header >> 15;
+  if (len < sizeof(uint32_t) + n * 5) {
+    return false;
+  }
+  const char* typecodes = buf + len - sizeof(uint32_t) - n;
+  const char* keys = typecodes - n * 4;
+  size_t bitset_idx = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint16_t key = 0;
+    memcpy(&key, keys + i * sizeof(uint16_t), sizeof(key));
+    if (kBitsetTypecode == (uint8_t)typecodes[i]) {
+      FrozenBitsetContainer c;
+      c.key = key;
+      c.words = reinterpret_cast<const uint64_t*>(buf + bitset_idx * kBitsetBytes);
+      bitsets.emplace_back(c);
+      bitset_idx++;
+    } else {
+      other_keys.emplace_back(key);
+    }
+  }
+  if (bitset_idx * kBitsetBytes > len) {
+    bitsets.clear();
+    other_keys.clear();
+    return false;
+  }
+  return true;
+}
+
+// freeze a probe bitmap with array, bitset and run containers once, and check the parsed bitsets
+// against roaring_bitmap_contains, so that a linked CRoaring with another layout is detected.
+static bool verify_frozen_layout() {
+  CRoaringBitmapPtr probe(roaring_bitmap_create());
+  for (uint32_t v = 0; v < 65536; v += 3) {
+    roaring_bitmap_add(probe.get(), v);
+  }
+  roaring_bitmap_add(probe.get(), 65536 + 7);
+  roaring_bitmap_add(probe.get(), 65536 + 4099);
+  roaring_bitmap_add_range(probe.get(), 2 * 65536, 2 * 65536 + 60000);
+  for (uint32_t v = 3 * 65536; v < 4 * 65536; v += 7) {
+    roaring_bitmap_add(probe.get(), v);
+  }
+  roaring_bitmap_run_optimize(probe.get());
+  size_t len = roaring_bitmap_frozen_size_in_bytes(probe.get());
+  size_t alloc_len =
+      (len + kBitmapFrozenAlignment - 1) / kBitmapFrozenAlignment * kBitmapFrozenAlignment;
+  std::unique_ptr<char, decltype(&std::free)> buf(
+      (char*)::aligned_alloc(kBitmapFrozenAlignment, alloc_len), &std::free);
+  roaring_bitmap_frozen_serialize(probe.get(), buf.get());
+  std::vector<FrozenBitsetContainer> bitsets;
+  std::vector<uint16_t> other_keys;
+  if (!parse_frozen_bitsets(buf.get(), len, bitsets, other_keys) ||
+      bitsets.size() + other_keys.size() != 4) {
+    return false;
+  }
+  for (const FrozenBitsetContainer& c : bitsets) {
+    for (uint32_t low = 0; low < 65536; low++) {
+      uint32_t v = ((uint32_t)c.key << 16) | low;
+      bool bit = (c.words[low >> 6] >> (low & 63)) & 1;
+      if (bit != roaring_bitmap_contains(probe.get(), v)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool RoaringBitmap::GetFrozenBitsets(std::vector<FrozenBitsetContainer>& bitsets,
+                                     std::vector<uint16_t>& other_keys) const {
+  static const bool layout_verified = []() {
+    bool verified = verify_frozen_layout();
+    if (!verified) {
+      ROBIMS_ERROR("Unexpected CRoaring frozen layout, frozen bitsets are not used.");
+    }
+    return verified;
+  }();
+  if (!layout_verified) {
+    return false;
+  }
+  return parse_frozen_bitsets(_frozen_buf, _frozen_len, bitsets, other_keys);
+}
+
 RoaringBitmap::~RoaringBitmap() {
   if (nullptr != _underly_buf) {
     std::free(_underly_buf);
@@ -197,11 +363,38 @@ int file_read_uint32(FILE* fp, uint32_t& n) {
   return 0;
 }
 
+int file_atomic_write(const std::string& path, const std::function<int(FILE*)>& func) {
+  std::string tmp_path = path + ".tmp";
+  FILE* fp = fopen(tmp_path.c_str(), "w");
+  if (nullptr == fp) {
+    ROBIMS_ERROR("Failed to create file:{}", tmp_path);
+    return -1;
+  }
+  int rc = func(fp);
+  if (0 == rc && (0 != fflush(fp) || 0 != fsync(fileno(fp)))) {
+    ROBIMS_ERROR("Failed to sync file:{}", tmp_path);
+    rc = -1;
+  }
+  fclose(fp);
+  if (0 != rc) {
+    unlink(tmp_path.c_str());
+    return rc;
+  }
+  if (0 != rename(tmp_path.c_str(), path.c_str())) {
+    ROBIMS_ERROR("Failed to rename {} to {}", tmp_path, path);
+    return -1;
+  }
+  return 0;
+}
+
 int file_write_string(FILE* fp, std::string_view s) {
   int rc = file_write_uint32(fp, s.size());
   if (0 != rc) {
     return -1;
   }
+  if (s.empty()) {
+    return 0;
+  }
   rc = fwrite(s.data(), s.size(), 1, fp);
   if (rc != 1) {
     return -1;
@@ -214,6 +407,9 @@ int file_read_string(FILE* fp, std::string& s) {
     return -1;
   }
   s.resize(n);
+  if (0 == n) {
+    return 0;
+  }
   int rc = fread(&(s[0]), s.size(), 1, fp);
   if (rc != 1) {
     return -1;
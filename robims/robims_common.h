@@ -32,10 +32,12 @@
 #include <stdio.h>
 #include <functional>
 #include <memory>
+#include <string>
 #include <string_view>
 #include <vector>
 #include "roaring/roaring.h"
 #include "robims_cache.h"
+#include "robims_image.h"
 
 namespace robims {
 uint64_t htonll(uint64_t val);
@@ -51,9 +53,26 @@ struct CRoaringBitmapDeleter {
   }
 };
 typedef std::unique_ptr<roaring_bitmap_t, CRoaringBitmapDeleter> CRoaringBitmapPtr;
+
+// bitmap save formats, the aligned frozen format could be viewed directly from a mmaped image.
+static const uint8_t kBitmapPortableFormat = 0;
+static const uint8_t kBitmapFrozenFormat = 1;
+static const uint8_t kBitmapAlignedFrozenFormat = 2;
+static const uint32_t kBitmapFrozenAlignment = 32;
+
+// a bitset container of a frozen bitmap, 'words' points to the 1024 words inside the frozen buffer.
+struct FrozenBitsetContainer {
+  uint16_t key = 0;
+  const uint64_t* words = nullptr;
+};
+
 struct RoaringBitmap {
   CRoaringBitmapPtr bitmap;
   char* _underly_buf = nullptr;
+  // frozen buffer viewed by 'bitmap', either inside the mmaped image or '_underly_buf'.
+  const char* _frozen_buf = nullptr;
+  size_t _frozen_len = 0;
+  RobimsImagePtr _image;
   bool _readonly = false;
   RoaringBitmap() = default;
   RoaringBitmap(const RoaringBitmap&) = delete;
@@ -66,6 +85,10 @@ struct RoaringBitmap {
   bool Put(uint32_t id);
   bool Remove(uint32_t id);
   bool IsReadonly() const { return _readonly; }
+  // collect the bitset containers of a readonly bitmap by parsing the frozen layout, keys of the
+  // array/run containers are put into 'other_keys'. return false if it's not a frozen bitmap.
+  bool GetFrozenBitsets(std::vector<FrozenBitsetContainer>& bitsets,
+                        std::vector<uint16_t>& other_keys) const;
   ~RoaringBitmap();
 };
 typedef std::unique_ptr<RoaringBitmap> RoaringBitmapPtr;
@@ -75,6 +98,9 @@ typedef std::function<bool(uint32_t)> CRoaringBitmapIterateFunc;
 void iterate_bitmap(const CRoaringBitmapIterateFunc& func, const roaring_bitmap_t* bitmap);
 
 void bitmap_extract_ids(const roaring_bitmap_t* out, std::vector<uint32_t>& ids);
+// copy 'src' to a new bitmap which should be released by 'release_bitmap', only ids inside 'range'
+// are kept if it's not null.
+roaring_bitmap_t* bitmap_copy_range(const roaring_bitmap_t* src, const roaring_bitmap_t* range);
 
 typedef std::function<void(roaring_bitmap_t*)> BitmapOperation;
 void bimap_get_ids(const BitmapOperation& op, std::vector<uint32_t>& ids);
@@ -85,5 +111,9 @@ int file_write_uint32(FILE* fp, uint32_t n);
 int file_read_uint32(FILE* fp, uint32_t& n);
 int file_write_uint64(FILE* fp, uint64_t n);
 int file_read_uint64(FILE* fp, uint64_t& n);
+// pad(write) or skip(read) to next kBitmapFrozenAlignment file offset
+int file_align(FILE* fp, bool write);
+// write 'path' by 'func' into a temp file, then sync and rename it to 'path'.
+int file_atomic_write(const std::string& path, const std::function<int(FILE*)>& func);
 
 }  // namespace robims
\ No newline at end of file
@@ -0,0 +1,237 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "robims_compact_id_mapping.h"
+#include <string.h>
+#include <string_view>
+#include "folly/hash/SpookyHashV2.h"
+#include "robims_common.h"
+#include "robims_log.h"
+
+namespace robims {
+static const size_t kMinSlotCount = 1024;
+static const uint64_t kIDHashSeed = 0x726f62696d73ull;
+
+// the hash is persisted with the table, so it must be stable across processes
+static inline uint64_t id_hash(const std::string_view& id) {
+  return folly::hash::SpookyHashV2::Hash64(id.data(), id.size(), kIDHashSeed);
+}
+
+template <typename T>
+static int save_array(FILE* fp, const T* data, size_t count) {
+  uint64_t nbytes = count * sizeof(T);
+  if (0 != file_write_uint64(fp, nbytes)) {
+    return -1;
+  }
+  if (0 != file_align(fp, true)) {
+    return -1;
+  }
+  if (nbytes > 0 && fwrite(data, nbytes, 1, fp) != 1) {
+    return -1;
+  }
+  return 0;
+}
+
+template <typename T>
+static int load_array(FILE* fp, std::vector<T>& buf, const T*& data, size_t& count) {
+  uint64_t nbytes = 0;
+  if (0 != file_read_uint64(fp, nbytes)) {
+    return -1;
+  }
+  if (0 != file_align(fp, false)) {
+    return -1;
+  }
+  count = nbytes / sizeof(T);
+  const RobimsImagePtr& image = RobimsImageScope::Current();
+  long pos = ftell(fp);
+  if (image && pos >= 0 && (size_t)pos + nbytes <= image->GetSize()) {
+    data = (const T*)(image->GetData() + pos);
+    return fseek(fp, nbytes, SEEK_CUR);
+  }
+  buf.resize(count);
+  if (nbytes > 0 && fread(buf.data(), nbytes, 1, fp) != 1) {
+    return -1;
+  }
+  data = buf.data();
+  return 0;
+}
+
+CompactIDMapping::CompactIDMapping() {
+  _offsets.push_back(0);
+  _slots.resize(kMinSlotCount);
+  SyncViews();
+}
+
+void CompactIDMapping::SyncViews() {
+  _arena_data = _arena.data();
+  _arena_size = _arena.size();
+  _offsets_data = _offsets.data();
+  _id_count = _offsets.size() - 1;
+  _slots_data = _slots.data();
+  _slot_count = _slots.size();
+}
+
+std::string_view CompactIDMapping::GetIDView(uint32_t local_id) const {
+  uint64_t begin = _offsets_data[local_id];
+  uint64_t end = _offsets_data[local_id + 1];
+  return std::string_view(_arena_data + begin, end - begin);
+}
+
+int CompactIDMapping::FindSlot(const std::string_view& id, size_t& slot) const {
+  size_t mask = _slot_count - 1;
+  slot = id_hash(id) & mask;
+  while (true) {
+    uint32_t v = _slots_data[slot];
+    if (0 == v) {
+      return -1;
+    }
+    if (GetIDView(v - 1) == id) {
+      return 0;
+    }
+    slot = (slot + 1) & mask;
+  }
+}
+
+int CompactIDMapping::MakeMutable() {
+  if (!_image) {
+    return 0;
+  }
+  if (_arena_data != _arena.data()) {
+    _arena.assign(_arena_data, _arena_data + _arena_size);
+  }
+  if (_offsets_data != _offsets.data()) {
+    _offsets.assign(_offsets_data, _offsets_data + _id_count + 1);
+  }
+  if (_slots_data != _slots.data()) {
+    _slots.assign(_slots_data, _slots_data + _slot_count);
+  }
+  _image.reset();
+  SyncViews();
+  return 0;
+}
+
+void CompactIDMapping::Rehash(size_t slot_count) {
+  std::vector<uint32_t> slots(slot_count);
+  size_t mask = slot_count - 1;
+  for (uint32_t local_id = 0; local_id < _id_count; local_id++) {
+    size_t slot = id_hash(GetIDView(local_id)) & mask;
+    while (0 != slots[slot]) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = local_id + 1;
+  }
+  _slots.swap(slots);
+  SyncViews();
+}
+
+int CompactIDMapping::GetLocalID(const std::string_view& id, bool create_ifnotexist,
+                                 uint32_t& local_id) {
+  size_t slot = 0;
+  if (0 == FindSlot(id, slot)) {
+    local_id = _slots_data[slot] - 1;
+    return 0;
+  }
+  if (!create_ifnotexist) {
+    return -1;
+  }
+  MakeMutable();
+  local_id = _id_count;
+  _arena.insert(_arena.end(), id.data(), id.data() + id.size());
+  _offsets.push_back(_arena.size());
+  _slots[slot] = local_id + 1;
+  SyncViews();
+  // keep load factor under 0.5
+  if (2 * (size_t)_id_count > _slot_count) {
+    Rehash(2 * _slot_count);
+  }
+  return 0;
+}
+
+int CompactIDMapping::GetID(uint32_t local_id, std::string_view& id) {
+  if (local_id >= _id_count) {
+    return -1;
+  }
+  id = GetIDView(local_id);
+  return 0;
+}
+
+int CompactIDMapping::Save(FILE* fp, bool readonly) {
+  int rc = file_write_uint32(fp, _id_count);
+  if (0 != rc) {
+    ROBIMS_ERROR("Failed to save id count");
+    return rc;
+  }
+  rc = save_array(fp, _arena_data, _arena_size);
+  if (0 != rc) {
+    ROBIMS_ERROR("Failed to save id arena");
+    return rc;
+  }
+  rc = save_array(fp, _offsets_data, _id_count + 1);
+  if (0 != rc) {
+    ROBIMS_ERROR("Failed to save id offsets");
+    return rc;
+  }
+  rc = save_array(fp, _slots_data, _slot_count);
+  if (0 != rc) {
+    ROBIMS_ERROR("Failed to save id hash slots");
+    return rc;
+  }
+  return 0;
+}
+
+int CompactIDMapping::Load(FILE* fp) {
+  uint32_t id_count = 0;
+  int rc = file_read_uint32(fp, id_count);
+  if (0 != rc) {
+    ROBIMS_ERROR("Failed to read id count");
+    return rc;
+  }
+  size_t offset_count = 0;
+  if (0 != load_array(fp, _arena, _arena_data, _arena_size)) {
+    ROBIMS_ERROR("Failed to read id arena");
+    return -1;
+  }
+  if (0 != load_array(fp, _offsets, _offsets_data, offset_count)) {
+    ROBIMS_ERROR("Failed to read id offsets");
+    return -1;
+  }
+  if (0 != load_array(fp, _slots, _slots_data, _slot_count)) {
+    ROBIMS_ERROR("Failed to read id hash slots");
+    return -1;
+  }
+  if (offset_count != (size_t)id_count + 1 || _slot_count < kMinSlotCount ||
+      (_slot_count & (_slot_count - 1)) != 0) {
+    ROBIMS_ERROR("Invalid id mapping with id count:{}, offsets:{}, slots:{}", id_count,
+                 offset_count, _slot_count);
+    return -1;
+  }
+  _id_count = id_count;
+  _image = RobimsImageScope::Current();
+  return 0;
+}
+}  // namespace robims
@@ -0,0 +1,75 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "robims_id_mapping.h"
+#include "robims_image.h"
+namespace robims {
+
+/**
+ * Memory compact id mapping:
+ *  - all real ids are appended to one contiguous arena
+ *  - local id -> arena offset array, local ids are allocated sequentially
+ *  - open addressing hash table of local ids for real id -> local id lookup
+ * All parts are saved as aligned raw arrays, which are referenced directly from the mmaped image
+ * when loaded from a readonly db file.
+ */
+class CompactIDMapping : public IDMapping {
+ private:
+  std::vector<char> _arena;
+  std::vector<uint64_t> _offsets;  // size is id count + 1
+  std::vector<uint32_t> _slots;    // local id + 1, 0 means empty slot
+
+  // current data, points to owned vectors above or views of the mmaped image
+  const char* _arena_data = nullptr;
+  size_t _arena_size = 0;
+  const uint64_t* _offsets_data = nullptr;
+  uint32_t _id_count = 0;
+  const uint32_t* _slots_data = nullptr;
+  size_t _slot_count = 0;
+  RobimsImagePtr _image;
+
+  std::string_view GetIDView(uint32_t local_id) const;
+  int FindSlot(const std::string_view& id, size_t& slot) const;
+  int MakeMutable();
+  void Rehash(size_t slot_count);
+  void SyncViews();
+
+  int GetLocalID(const std::string_view& id, bool create_ifnotexist, uint32_t& local_id) override;
+  int GetID(uint32_t local_id, std::string_view& id) override;
+  int Save(FILE* fp, bool readonly) override;
+  int Load(FILE* fp) override;
+
+ public:
+  CompactIDMapping();
+};
+
+}  // namespace robims
@@ -36,13 +36,26 @@
 #include "roaring/roaring.h"
 #include "robims.pb.h"
 #include "robims_id_mapping.h"
+#include "robims_wal.h"
 
 namespace robims {
 
+struct AggregateBucket {
+  std::string key;
+  int64_t count = 0;
+  double value = 0;
+};
+typedef std::vector<AggregateBucket> AggregateBuckets;
+
 struct SelectResult {
   std::vector<std::string> ids;
   int64_t total = 0;
+  // filled by aggregation query like 'count_by(test.city, test.age > 50)'
+  AggregateBuckets buckets;
 };
+// called with each id of a select result in order, the id is only valid during the call, return
+// false to stop.
+typedef std::function<bool(std::string_view id)> SelectVisitor;
 class RobimsDBImpl;
 class RobimsDB {
  private:
@@ -51,17 +64,42 @@ class RobimsDB {
   RobimsDBImpl* db_impl_;
 
  public:
-  RobimsDB();
+  explicit RobimsDB(IDMappingType id_mapping_type = SIMPLE_ID_MAPPING);
+  // 'file' could be a file created by 'Save' or a directory created by 'Checkpoint', records in
+  // wal after the loaded data are replayed if wal is enabled.
   int Load(const std::string& file);
   int Save(const std::string& file, bool readonly);
+  // log every Put/Remove into 'wal_file' before applying it, existing records after the loaded
+  // data are replayed at once. tables must be created/loaded before.
+  int EnableWAL(const std::string& wal_file, const WALOptions& options = WALOptions());
+  // save changes since last checkpoint into 'dir', and truncate the wal.
+  int Checkpoint(const std::string& dir);
   int SaveTable(const std::string& file, const std::string& table, bool readonly);
   void DisableThreadSafe();
   void EnableThreadSafe();
+  // split select query into high 16bit id ranges(roaring containers) and execute them on 'threads'
+  // threads, query over less than 'min_containers' containers is still executed in caller thread.
+  void EnableParallelQuery(uint32_t threads, uint32_t min_containers = 16);
+  void DisableParallelQuery();
+  // cache bitmap results of select queries, cached result is dropped once any table referenced by
+  // the query is changed by Put/Remove.
+  void EnableResultCache(size_t capacity = 1024);
+  void DisableResultCache();
   int CreateTable(const std::string& schema);
   int CreateTable(const TableSchema& schema);
   int Put(const std::string& table, const std::string& json);
   int Remove(const std::string& table, const std::string& json);
   int Select(const std::string& query, int64_t offset, int64_t limit, SelectResult& result);
+  // visit all ids of query result without copying, 'total' is filled if not null.
+  int SelectStream(const std::string& query, const SelectVisitor& visitor,
+                   int64_t* total = nullptr);
+  // pin the result of 'query' as a cursor for deep pagination, an idle cursor is dropped after
+  // 'ttl_ms'. result.total is filled, aggregation queries are not supported.
+  int OpenCursor(const std::string& query, uint32_t ttl_ms, uint64_t& cursor, SelectResult& result);
+  // fetch next 'limit' ids from where last fetch stopped, result.ids is empty once exhausted.
+  int FetchCursor(uint64_t cursor, int64_t limit, SelectResult& result);
+  int FetchCursor(uint64_t cursor, int64_t limit, const SelectVisitor& visitor);
+  int CloseCursor(uint64_t cursor);
   ~RobimsDB();
 };
 }  // namespace robims
\ No newline at end of file
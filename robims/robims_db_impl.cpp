@@ -27,15 +27,22 @@
  *THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include "robims_db_impl.h"
+#include <errno.h>
 #include <fcntl.h>
 #include <google/protobuf/util/json_util.h>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
+#include <chrono>
 #include <string_view>
 #include "folly/String.h"
+#include "folly/synchronization/Latch.h"
 #include "robims_common.h"
+#include "robims_compact_id_mapping.h"
+#include "robims_err.h"
+#include "robims_image.h"
 #include "robims_log.h"
 #include "robims_simple_id_mapping.h"
 #include "robims_table_creation.h"
@@ -43,7 +50,15 @@
 namespace robims {
 static const uint8_t kDBSaveType = 0;
 static const uint8_t kTableSaveType = 1;
-RobimsDB::RobimsDB() { db_impl_ = new RobimsDBImpl; }
+static const int64_t kCursorSweepIntervalMs = 100;
+static int64_t cursor_now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+RobimsDB::RobimsDB(IDMappingType id_mapping_type) {
+  db_impl_ = new RobimsDBImpl(id_mapping_type);
+}
 int RobimsDB ::Load(const std::string& file) { return db_impl_->Load(file); }
 int RobimsDB ::CreateTable(const TableSchema& schema) { return db_impl_->CreateTable(schema); }
 int RobimsDB::CreateTable(const std::string& schema) { return db_impl_->CreateTable(schema); }
@@ -56,6 +71,10 @@ int RobimsDB::Remove(const std::string& table, const std::string& json) {
 int RobimsDB::Save(const std::string& file, bool readonly) {
   return db_impl_->Save(file, readonly);
 }
+int RobimsDB::EnableWAL(const std::string& wal_file, const WALOptions& options) {
+  return db_impl_->EnableWAL(wal_file, options);
+}
+int RobimsDB::Checkpoint(const std::string& dir) { return db_impl_->Checkpoint(dir); }
 int RobimsDB::SaveTable(const std::string& file, const std::string& table, bool readonly) {
   return db_impl_->SaveTable(file, table, readonly);
 }
@@ -63,17 +82,60 @@ int RobimsDB::Select(const std::string& query, int64_t offset, int64_t limit,
                      SelectResult& result) {
   return db_impl_->Select(query, offset, limit, result);
 }
+int RobimsDB::SelectStream(const std::string& query, const SelectVisitor& visitor,
+                           int64_t* total) {
+  return db_impl_->SelectStream(query, visitor, total);
+}
+int RobimsDB::OpenCursor(const std::string& query, uint32_t ttl_ms, uint64_t& cursor,
+                         SelectResult& result) {
+  return db_impl_->OpenCursor(query, ttl_ms, cursor, result);
+}
+int RobimsDB::FetchCursor(uint64_t cursor, int64_t limit, SelectResult& result) {
+  result.ids.clear();
+  result.buckets.clear();
+  return db_impl_->FetchCursor(cursor, limit, [&result](std::string_view id) {
+    result.ids.emplace_back(id.data(), id.size());
+    return true;
+  });
+}
+int RobimsDB::FetchCursor(uint64_t cursor, int64_t limit, const SelectVisitor& visitor) {
+  return db_impl_->FetchCursor(cursor, limit, visitor);
+}
+int RobimsDB::CloseCursor(uint64_t cursor) { return db_impl_->CloseCursor(cursor); }
 void RobimsDB::DisableThreadSafe() { db_impl_->DisableThreadSafe(); }
 void RobimsDB::EnableThreadSafe() { db_impl_->EnableThreadSafe(); }
+void RobimsDB::EnableParallelQuery(uint32_t threads, uint32_t min_containers) {
+  db_impl_->EnableParallelQuery(threads, min_containers);
+}
+void RobimsDB::DisableParallelQuery() { db_impl_->DisableParallelQuery(); }
+void RobimsDB::EnableResultCache(size_t capacity) { db_impl_->EnableResultCache(capacity); }
+void RobimsDB::DisableResultCache() { db_impl_->DisableResultCache(); }
 
 RobimsDB::~RobimsDB() { delete db_impl_; }
-RobimsDBData::RobimsDBData() : id_mapping(new SimpleIDMapping), query_cache(1024) {}
+static IDMapping* new_id_mapping(IDMappingType type) {
+  switch (type) {
+    case COMPACT_ID_MAPPING: {
+      return new CompactIDMapping;
+    }
+    default: {
+      return new SimpleIDMapping;
+    }
+  }
+}
+RobimsDBData::RobimsDBData(IDMappingType type)
+    : id_mapping_type(type),
+      id_mapping(new_id_mapping(type)),
+      query_cache(1024),
+      result_cache(1024) {}
 RobimsDBData::~RobimsDBData() { delete id_mapping; }
-RobimsDBImpl::RobimsDBImpl() : shared_mutex_(nullptr) {
-  std::shared_ptr<RobimsDBData> p(new RobimsDBData);
+RobimsDBImpl::RobimsDBImpl(IDMappingType id_mapping_type) : shared_mutex_(nullptr) {
+  std::shared_ptr<RobimsDBData> p(new RobimsDBData(id_mapping_type));
   db_data_.store(p);
 }
-RobimsDBImpl::~RobimsDBImpl() { DisableThreadSafe(); }
+RobimsDBImpl::~RobimsDBImpl() {
+  DisableParallelQuery();
+  DisableThreadSafe();
+}
 
 void RobimsDBImpl::DisableThreadSafe() {
   if (nullptr != shared_mutex_) {
@@ -85,8 +147,41 @@ void RobimsDBImpl::EnableThreadSafe() {
   DisableThreadSafe();
   shared_mutex_ = new folly::SharedMutex;
 }
+void RobimsDBImpl::DisableParallelQuery() {
+  // the executor is joined once the last running query releases it
+  query_executor_.store(nullptr);
+}
+void RobimsDBImpl::EnableResultCache(size_t capacity) {
+  folly::SharedMutex::WriteHolder lock(shared_mutex_);
+  std::shared_ptr<RobimsDBData> db = db_data_.load();
+  result_cache_capacity_ = capacity;
+  db->result_cache.SetCapacity(capacity);
+}
+void RobimsDBImpl::DisableResultCache() {
+  folly::SharedMutex::WriteHolder lock(shared_mutex_);
+  std::shared_ptr<RobimsDBData> db = db_data_.load();
+  result_cache_capacity_ = 0;
+  db->result_cache.Clear();
+}
+void RobimsDBImpl::EnableParallelQuery(uint32_t threads, uint32_t min_containers) {
+  if (threads <= 1) {
+    DisableParallelQuery();
+    return;
+  }
+  ParallelQueryExecutorPtr executor(new ParallelQueryExecutor);
+  // caller thread executes the first id range
+  executor->executor = std::make_unique<folly::CPUThreadPoolExecutor>(
+      threads - 1, std::make_shared<folly::NamedThreadFactory>("robims_query"));
+  executor->threads = threads;
+  executor->min_containers = min_containers;
+  query_executor_.store(executor);
+}
 
 int RobimsDBImpl::Load(const std::string& file) {
+  struct stat st;
+  if (0 == stat(file.c_str(), &st) && S_ISDIR(st.st_mode)) {
+    return LoadCheckpoint(file);
+  }
   FILE* fp = fopen(file.c_str(), "r");
   if (nullptr == fp) {
     ROBIMS_ERROR("Failed to open file:{} to load robims db", file);
@@ -102,6 +197,14 @@ int RobimsDBImpl::Load(const std::string& file) {
     ROBIMS_ERROR("Failed to parse DBHeader!");
     return -1;
   }
+  RobimsImagePtr image;
+  if (header.readonly()) {
+    image = RobimsImage::Open(file);
+    if (!image) {
+      ROBIMS_ERROR("Failed to open readonly image:{}, fallback to read bitmaps.", file);
+    }
+  }
+  RobimsImageScope image_scope(image);
 
   int rc = 0;
   if (!header.whole_db()) {
@@ -124,8 +227,14 @@ int RobimsDBImpl::Load(const std::string& file) {
         found->second.store(new_table);
       }
     }
+    // cached queries refer to fields of replaced tables
+    db->query_cache.Clear();
+    db->result_cache.Clear();
   } else {
-    std::shared_ptr<RobimsDBData> new_db(new RobimsDBData);
+    std::shared_ptr<RobimsDBData> new_db(new RobimsDBData(header.id_mapping_type()));
+    if (result_cache_capacity_ > 0) {
+      new_db->result_cache.SetCapacity(result_cache_capacity_);
+    }
     uint32_t table_size = 0;
     file_read_uint32(fp, table_size);
     ROBIMS_INFO("There is {} tables in robims db", table_size);
@@ -144,72 +253,207 @@ int RobimsDBImpl::Load(const std::string& file) {
     rc = new_db->id_mapping->Load(fp);
     if (0 == rc) {
       db_data_.store(new_db);
+      checkpoint_lsn_ = header.wal_lsn();
+      checkpoint_dir_.clear();
+      id_mapping_dirty_ = false;
     }
   }
   fclose(fp);
+  if (0 == rc && header.whole_db() && wal_) {
+    rc = ReplayWAL();
+  }
   return rc;
 }
-int RobimsDBImpl::SaveTable(const std::string& file, const std::string& table, bool readonly) {
-  std::shared_ptr<RobimsDBData> db = db_data_.load();
-  auto found = db->tables.find(table);
-  if (found == db->tables.end()) {
-    ROBIMS_ERROR("Table:{} not found while tables:{}", table, db->tables.size());
-    return -1;
-  }
-  auto table_obj = found->second.load();
-  FILE* fp = fopen(file.c_str(), "w+");
+int RobimsDBImpl::LoadCheckpoint(const std::string& dir) {
+  std::string manifest_path = dir + "/MANIFEST";
+  FILE* fp = fopen(manifest_path.c_str(), "r");
   if (nullptr == fp) {
-    ROBIMS_ERROR("Failed to create file:{} to save robims table", file);
+    ROBIMS_ERROR("Failed to open checkpoint manifest:{}", manifest_path);
     return -1;
   }
+  std::string db_header_bin;
+  int rc = file_read_string(fp, db_header_bin);
+  fclose(fp);
   DBHeader header;
-  header.set_version(1);
-  header.set_whole_db(false);
-  header.add_partial_tables(table);
-  std::string header_bin = header.SerializeAsString();
-  int rc = file_write_string(fp, header_bin);
-  if (0 != rc) {
-    ROBIMS_ERROR("Failed to write save db header to file:{}", file);
+  if (0 != rc || !header.ParseFromString(db_header_bin)) {
+    ROBIMS_ERROR("Failed to parse checkpoint manifest:{}", manifest_path);
     return -1;
   }
-  rc = table_obj->Save(fp, readonly);
+  std::shared_ptr<RobimsDBData> new_db(new RobimsDBData(header.id_mapping_type()));
+  if (result_cache_capacity_ > 0) {
+    new_db->result_cache.SetCapacity(result_cache_capacity_);
+  }
+  for (const auto& schema : header.checkpoint_tables()) {
+    std::shared_ptr<RobimsTable> table(new RobimsTable(new_db->id_mapping));
+    if (0 != table->LoadCheckpoint(dir, schema)) {
+      ROBIMS_ERROR("Failed to load table:{} from checkpoint:{}", schema.name(), dir);
+      return -1;
+    }
+    std::string_view table_name = table->GetSchema().name();
+    new_db->tables[table_name].store(table);
+  }
+  std::string id_mapping_path = dir + "/id_mapping";
+  fp = fopen(id_mapping_path.c_str(), "r");
+  if (nullptr == fp) {
+    ROBIMS_ERROR("Failed to open checkpoint id mapping:{}", id_mapping_path);
+    return -1;
+  }
+  rc = new_db->id_mapping->Load(fp);
   fclose(fp);
+  if (0 != rc) {
+    return rc;
+  }
+  db_data_.store(new_db);
+  checkpoint_lsn_ = header.wal_lsn();
+  checkpoint_dir_ = dir;
+  id_mapping_dirty_ = false;
+  ROBIMS_INFO("Load checkpoint:{} with {} tables at wal lsn:{}", dir, header.checkpoint_tables_size(),
+              checkpoint_lsn_);
+  if (wal_) {
+    return ReplayWAL();
+  }
+  return 0;
+}
+int RobimsDBImpl::ReplayWAL() {
+  // new records must not reuse lsns already covered by the loaded data
+  wal_->AdvanceLSN(checkpoint_lsn_);
+  std::shared_ptr<RobimsDBData> db = db_data_.load();
+  uint64_t count = 0;
+  int rc = wal_->Replay(checkpoint_lsn_, [&](uint64_t lsn, WALOpType op, const std::string& table,
+                                            const std::string& json) {
+    auto found = db->tables.find(table);
+    if (found == db->tables.end()) {
+      ROBIMS_ERROR("Table:{} of wal record:{} not found", table, lsn);
+      return;
+    }
+    // ops failed at first run fail again, same as they were applied
+    if (WAL_OP_PUT == op) {
+      found->second.load()->Put(json);
+    } else {
+      found->second.load()->Remove(json);
+    }
+    count++;
+  });
+  if (count > 0) {
+    id_mapping_dirty_ = true;
+  }
+  ROBIMS_INFO("Replay {} wal records after lsn:{} with rc:{}", count, checkpoint_lsn_, rc);
   return rc;
 }
-int RobimsDBImpl::Save(const std::string& file, bool readonly) {
+int RobimsDBImpl::EnableWAL(const std::string& wal_file, const WALOptions& options) {
+  folly::SharedMutex::WriteHolder lock(shared_mutex_);
+  std::unique_ptr<RobimsWAL> wal(new RobimsWAL);
+  int rc = wal->Open(wal_file, options, checkpoint_lsn_);
+  if (0 != rc) {
+    return rc;
+  }
+  wal_ = std::move(wal);
+  return ReplayWAL();
+}
+int RobimsDBImpl::Checkpoint(const std::string& dir) {
+  std::lock_guard<std::mutex> checkpoint_guard(checkpoint_mutex_);
+  // saving compacts live bitmaps(run_optimize/shrink_to_fit) and weight set tags, and clears
+  // dirty flags, so selects must not run against the tables meanwhile.
+  folly::SharedMutex::WriteHolder lock(shared_mutex_);
   std::shared_ptr<RobimsDBData> db = db_data_.load();
-  FILE* fp = fopen(file.c_str(), "w+");
-  if (nullptr == fp) {
-    ROBIMS_ERROR("Failed to create file:{} to save robims db", file);
+  if (0 != mkdir(dir.c_str(), 0755) && EEXIST != errno) {
+    ROBIMS_ERROR("Failed to create checkpoint dir:{}", dir);
     return -1;
   }
+  bool full = (dir != checkpoint_dir_);
+  uint64_t lsn = wal_ ? wal_->LastLSN() : checkpoint_lsn_;
   DBHeader header;
   header.set_version(1);
   header.set_whole_db(true);
+  header.set_id_mapping_type(db->id_mapping_type);
+  header.set_wal_lsn(lsn);
+  for (auto& pair : db->tables) {
+    auto table = pair.second.load();
+    int rc = table->SaveCheckpoint(dir, full);
+    if (0 != rc) {
+      return rc;
+    }
+    header.add_checkpoint_tables()->CopyFrom(table->GetSchema());
+  }
+  if (full || id_mapping_dirty_) {
+    int rc = file_atomic_write(dir + "/id_mapping",
+                               [&db](FILE* fp) { return db->id_mapping->Save(fp, false); });
+    if (0 != rc) {
+      return rc;
+    }
+    id_mapping_dirty_ = false;
+  }
+  // manifest is the commit point of a checkpoint
   std::string header_bin = header.SerializeAsString();
-  int rc = file_write_string(fp, header_bin);
+  int rc = file_atomic_write(dir + "/MANIFEST",
+                             [&header_bin](FILE* fp) { return file_write_string(fp, header_bin); });
   if (0 != rc) {
-    ROBIMS_ERROR("Failed to write save db header to file:{}", file);
-    return -1;
+    return rc;
   }
-
-  uint32_t table_size = db->tables.size();
-  rc = file_write_uint32(fp, table_size);
-  if (0 != rc) {
-    ROBIMS_ERROR("Failed to write table size to file:{} to save robims db", file);
+  checkpoint_dir_ = dir;
+  checkpoint_lsn_ = lsn;
+  if (wal_) {
+    return wal_->Truncate();
+  }
+  return 0;
+}
+int RobimsDBImpl::SaveTable(const std::string& file, const std::string& table, bool readonly) {
+  std::shared_ptr<RobimsDBData> db = db_data_.load();
+  auto found = db->tables.find(table);
+  if (found == db->tables.end()) {
+    ROBIMS_ERROR("Table:{} not found while tables:{}", table, db->tables.size());
     return -1;
   }
-  for (auto& pair : db->tables) {
-    auto table = pair.second.load();
-    int rc = table->Save(fp, readonly);
+  auto table_obj = found->second.load();
+  DBHeader header;
+  header.set_version(1);
+  header.set_readonly(readonly);
+  header.set_whole_db(false);
+  header.add_partial_tables(table);
+  std::string header_bin = header.SerializeAsString();
+  // the target may be mmaped by a loaded image, never truncate it in place.
+  return file_atomic_write(file, [&](FILE* fp) {
+    int rc = file_write_string(fp, header_bin);
     if (0 != rc) {
-      fclose(fp);
-      return rc;
+      ROBIMS_ERROR("Failed to write save db header to file:{}", file);
+      return -1;
     }
+    return table_obj->Save(fp, readonly);
+  });
+}
+int RobimsDBImpl::Save(const std::string& file, bool readonly) {
+  std::shared_ptr<RobimsDBData> db = db_data_.load();
+  DBHeader header;
+  header.set_version(1);
+  header.set_readonly(readonly);
+  header.set_whole_db(true);
+  header.set_id_mapping_type(db->id_mapping_type);
+  if (wal_) {
+    header.set_wal_lsn(wal_->LastLSN());
   }
-  rc = db->id_mapping->Save(fp, readonly);
-  fclose(fp);
-  return rc;
+  std::string header_bin = header.SerializeAsString();
+  // the target may be mmaped by a loaded image, never truncate it in place.
+  return file_atomic_write(file, [&](FILE* fp) {
+    int rc = file_write_string(fp, header_bin);
+    if (0 != rc) {
+      ROBIMS_ERROR("Failed to write save db header to file:{}", file);
+      return -1;
+    }
+    uint32_t table_size = db->tables.size();
+    rc = file_write_uint32(fp, table_size);
+    if (0 != rc) {
+      ROBIMS_ERROR("Failed to write table size to file:{} to save robims db", file);
+      return -1;
+    }
+    for (auto& pair : db->tables) {
+      auto table = pair.second.load();
+      rc = table->Save(fp, readonly);
+      if (0 != rc) {
+        return rc;
+      }
+    }
+    return db->id_mapping->Save(fp, readonly);
+  });
 }
 
 void RobimsDBImpl::GetRealIDs(const std::vector<uint32_t>& local_ids,
@@ -269,27 +513,160 @@ RobimsTable* RobimsDBImpl::GetTable(const std::string& table) {
   return found->second.load().get();
 }
 int RobimsDBImpl::Put(const std::string& table, const std::string& json) {
-  folly::SharedMutex::WriteHolder lock(shared_mutex_);
-  std::shared_ptr<RobimsDBData> db = db_data_.load();
-  auto found = db->tables.find(table);
-  if (found == db->tables.end()) {
-    ROBIMS_ERROR("Table:{} not found while tables:{}", table, db->tables.size());
-    return -1;
+  MaybeSweepCursors();
+  uint64_t lsn = 0;
+  int rc = 0;
+  {
+    folly::SharedMutex::WriteHolder lock(shared_mutex_);
+    std::shared_ptr<RobimsDBData> db = db_data_.load();
+    auto found = db->tables.find(table);
+    if (found == db->tables.end()) {
+      ROBIMS_ERROR("Table:{} not found while tables:{}", table, db->tables.size());
+      return -1;
+    }
+    if (wal_) {
+      lsn = wal_->Append(WAL_OP_PUT, table, json);
+    }
+    id_mapping_dirty_ = true;
+    rc = found->second.load()->Put(json);
+  }
+  // wait wal write outside of db lock, so that concurrent writers commit as one group
+  if (lsn > 0 && 0 != wal_->Commit(lsn)) {
+    ROBIMS_ERROR("Failed to commit wal record:{}", lsn);
+    return ROBIMS_ERR_IO;
   }
-  return found->second.load()->Put(json);
+  return rc;
 }
 int RobimsDBImpl::Remove(const std::string& table, const std::string& json) {
-  folly::SharedMutex::WriteHolder lock(shared_mutex_);
-  std::shared_ptr<RobimsDBData> db = db_data_.load();
-  auto found = db->tables.find(table);
-  if (found == db->tables.end()) {
-    ROBIMS_ERROR("Table {} not found", table);
+  MaybeSweepCursors();
+  uint64_t lsn = 0;
+  int rc = 0;
+  {
+    folly::SharedMutex::WriteHolder lock(shared_mutex_);
+    std::shared_ptr<RobimsDBData> db = db_data_.load();
+    auto found = db->tables.find(table);
+    if (found == db->tables.end()) {
+      ROBIMS_ERROR("Table {} not found", table);
+      return -1;
+    }
+    if (wal_) {
+      lsn = wal_->Append(WAL_OP_REMOVE, table, json);
+    }
+    rc = found->second.load()->Remove(json);
+  }
+  if (lsn > 0 && 0 != wal_->Commit(lsn)) {
+    ROBIMS_ERROR("Failed to commit wal record:{}", lsn);
+    return ROBIMS_ERR_IO;
+  }
+  return rc;
+}
+RobimsQueryValue RobimsDBImpl::ExecuteQuery(RobimsDBData* db, RobimsQuery* query) {
+  ParallelQueryExecutorPtr executor = query_executor_.load();
+  if (!executor || !query->IsParallelizable()) {
+    return query->Execute(this);
+  }
+  // local ids are allocated from 0, so the max id of all tables bounds the containers to scan.
+  uint32_t max_id = 0;
+  for (auto& pair : db->tables) {
+    std::shared_ptr<RobimsTable> table = pair.second.load();
+    const roaring_bitmap_t* table_bitmap = table->GetTableBitmap().bitmap.get();
+    if (!roaring_bitmap_is_empty(table_bitmap)) {
+      max_id = std::max(max_id, roaring_bitmap_maximum(table_bitmap));
+    }
+  }
+  uint32_t containers = (max_id >> 16) + 1;
+  if (containers < executor->min_containers) {
+    return query->Execute(this);
+  }
+  uint32_t tasks = std::min(containers, executor->threads);
+  std::vector<CRoaringBitmapPtr> ranges(tasks);
+  std::vector<RobimsQueryValue> vals(tasks);
+  for (uint32_t i = 0; i < tasks; i++) {
+    uint64_t begin = (uint64_t)(containers * (uint64_t)i / tasks) << 16;
+    uint64_t end = (uint64_t)(containers * (uint64_t)(i + 1) / tasks) << 16;
+    ranges[i].reset(roaring_bitmap_from_range(begin, end, 1));
+  }
+  folly::Latch latch(tasks - 1);
+  for (uint32_t i = 1; i < tasks; i++) {
+    executor->executor->add([&, i]() {
+      vals[i] = query->Execute(this, ranges[i].get());
+      latch.count_down();
+    });
+  }
+  vals[0] = query->Execute(this, ranges[0].get());
+  latch.wait();
+
+  // id ranges are disjoint and ordered, merging them only appends containers.
+  CRoaringBitmapPtr* result = std::get_if<CRoaringBitmapPtr>(&vals[0]);
+  if (nullptr == result) {
+    return std::move(vals[0]);
+  }
+  for (uint32_t i = 1; i < tasks; i++) {
+    CRoaringBitmapPtr* bitmap = std::get_if<CRoaringBitmapPtr>(&vals[i]);
+    if (nullptr == bitmap) {
+      return std::move(vals[i]);
+    }
+    roaring_bitmap_or_inplace(result->get(), bitmap->get());
+  }
+  return std::move(vals[0]);
+}
+int RobimsDBImpl::ExecuteSelect(RobimsDBData* db, const std::string& query, SelectResult& result,
+                                QueryResultPtr& query_result) {
+  folly::fbstring cache_key = normalize_query(query);
+  RobimsQueryPtr query_obj;
+  if (!db->query_cache.Get(cache_key, query_obj)) {
+    query_obj.reset(new RobimsQuery);
+    int rc = query_obj->Init(this, query);
+    if (0 != rc) {
+      ROBIMS_ERROR("Parse query:{} faield with code:{}", query, rc);
+      return -1;
+    }
+    db->query_cache.Set(cache_key, query_obj);
+  }
+  // cached result is valid only if all tables referenced by query have not been written since.
+  std::vector<uint64_t> table_versions;
+  if (result_cache_capacity_ > 0) {
+    query_obj->GetTableVersions(table_versions);
+    if (db->result_cache.Get(query_obj->GetNormalizedKey(), query_result)) {
+      if (query_result->table_versions == table_versions) {
+        return 0;
+      }
+      query_result.reset();
+    }
+  }
+  RobimsQueryValue val = ExecuteQuery(db, query_obj.get());
+  AggregateResultPtr* aggregation = std::get_if<AggregateResultPtr>(&val);
+  if (nullptr != aggregation) {
+    result.total = (*aggregation)->total;
+    result.buckets = std::move((*aggregation)->buckets);
+    return 0;
+  }
+  CRoaringBitmapPtr* bitmap = std::get_if<CRoaringBitmapPtr>(&val);
+  if (nullptr == bitmap) {
+    switch (val.index()) {
+      case 0: {
+        RobimsQueryError err = std::get<RobimsQueryError>(val);
+        ROBIMS_ERROR("Query execute result:{}/{}", err.code, err.reason);
+        break;
+      }
+      default: {
+        ROBIMS_ERROR("Query execute result value index:{}", val.index());
+        break;
+      }
+    }
     return -1;
   }
-  return found->second.load()->Remove(json);
+  query_result = std::make_shared<QueryResult>();
+  query_result->table_versions = std::move(table_versions);
+  query_result->bitmap = std::move(*bitmap);
+  if (result_cache_capacity_ > 0) {
+    db->result_cache.Set(query_obj->GetNormalizedKey(), query_result);
+  }
+  return 0;
 }
 int RobimsDBImpl::Select(const std::string& query, int64_t offset, int64_t limit,
                          SelectResult& result) {
+  MaybeSweepCursors();
   if (limit <= 0) {
     limit = 100;
   }
@@ -298,80 +675,194 @@ int RobimsDBImpl::Select(const std::string& query, int64_t offset, int64_t limit
   }
   result.ids.clear();
   result.total = 0;
+  result.buckets.clear();
   folly::SharedMutex::ReadHolder lock(shared_mutex_);
   std::shared_ptr<RobimsDBData> db = db_data_.load();
-  RobimsQueryPtr query_obj;
-  {
-    std::lock_guard<std::mutex> guard(db->query_cache_mutex);
-    auto found = db->query_cache.find(query);
-    if (found != db->query_cache.end()) {
-      query_obj = found->second;
-    } else {
-      query_obj.reset(new RobimsQuery);
-      int rc = query_obj->Init(this, query);
-      if (0 != rc) {
-        ROBIMS_ERROR("Parse query:{} faield with code:{}", query, rc);
-        return -1;
-      }
-      db->query_cache.insert(query, query_obj);
-    }
+  QueryResultPtr query_result;
+  int rc = ExecuteSelect(db.get(), query, result, query_result);
+  if (0 != rc || !query_result) {
+    return rc;
+  }
+  const roaring_bitmap_t* result_bitmap = query_result->bitmap.get();
+  result.total = roaring_bitmap_get_cardinality(result_bitmap);
+  std::vector<uint32_t> local_ids;
+  local_ids.resize(limit);
+  // if (offset > 0) {
+  //   uint32_t element;
+  //   if (!roaring_bitmap_select(result_bitmap, offset, &element)) {
+  //     //ROBIMS_ERROR("Failed to select {} from bitmap while card:{}", offset, result.total);
+  //     return 0;
+  //   }
+  // }
+  // ROBIMS_ERROR("Range bitmap from:{}", offset);
+  if (!roaring_bitmap_range_uint32_array(result_bitmap, offset, limit, &local_ids[0])) {
+    ROBIMS_ERROR("Failed to extract ids");
+    return -1;
   }
-  RobimsQueryValue val = query_obj->Execute(this);
-  CRoaringBitmapPtr* bitmap = std::get_if<CRoaringBitmapPtr>(&val);
-  if (nullptr != bitmap) {
-    result.total = roaring_bitmap_get_cardinality(bitmap->get());
-    std::vector<uint32_t> local_ids;
-    local_ids.resize(limit);
-    // if (offset > 0) {
-    //   uint32_t element;
-    //   if (!roaring_bitmap_select(bitmap->get(), offset, &element)) {
-    //     //ROBIMS_ERROR("Failed to select {} from bitmap while card:{}", offset, result.total);
-    //     return 0;
-    //   }
-    // }
-    // ROBIMS_ERROR("Range bitmap from:{}", offset);
-    if (!roaring_bitmap_range_uint32_array(bitmap->get(), offset, limit, &local_ids[0])) {
-      ROBIMS_ERROR("Failed to extract ids");
-      return -1;
-    }
 
-    for (size_t i = 0; i < local_ids.size(); i++) {
-      if (0 == local_ids[i]) {
-        if (i > 0) {
-          break;
-        }
-        if (offset > 0) {
-          break;
-        }
-        if (!roaring_bitmap_contains(bitmap->get(), 0)) {
-          break;
-        }
-      }
-      std::string id;
-      std::string_view id_view;
-      if (0 == db->id_mapping->GetID(local_ids[i], id_view)) {
-        id.assign(id_view.data(), id_view.size());
-        result.ids.emplace_back(std::move(id));
-      } else {
-        result.ids.push_back(id);
+  for (size_t i = 0; i < local_ids.size(); i++) {
+    if (0 == local_ids[i]) {
+      if (i > 0) {
+        break;
       }
-      // result.offset = local_ids[i];
-    }
-    return 0;
-  } else {
-    switch (val.index()) {
-      case 0: {
-        RobimsQueryError err = std::get<RobimsQueryError>(val);
-        ROBIMS_ERROR("Query execute result:{}/{}", err.code, err.reason);
+      if (offset > 0) {
         break;
       }
-      default: {
-        ROBIMS_ERROR("Query execute result value index:{}", val.index());
+      if (!roaring_bitmap_contains(result_bitmap, 0)) {
         break;
       }
     }
+    std::string id;
+    std::string_view id_view;
+    if (0 == db->id_mapping->GetID(local_ids[i], id_view)) {
+      id.assign(id_view.data(), id_view.size());
+      result.ids.emplace_back(std::move(id));
+    } else {
+      result.ids.push_back(id);
+    }
+    // result.offset = local_ids[i];
+  }
+  return 0;
+}
+
+static const uint32_t kVisitBatchSize = 256;
+// read at most 'limit'(negative for all) ids from 'iter' in batches, returns visited count or -1
+// if stopped by visitor.
+static int64_t visit_ids(IDMapping* id_mapping, roaring_uint32_iterator_t* iter, int64_t limit,
+                         const SelectVisitor& visitor) {
+  uint32_t local_ids[kVisitBatchSize];
+  int64_t count = 0;
+  while (iter->has_value && (limit < 0 || count < limit)) {
+    uint32_t batch = kVisitBatchSize;
+    if (limit >= 0 && limit - count < batch) {
+      batch = limit - count;
+    }
+    uint32_t n = roaring_read_uint32_iterator(iter, local_ids, batch);
+    for (uint32_t i = 0; i < n; i++) {
+      std::string_view id;
+      id_mapping->GetID(local_ids[i], id);
+      if (!visitor(id)) {
+        return -1;
+      }
+    }
+    count += n;
+    if (0 == n) {
+      break;
+    }
+  }
+  return count;
+}
+int RobimsDBImpl::SelectStream(const std::string& query, const SelectVisitor& visitor,
+                               int64_t* total) {
+  MaybeSweepCursors();
+  SelectResult result;
+  folly::SharedMutex::ReadHolder lock(shared_mutex_);
+  std::shared_ptr<RobimsDBData> db = db_data_.load();
+  QueryResultPtr query_result;
+  int rc = ExecuteSelect(db.get(), query, result, query_result);
+  if (0 != rc) {
+    return rc;
+  }
+  if (!query_result) {
+    ROBIMS_ERROR("Aggregation query:{} can NOT be streamed", query);
+    return ROBIMS_ERR_INVALID_ARGS;
+  }
+  if (nullptr != total) {
+    *total = roaring_bitmap_get_cardinality(query_result->bitmap.get());
   }
-  return -1;
+  roaring_uint32_iterator_t iter;
+  roaring_init_iterator(query_result->bitmap.get(), &iter);
+  visit_ids(db->id_mapping, &iter, -1, visitor);
+  return 0;
+}
+int RobimsDBImpl::OpenCursor(const std::string& query, uint32_t ttl_ms, uint64_t& cursor,
+                             SelectResult& result) {
+  result.ids.clear();
+  result.total = 0;
+  result.buckets.clear();
+  SelectCursorPtr new_cursor = std::make_shared<SelectCursor>();
+  {
+    folly::SharedMutex::ReadHolder lock(shared_mutex_);
+    new_cursor->db = db_data_.load();
+    int rc = ExecuteSelect(new_cursor->db.get(), query, result, new_cursor->result);
+    if (0 != rc) {
+      return rc;
+    }
+  }
+  if (!new_cursor->result) {
+    ROBIMS_ERROR("Aggregation query:{} can NOT be opened as cursor", query);
+    return ROBIMS_ERR_INVALID_ARGS;
+  }
+  result.total = roaring_bitmap_get_cardinality(new_cursor->result->bitmap.get());
+  roaring_init_iterator(new_cursor->result->bitmap.get(), &new_cursor->iter);
+  new_cursor->ttl_ms = ttl_ms;
+  int64_t now = cursor_now_ms();
+  new_cursor->expire_ms = now + ttl_ms;
+  std::lock_guard<std::mutex> guard(cursor_mutex_);
+  SweepExpiredCursors(now);
+  cursor = ++cursor_seed_;
+  cursors_[cursor] = new_cursor;
+  return 0;
+}
+void RobimsDBImpl::SweepExpiredCursors(int64_t now) {
+  for (auto it = cursors_.begin(); it != cursors_.end();) {
+    if (it->second->expire_ms < now) {
+      it = cursors_.erase(it);
+    } else {
+      it++;
+    }
+  }
+  next_cursor_sweep_ms_.store(now + kCursorSweepIntervalMs, std::memory_order_relaxed);
+}
+void RobimsDBImpl::MaybeSweepCursors() {
+  int64_t next = next_cursor_sweep_ms_.load(std::memory_order_relaxed);
+  int64_t now = cursor_now_ms();
+  if (now < next) {
+    return;
+  }
+  // only one caller sweeps per interval
+  if (!next_cursor_sweep_ms_.compare_exchange_strong(next, now + kCursorSweepIntervalMs)) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(cursor_mutex_);
+  SweepExpiredCursors(now);
+}
+SelectCursorPtr RobimsDBImpl::GetCursor(uint64_t cursor) {
+  std::lock_guard<std::mutex> guard(cursor_mutex_);
+  auto found = cursors_.find(cursor);
+  if (found == cursors_.end()) {
+    return nullptr;
+  }
+  int64_t now = cursor_now_ms();
+  if (found->second->expire_ms < now) {
+    cursors_.erase(found);
+    return nullptr;
+  }
+  found->second->expire_ms = now + found->second->ttl_ms;
+  return found->second;
+}
+int RobimsDBImpl::FetchCursor(uint64_t cursor, int64_t limit, const SelectVisitor& visitor) {
+  if (limit <= 0) {
+    limit = 100;
+  }
+  SelectCursorPtr select_cursor = GetCursor(cursor);
+  if (!select_cursor) {
+    ROBIMS_ERROR("Cursor:{} not found or expired", cursor);
+    return ROBIMS_ERR_NOTFOUND;
+  }
+  // ids are resolved with the pinned id mapping, which is only appended by writers
+  folly::SharedMutex::ReadHolder lock(shared_mutex_);
+  std::lock_guard<std::mutex> guard(select_cursor->mutex);
+  visit_ids(select_cursor->db->id_mapping, &select_cursor->iter, limit, visitor);
+  return 0;
+}
+int RobimsDBImpl::CloseCursor(uint64_t cursor) {
+  std::lock_guard<std::mutex> guard(cursor_mutex_);
+  return cursors_.erase(cursor) > 0 ? 0 : ROBIMS_ERR_NOTFOUND;
+}
+size_t RobimsDBImpl::GetCursorCount() {
+  std::lock_guard<std::mutex> guard(cursor_mutex_);
+  return cursors_.size();
 }
 
 }  // namespace robims
@@ -28,6 +28,7 @@
  */
 
 #pragma once
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <string_view>
@@ -39,19 +40,48 @@
 #include "folly/concurrency/AtomicSharedPtr.h"
 #include "folly/container/EvictingCacheMap.h"
 #include "folly/container/F14Map.h"
+#include "folly/executors/CPUThreadPoolExecutor.h"
 #include "robims_db.h"
 #include "robims_query.h"
+#include "robims_query_cache.h"
 #include "robims_table.h"
+#include "robims_wal.h"
 
 namespace robims {
 typedef std::shared_ptr<RobimsQuery> RobimsQueryPtr;
 typedef folly::atomic_shared_ptr<RobimsTable> RobimsTablePtr;
+struct QueryResult {
+  std::vector<uint64_t> table_versions;
+  CRoaringBitmapPtr bitmap;
+};
+typedef std::shared_ptr<QueryResult> QueryResultPtr;
+// executor of parallel select queries, replaced as a whole so that a running query keeps the one
+// it started with.
+struct ParallelQueryExecutor {
+  std::unique_ptr<folly::CPUThreadPoolExecutor> executor;
+  uint32_t threads = 0;
+  uint32_t min_containers = 0;
+};
+typedef std::shared_ptr<ParallelQueryExecutor> ParallelQueryExecutorPtr;
+struct RobimsDBData;
+struct SelectCursor {
+  std::mutex mutex;
+  // pin the db data, so that ids are resolved with the id mapping which the result is built on.
+  std::shared_ptr<RobimsDBData> db;
+  QueryResultPtr result;
+  roaring_uint32_iterator_t iter;
+  uint32_t ttl_ms = 0;
+  int64_t expire_ms = 0;
+};
+typedef std::shared_ptr<SelectCursor> SelectCursorPtr;
 struct RobimsDBData {
+  IDMappingType id_mapping_type;
   IDMapping* id_mapping;
   folly::F14NodeMap<std::string_view, RobimsTablePtr> tables;
-  folly::EvictingCacheMap<folly::fbstring, RobimsQueryPtr> query_cache;
-  std::mutex query_cache_mutex;
-  RobimsDBData();
+  // parsed queries keyed by normalized query text, results keyed by normalized query ast
+  ShardedEvictingCache<RobimsQueryPtr> query_cache;
+  ShardedEvictingCache<QueryResultPtr> result_cache;
+  explicit RobimsDBData(IDMappingType type);
   ~RobimsDBData();
 };
 class RobimsDBImpl {
@@ -64,22 +94,58 @@ class RobimsDBImpl {
   // folly::EvictingCacheMap<folly::fbstring, RobimsQuery> query_table_;
   RobimsDBDataPtr db_data_;
   folly::SharedMutex* shared_mutex_;
+  folly::atomic_shared_ptr<ParallelQueryExecutor> query_executor_;
+  size_t result_cache_capacity_ = 0;
+  std::unique_ptr<RobimsWAL> wal_;
+  // last wal record included in loaded/checkpointed data
+  uint64_t checkpoint_lsn_ = 0;
+  std::string checkpoint_dir_;
+  bool id_mapping_dirty_ = false;
+  std::mutex checkpoint_mutex_;
+  std::mutex cursor_mutex_;
+  folly::F14FastMap<uint64_t, SelectCursorPtr> cursors_;
+  uint64_t cursor_seed_ = 0;
+  // earliest time of next expired cursor sweep, checked by selects and writes
+  std::atomic<int64_t> next_cursor_sweep_ms_{0};
 
   void GetRealIDs(const std::vector<uint32_t>& local_ids, std::vector<std::string>& ids);
   std::shared_ptr<RobimsTable> CreateTableInstance(const TableSchema& schema);
+  RobimsQueryValue ExecuteQuery(RobimsDBData* db, RobimsQuery* query);
+  // 'query_result' is empty if 'query' is an aggregation query, which is filled into 'result'.
+  int ExecuteSelect(RobimsDBData* db, const std::string& query, SelectResult& result,
+                    QueryResultPtr& query_result);
+  SelectCursorPtr GetCursor(uint64_t cursor);
+  // caller must hold 'cursor_mutex_'
+  void SweepExpiredCursors(int64_t now);
+  // sweep at most once per interval, so that idle cursors release pinned db data even if no cursor
+  // is opened or fetched later.
+  void MaybeSweepCursors();
+  int LoadCheckpoint(const std::string& dir);
+  int ReplayWAL();
 
  public:
-  RobimsDBImpl();
+  explicit RobimsDBImpl(IDMappingType id_mapping_type);
   void DisableThreadSafe();
   void EnableThreadSafe();
+  void EnableParallelQuery(uint32_t threads, uint32_t min_containers);
+  void DisableParallelQuery();
+  void EnableResultCache(size_t capacity);
+  void DisableResultCache();
   int Load(const std::string& file);
   int Save(const std::string& file, bool readonly);
+  int EnableWAL(const std::string& wal_file, const WALOptions& options);
+  int Checkpoint(const std::string& dir);
   int SaveTable(const std::string& file, const std::string& table, bool readonly);
   int CreateTable(const std::string& schema);
   int CreateTable(const TableSchema& schema);
   int Put(const std::string& table, const std::string& json);
   int Remove(const std::string& table, const std::string& json);
   int Select(const std::string& query, int64_t offset, int64_t limit, SelectResult& result);
+  int SelectStream(const std::string& query, const SelectVisitor& visitor, int64_t* total);
+  int OpenCursor(const std::string& query, uint32_t ttl_ms, uint64_t& cursor, SelectResult& result);
+  int FetchCursor(uint64_t cursor, int64_t limit, const SelectVisitor& visitor);
+  int CloseCursor(uint64_t cursor);
+  size_t GetCursorCount();
   RobimsTable* GetTable(const std::string& name);
   ~RobimsDBImpl();
 };
@@ -34,6 +34,7 @@
 #define ROBIMS_ERR_NOTFOUND -10001
 #define ROBIMS_ERR_INVALID_ARGS -10002
 #define ROBIMS_ERR_INVALID_OPERATOR -10003
+#define ROBIMS_ERR_IO -10004
 
 #define ROBIMS_QUERY_ERR_INVALID_OPERATOR -20000
 #define ROBIMS_QUERY_ERR_INVALID_FIELD_ARGS -20001
@@ -41,4 +42,7 @@
 #define ROBIMS_QUERY_ERR_INVALID_FIELD_NAME -20003
 #define ROBIMS_QUERY_ERR_EMPTY_FIELD_INSTANCE -20004
 #define ROBIMS_QUERY_ERR_INVALID_OPERAND -20005
-#define ROBIMS_QUERY_ERR_NIL_INTERPRETER -20006
\ No newline at end of file
+#define ROBIMS_QUERY_ERR_NIL_INTERPRETER -20006
+#define ROBIMS_QUERY_ERR_INVALID_FUNCTION -20007
+#define ROBIMS_QUERY_ERR_INVALID_FUNCTION_ARGS -20008
+#define ROBIMS_QUERY_ERR_INVALID_FILTER_EXPR -20009
\ No newline at end of file
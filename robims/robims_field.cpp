@@ -40,6 +40,10 @@
 #include "robims_log.h"
 #include "robims_table.h"
 namespace robims {
+void sort_buckets_by_count(AggregateBuckets& buckets) {
+  std::sort(buckets.begin(), buckets.end(),
+            [](const AggregateBucket& x, const AggregateBucket& y) { return x.count > y.count; });
+}
 
 int RobimsField::Put(uint32_t id, const std::string_view& val) {
   ROBIMS_ERROR("Unimplemented!");
@@ -53,6 +57,10 @@ int RobimsField::Put(uint32_t id, float val) {
   ROBIMS_ERROR("Unimplemented!");
   return ROBIMS_ERR_UNIMPLEMENTED;
 }
+int RobimsField::Put(uint32_t id, double val) {
+  ROBIMS_ERROR("Unimplemented!");
+  return ROBIMS_ERR_UNIMPLEMENTED;
+}
 int RobimsField::Put(uint32_t id) {
   ROBIMS_ERROR("Unimplemented!");
   return ROBIMS_ERR_UNIMPLEMENTED;
@@ -65,7 +73,20 @@ int RobimsField::Remove(uint32_t id) {
   ROBIMS_ERROR("Unimplemented!");
   return ROBIMS_ERR_UNIMPLEMENTED;
 }
-int RobimsField::Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& out) {
+int RobimsField::Select(FieldOperator op, FieldArg arg, const roaring_bitmap_t* range,
+                        CRoaringBitmapPtr& out) {
+  ROBIMS_ERROR("Unimplemented!");
+  return ROBIMS_ERR_UNIMPLEMENTED;
+}
+int RobimsField::CountBy(const roaring_bitmap_t* filter, AggregateBuckets& buckets) {
+  ROBIMS_ERROR("Unimplemented!");
+  return ROBIMS_ERR_UNIMPLEMENTED;
+}
+int RobimsField::Sum(const roaring_bitmap_t* filter, AggregateBucket& bucket) {
+  ROBIMS_ERROR("Unimplemented!");
+  return ROBIMS_ERR_UNIMPLEMENTED;
+}
+int RobimsField::Histogram(const roaring_bitmap_t* filter, uint32_t n, AggregateBuckets& buckets) {
   ROBIMS_ERROR("Unimplemented!");
   return ROBIMS_ERR_UNIMPLEMENTED;
 }
@@ -144,6 +165,12 @@ RobimsField* RobimsFieldBuilder::Build(RobimsTable* table, const FieldMeta& meta
       field = new RobimsFloatField;
       break;
     }
+    case INT_COLUMN:
+    case FLOAT_COLUMN:
+    case STRING_COLUMN: {
+      field = new RobimsColumnField;
+      break;
+    }
     default: {
       break;
     }
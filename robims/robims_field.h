@@ -47,6 +47,12 @@ namespace robims {
 typedef std::variant<std::string_view, int64_t, double> FieldArg;
 typedef std::pair<uint32_t, float> IDWeight;
 
+// sort aggregation buckets by count in descending order
+void sort_buckets_by_count(AggregateBuckets& buckets);
+inline bool is_column_field(FieldIndexType type) {
+  return INT_COLUMN == type || FLOAT_COLUMN == type || STRING_COLUMN == type;
+}
+
 class RobimsTable;
 class RobimsField {
  protected:
@@ -56,6 +62,8 @@ class RobimsField {
   FieldMeta _meta;
 
   RobimsTable* _table = nullptr;
+  // changed after last checkpoint
+  bool _dirty = false;
 
   virtual int OnInit() = 0;
 
@@ -63,6 +71,10 @@ class RobimsField {
   RobimsField() = default;
   int Init(RobimsTable* table, const FieldMeta& meta);
   const FieldMeta& GetFieldMeta() { return _meta; }
+  RobimsTable* GetTable() { return _table; }
+  void MarkDirty() { _dirty = true; }
+  bool IsDirty() const { return _dirty; }
+  void ClearDirty() { _dirty = false; }
   int Save(FILE* fp, bool readonly);
   int Load(FILE* fp);
   virtual int DoLoad(FILE* fp);
@@ -70,10 +82,17 @@ class RobimsField {
   virtual int Put(uint32_t id, const std::string_view& val);
   virtual int Put(uint32_t id, int64_t val);
   virtual int Put(uint32_t id, float val);
+  virtual int Put(uint32_t id, double val);
   virtual int Put(uint32_t id);
   virtual int Put(uint32_t id, const std::string_view& val, float weight);
+  // return non zero if the field holds no value of 'id'.
   virtual int Remove(uint32_t id);
-  virtual int Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& out);
+  // only ids inside 'range' are selected if it's not null, used by parallel query.
+  virtual int Select(FieldOperator op, FieldArg arg, const roaring_bitmap_t* range,
+                     CRoaringBitmapPtr& out);
+  virtual int CountBy(const roaring_bitmap_t* filter, AggregateBuckets& buckets);
+  virtual int Sum(const roaring_bitmap_t* filter, AggregateBucket& bucket);
+  virtual int Histogram(const roaring_bitmap_t* filter, uint32_t n, AggregateBuckets& buckets);
 
   virtual ~RobimsField() {}
 };
@@ -86,7 +105,9 @@ class RobimsBoolField : public RobimsField {
   int DoLoad(FILE* fp) override;
   int Put(uint32_t id, int64_t val) override;
   int Remove(uint32_t id) override;
-  int Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& out) override;
+  int Select(FieldOperator op, FieldArg arg, const roaring_bitmap_t* range,
+             CRoaringBitmapPtr& out) override;
+  int CountBy(const roaring_bitmap_t* filter, AggregateBuckets& buckets) override;
 };
 
 class RobimsIntField : public RobimsField {
@@ -97,7 +118,10 @@ class RobimsIntField : public RobimsField {
   int DoLoad(FILE* fp) override;
   int Put(uint32_t id, int64_t val) override;
   int Remove(uint32_t id) override;
-  int Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& out) override;
+  int Select(FieldOperator op, FieldArg arg, const roaring_bitmap_t* range,
+             CRoaringBitmapPtr& out) override;
+  int Sum(const roaring_bitmap_t* filter, AggregateBucket& bucket) override;
+  int Histogram(const roaring_bitmap_t* filter, uint32_t n, AggregateBuckets& buckets) override;
 };
 class RobimsFloatField : public RobimsField {
  private:
@@ -107,7 +131,10 @@ class RobimsFloatField : public RobimsField {
   int DoLoad(FILE* fp) override;
   int Put(uint32_t id, float val) override;
   int Remove(uint32_t id) override;
-  int Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& out) override;
+  int Select(FieldOperator op, FieldArg arg, const roaring_bitmap_t* range,
+             CRoaringBitmapPtr& out) override;
+  int Sum(const roaring_bitmap_t* filter, AggregateBucket& bucket) override;
+  int Histogram(const roaring_bitmap_t* filter, uint32_t n, AggregateBuckets& buckets) override;
 };
 
 struct NamedRoaringBitmap {
@@ -124,13 +151,22 @@ class RobimsSetField : public RobimsField {
   int DoLoad(FILE* fp) override;
   int Put(uint32_t id, const std::string_view& val) override;
   int Remove(uint32_t id) override;
-  int Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& out) override;
+  int Select(FieldOperator op, FieldArg arg, const roaring_bitmap_t* range,
+             CRoaringBitmapPtr& out) override;
+  int CountBy(const roaring_bitmap_t* filter, AggregateBuckets& buckets) override;
 };
 
+// weights are quantized into 16 bits(order preserving high bits of 'float_to_uint32'), entries
+// of a tag are kept in contiguous arrays sorted by (weight, id) desc, entries put after load are
+// kept in 'overlay' until the tag is compacted. base entries are valid only if the reverse index
+// still holds the same weight for (id, tag).
 struct NamedWeightRoaringBitmap {
   std::string name;
-  absl::btree_set<uint64_t, std::greater<uint64_t>> weight_ids;
-  absl::btree_map<uint32_t, float> id_weights;
+  uint32_t idx = 0;
+  uint32_t count = 0;
+  std::vector<uint32_t> base_ids;
+  std::vector<uint16_t> base_weights;
+  absl::btree_set<uint64_t, std::greater<uint64_t>> overlay;
   RoaringBitmap bitmap;
 };
 
@@ -138,17 +174,67 @@ typedef std::unique_ptr<NamedWeightRoaringBitmap> NamedWeightRoaringBitmapPtr;
 
 class RobimsWeightSetField : public RobimsField {
  private:
+  struct TagWeight {
+    uint32_t tag;
+    uint16_t weight;
+  };
+  typedef std::vector<TagWeight> TagWeights;
   typedef folly::F14FastMap<std::string_view, NamedWeightRoaringBitmapPtr>
       NamedWeightRoaringBitmapTable;
   NamedWeightRoaringBitmapTable _bitmaps;
+  std::vector<NamedWeightRoaringBitmap*> _tags;
+  // id -> tags reverse index, built as csr arrays while loading, ids changed after load are
+  // shadowed by '_id_tags_overlay'.
+  std::vector<uint32_t> _id_tag_offsets;
+  std::vector<uint32_t> _id_tag_tags;
+  std::vector<uint16_t> _id_tag_weights;
+  folly::F14FastMap<uint32_t, TagWeights> _id_tags_overlay;
+
   int DoSave(FILE* fp, bool readonly) override;
   int DoLoad(FILE* fp) override;
 
   int OnInit() override;
   int Put(uint32_t id, const std::string_view& val, float weight) override;
   int Remove(uint32_t id) override;
-  int Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& out) override;
+  int Select(FieldOperator op, FieldArg arg, const roaring_bitmap_t* range,
+             CRoaringBitmapPtr& out) override;
+  int CountBy(const roaring_bitmap_t* filter, AggregateBuckets& buckets) override;
   // int Visit(const roaring_bitmap_t* b, const VisitOptions& options) override;
+
+  TagWeights* MutableIDTags(uint32_t id);
+  bool GetTagWeight(uint32_t id, uint32_t tag, uint16_t& weight);
+  bool IsBaseEntryValid(NamedWeightRoaringBitmap* tag, size_t idx);
+  bool BaseContains(NamedWeightRoaringBitmap* tag, uint16_t weight, uint32_t id);
+  void EvictMin(NamedWeightRoaringBitmap* tag);
+  void CompactTag(NamedWeightRoaringBitmap* tag);
+  void BuildReverseIndex();
+  int LoadLegacyEntries(FILE* fp, uint32_t count, NamedWeightRoaringBitmap* tag);
+};
+
+// non-indexed attribute stored as a column addressed by local id, the column always covers all ids
+// put into the table(missing value is 0/empty). values are only read by 'filter' predicates.
+class RobimsColumnField : public RobimsField {
+ private:
+  std::vector<int64_t> _ints;
+  std::vector<double> _floats;
+  std::vector<std::string> _strings;
+  // address of the active column's first value, jit code reads it through 'GetDataAddress'
+  // since the column may be reallocated by later writes.
+  const void* _data = nullptr;
+  size_t _size = 0;
+
+  void Resize(uint32_t id);
+  int OnInit() override;
+  int DoSave(FILE* fp, bool readonly) override;
+  int DoLoad(FILE* fp) override;
+  int Put(uint32_t id, const std::string_view& val) override;
+  int Put(uint32_t id, int64_t val) override;
+  int Put(uint32_t id, double val) override;
+  int Remove(uint32_t id) override;
+
+ public:
+  size_t Size() const { return _size; }
+  const void* const* GetDataAddress() const { return &_data; }
 };
 
 class RobimsFieldBuilder {
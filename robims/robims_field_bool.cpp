@@ -47,15 +47,23 @@ int RobimsBoolField::Put(uint32_t id, int64_t val) {
   }
   return 0;
 }
-int RobimsBoolField::Remove(uint32_t id) {
-  _bitmap.Remove(id);
+int RobimsBoolField::Remove(uint32_t id) { return _bitmap.Remove(id) ? 0 : -1; }
+int RobimsBoolField::CountBy(const roaring_bitmap_t* filter, AggregateBuckets& buckets) {
+  uint64_t total = roaring_bitmap_and_cardinality(_table->GetTableBitmap().bitmap.get(), filter);
+  uint64_t true_count = roaring_bitmap_and_cardinality(_bitmap.bitmap.get(), filter);
+  buckets.resize(2);
+  buckets[0].key = "1";
+  buckets[0].count = true_count;
+  buckets[1].key = "0";
+  buckets[1].count = total - true_count;
+  sort_buckets_by_count(buckets);
   return 0;
 }
-int RobimsBoolField::Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& out) {
+int RobimsBoolField::Select(FieldOperator op, FieldArg arg, const roaring_bitmap_t* range,
+                            CRoaringBitmapPtr& out) {
   switch (op) {
     case FIELD_OP_ALL: {
-      out.reset(acquire_bitmap());
-      roaring_bitmap_overwrite(out.get(), _table->GetTableBitmap().bitmap.get());
+      out.reset(bitmap_copy_range(_table->GetTableBitmap().bitmap.get(), range));
       break;
     }
     case FIELD_OP_EQ:
@@ -66,21 +74,20 @@ int RobimsBoolField::Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& o
                      arg.index());
         return ROBIMS_ERR_INVALID_ARGS;
       }
-      out.reset(acquire_bitmap());
       // ROBIMS_DEBUG("RobimsBoolField EQ before size={}",
       //            roaring_bitmap_get_cardinality(_bitmap.bitmap.get()));
       if (FIELD_OP_EQ == op) {
         if (*iv == 0) {
-          roaring_bitmap_overwrite(out.get(), _table->GetTableBitmap().bitmap.get());
+          out.reset(bitmap_copy_range(_table->GetTableBitmap().bitmap.get(), range));
           roaring_bitmap_andnot_inplace(out.get(), _bitmap.bitmap.get());
         } else {
-          roaring_bitmap_overwrite(out.get(), _bitmap.bitmap.get());
+          out.reset(bitmap_copy_range(_bitmap.bitmap.get(), range));
         }
       } else {
         if (*iv == 0) {
-          roaring_bitmap_overwrite(out.get(), _bitmap.bitmap.get());
+          out.reset(bitmap_copy_range(_bitmap.bitmap.get(), range));
         } else {
-          roaring_bitmap_overwrite(out.get(), _table->GetTableBitmap().bitmap.get());
+          out.reset(bitmap_copy_range(_table->GetTableBitmap().bitmap.get(), range));
           roaring_bitmap_andnot_inplace(out.get(), _bitmap.bitmap.get());
         }
       }
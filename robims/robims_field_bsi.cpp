@@ -26,7 +26,9 @@
  *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
  *THE POSSIBILITY OF SUCH DAMAGE.
  */
+#include <fmt/core.h>
 #include "robims_bsi.h"
+#include "robims_cache.h"
 #include "robims_db.h"
 #include "robims_err.h"
 #include "robims_field.h"
@@ -45,12 +47,14 @@ int RobimsIntField::Put(uint32_t id, int64_t val) {
 }
 int RobimsIntField::Remove(uint32_t id) {
   int64_t val;
-  if (0 == _bsi->Get(id, val)) {
-    _bsi->Remove(id, val);
+  if (!_bsi->Get(id, val)) {
+    return -1;
   }
+  _bsi->Remove(id, val);
   return 0;
 }
-int RobimsIntField::Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& out) {
+int RobimsIntField::Select(FieldOperator op, FieldArg arg, const roaring_bitmap_t* range,
+                           CRoaringBitmapPtr& out) {
   int64_t* iv = std::get_if<int64_t>(&arg);
   if (nullptr == iv) {
     ROBIMS_ERROR("RobimsIntField does NOT support  args with data type which is not int:{}!",
@@ -58,6 +62,10 @@ int RobimsIntField::Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& ou
     return ROBIMS_ERR_INVALID_ARGS;
   }
   out.reset(acquire_bitmap());
+  if (nullptr != range) {
+    // bsi range ops only scan ids already in 'out'
+    roaring_bitmap_overwrite(out.get(), range);
+  }
   switch (op) {
     case FIELD_OP_EQ: {
       _bsi->RangeEQ(*iv, out.get());
@@ -91,6 +99,50 @@ int RobimsIntField::Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& ou
   ROBIMS_DEBUG("Int return siz={}", roaring_bitmap_get_cardinality(out.get()));
   return 0;
 }
+int RobimsIntField::Sum(const roaring_bitmap_t* filter, AggregateBucket& bucket) {
+  bucket.key = "sum";
+  return _bsi->Sum(filter, bucket.value, bucket.count);
+}
+int RobimsIntField::Histogram(const roaring_bitmap_t* filter, uint32_t n,
+                              AggregateBuckets& buckets) {
+  if (0 == n) {
+    return ROBIMS_ERR_INVALID_ARGS;
+  }
+  BitMapCacheGuard guard;
+  auto matched = acquire_bitmap();
+  auto tmp = acquire_bitmap();
+  guard.Add(matched);
+  guard.Add(tmp);
+  roaring_bitmap_overwrite(matched, filter);
+  roaring_bitmap_and_inplace(matched, _bsi->GetExistBitmap());
+  if (roaring_bitmap_is_empty(matched)) {
+    return 0;
+  }
+  int64_t min_val = 0, max_val = 0, count = 0;
+  roaring_bitmap_overwrite(tmp, matched);
+  _bsi->GetMin(tmp, min_val, count);
+  roaring_bitmap_overwrite(tmp, matched);
+  _bsi->GetMax(tmp, max_val, count);
+  uint64_t width = ((uint64_t)(max_val - min_val) + n) / n;
+  for (uint32_t i = 0; i < n; i++) {
+    int64_t lo = min_val + (int64_t)(i * width);
+    if (lo > max_val) {
+      break;
+    }
+    int64_t hi = lo + (int64_t)width - 1;
+    if (hi > max_val) {
+      hi = max_val;
+    }
+    roaring_bitmap_overwrite(tmp, matched);
+    _bsi->RangeBetween(lo, hi, tmp);
+    AggregateBucket bucket;
+    bucket.key = fmt::format("[{},{}]", lo, hi);
+    bucket.count = roaring_bitmap_get_cardinality(tmp);
+    bucket.value = lo;
+    buckets.emplace_back(std::move(bucket));
+  }
+  return 0;
+}
 
 int RobimsFloatField::OnInit() {
   _bsi.reset(new BitSliceFloatIndex);
@@ -106,12 +158,14 @@ int RobimsFloatField::Put(uint32_t id, float val) {
 }
 int RobimsFloatField::Remove(uint32_t id) {
   float val;
-  if (0 == _bsi->Get(id, val)) {
-    _bsi->Remove(id, val);
+  if (!_bsi->Get(id, val)) {
+    return -1;
   }
+  _bsi->Remove(id, val);
   return 0;
 }
-int RobimsFloatField::Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& out) {
+int RobimsFloatField::Select(FieldOperator op, FieldArg arg, const roaring_bitmap_t* range,
+                             CRoaringBitmapPtr& out) {
   float fv = 0;
   double* dv = std::get_if<double>(&arg);
   if (nullptr != dv) {
@@ -127,6 +181,10 @@ int RobimsFloatField::Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr&
     fv = *iv;
   }
   out.reset(acquire_bitmap());
+  if (nullptr != range) {
+    // bsi range ops only scan ids already in 'out'
+    roaring_bitmap_overwrite(out.get(), range);
+  }
   switch (op) {
     case FIELD_OP_EQ: {
       _bsi->RangeEQ(fv, out.get());
@@ -160,4 +218,55 @@ int RobimsFloatField::Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr&
   // ROBIMS_ERROR("Float return siz={}", roaring_bitmap_get_cardinality(out.get()));
   return 0;
 }
+int RobimsFloatField::Sum(const roaring_bitmap_t* filter, AggregateBucket& bucket) {
+  bucket.key = "sum";
+  return _bsi->Sum(filter, bucket.value, bucket.count);
+}
+int RobimsFloatField::Histogram(const roaring_bitmap_t* filter, uint32_t n,
+                                AggregateBuckets& buckets) {
+  if (0 == n) {
+    return ROBIMS_ERR_INVALID_ARGS;
+  }
+  BitMapCacheGuard guard;
+  auto matched = acquire_bitmap();
+  auto tmp = acquire_bitmap();
+  guard.Add(matched);
+  guard.Add(tmp);
+  roaring_bitmap_overwrite(matched, filter);
+  roaring_bitmap_and_inplace(matched, _bsi->GetExistBitmap());
+  if (roaring_bitmap_is_empty(matched)) {
+    return 0;
+  }
+  float min_val = 0, max_val = 0;
+  int64_t count = 0;
+  roaring_bitmap_overwrite(tmp, matched);
+  _bsi->GetMin(tmp, min_val, count);
+  roaring_bitmap_overwrite(tmp, matched);
+  _bsi->GetMax(tmp, max_val, count);
+  float width = (max_val - min_val) / n;
+  if (width <= 0) {
+    n = 1;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    bool last = (i == n - 1);
+    float lo = min_val + i * width;
+    float hi = last ? max_val : (min_val + (i + 1) * width);
+    roaring_bitmap_overwrite(tmp, matched);
+    // range ops treat an empty input as all, so stop once nothing left
+    _bsi->RangeGT(lo, true, tmp);
+    if (!roaring_bitmap_is_empty(tmp)) {
+      _bsi->RangeLT(hi, last, tmp);
+    }
+    AggregateBucket bucket;
+    if (last) {
+      bucket.key = fmt::format("[{},{}]", lo, hi);
+    } else {
+      bucket.key = fmt::format("[{},{})", lo, hi);
+    }
+    bucket.count = roaring_bitmap_get_cardinality(tmp);
+    bucket.value = lo;
+    buckets.emplace_back(std::move(bucket));
+  }
+  return 0;
+}
 }  // namespace robims
@@ -0,0 +1,168 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "robims_common.h"
+#include "robims_err.h"
+#include "robims_field.h"
+#include "robims_log.h"
+#include "robims_table.h"
+namespace robims {
+int RobimsColumnField::OnInit() { return 0; }
+void RobimsColumnField::Resize(uint32_t id) {
+  if (id < _size) {
+    return;
+  }
+  _size = id + 1;
+  switch (GetFieldMeta().index_type()) {
+    case INT_COLUMN: {
+      _ints.resize(_size);
+      _data = _ints.data();
+      break;
+    }
+    case FLOAT_COLUMN: {
+      _floats.resize(_size);
+      _data = _floats.data();
+      break;
+    }
+    default: {
+      _strings.resize(_size);
+      _data = _strings.data();
+      break;
+    }
+  }
+}
+int RobimsColumnField::Put(uint32_t id, const std::string_view& val) {
+  if (STRING_COLUMN != GetFieldMeta().index_type()) {
+    return ROBIMS_ERR_INVALID_ARGS;
+  }
+  Resize(id);
+  _strings[id].assign(val.data(), val.size());
+  return 0;
+}
+int RobimsColumnField::Put(uint32_t id, int64_t val) {
+  if (INT_COLUMN != GetFieldMeta().index_type()) {
+    return ROBIMS_ERR_INVALID_ARGS;
+  }
+  Resize(id);
+  _ints[id] = val;
+  return 0;
+}
+int RobimsColumnField::Put(uint32_t id, double val) {
+  if (FLOAT_COLUMN != GetFieldMeta().index_type()) {
+    return ROBIMS_ERR_INVALID_ARGS;
+  }
+  Resize(id);
+  _floats[id] = val;
+  return 0;
+}
+int RobimsColumnField::Remove(uint32_t id) {
+  Resize(id);
+  bool changed = false;
+  switch (GetFieldMeta().index_type()) {
+    case INT_COLUMN: {
+      changed = 0 != _ints[id];
+      _ints[id] = 0;
+      break;
+    }
+    case FLOAT_COLUMN: {
+      changed = 0 != _floats[id];
+      _floats[id] = 0;
+      break;
+    }
+    default: {
+      changed = !_strings[id].empty();
+      _strings[id].clear();
+      break;
+    }
+  }
+  return changed ? 0 : -1;
+}
+int RobimsColumnField::DoSave(FILE* fp, bool readonly) {
+  int rc = file_write_uint32(fp, _size);
+  if (0 != rc || 0 == _size) {
+    return rc;
+  }
+  switch (GetFieldMeta().index_type()) {
+    case INT_COLUMN: {
+      if (1 != ::fwrite(_ints.data(), _size * sizeof(int64_t), 1, fp)) {
+        return -1;
+      }
+      break;
+    }
+    case FLOAT_COLUMN: {
+      if (1 != ::fwrite(_floats.data(), _size * sizeof(double), 1, fp)) {
+        return -1;
+      }
+      break;
+    }
+    default: {
+      for (const std::string& str : _strings) {
+        rc = file_write_string(fp, str);
+        if (0 != rc) {
+          return rc;
+        }
+      }
+      break;
+    }
+  }
+  return 0;
+}
+int RobimsColumnField::DoLoad(FILE* fp) {
+  uint32_t n = 0;
+  if (0 != file_read_uint32(fp, n)) {
+    return -1;
+  }
+  if (0 == n) {
+    return 0;
+  }
+  Resize(n - 1);
+  switch (GetFieldMeta().index_type()) {
+    case INT_COLUMN: {
+      if (1 != fread((char*)(_ints.data()), n * sizeof(int64_t), 1, fp)) {
+        return -1;
+      }
+      break;
+    }
+    case FLOAT_COLUMN: {
+      if (1 != fread((char*)(_floats.data()), n * sizeof(double), 1, fp)) {
+        return -1;
+      }
+      break;
+    }
+    default: {
+      for (std::string& str : _strings) {
+        if (0 != file_read_string(fp, str)) {
+          return -1;
+        }
+      }
+      break;
+    }
+  }
+  return 0;
+}
+}  // namespace robims
@@ -89,16 +89,31 @@ int RobimsSetField::Put(uint32_t id, const std::string_view& val) {
   return 0;
 }
 int RobimsSetField::Remove(uint32_t id) {
+  bool removed = false;
   for (auto& pair : _bitmaps) {
-    pair.second->bitmap.Remove(id);
+    removed = pair.second->bitmap.Remove(id) || removed;
   }
+  return removed ? 0 : -1;
+}
+int RobimsSetField::CountBy(const roaring_bitmap_t* filter, AggregateBuckets& buckets) {
+  for (auto& pair : _bitmaps) {
+    uint64_t count = roaring_bitmap_and_cardinality(pair.second->bitmap.bitmap.get(), filter);
+    if (0 == count) {
+      continue;
+    }
+    AggregateBucket bucket;
+    bucket.key = pair.second->name;
+    bucket.count = count;
+    buckets.emplace_back(std::move(bucket));
+  }
+  sort_buckets_by_count(buckets);
   return 0;
 }
-int RobimsSetField::Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& out) {
+int RobimsSetField::Select(FieldOperator op, FieldArg arg, const roaring_bitmap_t* range,
+                           CRoaringBitmapPtr& out) {
   switch (op) {
     case FIELD_OP_ALL: {
-      out.reset(acquire_bitmap());
-      roaring_bitmap_overwrite(out.get(), _table->GetTableBitmap().bitmap.get());
+      out.reset(bitmap_copy_range(_table->GetTableBitmap().bitmap.get(), range));
       break;
     }
     case FIELD_OP_EQ:
@@ -114,11 +129,10 @@ int RobimsSetField::Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& ou
         return ROBIMS_ERR_NOTFOUND;
       }
       auto& matched_bitmap = found->second->bitmap;
-      out.reset(acquire_bitmap());
       if (FIELD_OP_EQ == op) {
-        roaring_bitmap_overwrite(out.get(), matched_bitmap.bitmap.get());
+        out.reset(bitmap_copy_range(matched_bitmap.bitmap.get(), range));
       } else {
-        roaring_bitmap_overwrite(out.get(), _table->GetTableBitmap().bitmap.get());
+        out.reset(bitmap_copy_range(_table->GetTableBitmap().bitmap.get(), range));
         roaring_bitmap_andnot_inplace(out.get(), matched_bitmap.bitmap.get());
       }
       // ROBIMS_DEBUG("RobimsSetField EQ return siz={}", roaring_bitmap_get_cardinality(out.get()));
@@ -32,35 +32,58 @@
 #include "robims_field.h"
 #include "robims_log.h"
 #include "robims_table.h"
+#include <algorithm>
 namespace robims {
+// weights only decide the order of entries(topk eviction), keep high 16 bits of the order
+// preserving uint32 representation.
+static inline uint16_t quantize_weight(float weight) { return float_to_uint32(weight) >> 16; }
+static inline uint64_t weight_key(uint16_t weight, uint32_t id) {
+  return (static_cast<uint64_t>(weight) << 32) + id;
+}
+static constexpr size_t kMinOverlayCompactSize = 1024;
+// fields saved before quantization start with the tag count and store (float weight << 32 | id)
+// per entry, a tag count can never be 0xFFFFFFFF, so it marks the versioned layout.
+static constexpr uint32_t kWeightSetFormatMarker = 0xFFFFFFFF;
+static constexpr uint32_t kWeightSetFormatVersion = 1;
+
 int RobimsWeightSetField::OnInit() { return 0; }
 int RobimsWeightSetField::DoSave(FILE* fp, bool readonly) {
-  int rc = file_write_uint32(fp, _bitmaps.size());
+  int rc = file_write_uint32(fp, kWeightSetFormatMarker);
   if (0 != rc) {
     return rc;
   }
-  for (auto& pair : _bitmaps) {
-    rc = file_write_string(fp, pair.second->name);
+  rc = file_write_uint32(fp, kWeightSetFormatVersion);
+  if (0 != rc) {
+    return rc;
+  }
+  rc = file_write_uint32(fp, _tags.size());
+  if (0 != rc) {
+    return rc;
+  }
+  for (NamedWeightRoaringBitmap* tag : _tags) {
+    CompactTag(tag);
+    rc = file_write_string(fp, tag->name);
     if (0 != rc) {
       return rc;
     }
-    std::vector<uint64_t> tmp(pair.second->weight_ids.begin(), pair.second->weight_ids.end());
-    int rc = file_write_uint32(fp, tmp.size());
+    rc = file_write_uint32(fp, tag->base_ids.size());
     if (0 != rc) {
       return rc;
     }
-    if (tmp.size() > 0) {
-      rc = ::fwrite(tmp.data(), tmp.size() * sizeof(uint64_t), 1, fp);
-      if (rc != 1) {
+    if (tag->base_ids.size() > 0) {
+      if (1 != ::fwrite(tag->base_ids.data(), tag->base_ids.size() * sizeof(uint32_t), 1, fp)) {
+        return -1;
+      }
+      if (1 != ::fwrite(tag->base_weights.data(), tag->base_weights.size() * sizeof(uint16_t), 1,
+                        fp)) {
         return -1;
       }
     }
-    rc = pair.second->bitmap.Save(fp, readonly);
+    rc = tag->bitmap.Save(fp, readonly);
     if (0 != rc) {
       return rc;
     }
   }
-
   return 0;
 }
 int RobimsWeightSetField::DoLoad(FILE* fp) {
@@ -68,6 +91,21 @@ int RobimsWeightSetField::DoLoad(FILE* fp) {
   if (0 != file_read_uint32(fp, n)) {
     return -1;
   }
+  bool legacy = true;
+  if (kWeightSetFormatMarker == n) {
+    uint32_t version = 0;
+    if (0 != file_read_uint32(fp, version)) {
+      return -1;
+    }
+    if (version != kWeightSetFormatVersion) {
+      ROBIMS_ERROR("Unsupported weight set field format version:{}", version);
+      return ROBIMS_ERR_INVALID_ARGS;
+    }
+    if (0 != file_read_uint32(fp, n)) {
+      return -1;
+    }
+    legacy = false;
+  }
   for (uint32_t i = 0; i < n; i++) {
     NamedWeightRoaringBitmapPtr p(new NamedWeightRoaringBitmap);
     if (0 != file_read_string(fp, p->name)) {
@@ -77,80 +115,294 @@ int RobimsWeightSetField::DoLoad(FILE* fp) {
     if (0 != file_read_uint32(fp, count)) {
       return -1;
     }
-    std::vector<uint64_t> tmp(count);
-    if (count > 0) {
-      int rc = fread((char*)(tmp.data()), tmp.size() * sizeof(uint64_t), 1, fp);
-      if (rc != 1) {
+    if (legacy) {
+      if (0 != LoadLegacyEntries(fp, count, p.get())) {
         return -1;
       }
-      p->weight_ids.insert(tmp.begin(), tmp.end());
-      for (uint64_t v : tmp) {
-        uint32_t id = v & 0xFFFFFFFFull;
-        uint32_t weight = ((v >> 32) & 0xFFFFFFFFull);
-        p->id_weights[id] = uint32_to_float(weight);
+    } else if (count > 0) {
+      p->base_ids.resize(count);
+      p->base_weights.resize(count);
+      if (1 != fread((char*)(p->base_ids.data()), count * sizeof(uint32_t), 1, fp)) {
+        return -1;
+      }
+      if (1 != fread((char*)(p->base_weights.data()), count * sizeof(uint16_t), 1, fp)) {
+        return -1;
       }
     }
     if (0 != p->bitmap.Load(fp)) {
       return -1;
     }
+    p->idx = i;
+    p->count = count;
+    _tags.push_back(p.get());
     std::string_view name = p->name;
     _bitmaps[name].reset(p.release());
   }
+  BuildReverseIndex();
   return 0;
 }
+int RobimsWeightSetField::LoadLegacyEntries(FILE* fp, uint32_t count,
+                                            NamedWeightRoaringBitmap* tag) {
+  if (0 == count) {
+    return 0;
+  }
+  std::vector<uint64_t> weight_ids(count);
+  if (1 != fread((char*)(weight_ids.data()), count * sizeof(uint64_t), 1, fp)) {
+    return -1;
+  }
+  // full float weights with the same quantized value may be ordered differently than ids.
+  for (uint64_t& v : weight_ids) {
+    v = weight_key((v >> 32) >> 16, v & 0xFFFFFFFFull);
+  }
+  std::sort(weight_ids.begin(), weight_ids.end(), std::greater<uint64_t>());
+  tag->base_ids.resize(count);
+  tag->base_weights.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    tag->base_ids[i] = weight_ids[i] & 0xFFFFFFFFull;
+    tag->base_weights[i] = weight_ids[i] >> 32;
+  }
+  return 0;
+}
+void RobimsWeightSetField::BuildReverseIndex() {
+  _id_tags_overlay.clear();
+  uint32_t max_id = 0;
+  size_t total = 0;
+  for (NamedWeightRoaringBitmap* tag : _tags) {
+    for (uint32_t id : tag->base_ids) {
+      max_id = std::max(max_id, id);
+    }
+    total += tag->base_ids.size();
+  }
+  _id_tag_offsets.assign(total > 0 ? max_id + 2 : 0, 0);
+  _id_tag_tags.resize(total);
+  _id_tag_weights.resize(total);
+  if (0 == total) {
+    return;
+  }
+  for (NamedWeightRoaringBitmap* tag : _tags) {
+    for (uint32_t id : tag->base_ids) {
+      _id_tag_offsets[id + 1]++;
+    }
+  }
+  for (size_t i = 1; i < _id_tag_offsets.size(); i++) {
+    _id_tag_offsets[i] += _id_tag_offsets[i - 1];
+  }
+  std::vector<uint32_t> cursors(_id_tag_offsets.begin(), _id_tag_offsets.end() - 1);
+  for (NamedWeightRoaringBitmap* tag : _tags) {
+    for (size_t i = 0; i < tag->base_ids.size(); i++) {
+      uint32_t pos = cursors[tag->base_ids[i]]++;
+      _id_tag_tags[pos] = tag->idx;
+      _id_tag_weights[pos] = tag->base_weights[i];
+    }
+  }
+}
+RobimsWeightSetField::TagWeights* RobimsWeightSetField::MutableIDTags(uint32_t id) {
+  auto found = _id_tags_overlay.find(id);
+  if (found != _id_tags_overlay.end()) {
+    return &(found->second);
+  }
+  TagWeights& tags = _id_tags_overlay[id];
+  if (id + 1 < _id_tag_offsets.size()) {
+    for (uint32_t i = _id_tag_offsets[id]; i < _id_tag_offsets[id + 1]; i++) {
+      tags.emplace_back(TagWeight{_id_tag_tags[i], _id_tag_weights[i]});
+    }
+  }
+  return &tags;
+}
+bool RobimsWeightSetField::GetTagWeight(uint32_t id, uint32_t tag, uint16_t& weight) {
+  auto found = _id_tags_overlay.find(id);
+  if (found != _id_tags_overlay.end()) {
+    for (const TagWeight& tw : found->second) {
+      if (tw.tag == tag) {
+        weight = tw.weight;
+        return true;
+      }
+    }
+    return false;
+  }
+  if (id + 1 < _id_tag_offsets.size()) {
+    for (uint32_t i = _id_tag_offsets[id]; i < _id_tag_offsets[id + 1]; i++) {
+      if (_id_tag_tags[i] == tag) {
+        weight = _id_tag_weights[i];
+        return true;
+      }
+    }
+  }
+  return false;
+}
+bool RobimsWeightSetField::IsBaseEntryValid(NamedWeightRoaringBitmap* tag, size_t idx) {
+  uint16_t weight = 0;
+  return GetTagWeight(tag->base_ids[idx], tag->idx, weight) && weight == tag->base_weights[idx];
+}
+bool RobimsWeightSetField::BaseContains(NamedWeightRoaringBitmap* tag, uint16_t weight,
+                                        uint32_t id) {
+  uint64_t key = weight_key(weight, id);
+  size_t left = 0, right = tag->base_ids.size();
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+    uint64_t mid_key = weight_key(tag->base_weights[mid], tag->base_ids[mid]);
+    if (mid_key == key) {
+      return true;
+    }
+    if (mid_key > key) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return false;
+}
+void RobimsWeightSetField::EvictMin(NamedWeightRoaringBitmap* tag) {
+  while (!tag->base_ids.empty() && !IsBaseEntryValid(tag, tag->base_ids.size() - 1)) {
+    tag->base_ids.pop_back();
+    tag->base_weights.pop_back();
+  }
+  bool from_base = false;
+  uint64_t min_key = 0;
+  if (!tag->overlay.empty()) {
+    min_key = *(tag->overlay.rbegin());
+  }
+  if (!tag->base_ids.empty()) {
+    uint64_t base_key = weight_key(tag->base_weights.back(), tag->base_ids.back());
+    if (tag->overlay.empty() || base_key < min_key) {
+      min_key = base_key;
+      from_base = true;
+    }
+  } else if (tag->overlay.empty()) {
+    return;
+  }
+  if (from_base) {
+    tag->base_ids.pop_back();
+    tag->base_weights.pop_back();
+  } else {
+    tag->overlay.erase(min_key);
+  }
+  uint32_t remove_id = min_key & 0xFFFFFFFFull;
+  tag->bitmap.Remove(remove_id);
+  tag->count--;
+  TagWeights* tags = MutableIDTags(remove_id);
+  tags->erase(std::remove_if(tags->begin(), tags->end(),
+                             [tag](const TagWeight& tw) { return tw.tag == tag->idx; }),
+              tags->end());
+}
+void RobimsWeightSetField::CompactTag(NamedWeightRoaringBitmap* tag) {
+  if (tag->overlay.empty() && tag->count == tag->base_ids.size()) {
+    return;
+  }
+  std::vector<uint32_t> ids;
+  std::vector<uint16_t> weights;
+  ids.reserve(tag->count);
+  weights.reserve(tag->count);
+  auto overlay_it = tag->overlay.begin();
+  for (size_t i = 0; i < tag->base_ids.size(); i++) {
+    if (!IsBaseEntryValid(tag, i)) {
+      continue;
+    }
+    uint64_t base_key = weight_key(tag->base_weights[i], tag->base_ids[i]);
+    while (overlay_it != tag->overlay.end() && *overlay_it > base_key) {
+      ids.emplace_back(*overlay_it & 0xFFFFFFFFull);
+      weights.emplace_back(*overlay_it >> 32);
+      overlay_it++;
+    }
+    ids.emplace_back(tag->base_ids[i]);
+    weights.emplace_back(tag->base_weights[i]);
+  }
+  for (; overlay_it != tag->overlay.end(); overlay_it++) {
+    ids.emplace_back(*overlay_it & 0xFFFFFFFFull);
+    weights.emplace_back(*overlay_it >> 32);
+  }
+  tag->base_ids.swap(ids);
+  tag->base_weights.swap(weights);
+  tag->overlay.clear();
+}
 
 int RobimsWeightSetField::Put(uint32_t id, const std::string_view& val, float weight) {
-  NamedWeightRoaringBitmap* bitmap = nullptr;
+  NamedWeightRoaringBitmap* tag = nullptr;
   auto found = _bitmaps.find(val);
   if (found == _bitmaps.end()) {
-    bitmap = new NamedWeightRoaringBitmap;
-    bitmap->name.assign(val.data(), val.size());
-    bitmap->bitmap.NewCRoaringBitmap();
-    _bitmaps[bitmap->name].reset(bitmap);
+    tag = new NamedWeightRoaringBitmap;
+    tag->name.assign(val.data(), val.size());
+    tag->idx = _tags.size();
+    tag->bitmap.NewCRoaringBitmap();
+    _bitmaps[tag->name].reset(tag);
+    _tags.push_back(tag);
   } else {
-    bitmap = found->second.get();
-  }
-  auto vfound = bitmap->id_weights.find(id);
-  if (vfound != bitmap->id_weights.end()) {
-    if (weight != vfound->second) {
-      uint64_t old_weight_id = float_to_uint32(vfound->second);
-      old_weight_id = (old_weight_id << 32) + id;
-      bitmap->weight_ids.erase(old_weight_id);
-    }
-  }
-  bitmap->id_weights[id] = weight;
-  uint64_t new_weight_id = float_to_uint32(weight);
-  new_weight_id = (new_weight_id << 32) + id;
-  bitmap->weight_ids.insert(new_weight_id);
-  bitmap->bitmap.Put(id);
-  if (GetFieldMeta().topk_limit() > 0 && bitmap->id_weights.size() > GetFieldMeta().topk_limit()) {
-    uint64_t min_weight_id = *(bitmap->weight_ids.rbegin());
-    uint32_t remove_id = min_weight_id & 0xFFFFFFFFull;
-    bitmap->id_weights.erase(remove_id);
-    bitmap->weight_ids.erase(min_weight_id);
+    tag = found->second.get();
+  }
+  uint16_t quantized_weight = quantize_weight(weight);
+  TagWeights* tags = MutableIDTags(id);
+  bool exists = false;
+  for (TagWeight& tw : *tags) {
+    if (tw.tag == tag->idx) {
+      if (tw.weight == quantized_weight) {
+        return 0;
+      }
+      tag->overlay.erase(weight_key(tw.weight, id));
+      tw.weight = quantized_weight;
+      exists = true;
+      break;
+    }
+  }
+  if (!exists) {
+    tags->emplace_back(TagWeight{tag->idx, quantized_weight});
+    tag->bitmap.Put(id);
+    tag->count++;
+  }
+  // a stale base entry with same weight becomes valid again
+  if (!BaseContains(tag, quantized_weight, id)) {
+    tag->overlay.insert(weight_key(quantized_weight, id));
+  }
+  if (GetFieldMeta().topk_limit() > 0 && tag->count > GetFieldMeta().topk_limit()) {
+    EvictMin(tag);
+  }
+  if (tag->overlay.size() > kMinOverlayCompactSize && tag->overlay.size() > tag->base_ids.size()) {
+    CompactTag(tag);
   }
   return 0;
 }
 int RobimsWeightSetField::Remove(uint32_t id) {
+  auto found = _id_tags_overlay.find(id);
+  bool in_base = id + 1 < _id_tag_offsets.size() && _id_tag_offsets[id + 1] > _id_tag_offsets[id];
+  if (found == _id_tags_overlay.end() && !in_base) {
+    return -1;
+  }
+  TagWeights* tags = MutableIDTags(id);
+  if (tags->empty()) {
+    return -1;
+  }
+  for (const TagWeight& tw : *tags) {
+    NamedWeightRoaringBitmap* tag = _tags[tw.tag];
+    tag->overlay.erase(weight_key(tw.weight, id));
+    tag->bitmap.Remove(id);
+    tag->count--;
+  }
+  if (in_base) {
+    // keep an empty entry to shadow the loaded reverse index
+    tags->clear();
+  } else {
+    _id_tags_overlay.erase(id);
+  }
+  return 0;
+}
+int RobimsWeightSetField::CountBy(const roaring_bitmap_t* filter, AggregateBuckets& buckets) {
   for (auto& pair : _bitmaps) {
-    auto found = pair.second->id_weights.find(id);
-    if (found == pair.second->id_weights.end()) {
-      return -1;
+    uint64_t count = roaring_bitmap_and_cardinality(pair.second->bitmap.bitmap.get(), filter);
+    if (0 == count) {
+      continue;
     }
-    float weight = found->second;
-    uint64_t weight_id = float_to_uint32(weight);
-    weight_id = (weight_id << 32) + id;
-    pair.second->id_weights.erase(found);
-    pair.second->weight_ids.erase(weight_id);
-    pair.second->bitmap.Remove(id);
+    AggregateBucket bucket;
+    bucket.key = pair.second->name;
+    bucket.count = count;
+    buckets.emplace_back(std::move(bucket));
   }
+  sort_buckets_by_count(buckets);
   return 0;
 }
-int RobimsWeightSetField::Select(FieldOperator op, FieldArg arg, CRoaringBitmapPtr& out) {
+int RobimsWeightSetField::Select(FieldOperator op, FieldArg arg, const roaring_bitmap_t* range,
+                                 CRoaringBitmapPtr& out) {
   switch (op) {
     case FIELD_OP_ALL: {
-      out.reset(acquire_bitmap());
-      roaring_bitmap_overwrite(out.get(), _table->GetTableBitmap().bitmap.get());
+      out.reset(bitmap_copy_range(_table->GetTableBitmap().bitmap.get(), range));
       break;
     }
     case FIELD_OP_EQ:
@@ -165,11 +417,10 @@ int RobimsWeightSetField::Select(FieldOperator op, FieldArg arg, CRoaringBitmapP
       if (found == _bitmaps.end()) {
         return ROBIMS_ERR_NOTFOUND;
       }
-      out.reset(acquire_bitmap());
       if (FIELD_OP_EQ == op) {
-        roaring_bitmap_overwrite(out.get(), found->second->bitmap.bitmap.get());
+        out.reset(bitmap_copy_range(found->second->bitmap.bitmap.get(), range));
       } else {
-        roaring_bitmap_overwrite(out.get(), _table->GetTableBitmap().bitmap.get());
+        out.reset(bitmap_copy_range(_table->GetTableBitmap().bitmap.get(), range));
         roaring_bitmap_andnot_inplace(out.get(), found->second->bitmap.bitmap.get());
       }
       break;
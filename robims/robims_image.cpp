@@ -0,0 +1,82 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "robims_image.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "robims_log.h"
+
+namespace robims {
+static thread_local RobimsImagePtr g_current_image;
+
+RobimsImagePtr RobimsImage::Open(const std::string& file) {
+  int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    ROBIMS_ERROR("Failed to open image file:{} with errno:{}", file, errno);
+    return nullptr;
+  }
+  RobimsImagePtr image(new RobimsImage);
+  image->_fd = fd;
+  struct stat st;
+  if (0 != fstat(fd, &st)) {
+    ROBIMS_ERROR("Failed to stat image file:{} with errno:{}", file, errno);
+    return nullptr;
+  }
+  if (st.st_size == 0) {
+    return image;
+  }
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    ROBIMS_ERROR("Failed to mmap image file:{} with errno:{}", file, errno);
+    return nullptr;
+  }
+  image->_data = (char*)data;
+  image->_size = st.st_size;
+  return image;
+}
+
+RobimsImage::~RobimsImage() {
+  if (nullptr != _data) {
+    munmap(_data, _size);
+  }
+  if (_fd >= 0) {
+    ::close(_fd);
+  }
+}
+
+RobimsImageScope::RobimsImageScope(RobimsImagePtr image) {
+  _prev = std::move(g_current_image);
+  g_current_image = std::move(image);
+}
+const RobimsImagePtr& RobimsImageScope::Current() { return g_current_image; }
+RobimsImageScope::~RobimsImageScope() { g_current_image = std::move(_prev); }
+
+}  // namespace robims
@@ -0,0 +1,72 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+namespace robims {
+/**
+ * Readonly db file mapped into memory as a whole, readonly bitmaps are stored 32 bytes aligned
+ * inside it and loaded as frozen views, so the page cache is shared between processes.
+ */
+class RobimsImage {
+ private:
+  RobimsImage(const RobimsImage&) = delete;
+  RobimsImage& operator=(const RobimsImage&) = delete;
+  int _fd = -1;
+  char* _data = nullptr;
+  size_t _size = 0;
+
+  RobimsImage() = default;
+
+ public:
+  static std::shared_ptr<RobimsImage> Open(const std::string& file);
+  const char* GetData() const { return _data; }
+  size_t GetSize() const { return _size; }
+  ~RobimsImage();
+};
+typedef std::shared_ptr<RobimsImage> RobimsImagePtr;
+
+/**
+ * Install an image for bitmaps loaded on current thread while the scope is alive.
+ */
+class RobimsImageScope {
+ private:
+  RobimsImagePtr _prev;
+
+ public:
+  explicit RobimsImageScope(RobimsImagePtr image);
+  static const RobimsImagePtr& Current();
+  ~RobimsImageScope();
+};
+
+}  // namespace robims
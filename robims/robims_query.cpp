@@ -27,6 +27,7 @@
  *THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include "robims_query.h"
+#include <algorithm>
 #include <iostream>
 #include <list>
 #include <memory>
@@ -45,9 +46,12 @@
 #include "folly/Demangle.h"
 
 #include "robims_cache.h"
+#include "robims_column_filter.h"
 #include "robims_db_impl.h"
 #include "robims_err.h"
+#include "robims_field.h"
 #include "robims_log.h"
+#include "robims_table.h"
 
 namespace robims {
 namespace ast {
@@ -112,9 +116,19 @@ struct Operation : x3::position_tagged {
   Operand operand_;
 };
 
+enum AggregateFunc {
+  agg_none,
+  agg_count_by,
+  agg_sum,
+  agg_histogram,
+};
+
 struct FuncCall : x3::position_tagged {
   std::string func;
   std::vector<Operand> args;
+  AggregateFunc agg_func = agg_none;
+  // compiled residual predicate of 'filter(bitmap, "expr")'
+  RobimsColumnFilterPtr column_filter;
 
   // ExprFunction functor_;
 };
@@ -323,6 +337,7 @@ namespace ast {
 
 struct QueryCalc {
   Optoken op;
+  const roaring_bitmap_t* range = nullptr;
   template <typename T, typename R>
   RobimsQueryValue operator()(const T& left, const R& right) const {
     RobimsQueryValue result;
@@ -403,7 +418,7 @@ struct QueryCalc {
             result = e;
             return result;
           }
-          int rc = left->Select(robims::FIELD_OP_EQ, arg, out);
+          int rc = left->Select(robims::FIELD_OP_EQ, arg, range, out);
           if (0 == rc) {
             result = std::move(out);
           } else {
@@ -424,7 +439,7 @@ struct QueryCalc {
             result = e;
             return result;
           }
-          int rc = right->Select(robims::FIELD_OP_EQ, arg, out);
+          int rc = right->Select(robims::FIELD_OP_EQ, arg, range, out);
           if (0 == rc) {
             result = std::move(out);
           } else {
@@ -460,7 +475,7 @@ struct QueryCalc {
             result = e;
             return result;
           }
-          int rc = left->Select(robims::FIELD_OP_NEQ, arg, out);
+          int rc = left->Select(robims::FIELD_OP_NEQ, arg, range, out);
           if (0 == rc) {
             result = std::move(out);
           } else {
@@ -480,7 +495,7 @@ struct QueryCalc {
             result = e;
             return result;
           }
-          int rc = right->Select(robims::FIELD_OP_NEQ, arg, out);
+          int rc = right->Select(robims::FIELD_OP_NEQ, arg, range, out);
           if (0 == rc) {
             result = std::move(out);
           } else {
@@ -515,7 +530,7 @@ struct QueryCalc {
             result = e;
             return result;
           }
-          int rc = left->Select(robims::FIELD_OP_LT, arg, out);
+          int rc = left->Select(robims::FIELD_OP_LT, arg, range, out);
           if (0 == rc) {
             result = std::move(out);
           } else {
@@ -534,7 +549,7 @@ struct QueryCalc {
             result = e;
             return result;
           }
-          int rc = right->Select(robims::FIELD_OP_GT, arg, out);
+          int rc = right->Select(robims::FIELD_OP_GT, arg, range, out);
           if (0 == rc) {
             result = std::move(out);
           } else {
@@ -569,7 +584,7 @@ struct QueryCalc {
             result = e;
             return result;
           }
-          int rc = left->Select(robims::FIELD_OP_LTE, arg, out);
+          int rc = left->Select(robims::FIELD_OP_LTE, arg, range, out);
           if (0 == rc) {
             result = std::move(out);
           } else {
@@ -588,7 +603,7 @@ struct QueryCalc {
             result = e;
             return result;
           }
-          int rc = right->Select(robims::FIELD_OP_GTE, arg, out);
+          int rc = right->Select(robims::FIELD_OP_GTE, arg, range, out);
           if (0 == rc) {
             result = std::move(out);
           } else {
@@ -626,7 +641,7 @@ struct QueryCalc {
             result = e;
             return result;
           }
-          int rc = left->Select(robims::FIELD_OP_GT, arg, out);
+          int rc = left->Select(robims::FIELD_OP_GT, arg, range, out);
           if (0 == rc) {
             result = std::move(out);
           } else {
@@ -646,7 +661,7 @@ struct QueryCalc {
             result = e;
             return result;
           }
-          int rc = right->Select(robims::FIELD_OP_LT, arg, out);
+          int rc = right->Select(robims::FIELD_OP_LT, arg, range, out);
           if (0 == rc) {
             result = std::move(out);
           } else {
@@ -689,7 +704,7 @@ struct QueryCalc {
             result = e;
             return result;
           }
-          int rc = left->Select(robims::FIELD_OP_GTE, arg, out);
+          int rc = left->Select(robims::FIELD_OP_GTE, arg, range, out);
           if (0 == rc) {
             result = std::move(out);
           } else {
@@ -708,7 +723,7 @@ struct QueryCalc {
             result = e;
             return result;
           }
-          int rc = right->Select(robims::FIELD_OP_LTE, arg, out);
+          int rc = right->Select(robims::FIELD_OP_LTE, arg, range, out);
           if (0 == rc) {
             result = std::move(out);
           } else {
@@ -767,9 +782,29 @@ struct QueryCalc {
   }
 };
 
+// a literal argument is parsed as nested single operand expressions, e.g. the "expr" of
+// 'filter(bitmap, "expr")', returns nullptr if the operand is not a string literal.
+static const std::string* get_string_literal(const Operand& operand) {
+  const Operand* current = &operand;
+  while (true) {
+    const std::string* str = boost::get<std::string>(current);
+    if (nullptr != str) {
+      return str;
+    }
+    const x3::forward_ast<Expression>* expr = boost::get<x3::forward_ast<Expression>>(current);
+    if (nullptr == expr || !expr->get().rest.empty()) {
+      return nullptr;
+    }
+    current = &(expr->get().first);
+  }
+}
+
 struct Initializer {
   robims::RobimsDBImpl* db;
-  Initializer(robims::RobimsDBImpl* d) : db(d) {}
+  bool& has_func_call;
+  std::vector<RobimsTable*>& tables;
+  Initializer(robims::RobimsDBImpl* d, bool& f, std::vector<RobimsTable*>& t)
+      : db(d), has_func_call(f), tables(t) {}
   int operator()(Nil) const { return 0; }
   int operator()(int64_t n) const { return 0; }
   int operator()(bool n) const { return 0; }
@@ -806,10 +841,64 @@ struct Initializer {
       return ROBIMS_QUERY_ERR_INVALID_FIELD_NAME;
     }
     n.field = field;
+    if (std::find(tables.begin(), tables.end(), table) == tables.end()) {
+      tables.push_back(table);
+    }
     return 0;
   }
   int operator()(DynamicVariable& n) const { return 0; }
-  int operator()(FuncCall& n) const { return 0; }
+  int operator()(FuncCall& n) const {
+    if (n.func == "filter") {
+      // filter(bitmap, "column predicate") still produces a bitmap, so it's parallelizable.
+      const std::string* expr = nullptr;
+      if (n.args.size() == 2) {
+        expr = get_string_literal(n.args[1]);
+      }
+      if (nullptr == expr) {
+        ROBIMS_ERROR("Expected args (bitmap, \"expr\") for function:{}", n.func);
+        return ROBIMS_QUERY_ERR_INVALID_FUNCTION_ARGS;
+      }
+      int rc = boost::apply_visitor(*this, n.args[0]);
+      if (0 != rc) {
+        return rc;
+      }
+      n.column_filter = std::make_shared<RobimsColumnFilter>();
+      rc = n.column_filter->Init(db, *expr);
+      if (0 != rc) {
+        return rc;
+      }
+      RobimsTable* table = n.column_filter->GetTable();
+      if (std::find(tables.begin(), tables.end(), table) == tables.end()) {
+        tables.push_back(table);
+      }
+      return 0;
+    }
+    // count_by(field[, filter]), sum(field[, filter]), histogram(field, buckets[, filter])
+    has_func_call = true;
+    size_t min_args = 1;
+    if (n.func == "count_by") {
+      n.agg_func = agg_count_by;
+    } else if (n.func == "sum") {
+      n.agg_func = agg_sum;
+    } else if (n.func == "histogram") {
+      n.agg_func = agg_histogram;
+      min_args = 2;
+    } else {
+      ROBIMS_ERROR("Unsupported function:{}", n.func);
+      return ROBIMS_QUERY_ERR_INVALID_FUNCTION;
+    }
+    if (n.args.size() < min_args || n.args.size() > min_args + 1) {
+      ROBIMS_ERROR("Invalid args count:{} for function:{}", n.args.size(), n.func);
+      return ROBIMS_QUERY_ERR_INVALID_FUNCTION_ARGS;
+    }
+    for (Operand& arg : n.args) {
+      int rc = boost::apply_visitor(*this, arg);
+      if (0 != rc) {
+        return rc;
+      }
+    }
+    return 0;
+  }
   int operator()(Unary& n) const { return boost::apply_visitor(*this, n.operand_); }
   int operator()(Expression& x) const {
     int rc = boost::apply_visitor(*this, x.first);
@@ -826,9 +915,111 @@ struct Initializer {
   }
 };
 
+// prints the ast as a canonical key, operands of a chain of only '&&' or only '||' are sorted since
+// bitmap and/or are commutative, so 'a && b' and 'b && a' share same cached result.
+struct QueryNormalizer {
+  static const char* OpString(Optoken op) {
+    switch (op) {
+      case op_plus:
+      case op_positive:
+        return "+";
+      case op_minus:
+      case op_negative:
+        return "-";
+      case op_times:
+        return "*";
+      case op_divide:
+        return "/";
+      case op_equal:
+        return "==";
+      case op_not_equal:
+        return "!=";
+      case op_less:
+        return "<";
+      case op_less_equal:
+        return "<=";
+      case op_greater:
+        return ">";
+      case op_greater_equal:
+        return ">=";
+      case op_and:
+        return "&&";
+      case op_or:
+        return "||";
+      case op_and_not:
+        return "&&!";
+    }
+    return "?";
+  }
+  std::string operator()(Nil) const { return ""; }
+  std::string operator()(int64_t n) const { return std::to_string(n); }
+  // keep double literals distinguishable from int literals with same text
+  std::string operator()(double n) const { return fmt::format("{}d", n); }
+  std::string operator()(bool n) const { return n ? "true" : "false"; }
+  std::string operator()(std::string const& n) const { return "\"" + n + "\""; }
+  std::string operator()(CondExpr const& n) const {
+    return "(" + boost::apply_visitor(*this, n.lhs) + "?" + boost::apply_visitor(*this, n.rhs_true) +
+           ":" + boost::apply_visitor(*this, n.rhs_false) + ")";
+  }
+  static std::string JoinVar(const std::vector<std::string>& v) {
+    std::string key;
+    for (size_t i = 0; i < v.size(); i++) {
+      if (i > 0) {
+        key.push_back('.');
+      }
+      key.append(v[i]);
+    }
+    return key;
+  }
+  std::string operator()(Variable const& n) const { return JoinVar(n.v); }
+  std::string operator()(DynamicVariable const& n) const { return "$" + JoinVar(n.v); }
+  std::string operator()(FuncCall const& n) const {
+    std::string key = n.func + "(";
+    for (size_t i = 0; i < n.args.size(); i++) {
+      if (i > 0) {
+        key.push_back(',');
+      }
+      key.append(boost::apply_visitor(*this, n.args[i]));
+    }
+    key.push_back(')');
+    return key;
+  }
+  std::string operator()(Unary const& n) const {
+    return OpString(n.operator_) + boost::apply_visitor(*this, n.operand_);
+  }
+  std::string operator()(Expression const& x) const {
+    std::string first = boost::apply_visitor(*this, x.first);
+    if (x.rest.empty()) {
+      return first;
+    }
+    Optoken op = x.rest[0].operator_;
+    bool commutative = (op_and == op || op_or == op);
+    for (const Operation& oper : x.rest) {
+      commutative = commutative && oper.operator_ == op;
+    }
+    std::vector<std::string> operands;
+    operands.emplace_back(std::move(first));
+    for (const Operation& oper : x.rest) {
+      operands.emplace_back(boost::apply_visitor(*this, oper.operand_));
+    }
+    if (commutative) {
+      std::sort(operands.begin(), operands.end());
+    }
+    std::string key = "(" + operands[0];
+    for (size_t i = 1; i < operands.size(); i++) {
+      key.append(OpString(x.rest[i - 1].operator_));
+      key.append(operands[i]);
+    }
+    key.push_back(')');
+    return key;
+  }
+};
+
 struct QueryInterpreter {
   //   EvalContext& ctx_;
   //   QueryInterpreter(EvalContext& ctx) : ctx_(ctx) {}
+  // field selections only produce ids inside 'range' if it's not null
+  const roaring_bitmap_t* range = nullptr;
   RobimsQueryValue operator()(Nil) const {
     RobimsQueryValue empty;
     return empty;
@@ -881,8 +1072,92 @@ struct QueryInterpreter {
     return empty;
   }
   RobimsQueryValue operator()(FuncCall const& n) const {
-    RobimsQueryValue empty;
-    return empty;
+    RobimsQueryValue v;
+    if (n.column_filter) {
+      RobimsQueryValue bitmap_val = boost::apply_visitor(*this, n.args[0]);
+      CRoaringBitmapPtr* bitmap = std::get_if<CRoaringBitmapPtr>(&bitmap_val);
+      if (nullptr == bitmap) {
+        if (0 == bitmap_val.index()) {
+          return bitmap_val;
+        }
+        RobimsQueryError e(ROBIMS_QUERY_ERR_INVALID_FUNCTION_ARGS,
+                           "first arg of filter must be bitmap");
+        v = e;
+        return v;
+      }
+      CRoaringBitmapPtr out(acquire_bitmap());
+      n.column_filter->Apply(bitmap->get(), out.get());
+      v = std::move(out);
+      return v;
+    }
+    RobimsQueryValue field_val = boost::apply_visitor(*this, n.args[0]);
+    RobimsField** field = std::get_if<RobimsField*>(&field_val);
+    if (nullptr == field) {
+      RobimsQueryError e(ROBIMS_QUERY_ERR_INVALID_FUNCTION_ARGS,
+                         "first arg of aggregate function must be field");
+      v = e;
+      return v;
+    }
+    size_t filter_idx = 1;
+    int64_t bucket_num = 0;
+    if (agg_histogram == n.agg_func) {
+      RobimsQueryValue bucket_val = boost::apply_visitor(*this, n.args[1]);
+      int64_t* pbucket_num = std::get_if<int64_t>(&bucket_val);
+      if (nullptr == pbucket_num || *pbucket_num <= 0) {
+        RobimsQueryError e(ROBIMS_QUERY_ERR_INVALID_FUNCTION_ARGS,
+                           "buckets arg of histogram must be positive int");
+        v = e;
+        return v;
+      }
+      bucket_num = *pbucket_num;
+      filter_idx = 2;
+    }
+    CRoaringBitmapPtr filter;
+    const roaring_bitmap_t* filter_bitmap = (*field)->GetTable()->GetTableBitmap().bitmap.get();
+    if (n.args.size() > filter_idx) {
+      RobimsQueryValue filter_val = boost::apply_visitor(*this, n.args[filter_idx]);
+      CRoaringBitmapPtr* pfilter = std::get_if<CRoaringBitmapPtr>(&filter_val);
+      if (nullptr == pfilter) {
+        if (0 == filter_val.index()) {
+          return filter_val;
+        }
+        RobimsQueryError e(ROBIMS_QUERY_ERR_INVALID_FUNCTION_ARGS,
+                           "filter arg of aggregate function must be bitmap");
+        v = e;
+        return v;
+      }
+      filter = std::move(*pfilter);
+      filter_bitmap = filter.get();
+    }
+    AggregateResultPtr result(new AggregateResult);
+    result->total = roaring_bitmap_get_cardinality(filter_bitmap);
+    int rc = 0;
+    switch (n.agg_func) {
+      case agg_count_by: {
+        rc = (*field)->CountBy(filter_bitmap, result->buckets);
+        break;
+      }
+      case agg_sum: {
+        result->buckets.resize(1);
+        rc = (*field)->Sum(filter_bitmap, result->buckets[0]);
+        break;
+      }
+      case agg_histogram: {
+        rc = (*field)->Histogram(filter_bitmap, (uint32_t)bucket_num, result->buckets);
+        break;
+      }
+      default: {
+        rc = ROBIMS_QUERY_ERR_INVALID_FUNCTION;
+        break;
+      }
+    }
+    if (0 != rc) {
+      RobimsQueryError e(rc, "aggregate function '" + n.func + "' failed");
+      v = e;
+      return v;
+    }
+    v = std::move(result);
+    return v;
   }
   RobimsQueryValue operator()(Unary const& n) const {
     RobimsQueryValue v = boost::apply_visitor(*this, n.operand_);
@@ -929,6 +1204,7 @@ struct QueryInterpreter {
     RobimsQueryValue rhs = boost::apply_visitor(*this, x.operand_);
     QueryCalc visitor;
     visitor.op = x.operator_;
+    visitor.range = range;
     // ROBIMS_ERROR("visit op:{}, left:{}, right:{}", visitor.op, lhs.index(), rhs.index());
     RobimsQueryValue result = std::visit(visitor, lhs, rhs);
     return result;
@@ -968,16 +1244,25 @@ int RobimsQuery::Init(RobimsDBImpl* db, const std::string& query) {
     delete ast;
     return -1;
   }
-  robims::ast::Initializer init(db);
+  robims::ast::Initializer init(db, has_func_call_, tables_);
   int rc = init(*ast);
   if (0 != rc) {
     delete ast;
     return rc;
   }
+  // versions are compared with results cached by queries differ in operand order
+  std::sort(tables_.begin(), tables_.end());
+  normalized_key_ = robims::ast::QueryNormalizer()(*ast);
   expr_.reset(ast);
   return 0;
 }
-RobimsQueryValue RobimsQuery::Execute(RobimsDBImpl* db) {
+void RobimsQuery::GetTableVersions(std::vector<uint64_t>& versions) const {
+  versions.resize(tables_.size());
+  for (size_t i = 0; i < tables_.size(); i++) {
+    versions[i] = tables_[i]->GetVersion();
+  }
+}
+RobimsQueryValue RobimsQuery::Execute(RobimsDBImpl* db, const roaring_bitmap_t* range) {
   RobimsQueryError err;
   robims::ast::Expression* ast = (robims::ast::Expression*)(expr_.get());
   if (nullptr == ast) {
@@ -986,6 +1271,7 @@ RobimsQueryValue RobimsQuery::Execute(RobimsDBImpl* db) {
     return err;
   }
   robims::ast::QueryInterpreter interpreter;
+  interpreter.range = range;
   return interpreter(*ast);
 }
 }  // namespace robims
\ No newline at end of file
@@ -31,8 +31,10 @@
 #include <memory>
 #include <string>
 #include <variant>
+#include <vector>
 #include "roaring/roaring.h"
 #include "robims_common.h"
+#include "robims_db.h"
 
 namespace robims {
 struct Expr {
@@ -45,16 +47,33 @@ struct RobimsQueryError {
   RobimsQueryError(int c = -1, const std::string& r = "unknown error") : code(c), reason(r) {}
 };
 class RobimsField;
+class RobimsTable;
+struct AggregateResult {
+  int64_t total = 0;
+  AggregateBuckets buckets;
+};
+typedef std::unique_ptr<AggregateResult> AggregateResultPtr;
 typedef std::variant<RobimsQueryError, bool, int64_t, double, std::string_view, RobimsField*,
-                     CRoaringBitmapPtr>
+                     CRoaringBitmapPtr, AggregateResultPtr>
     RobimsQueryValue;
 
 class RobimsQuery {
  private:
   std::unique_ptr<Expr> expr_;
+  bool has_func_call_ = false;
+  std::vector<RobimsTable*> tables_;
+  std::string normalized_key_;
 
  public:
   int Init(RobimsDBImpl* db, const std::string& query);
-  RobimsQueryValue Execute(RobimsDBImpl* db);
+  // aggregate functions need the whole filter bitmap, so they can NOT be split by id ranges.
+  bool IsParallelizable() const { return !has_func_call_; }
+  // write versions of all tables referenced by the query, used to validate cached results.
+  void GetTableVersions(std::vector<uint64_t>& versions) const;
+  // canonical text of the parsed query, queries only differ in blanks or in operand order of
+  // '&&'/'||' chains have same key.
+  const std::string& GetNormalizedKey() const { return normalized_key_; }
+  // only ids inside 'range' would be selected if it's not null.
+  RobimsQueryValue Execute(RobimsDBImpl* db, const roaring_bitmap_t* range = nullptr);
 };
 }  // namespace robims
\ No newline at end of file
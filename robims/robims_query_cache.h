@@ -0,0 +1,99 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <stddef.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "folly/FBString.h"
+#include "folly/container/EvictingCacheMap.h"
+#include "folly/hash/SpookyHashV2.h"
+
+namespace robims {
+// remove blanks outside quoted strings, queries only differ in blanks share same cache entry.
+std::string normalize_query(const std::string& query);
+
+// LRU cache split into shards by key hash, each shard has its own lock, so concurrent selects with
+// different queries rarely contend on the same mutex.
+template <typename V>
+class ShardedEvictingCache {
+ private:
+  struct Shard {
+    std::mutex mutex;
+    folly::EvictingCacheMap<folly::fbstring, V> cache;
+    explicit Shard(size_t capacity) : cache(capacity) {}
+  };
+  std::vector<std::unique_ptr<Shard>> _shards;
+
+  static size_t ShardCapacity(size_t capacity, size_t shard_num) {
+    size_t n = capacity / shard_num;
+    return n > 0 ? n : 1;
+  }
+  Shard& GetShard(const folly::fbstring& key) {
+    uint64_t hash = folly::hash::SpookyHashV2::Hash64(key.data(), key.size(), 0);
+    return *_shards[hash % _shards.size()];
+  }
+
+ public:
+  explicit ShardedEvictingCache(size_t capacity, size_t shard_num = 16) {
+    for (size_t i = 0; i < shard_num; i++) {
+      _shards.emplace_back(std::make_unique<Shard>(ShardCapacity(capacity, shard_num)));
+    }
+  }
+  bool Get(const folly::fbstring& key, V& val) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    auto found = shard.cache.find(key);
+    if (found == shard.cache.end()) {
+      return false;
+    }
+    val = found->second;
+    return true;
+  }
+  void Set(const folly::fbstring& key, const V& val) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    shard.cache.set(key, val);
+  }
+  void SetCapacity(size_t capacity) {
+    for (auto& shard : _shards) {
+      std::lock_guard<std::mutex> guard(shard->mutex);
+      shard->cache.setMaxSize(ShardCapacity(capacity, _shards.size()));
+    }
+  }
+  void Clear() {
+    for (auto& shard : _shards) {
+      std::lock_guard<std::mutex> guard(shard->mutex);
+      shard->cache.clear();
+    }
+  }
+};
+}  // namespace robims
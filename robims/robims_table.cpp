@@ -36,8 +36,12 @@
 #include "robims_log.h"
 #include "simdjson.h"
 namespace robims {
+static std::atomic<uint64_t> g_table_version_seed{0};
 
-RobimsTable::RobimsTable(IDMapping* id_mapping) : _id_mapping(id_mapping) {}
+RobimsTable::RobimsTable(IDMapping* id_mapping) : _id_mapping(id_mapping) { IncVersion(); }
+void RobimsTable::IncVersion() {
+  _version.store(g_table_version_seed.fetch_add(1) + 1, std::memory_order_release);
+}
 const TableSchema& RobimsTable::GetSchema() { return _schema; }
 RoaringBitmap& RobimsTable::GetTableBitmap() { return _id_bitmap; }
 IDMapping* RobimsTable::GetIDMapping() { return _id_mapping; }
@@ -98,7 +102,7 @@ int RobimsTable::Select(const std::string_view& field, FieldOperator op, FieldAr
     return ROBIMS_ERR_NOTFOUND;
   }
 
-  return found->second->Select(op, arg, out);
+  return found->second->Select(op, arg, nullptr, out);
 }
 // int RobimsTable::Visit(const roaring_bitmap_t* b, const VisitOptions& options) {
 //   auto found = _fields.find(options.field);
@@ -115,8 +119,12 @@ int RobimsTable::Remove(const std::string& json) {
   if (0 != GetLocalId(doc, id)) {
     return -1;
   }
+  IncVersion();
   for (const auto& field_pair : _fields) {
-    field_pair.second->Remove(id);
+    // only fields holding a value of the id are changed
+    if (0 == field_pair.second->Remove(id)) {
+      field_pair.second->MarkDirty();
+    }
   }
   return 0;
 }
@@ -134,16 +142,21 @@ int RobimsTable::Put(const std::string& json) {
     ROBIMS_ERROR("Faield to get local id");
     return -1;
   }
+  IncVersion();
+  _ids_dirty = true;
   roaring_bitmap_add(_id_bitmap.bitmap.get(), id);
   for (const auto& field_pair : _fields) {
     auto field_result = doc.find_field_unordered(field_pair.first);
     RobimsField* field = field_pair.second.get();
     if (field_result.error()) {
-      if (BOOL_INDEX != field->GetFieldMeta().index_type()) {
+      // columns must cover every id of table, missing value is reset to default
+      if (BOOL_INDEX != field->GetFieldMeta().index_type() &&
+          !is_column_field(field->GetFieldMeta().index_type())) {
         continue;
       }
     }
     // ROBIMS_ERROR("enter for field:{}/{}", field_pair.first, field->GetFieldMeta().index_type());
+    field->MarkDirty();
     switch (field->GetFieldMeta().index_type()) {
       case SET_INDEX: {
         if (field_result.get_array().error()) {
@@ -226,6 +239,25 @@ int RobimsTable::Put(const std::string& json) {
         field->Put(id, (float)(field_result.get_double().value()));
         break;
       }
+      case INT_COLUMN:
+      case FLOAT_COLUMN:
+      case STRING_COLUMN: {
+        FieldIndexType type = field->GetFieldMeta().index_type();
+        if (field_result.error()) {
+          field->Remove(id);
+        } else if (INT_COLUMN == type && !field_result.get_int64().error()) {
+          field->Put(id, field_result.get_int64().value());
+        } else if (FLOAT_COLUMN == type && !field_result.get_double().error()) {
+          field->Put(id, field_result.get_double().value());
+        } else if (STRING_COLUMN == type && !field_result.get_string().error()) {
+          field->Put(id, field_result.get_string().value());
+        } else {
+          ROBIMS_ERROR("{} has invalid value type for column:{}", field_pair.first, type);
+          field->Remove(id);
+          return -1;
+        }
+        break;
+      }
       default: {
         break;
       }
@@ -289,4 +321,75 @@ int RobimsTable::Load(FILE* fp) {
   }
   return 0;
 }
+int RobimsTable::SaveCheckpoint(const std::string& dir, bool full) {
+  std::string prefix = dir + "/" + _schema.name();
+  if (full || _ids_dirty) {
+    int rc = file_atomic_write(prefix + ".ids",
+                               [this](FILE* fp) { return _id_bitmap.Save(fp, false); });
+    if (0 != rc) {
+      ROBIMS_ERROR("Failed to save table:{} id bitmap checkpoint", _schema.name());
+      return rc;
+    }
+    _ids_dirty = false;
+  }
+  for (int i = 0; i < _schema.index_field_size(); i++) {
+    const std::string& name = _schema.index_field(i).name();
+    auto found = _fields.find(name);
+    if (found == _fields.end()) {
+      ROBIMS_ERROR("No robims field:{} instance.", name);
+      return -1;
+    }
+    RobimsField* field = found->second.get();
+    if (!full && !field->IsDirty()) {
+      continue;
+    }
+    int rc = file_atomic_write(prefix + "." + name + ".field",
+                               [field](FILE* fp) { return field->Save(fp, false); });
+    if (0 != rc) {
+      ROBIMS_ERROR("Failed to save robims field:{} checkpoint.", name);
+      return rc;
+    }
+    field->ClearDirty();
+  }
+  return 0;
+}
+int RobimsTable::LoadCheckpoint(const std::string& dir, const TableSchema& schema) {
+  _schema = schema;
+  std::string prefix = dir + "/" + _schema.name();
+  std::string path = prefix + ".ids";
+  FILE* fp = fopen(path.c_str(), "r");
+  if (nullptr == fp) {
+    ROBIMS_ERROR("Failed to open table checkpoint:{}", path);
+    return -1;
+  }
+  int rc = _id_bitmap.Load(fp);
+  fclose(fp);
+  if (0 != rc) {
+    ROBIMS_ERROR("Failed to load table id bitmap from:{}", path);
+    return rc;
+  }
+  _fields.clear();
+  for (int i = 0; i < _schema.index_field_size(); i++) {
+    const auto& meta = _schema.index_field(i);
+    path = prefix + "." + meta.name() + ".field";
+    fp = fopen(path.c_str(), "r");
+    if (nullptr == fp) {
+      ROBIMS_ERROR("Failed to open field checkpoint:{}", path);
+      return -1;
+    }
+    std::unique_ptr<RobimsField> field(RobimsFieldBuilder::Build(this, meta));
+    if (!field) {
+      fclose(fp);
+      return -1;
+    }
+    rc = field->Load(fp);
+    fclose(fp);
+    if (0 != rc) {
+      ROBIMS_ERROR("Failed to load robims field:{} from:{}", meta.name(), path);
+      return rc;
+    }
+    _fields[field->GetFieldMeta().name()] = std::move(field);
+  }
+  return 0;
+}
 }  // namespace robims
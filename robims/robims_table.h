@@ -29,6 +29,7 @@
 
 #pragma once
 #include <stdint.h>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -53,8 +54,12 @@ class RobimsTable {
   RobimsFieldTable _fields;
   IDMapping* _id_mapping;
   RoaringBitmap _id_bitmap;
+  std::atomic<uint64_t> _version;
+  // id bitmap changed after last checkpoint
+  bool _ids_dirty = false;
 
   int GetLocalId(simdjson::ondemand::document& doc, uint32_t& id);
+  void IncVersion();
 
  public:
   RobimsTable(IDMapping* id_mapping);
@@ -62,6 +67,8 @@ class RobimsTable {
   const TableSchema& GetSchema();
   RoaringBitmap& GetTableBitmap();
   IDMapping* GetIDMapping();
+  // changed on every Put/Remove, unique across all tables in process.
+  uint64_t GetVersion() const { return _version.load(std::memory_order_acquire); }
   RobimsField* GetField(const std::string& name);
   int Init(const TableSchema& schema);
   int CreateTable(const std::string& schema);
@@ -71,5 +78,9 @@ class RobimsTable {
   // int Visit(const roaring_bitmap_t* b, const VisitOptions& options);
   int Save(FILE* fp, bool readonly);
   int Load(FILE* fp);
+  // save id bitmap and fields changed after last checkpoint(all if 'full') as separate files in
+  // 'dir', so checkpoint I/O is proportional to changes.
+  int SaveCheckpoint(const std::string& dir, bool full);
+  int LoadCheckpoint(const std::string& dir, const TableSchema& schema);
 };
 }  // namespace robims
\ No newline at end of file
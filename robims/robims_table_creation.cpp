@@ -134,6 +134,12 @@ int parse_talbe_creation_desc(const std::string& desc, TableSchema& schema) {
       ftype = FLOAT_INDEX;
     } else if (filed_type == "bool" || filed_type == "BOOL") {
       ftype = BOOL_INDEX;
+    } else if (filed_type == "int_column" || filed_type == "INT_COLUMN") {
+      ftype = INT_COLUMN;
+    } else if (filed_type == "float_column" || filed_type == "FLOAT_COLUMN") {
+      ftype = FLOAT_COLUMN;
+    } else if (filed_type == "string_column" || filed_type == "STRING_COLUMN") {
+      ftype = STRING_COLUMN;
     } else {
       ROBIMS_ERROR("Invalid field type:{} in {}", filed_type, desc);
       return -1;
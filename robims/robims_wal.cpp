@@ -0,0 +1,310 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "robims_wal.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include "folly/hash/Checksum.h"
+#include "robims_common.h"
+#include "robims_err.h"
+#include "robims_log.h"
+
+namespace robims {
+static const uint32_t kMaxWALRecordSize = 64 * 1024 * 1024;
+// lsn + op + table size + json size
+static const uint32_t kMinWALRecordSize = 8 + 1 + 4 + 4;
+
+static void wal_put_uint32(std::string& buf, uint32_t n) {
+  n = htonl(n);
+  buf.append((const char*)&n, sizeof(n));
+}
+static void wal_put_uint64(std::string& buf, uint64_t n) {
+  n = htonll(n);
+  buf.append((const char*)&n, sizeof(n));
+}
+static bool wal_get_uint32(std::string_view& buf, uint32_t& n) {
+  if (buf.size() < sizeof(n)) {
+    return false;
+  }
+  memcpy(&n, buf.data(), sizeof(n));
+  n = ntohl(n);
+  buf.remove_prefix(sizeof(n));
+  return true;
+}
+static bool wal_get_uint64(std::string_view& buf, uint64_t& n) {
+  if (buf.size() < sizeof(n)) {
+    return false;
+  }
+  memcpy(&n, buf.data(), sizeof(n));
+  n = ntohll(n);
+  buf.remove_prefix(sizeof(n));
+  return true;
+}
+static bool wal_get_string(std::string_view& buf, std::string& s) {
+  uint32_t n = 0;
+  if (!wal_get_uint32(buf, n) || buf.size() < n) {
+    return false;
+  }
+  s.assign(buf.data(), n);
+  buf.remove_prefix(n);
+  return true;
+}
+static int wal_write_all(int fd, const std::string& data) {
+  size_t offset = 0;
+  while (offset < data.size()) {
+    ssize_t n = write(fd, data.data() + offset, data.size() - offset);
+    if (n < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      ROBIMS_ERROR("Failed to write wal with errno:{}", errno);
+      return ROBIMS_ERR_IO;
+    }
+    offset += n;
+  }
+  return 0;
+}
+
+int RobimsWAL::ReadRecords(const std::string& path, uint64_t min_lsn, const ReplayFunc& func,
+                           uint64_t& valid_size, uint64_t& last_lsn) {
+  valid_size = 0;
+  last_lsn = 0;
+  FILE* fp = fopen(path.c_str(), "r");
+  if (nullptr == fp) {
+    if (ENOENT == errno) {
+      return 0;
+    }
+    ROBIMS_ERROR("Failed to open wal:{} with errno:{}", path, errno);
+    return ROBIMS_ERR_IO;
+  }
+  std::string payload;
+  std::string table, json;
+  while (true) {
+    uint32_t size = 0, crc = 0;
+    if (0 != file_read_uint32(fp, size) || 0 != file_read_uint32(fp, crc)) {
+      break;
+    }
+    if (size < kMinWALRecordSize || size > kMaxWALRecordSize) {
+      break;
+    }
+    payload.resize(size);
+    if (fread(&payload[0], size, 1, fp) != 1) {
+      break;
+    }
+    if (folly::crc32c((const uint8_t*)payload.data(), size) != crc) {
+      break;
+    }
+    std::string_view buf(payload);
+    uint64_t lsn = 0;
+    wal_get_uint64(buf, lsn);
+    uint8_t op = buf[0];
+    buf.remove_prefix(1);
+    if (!wal_get_string(buf, table) || !wal_get_string(buf, json)) {
+      break;
+    }
+    if (lsn > min_lsn && func) {
+      func(lsn, (WALOpType)op, table, json);
+    }
+    last_lsn = lsn;
+    valid_size += 2 * sizeof(uint32_t) + size;
+  }
+  fclose(fp);
+  return 0;
+}
+
+int RobimsWAL::Open(const std::string& path, const WALOptions& options, uint64_t min_lsn) {
+  uint64_t valid_size = 0, last_lsn = 0;
+  int rc = ReadRecords(path, UINT64_MAX, nullptr, valid_size, last_lsn);
+  if (0 != rc) {
+    return rc;
+  }
+  _fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (_fd < 0) {
+    ROBIMS_ERROR("Failed to open wal:{} with errno:{}", path, errno);
+    return ROBIMS_ERR_IO;
+  }
+  // drop torn record written by a crashed process
+  if (0 != ftruncate(_fd, valid_size)) {
+    ROBIMS_ERROR("Failed to truncate wal:{} to {} with errno:{}", path, valid_size, errno);
+    return ROBIMS_ERR_IO;
+  }
+  _path = path;
+  _options = options;
+  _written_lsn = std::max(last_lsn, min_lsn);
+  _synced_lsn = _written_lsn;
+  _next_lsn = _written_lsn + 1;
+  if (WAL_SYNC_INTERVAL == _options.sync_policy) {
+    _sync_thread = std::thread(&RobimsWAL::SyncLoop, this);
+  }
+  ROBIMS_INFO("Open wal:{} with size:{}, last lsn:{}", path, valid_size, last_lsn);
+  return 0;
+}
+
+int RobimsWAL::Replay(uint64_t min_lsn, const ReplayFunc& func) {
+  int rc = Commit(LastLSN());
+  if (0 != rc) {
+    return rc;
+  }
+  uint64_t valid_size = 0, last_lsn = 0;
+  return ReadRecords(_path, min_lsn, func, valid_size, last_lsn);
+}
+
+uint64_t RobimsWAL::Append(WALOpType op, std::string_view table, std::string_view json) {
+  std::lock_guard<std::mutex> guard(_mutex);
+  uint64_t lsn = _next_lsn++;
+  std::string payload;
+  payload.reserve(kMinWALRecordSize + table.size() + json.size());
+  wal_put_uint64(payload, lsn);
+  payload.push_back((char)op);
+  wal_put_uint32(payload, table.size());
+  payload.append(table.data(), table.size());
+  wal_put_uint32(payload, json.size());
+  payload.append(json.data(), json.size());
+  wal_put_uint32(_buffer, payload.size());
+  wal_put_uint32(_buffer, folly::crc32c((const uint8_t*)payload.data(), payload.size()));
+  _buffer.append(payload);
+  return lsn;
+}
+
+int RobimsWAL::Commit(uint64_t lsn) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (_written_lsn < lsn && 0 == _error) {
+    if (_flushing) {
+      _cond.wait(lock);
+      continue;
+    }
+    // become the leader, write records of all waiting writers at once
+    _flushing = true;
+    std::string data;
+    data.swap(_buffer);
+    uint64_t target_lsn = _next_lsn - 1;
+    lock.unlock();
+    int rc = wal_write_all(_fd, data);
+    if (0 == rc && WAL_SYNC_ALWAYS == _options.sync_policy && 0 != fdatasync(_fd)) {
+      ROBIMS_ERROR("Failed to sync wal:{} with errno:{}", _path, errno);
+      rc = ROBIMS_ERR_IO;
+    }
+    lock.lock();
+    _flushing = false;
+    if (0 != rc) {
+      _error = rc;
+    } else {
+      _written_lsn = target_lsn;
+      if (WAL_SYNC_ALWAYS == _options.sync_policy) {
+        _synced_lsn = target_lsn;
+      }
+    }
+    _cond.notify_all();
+  }
+  return _error;
+}
+
+int RobimsWAL::Truncate() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _cond.wait(lock, [this]() { return !_flushing; });
+  _buffer.clear();
+  _written_lsn = _next_lsn - 1;
+  _synced_lsn = _written_lsn;
+  _cond.notify_all();
+  if (0 != ftruncate(_fd, 0) || 0 != fsync(_fd)) {
+    ROBIMS_ERROR("Failed to truncate wal:{} with errno:{}", _path, errno);
+    return ROBIMS_ERR_IO;
+  }
+  return 0;
+}
+
+void RobimsWAL::AdvanceLSN(uint64_t min_lsn) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _cond.wait(lock, [this]() { return !_flushing; });
+  if (_next_lsn > min_lsn) {
+    return;
+  }
+  // buffered records keep their lsn, they are written before any new one
+  if (_buffer.empty()) {
+    _written_lsn = min_lsn;
+    _synced_lsn = std::max(_synced_lsn, min_lsn);
+  }
+  _next_lsn = min_lsn + 1;
+}
+
+// sync records written by committers in background, so that they are durable within
+// 'sync_interval_ms' even if no more records are committed.
+void RobimsWAL::SyncLoop() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (!_closing) {
+    _sync_cond.wait_for(lock, std::chrono::milliseconds(_options.sync_interval_ms),
+                        [this]() { return _closing; });
+    if (_written_lsn <= _synced_lsn || 0 != _error) {
+      continue;
+    }
+    uint64_t target_lsn = _written_lsn;
+    lock.unlock();
+    int rc = fdatasync(_fd);
+    lock.lock();
+    if (0 != rc) {
+      ROBIMS_ERROR("Failed to sync wal:{} with errno:{}", _path, errno);
+      _error = ROBIMS_ERR_IO;
+      _cond.notify_all();
+    } else {
+      _synced_lsn = std::max(_synced_lsn, target_lsn);
+    }
+  }
+}
+
+uint64_t RobimsWAL::LastLSN() {
+  std::lock_guard<std::mutex> guard(_mutex);
+  return _next_lsn - 1;
+}
+
+uint64_t RobimsWAL::SyncedLSN() {
+  std::lock_guard<std::mutex> guard(_mutex);
+  return _synced_lsn;
+}
+
+RobimsWAL::~RobimsWAL() {
+  if (_sync_thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(_mutex);
+      _closing = true;
+    }
+    _sync_cond.notify_all();
+    _sync_thread.join();
+  }
+  if (_fd >= 0) {
+    Commit(LastLSN());
+    fdatasync(_fd);
+    close(_fd);
+  }
+}
+}  // namespace robims
@@ -0,0 +1,108 @@
+/*
+ *Copyright (c) 2021, qiyingwang <qiyingwang@tencent.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of rimos nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace robims {
+enum WALOpType {
+  WAL_OP_PUT = 1,
+  WAL_OP_REMOVE = 2,
+};
+enum WALSyncPolicy {
+  // only write to os page cache, records may lost if the machine crashes.
+  WAL_SYNC_NONE = 0,
+  // fdatasync written records every 'sync_interval_ms' by a background thread.
+  WAL_SYNC_INTERVAL = 1,
+  // fdatasync every commit group.
+  WAL_SYNC_ALWAYS = 2,
+};
+struct WALOptions {
+  WALSyncPolicy sync_policy = WAL_SYNC_INTERVAL;
+  uint32_t sync_interval_ms = 1000;
+};
+
+// Append only log of Put/Remove ops, each record is:
+//   [uint32 payload size][uint32 crc32c][payload: uint64 lsn, uint8 op, string table, string json]
+// Records are appended to a memory buffer under db write lock, and written by 'Commit' outside of
+// it, the first committer writes/syncs the whole buffer for all waiting writers(group commit).
+class RobimsWAL {
+ public:
+  typedef std::function<void(uint64_t lsn, WALOpType op, const std::string& table,
+                             const std::string& json)>
+      ReplayFunc;
+  RobimsWAL() = default;
+  RobimsWAL(const RobimsWAL&) = delete;
+  RobimsWAL& operator=(const RobimsWAL&) = delete;
+  // open or create the log file, torn records at the tail are truncated.
+  // lsn of new records is larger than both 'min_lsn' and the last lsn in file.
+  int Open(const std::string& path, const WALOptions& options, uint64_t min_lsn);
+  // visit records with lsn > 'min_lsn' in order.
+  int Replay(uint64_t min_lsn, const ReplayFunc& func);
+  // buffer the record and return its lsn.
+  uint64_t Append(WALOpType op, std::string_view table, std::string_view json);
+  // wait until record with 'lsn' is written(and synced by policy).
+  int Commit(uint64_t lsn);
+  // drop all records, called after a checkpoint includes them, lsn keeps increasing.
+  int Truncate();
+  // make lsn of new records larger than 'min_lsn', called after loading data saved at 'min_lsn'.
+  void AdvanceLSN(uint64_t min_lsn);
+  uint64_t LastLSN();
+  // last lsn known to be on disk.
+  uint64_t SyncedLSN();
+  ~RobimsWAL();
+
+ private:
+  std::string _path;
+  WALOptions _options;
+  int _fd = -1;
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  std::string _buffer;
+  uint64_t _next_lsn = 1;
+  uint64_t _written_lsn = 0;
+  uint64_t _synced_lsn = 0;
+  bool _flushing = false;
+  bool _closing = false;
+  int _error = 0;
+  std::condition_variable _sync_cond;
+  std::thread _sync_thread;
+
+  void SyncLoop();
+
+  static int ReadRecords(const std::string& path, uint64_t min_lsn, const ReplayFunc& func,
+                         uint64_t& valid_size, uint64_t& last_lsn);
+};
+}  // namespace robims
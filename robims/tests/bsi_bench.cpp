@@ -0,0 +1,79 @@
+#include <benchmark/benchmark.h>
+#include <stdio.h>
+#include <memory>
+#include "robims_bsi.h"
+#include "robims_common.h"
+using namespace robims;
+
+static const uint32_t kBenchIds = 1000000;
+
+// the same index saved as readonly is evaluated by the fused chunk kernel.
+static BitSliceIntIndex* get_bench_index(bool readonly) {
+  static std::unique_ptr<BitSliceIntIndex> mutable_index, readonly_index;
+  if (!mutable_index) {
+    FieldMeta opt;
+    opt.set_min(0);
+    opt.set_max(65535);
+    mutable_index.reset(new BitSliceIntIndex);
+    mutable_index->Init(opt);
+    for (uint32_t i = 0; i < kBenchIds; i++) {
+      mutable_index->Put(i, (i * 7919) % 65536);
+    }
+    FILE* fp = tmpfile();
+    mutable_index->Save(fp, true);
+    rewind(fp);
+    readonly_index.reset(new BitSliceIntIndex);
+    readonly_index->Init(opt);
+    readonly_index->Load(fp);
+    fclose(fp);
+  }
+  return readonly ? readonly_index.get() : mutable_index.get();
+}
+
+static void BM_bsi_lt(benchmark::State& state) {
+  BitSliceIntIndex* index = get_bench_index(state.range(0) > 0);
+  for (auto _ : state) {
+    BitMapCacheGuard guard;
+    roaring_bitmap_t* out = acquire_bitmap();
+    guard.Add(out);
+    index->RangeLT(10000, false, out);
+    benchmark::DoNotOptimize(out);
+  }
+}
+static void BM_bsi_gt(benchmark::State& state) {
+  BitSliceIntIndex* index = get_bench_index(state.range(0) > 0);
+  for (auto _ : state) {
+    BitMapCacheGuard guard;
+    roaring_bitmap_t* out = acquire_bitmap();
+    guard.Add(out);
+    index->RangeGT(50000, true, out);
+    benchmark::DoNotOptimize(out);
+  }
+}
+static void BM_bsi_between(benchmark::State& state) {
+  BitSliceIntIndex* index = get_bench_index(state.range(0) > 0);
+  for (auto _ : state) {
+    BitMapCacheGuard guard;
+    roaring_bitmap_t* out = acquire_bitmap();
+    guard.Add(out);
+    index->RangeBetween(20000, 30000, out);
+    benchmark::DoNotOptimize(out);
+  }
+}
+static void BM_bsi_between_filter(benchmark::State& state) {
+  BitSliceIntIndex* index = get_bench_index(state.range(0) > 0);
+  for (auto _ : state) {
+    BitMapCacheGuard guard;
+    roaring_bitmap_t* out = acquire_bitmap();
+    guard.Add(out);
+    roaring_bitmap_add_range(out, 0, kBenchIds / 10);
+    index->RangeBetween(20000, 30000, out);
+    benchmark::DoNotOptimize(out);
+  }
+}
+// arg 0: slice bitmap operations, arg 1: fused kernel on readonly slices
+BENCHMARK(BM_bsi_lt)->Arg(0)->Arg(1);
+BENCHMARK(BM_bsi_gt)->Arg(0)->Arg(1);
+BENCHMARK(BM_bsi_between)->Arg(0)->Arg(1);
+BENCHMARK(BM_bsi_between_filter)->Arg(0)->Arg(1);
+BENCHMARK_MAIN();
@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "robims_db.h"
+
+using namespace robims;
+
+// record i(0..99): age=i%10+1, score=i/2 only for even i, city=[sz] plus bj for i%4==0,
+// gender=m for even i, tags={a} for i%3==0, is_child for even i.
+static void fill_db(RobimsDB& db) {
+  EXPECT_EQ(0, db.CreateTable("test(id id, age int[1,150], score float, city set, gender mutex, "
+                              "tags weight_set, is_child bool, v int_column)"));
+  for (int i = 0; i < 100; i++) {
+    std::string json = "{\"id\":" + std::to_string(i + 1) +
+                       ",\"age\":" + std::to_string(i % 10 + 1) + ",\"v\":" + std::to_string(i);
+    if (i % 2 == 0) {
+      json += ",\"score\":" + std::to_string(i / 2);
+    }
+    json += i % 4 == 0 ? ",\"city\":[\"sz\",\"bj\"]" : ",\"city\":[\"sz\"]";
+    json += i % 2 == 0 ? ",\"gender\":\"m\"" : ",\"gender\":\"f\"";
+    if (i % 3 == 0) {
+      json += ",\"tags\":{\"a\":0.5}";
+    }
+    json += i % 2 == 0 ? ",\"is_child\":true}" : ",\"is_child\":false}";
+    EXPECT_EQ(0, db.Put("test", json));
+  }
+}
+
+static std::map<std::string, int64_t> count_by(RobimsDB& db, const std::string& query,
+                                               int64_t* total = nullptr) {
+  SelectResult result;
+  EXPECT_EQ(0, db.Select(query, 0, 0, result));
+  std::map<std::string, int64_t> counts;
+  for (size_t i = 0; i < result.buckets.size(); i++) {
+    counts[result.buckets[i].key] = result.buckets[i].count;
+    if (i > 0) {
+      // buckets are sorted by count
+      EXPECT_GE(result.buckets[i - 1].count, result.buckets[i].count);
+    }
+  }
+  if (nullptr != total) {
+    *total = result.total;
+  }
+  return counts;
+}
+
+TEST(AggregateTest, CountBy) {
+  RobimsDB db;
+  fill_db(db);
+  int64_t total = 0;
+  auto city = count_by(db, "count_by(test.city)", &total);
+  EXPECT_EQ(100, total);
+  EXPECT_EQ((std::map<std::string, int64_t>{{"sz", 100}, {"bj", 25}}), city);
+
+  auto gender = count_by(db, "count_by(test.gender, test.age > 5)", &total);
+  EXPECT_EQ(50, total);
+  EXPECT_EQ((std::map<std::string, int64_t>{{"m", 20}, {"f", 30}}), gender);
+
+  auto tags = count_by(db, "count_by(test.tags)");
+  EXPECT_EQ((std::map<std::string, int64_t>{{"a", 34}}), tags);
+
+  auto is_child = count_by(db, "count_by(test.is_child, test.age <= 3)", &total);
+  EXPECT_EQ(30, total);
+  EXPECT_EQ((std::map<std::string, int64_t>{{"1", 20}, {"0", 10}}), is_child);
+}
+
+TEST(AggregateTest, Sum) {
+  RobimsDB db;
+  fill_db(db);
+  SelectResult result;
+  EXPECT_EQ(0, db.Select("sum(test.age)", 0, 0, result));
+  ASSERT_EQ(1u, result.buckets.size());
+  EXPECT_EQ(100, result.buckets[0].count);
+  EXPECT_DOUBLE_EQ(550, result.buckets[0].value);
+
+  // records without a score are not counted
+  EXPECT_EQ(0, db.Select("sum(test.score)", 0, 0, result));
+  ASSERT_EQ(1u, result.buckets.size());
+  EXPECT_EQ(100, result.total);
+  EXPECT_EQ(50, result.buckets[0].count);
+  EXPECT_DOUBLE_EQ(1225, result.buckets[0].value);
+
+  EXPECT_EQ(0, db.Select("sum(test.score, test.age > 5)", 0, 0, result));
+  ASSERT_EQ(1u, result.buckets.size());
+  EXPECT_EQ(50, result.total);
+  EXPECT_EQ(20, result.buckets[0].count);
+  EXPECT_DOUBLE_EQ(520, result.buckets[0].value);
+}
+
+TEST(AggregateTest, Histogram) {
+  RobimsDB db;
+  fill_db(db);
+  SelectResult result;
+  EXPECT_EQ(0, db.Select("histogram(test.age, 5)", 0, 0, result));
+  ASSERT_EQ(5u, result.buckets.size());
+  for (size_t i = 0; i < result.buckets.size(); i++) {
+    EXPECT_EQ(20, result.buckets[i].count);
+    EXPECT_DOUBLE_EQ(1 + 2 * i, result.buckets[i].value);
+  }
+  EXPECT_EQ("[1,2]", result.buckets[0].key);
+  EXPECT_EQ("[9,10]", result.buckets[4].key);
+
+  // scores are 0..49 on even records
+  EXPECT_EQ(0, db.Select("histogram(test.score, 2)", 0, 0, result));
+  ASSERT_EQ(2u, result.buckets.size());
+  EXPECT_EQ(25, result.buckets[0].count);
+  EXPECT_EQ(25, result.buckets[1].count);
+
+  EXPECT_EQ(0, db.Select("histogram(test.score, 4, test.age <= 2)", 0, 0, result));
+  EXPECT_EQ(20, result.total);
+  int64_t count = 0;
+  for (const auto& bucket : result.buckets) {
+    count += bucket.count;
+  }
+  EXPECT_EQ(10, count);
+}
+
+TEST(AggregateTest, EmptyResultSet) {
+  RobimsDB db;
+  fill_db(db);
+  int64_t total = -1;
+  EXPECT_TRUE(count_by(db, "count_by(test.city, test.age > 100)", &total).empty());
+  EXPECT_EQ(0, total);
+  EXPECT_TRUE(count_by(db, "count_by(test.tags, test.age > 100)").empty());
+
+  SelectResult result;
+  EXPECT_EQ(0, db.Select("sum(test.age, test.age > 100)", 0, 0, result));
+  ASSERT_EQ(1u, result.buckets.size());
+  EXPECT_EQ(0, result.total);
+  EXPECT_EQ(0, result.buckets[0].count);
+  EXPECT_DOUBLE_EQ(0, result.buckets[0].value);
+
+  EXPECT_EQ(0, db.Select("histogram(test.age, 4, test.age > 100)", 0, 0, result));
+  EXPECT_EQ(0, result.total);
+  EXPECT_TRUE(result.buckets.empty());
+  // no record with age 2 has a score
+  EXPECT_EQ(0, db.Select("histogram(test.score, 4, test.age == 2)", 0, 0, result));
+  EXPECT_EQ(10, result.total);
+  EXPECT_TRUE(result.buckets.empty());
+
+  RobimsDB empty;
+  EXPECT_EQ(0, empty.CreateTable("test(id id, age int[1,150], city set)"));
+  EXPECT_TRUE(count_by(empty, "count_by(test.city)", &total).empty());
+  EXPECT_EQ(0, total);
+}
+
+TEST(AggregateTest, InvalidField) {
+  RobimsDB db;
+  fill_db(db);
+  SelectResult result;
+  // unknown field
+  EXPECT_NE(0, db.Select("count_by(test.none)", 0, 0, result));
+  EXPECT_NE(0, db.Select("sum(test.none, test.age > 5)", 0, 0, result));
+  // unsupported field types
+  EXPECT_NE(0, db.Select("sum(test.city)", 0, 0, result));
+  EXPECT_NE(0, db.Select("histogram(test.gender, 2)", 0, 0, result));
+  EXPECT_NE(0, db.Select("count_by(test.age)", 0, 0, result));
+  EXPECT_NE(0, db.Select("count_by(test.v)", 0, 0, result));
+  // invalid args
+  EXPECT_NE(0, db.Select("histogram(test.age, 0)", 0, 0, result));
+  EXPECT_NE(0, db.Select("histogram(test.age)", 0, 0, result));
+  EXPECT_NE(0, db.Select("count_by(test.city, test.age > 5, 1)", 0, 0, result));
+}
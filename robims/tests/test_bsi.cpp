@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
+#include <functional>
 #include "robims_bsi.h"
+#include "robims_bsi_kernel.h"
 #include "robims_common.h"
 
 using namespace robims;
@@ -102,4 +104,180 @@ TEST(BSITest, TopK) {
   for (int i = 0; i < 10; i++) {
     EXPECT_EQ(i + 90, ids[i]);
   }
-}
\ No newline at end of file
+}
+TEST(BSITest, PutMany) {
+  BitSliceIntIndex index;
+  FieldMeta opt;
+  index.Init(opt);
+
+  std::vector<uint32_t> ids;
+  std::vector<int64_t> vals;
+  for (int i = 0; i < 100; i++) {
+    ids.push_back(99 - i);
+    vals.push_back(99 - i);
+  }
+  // duplicate id, last value wins
+  ids.push_back(5);
+  vals.push_back(1000);
+  index.PutMany(ids, vals);
+
+  int64_t val;
+  EXPECT_EQ(true, index.Get(5, val));
+  EXPECT_EQ(1000, val);
+  EXPECT_EQ(true, index.Get(42, val));
+  EXPECT_EQ(42, val);
+
+  // update existing values
+  index.PutMany({42, 43}, {7, 43});
+  EXPECT_EQ(true, index.Get(42, val));
+  EXPECT_EQ(7, val);
+  std::vector<uint32_t> result;
+  bimap_get_ids([&](roaring_bitmap_t* out) { index.RangeEQ(7, out); }, result);
+  EXPECT_EQ(2, result.size());
+  EXPECT_EQ(7, result[0]);
+  EXPECT_EQ(42, result[1]);
+  bimap_get_ids([&](roaring_bitmap_t* out) { index.RangeGT(99, false, out); }, result);
+  EXPECT_EQ(1, result.size());
+  EXPECT_EQ(5, result[0]);
+}
+
+TEST(BSITest, TopKLimit) {
+  BitSliceIntIndex index;
+  FieldMeta opt;
+  opt.set_topk_limit(10);
+  index.Init(opt);
+
+  for (int i = 0; i < 50; i++) {
+    index.Put(i, 100 - i);
+  }
+  // id:0~9 have the largest values
+  std::vector<uint32_t> ids;
+  bimap_get_ids([&](roaring_bitmap_t* out) { index.RangeGT(0, false, out); }, ids);
+  EXPECT_EQ(10, ids.size());
+  EXPECT_EQ(0, ids[0]);
+  EXPECT_EQ(9, ids[9]);
+
+  // id:0 is updated to the min value, removed by next insert
+  index.Put(0, 1);
+  index.PutMany({100, 101}, {200, 201});
+  bimap_get_ids([&](roaring_bitmap_t* out) { index.RangeGT(0, false, out); }, ids);
+  EXPECT_EQ(10, ids.size());
+  int64_t val;
+  EXPECT_EQ(false, index.Get(0, val));
+  EXPECT_EQ(false, index.Get(9, val));
+  EXPECT_EQ(true, index.Get(101, val));
+  EXPECT_EQ(201, val);
+}
+
+TEST(BSITest, ReadonlyFusedRange) {
+  FieldMeta opt;
+  opt.set_min(0);
+  opt.set_max(1023);
+  BitSliceIntIndex index;
+  index.Init(opt);
+  // dense ids are saved as bitset containers, the tail & sparse ids are array containers.
+  for (uint32_t i = 0; i < 200000; i++) {
+    index.Put(i, (i * 7919) % 1024);
+  }
+  for (uint32_t i = 0; i < 100; i++) {
+    index.Put(1000000 + i * 100, i * 10);
+  }
+  FILE* fp = tmpfile();
+  ASSERT_EQ(0, index.Save(fp, true));
+  rewind(fp);
+  BitSliceIntIndex readonly;
+  readonly.Init(opt);
+  ASSERT_EQ(0, readonly.Load(fp));
+  fclose(fp);
+
+  std::vector<uint32_t> filter_ids;
+  for (uint32_t i = 0; i < 200000; i += 3) {
+    filter_ids.push_back(i);
+  }
+  filter_ids.push_back(1000000 + 500);
+  auto check = [&](const std::function<void(BitSliceIntIndex&, roaring_bitmap_t*)>& op) {
+    for (int with_filter = 0; with_filter < 2; with_filter++) {
+      std::vector<uint32_t> expect, actual;
+      bimap_get_ids(
+          [&](roaring_bitmap_t* out) {
+            if (with_filter) {
+              roaring_bitmap_add_many(out, filter_ids.size(), filter_ids.data());
+            }
+            op(index, out);
+          },
+          expect);
+      bimap_get_ids(
+          [&](roaring_bitmap_t* out) {
+            if (with_filter) {
+              roaring_bitmap_add_many(out, filter_ids.size(), filter_ids.data());
+            }
+            op(readonly, out);
+          },
+          actual);
+      EXPECT_FALSE(expect.empty());
+      EXPECT_EQ(expect, actual);
+    }
+  };
+  check([](BitSliceIntIndex& bsi, roaring_bitmap_t* out) { bsi.RangeLT(300, false, out); });
+  check([](BitSliceIntIndex& bsi, roaring_bitmap_t* out) { bsi.RangeLT(300, true, out); });
+  check([](BitSliceIntIndex& bsi, roaring_bitmap_t* out) { bsi.RangeGT(700, false, out); });
+  check([](BitSliceIntIndex& bsi, roaring_bitmap_t* out) { bsi.RangeGT(700, true, out); });
+  check([](BitSliceIntIndex& bsi, roaring_bitmap_t* out) { bsi.RangeEQ(500, out); });
+  check([](BitSliceIntIndex& bsi, roaring_bitmap_t* out) { bsi.RangeNEQ(500, out); });
+  check([](BitSliceIntIndex& bsi, roaring_bitmap_t* out) { bsi.RangeBetween(100, 600, out); });
+}
+
+TEST(BSITest, CompareChunkKernel) {
+  const uint32_t depth = 5;
+  std::vector<uint64_t> exist(kChunkWords), slices_data(depth * kChunkWords);
+  std::vector<uint32_t> vals(kChunkWords * 64);
+  const uint64_t* slices[depth];
+  for (uint32_t i = 0; i < depth; i++) {
+    slices[i] = slices_data.data() + i * kChunkWords;
+  }
+  for (uint32_t id = 0; id < vals.size(); id++) {
+    vals[id] = (id * 13) % 32;
+    if (id % 5 != 0) {
+      exist[id / 64] |= 1ull << (id % 64);
+      for (uint32_t i = 0; i < depth; i++) {
+        if ((vals[id] >> i) & 0x1) {
+          slices_data[i * kChunkWords + id / 64] |= 1ull << (id % 64);
+        }
+      }
+    }
+  }
+  std::vector<uint64_t> out(kChunkWords), scalar_out(kChunkWords);
+  for (int op = BSI_CMP_EQ; op <= BSI_CMP_BETWEEN; op++) {
+    bsi_compare_chunk(exist.data(), slices, depth, (BSICompareOp)op, 10, 20, out.data());
+    bsi_compare_chunk_scalar(exist.data(), slices, depth, (BSICompareOp)op, 10, 20,
+                             scalar_out.data());
+    EXPECT_EQ(scalar_out, out);
+    for (uint32_t id = 0; id < vals.size(); id++) {
+      bool matched = false;
+      if (id % 5 != 0) {
+        uint32_t v = vals[id];
+        switch (op) {
+          case BSI_CMP_EQ:
+            matched = (v == 10);
+            break;
+          case BSI_CMP_LT:
+            matched = (v < 10);
+            break;
+          case BSI_CMP_LE:
+            matched = (v <= 10);
+            break;
+          case BSI_CMP_GT:
+            matched = (v > 10);
+            break;
+          case BSI_CMP_GE:
+            matched = (v >= 10);
+            break;
+          default:
+            matched = (v >= 10 && v <= 20);
+            break;
+        }
+      }
+      ASSERT_EQ(matched, ((out[id / 64] >> (id % 64)) & 0x1) == 1) << "op:" << op << " id:" << id;
+    }
+  }
+}
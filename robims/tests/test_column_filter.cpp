@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+#include "robims_db.h"
+
+using namespace robims;
+
+struct Row {
+  int64_t age = 0;
+  int64_t cnt = 0;
+  double price = 0;
+  std::string city;
+  std::string name;
+  std::string alias;
+};
+typedef std::function<bool(const Row&)> RowPredicate;
+
+static const int kRows = 5000;
+
+static Row make_row(int i) {
+  std::vector<std::string> cities = {"sz", "bj", "sh"};
+  Row row;
+  row.age = i % 100 + 1;
+  row.cnt = i % 7;
+  row.price = i * 0.5;
+  row.city = cities[i % cities.size()];
+  row.name = "n" + std::to_string(i % 3);
+  row.alias = "n" + std::to_string(i % 5);
+  return row;
+}
+
+static void fill_db(RobimsDB& db) {
+  EXPECT_EQ(0, db.CreateTable(
+                   "test(id id, age int[1,150], city set, age_c int_column, cnt int_column, price "
+                   "float_column, name string_column, alias string_column)"));
+  for (int i = 0; i < kRows; i++) {
+    Row row = make_row(i);
+    std::string json = "{\"id\":" + std::to_string(i) + ",\"age\":" + std::to_string(row.age) +
+                       ",\"city\":[\"" + row.city + "\"],\"age_c\":" + std::to_string(row.age) +
+                       ",\"cnt\":" + std::to_string(row.cnt) +
+                       ",\"price\":" + std::to_string(row.price) + ",\"name\":\"" + row.name +
+                       "\",\"alias\":\"" + row.alias + "\"}";
+    EXPECT_EQ(0, db.Put("test", json));
+  }
+}
+
+static std::set<std::string> select_ids(RobimsDB& db, const std::string& query) {
+  std::set<std::string> ids;
+  EXPECT_EQ(0, db.SelectStream(query, [&](std::string_view id) {
+    ids.emplace(id);
+    return true;
+  }));
+  return ids;
+}
+
+// the row by row evaluation of the same predicate in c++
+static std::set<std::string> expected_ids(const std::string& city, const RowPredicate& pred) {
+  std::set<std::string> ids;
+  for (int i = 0; i < kRows; i++) {
+    Row row = make_row(i);
+    if (row.city == city && pred(row)) {
+      ids.emplace(std::to_string(i));
+    }
+  }
+  return ids;
+}
+
+static void check_filters(RobimsDB& db) {
+  // int column, same predicate answered by the bitmap index
+  std::set<std::string> by_index = select_ids(db, "test.city == \"sz\" && test.age > 50");
+  EXPECT_FALSE(by_index.empty());
+  EXPECT_EQ(by_index, select_ids(db, "filter(test.city == \"sz\", \"test.age_c > 50\")"));
+  EXPECT_EQ(by_index, expected_ids("sz", [](const Row& r) { return r.age > 50; }));
+
+  // float column mixed with int column
+  std::set<std::string> ids =
+      select_ids(db, "filter(test.city == \"bj\", \"test.price * test.cnt > 100\")");
+  EXPECT_FALSE(ids.empty());
+  EXPECT_EQ(expected_ids("bj", [](const Row& r) { return r.price * r.cnt > 100; }), ids);
+
+  // string columns
+  ids = select_ids(db, "filter(test.city == \"sh\", \"test.name == test.alias\")");
+  EXPECT_FALSE(ids.empty());
+  EXPECT_EQ(expected_ids("sh", [](const Row& r) { return r.name == r.alias; }), ids);
+
+  ids = select_ids(db,
+                   "filter(test.city == \"sz\" || test.city == \"bj\", \"test.age_c <= 10 && "
+                   "test.price >= 1000\")");
+  EXPECT_FALSE(ids.empty());
+  RowPredicate pred = [](const Row& r) { return r.age <= 10 && r.price >= 1000; };
+  std::set<std::string> expected = expected_ids("sz", pred);
+  for (const auto& id : expected_ids("bj", pred)) {
+    expected.emplace(id);
+  }
+  EXPECT_EQ(expected, ids);
+}
+
+TEST(ColumnFilterTest, FilterByColumnType) {
+  RobimsDB db;
+  fill_db(db);
+  check_filters(db);
+}
+
+TEST(ColumnFilterTest, MissingAndRemovedValues) {
+  RobimsDB db;
+  fill_db(db);
+  // columns not in the json are reset to default
+  EXPECT_EQ(0, db.Put("test", "{\"id\":0,\"city\":[\"sz\"],\"age\":60}"));
+  std::set<std::string> ids = select_ids(db, "filter(test.city == \"sz\", \"test.age_c == 0\")");
+  EXPECT_EQ(std::set<std::string>({"0"}), ids);
+  EXPECT_EQ(0, db.Remove("test", "{\"id\":0}"));
+  EXPECT_TRUE(select_ids(db, "filter(test.city == \"sz\", \"test.age_c == 0\")").empty());
+  // empty input bitmap
+  EXPECT_TRUE(select_ids(db, "filter(test.age > 140, \"test.age_c >= 0\")").empty());
+}
+
+TEST(ColumnFilterTest, InvalidFilter) {
+  RobimsDB db;
+  fill_db(db);
+  EXPECT_EQ(0, db.CreateTable("other(id id, v int_column)"));
+  SelectResult result;
+  // indexed field is not a column
+  EXPECT_NE(0, db.Select("filter(test.city == \"sz\", \"test.age > 50\")", 0, 10, result));
+  // columns of different tables
+  EXPECT_NE(0, db.Select("filter(test.city == \"sz\", \"test.age_c > other.v\")", 0, 10, result));
+  // no column referenced
+  EXPECT_NE(0, db.Select("filter(test.city == \"sz\", \"1 > 0\")", 0, 10, result));
+}
+
+TEST(ColumnFilterTest, SaveLoad) {
+  std::string path = std::string("/tmp/robims_test_column_") + std::to_string(getpid());
+  {
+    RobimsDB db;
+    fill_db(db);
+    EXPECT_EQ(0, db.Save(path, false));
+  }
+  {
+    RobimsDB db;
+    EXPECT_EQ(0, db.Load(path));
+    check_filters(db);
+    // loaded columns are still writable, the missing string columns are saved as empty
+    EXPECT_EQ(0, db.Put("test", "{\"id\":1,\"city\":[\"bj\"],\"price\":1000.5,\"cnt\":2}"));
+    EXPECT_EQ(1, select_ids(db, "filter(test.city == \"bj\", \"test.price > 1000 && test.cnt == 2 "
+                                "&& test.age_c == 0\")")
+                     .count("1"));
+    EXPECT_EQ(0, db.Save(path, true));
+  }
+  RobimsDB db;
+  EXPECT_EQ(0, db.Load(path));
+  EXPECT_EQ(1, select_ids(db, "filter(test.city == \"bj\", \"test.price > 1000 && test.cnt == 2 "
+                              "&& test.age_c == 0\")")
+                   .count("1"));
+  unlink(path.c_str());
+}
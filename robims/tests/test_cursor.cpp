@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <set>
+#include <string>
+#include <vector>
+#include "robims_db.h"
+#include "robims_db_impl.h"
+#include "robims_err.h"
+
+using namespace robims;
+
+static void fill_db(RobimsDBImpl& db, int n) {
+  EXPECT_EQ(0, db.CreateTable("test(id id, age int[1,150], city set)"));
+  std::vector<std::string> cities = {"sz", "bj", "sh"};
+  for (int i = 0; i < n; i++) {
+    std::string json = "{\"id\":" + std::to_string(i + 1) + ",\"age\":" + std::to_string(i % 100 + 1) +
+                       ",\"city\":[\"" + cities[i % cities.size()] + "\"]}";
+    EXPECT_EQ(0, db.Put("test", json));
+  }
+}
+
+static std::vector<std::string> fetch(RobimsDBImpl& db, uint64_t cursor, int64_t limit,
+                                      int* rc = nullptr) {
+  std::vector<std::string> ids;
+  int ret = db.FetchCursor(cursor, limit, [&ids](std::string_view id) {
+    ids.emplace_back(id);
+    return true;
+  });
+  if (nullptr != rc) {
+    *rc = ret;
+  } else {
+    EXPECT_EQ(0, ret);
+  }
+  return ids;
+}
+
+static std::vector<std::string> stream(RobimsDBImpl& db, const std::string& query) {
+  std::vector<std::string> ids;
+  EXPECT_EQ(0, db.SelectStream(
+                   query,
+                   [&ids](std::string_view id) {
+                     ids.emplace_back(id);
+                     return true;
+                   },
+                   nullptr));
+  return ids;
+}
+
+TEST(CursorTest, Paging) {
+  RobimsDBImpl db(SIMPLE_ID_MAPPING);
+  fill_db(db, 1000);
+  const std::string query = "test.city == \"sz\" && test.age > 50";
+  std::vector<std::string> expected = stream(db, query);
+  ASSERT_FALSE(expected.empty());
+
+  uint64_t cursor = 0;
+  SelectResult result;
+  EXPECT_EQ(0, db.OpenCursor(query, 60000, cursor, result));
+  EXPECT_EQ((int64_t)expected.size(), result.total);
+  EXPECT_TRUE(result.ids.empty());
+  std::vector<std::string> all;
+  while (true) {
+    std::vector<std::string> page = fetch(db, cursor, 7);
+    if (page.empty()) {
+      break;
+    }
+    EXPECT_LE(page.size(), 7u);
+    all.insert(all.end(), page.begin(), page.end());
+  }
+  EXPECT_EQ(expected, all);
+  // stays exhausted
+  EXPECT_TRUE(fetch(db, cursor, 7).empty());
+  EXPECT_EQ(0, db.CloseCursor(cursor));
+  int rc = 0;
+  fetch(db, cursor, 7, &rc);
+  EXPECT_EQ(ROBIMS_ERR_NOTFOUND, rc);
+  EXPECT_EQ(ROBIMS_ERR_NOTFOUND, db.CloseCursor(cursor));
+
+  // aggregation can not be paged
+  EXPECT_EQ(ROBIMS_ERR_INVALID_ARGS, db.OpenCursor("count_by(test.city)", 60000, cursor, result));
+}
+
+TEST(CursorTest, SnapshotAcrossWrites) {
+  RobimsDBImpl db(SIMPLE_ID_MAPPING);
+  fill_db(db, 1000);
+  const std::string query = "test.city == \"sz\"";
+  std::vector<std::string> expected = stream(db, query);
+  uint64_t cursor = 0;
+  SelectResult result;
+  EXPECT_EQ(0, db.OpenCursor(query, 60000, cursor, result));
+  std::vector<std::string> all = fetch(db, cursor, 10);
+  // add, update and remove records matched by the query while paging
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(0, db.Put("test", "{\"id\":" + std::to_string(2000 + i) + ",\"city\":[\"sz\"]}"));
+    EXPECT_EQ(0, db.Put("test", "{\"id\":" + std::to_string(3 * i + 1) + ",\"city\":[\"bj\"]}"));
+    EXPECT_EQ(0, db.Remove("test", "{\"id\":" + std::to_string(3 * i + 301) + "}"));
+  }
+  EXPECT_NE(expected, stream(db, query));
+  while (true) {
+    std::vector<std::string> page = fetch(db, cursor, 64);
+    if (page.empty()) {
+      break;
+    }
+    all.insert(all.end(), page.begin(), page.end());
+  }
+  EXPECT_EQ(expected, all);
+  EXPECT_EQ(0, db.CloseCursor(cursor));
+}
+
+TEST(CursorTest, Expire) {
+  RobimsDBImpl db(SIMPLE_ID_MAPPING);
+  fill_db(db, 100);
+  uint64_t idle = 0, active = 0;
+  SelectResult result;
+  EXPECT_EQ(0, db.OpenCursor("test.city == \"sz\"", 200, idle, result));
+  EXPECT_EQ(0, db.OpenCursor("test.city == \"sz\"", 200, active, result));
+  EXPECT_EQ(2u, db.GetCursorCount());
+  // fetching refreshes the ttl
+  for (int i = 0; i < 4; i++) {
+    usleep(100 * 1000);
+    EXPECT_EQ(1u, fetch(db, active, 1).size());
+  }
+  int rc = 0;
+  fetch(db, idle, 1, &rc);
+  EXPECT_EQ(ROBIMS_ERR_NOTFOUND, rc);
+  EXPECT_EQ(1u, db.GetCursorCount());
+
+  // expired cursors are swept by selects and writes without any later cursor call
+  usleep(300 * 1000);
+  EXPECT_EQ(1u, db.GetCursorCount());
+  SelectResult select_result;
+  EXPECT_EQ(0, db.Select("test.city == \"bj\"", 0, 10, select_result));
+  EXPECT_EQ(0u, db.GetCursorCount());
+
+  EXPECT_EQ(0, db.OpenCursor("test.city == \"sz\"", 100, idle, result));
+  usleep(250 * 1000);
+  EXPECT_EQ(0, db.Put("test", "{\"id\":1000,\"city\":[\"sz\"]}"));
+  EXPECT_EQ(0u, db.GetCursorCount());
+}
+
+TEST(SelectStreamTest, VisitAndStop) {
+  RobimsDBImpl db(SIMPLE_ID_MAPPING);
+  fill_db(db, 1000);
+  const std::string query = "test.city == \"bj\" && test.age <= 10";
+  SelectResult result;
+  EXPECT_EQ(0, db.Select(query, 0, 1000, result));
+  int64_t total = 0;
+  std::vector<std::string> ids;
+  EXPECT_EQ(0, db.SelectStream(
+                   query,
+                   [&ids](std::string_view id) {
+                     ids.emplace_back(id);
+                     return true;
+                   },
+                   &total));
+  EXPECT_EQ(result.total, total);
+  EXPECT_EQ(result.ids, ids);
+
+  std::vector<std::string> first;
+  EXPECT_EQ(0, db.SelectStream(
+                   query,
+                   [&first](std::string_view id) {
+                     first.emplace_back(id);
+                     return first.size() < 3;
+                   },
+                   nullptr));
+  EXPECT_EQ(std::vector<std::string>(ids.begin(), ids.begin() + 3), first);
+
+  EXPECT_EQ(ROBIMS_ERR_INVALID_ARGS,
+            db.SelectStream("count_by(test.city)", [](std::string_view) { return true; }, nullptr));
+  EXPECT_NE(0, db.SelectStream("test.none == 1", [](std::string_view) { return true; }, nullptr));
+}
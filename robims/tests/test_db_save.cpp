@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "robims_db.h"
+
+using namespace robims;
+static std::string save_path(const char* name) {
+  std::string path = std::string("/tmp/robims_test_") + name + "_" + std::to_string(getpid());
+  unlink(path.c_str());
+  return path;
+}
+
+static void fill_db(RobimsDB& db, int n) {
+  EXPECT_EQ(0, db.CreateTable("test(id id, age int[1,150], city set, score float, is_child bool)"));
+  std::vector<std::string> cities = {"sz", "bj", "sh"};
+  for (int i = 0; i < n; i++) {
+    std::string json = "{\"id\":" + std::to_string(i + 1) + ",\"age\":" + std::to_string(i % 100 + 1) +
+                       ",\"city\":[\"" + cities[i % cities.size()] + "\"],\"score\":" +
+                       std::to_string(i * 0.5) + ",\"is_child\":" + (i % 2 == 0 ? "true" : "false") +
+                       "}";
+    EXPECT_EQ(0, db.Put("test", json));
+  }
+}
+
+static int64_t count(RobimsDB& db, const std::string& query) {
+  SelectResult result;
+  EXPECT_EQ(0, db.Select(query, 0, 10, result));
+  return result.total;
+}
+
+TEST(DBSaveTest, SaveOverLoadedImage) {
+  std::string path = save_path("image");
+  {
+    RobimsDB db;
+    fill_db(db, 100000);
+    EXPECT_EQ(0, db.Save(path, true));
+  }
+  const std::string query = "test.age > 50 && test.city == \"sz\" && test.is_child==1";
+  RobimsDB db;
+  EXPECT_EQ(0, db.Load(path));
+  int64_t expected = count(db, query);
+  EXPECT_GT(expected, 0);
+  // bitmaps of 'db' still view the mmaped image while the file is replaced
+  EXPECT_EQ(0, db.Save(path, true));
+  EXPECT_EQ(expected, count(db, query));
+  EXPECT_EQ(0, db.Save(path, true));
+  EXPECT_EQ(expected, count(db, query));
+  EXPECT_NE(0, access((path + ".tmp").c_str(), F_OK));
+
+  RobimsDB reloaded;
+  EXPECT_EQ(0, reloaded.Load(path));
+  EXPECT_EQ(expected, count(reloaded, query));
+  unlink(path.c_str());
+}
+
+TEST(DBSaveTest, SaveTableOverLoadedImage) {
+  std::string path = save_path("table");
+  {
+    RobimsDB db;
+    fill_db(db, 50000);
+    EXPECT_EQ(0, db.Save(path, true));
+  }
+  const std::string query = "test.age < 30 && test.city == \"bj\"";
+  RobimsDB db;
+  EXPECT_EQ(0, db.Load(path));
+  int64_t expected = count(db, query);
+  EXPECT_GT(expected, 0);
+  EXPECT_EQ(0, db.SaveTable(path, "test", true));
+  EXPECT_EQ(expected, count(db, query));
+  EXPECT_EQ(0, db.SaveTable(path, "test", false));
+  EXPECT_EQ(expected, count(db, query));
+  struct stat st;
+  EXPECT_EQ(0, stat(path.c_str(), &st));
+  // failed save keeps the old file
+  EXPECT_NE(0, db.SaveTable(path, "none", true));
+  struct stat after;
+  EXPECT_EQ(0, stat(path.c_str(), &after));
+  EXPECT_EQ(st.st_ino, after.st_ino);
+  EXPECT_EQ(st.st_size, after.st_size);
+  EXPECT_NE(0, access((path + ".tmp").c_str(), F_OK));
+  unlink(path.c_str());
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <set>
+#include <vector>
+#include "robims_common.h"
+
+using namespace robims;
+
+// key 0: bitset, key 1: array, key 2: run, key 4: bitset, key 5: array
+static void fill_bitmap(RoaringBitmap& bitmap) {
+  bitmap.NewCRoaringBitmap();
+  for (uint32_t v = 0; v < 65536; v += 3) {
+    bitmap.Put(v);
+  }
+  for (uint32_t v = 65536; v < 65536 + 1000; v += 11) {
+    bitmap.Put(v);
+  }
+  roaring_bitmap_add_range(bitmap.bitmap.get(), 2 * 65536 + 100, 2 * 65536 + 50000);
+  for (uint32_t v = 4 * 65536; v < 5 * 65536; v += 5) {
+    bitmap.Put(v);
+  }
+  bitmap.Put(5 * 65536 + 65535);
+}
+
+static bool frozen_bit(const FrozenBitsetContainer& c, uint32_t low) {
+  return (c.words[low >> 6] >> (low & 63)) & 1;
+}
+
+TEST(FrozenBitsetTest, MatchContains) {
+  RoaringBitmap bitmap;
+  fill_bitmap(bitmap);
+  std::vector<FrozenBitsetContainer> bitsets;
+  std::vector<uint16_t> other_keys;
+  // not frozen
+  EXPECT_FALSE(bitmap.GetFrozenBitsets(bitsets, other_keys));
+
+  FILE* fp = tmpfile();
+  ASSERT_NE(nullptr, fp);
+  ASSERT_EQ(0, bitmap.Save(fp, true));
+  rewind(fp);
+  RoaringBitmap frozen;
+  ASSERT_EQ(0, frozen.Load(fp));
+  fclose(fp);
+  EXPECT_TRUE(frozen.IsReadonly());
+  ASSERT_TRUE(frozen.GetFrozenBitsets(bitsets, other_keys));
+
+  std::set<uint16_t> bitset_keys;
+  for (const FrozenBitsetContainer& c : bitsets) {
+    bitset_keys.insert(c.key);
+    for (uint32_t low = 0; low < 65536; low++) {
+      uint32_t v = ((uint32_t)c.key << 16) | low;
+      ASSERT_EQ(roaring_bitmap_contains(bitmap.bitmap.get(), v), frozen_bit(c, low)) << v;
+    }
+  }
+  // dense containers are bitsets, sparse ones never are
+  EXPECT_EQ(1u, bitset_keys.count(0));
+  EXPECT_EQ(1u, bitset_keys.count(4));
+  EXPECT_EQ(0u, bitset_keys.count(1));
+  EXPECT_EQ(0u, bitset_keys.count(5));
+  std::set<uint16_t> all_keys(bitset_keys);
+  for (uint16_t key : other_keys) {
+    EXPECT_EQ(0u, bitset_keys.count(key));
+    all_keys.insert(key);
+  }
+  EXPECT_EQ((std::set<uint16_t>{0, 1, 2, 4, 5}), all_keys);
+  EXPECT_EQ(bitsets.size() + other_keys.size(), all_keys.size());
+}
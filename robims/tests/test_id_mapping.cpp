@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include "robims_compact_id_mapping.h"
+
+using namespace robims;
+TEST(IDMappingTest, CompactPutGet) {
+  std::unique_ptr<IDMapping> mapping(new CompactIDMapping);
+  for (int i = 0; i < 10000; i++) {
+    uint32_t local_id = 0;
+    EXPECT_EQ(0, mapping->GetLocalID("id_" + std::to_string(i), true, local_id));
+    EXPECT_EQ(i, local_id);
+  }
+  uint32_t local_id = 0;
+  EXPECT_EQ(0, mapping->GetLocalID("id_100", false, local_id));
+  EXPECT_EQ(100, local_id);
+  EXPECT_EQ(-1, mapping->GetLocalID("id_none", false, local_id));
+  std::string_view id;
+  EXPECT_EQ(0, mapping->GetID(9999, id));
+  EXPECT_EQ("id_9999", id);
+  EXPECT_EQ(-1, mapping->GetID(10000, id));
+}
+
+TEST(IDMappingTest, CompactSaveLoad) {
+  std::unique_ptr<IDMapping> mapping(new CompactIDMapping);
+  for (int i = 0; i < 1000; i++) {
+    uint32_t local_id = 0;
+    mapping->GetLocalID("id_" + std::to_string(i), true, local_id);
+  }
+  FILE* fp = tmpfile();
+  EXPECT_EQ(0, mapping->Save(fp, true));
+  rewind(fp);
+  std::unique_ptr<IDMapping> loaded(new CompactIDMapping);
+  EXPECT_EQ(0, loaded->Load(fp));
+  fclose(fp);
+  uint32_t local_id = 0;
+  EXPECT_EQ(0, loaded->GetLocalID("id_500", false, local_id));
+  EXPECT_EQ(500, local_id);
+  EXPECT_EQ(0, loaded->GetLocalID("id_1000", true, local_id));
+  EXPECT_EQ(1000, local_id);
+  std::string_view id;
+  EXPECT_EQ(0, loaded->GetID(999, id));
+  EXPECT_EQ("id_999", id);
+}
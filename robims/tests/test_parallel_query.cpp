@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "robims_db.h"
+
+using namespace robims;
+
+static void fill_db(RobimsDB& db, int n) {
+  EXPECT_EQ(0, db.CreateTable("test(id id, age int[1,150], city set)"));
+  std::vector<std::string> cities = {"sz", "bj", "sh"};
+  for (int i = 0; i < n; i++) {
+    std::string json = "{\"id\":" + std::to_string(i + 1) + ",\"age\":" + std::to_string(i % 100 + 1) +
+                       ",\"city\":[\"" + cities[i % cities.size()] + "\"]}";
+    EXPECT_EQ(0, db.Put("test", json));
+  }
+}
+
+TEST(ParallelQueryTest, ToggleWhileSelecting) {
+  RobimsDB db;
+  db.EnableThreadSafe();
+  // 4 containers of local ids
+  fill_db(db, 4 * 65536);
+  const std::string query = "test.age > 50 && test.city == \"sz\"";
+  SelectResult serial;
+  EXPECT_EQ(0, db.Select(query, 0, 10, serial));
+  EXPECT_GT(serial.total, 0);
+
+  std::atomic<bool> stop(false);
+  std::atomic<int> mismatches(0);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; i++) {
+    readers.emplace_back([&]() {
+      while (!stop.load()) {
+        SelectResult result;
+        if (0 != db.Select(query, 0, 10, result) || result.total != serial.total ||
+            result.ids != serial.ids) {
+          mismatches++;
+        }
+      }
+    });
+  }
+  for (int i = 0; i < 50; i++) {
+    db.EnableParallelQuery(4, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (i % 2 == 0) {
+      db.DisableParallelQuery();
+    }
+  }
+  stop = true;
+  for (auto& t : readers) {
+    t.join();
+  }
+  EXPECT_EQ(0, mismatches.load());
+  db.DisableParallelQuery();
+}
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "robims_db_impl.h"
+#include "robims_field.h"
+#include "robims_query.h"
+#include "robims_query_cache.h"
+#include "robims_table.h"
+
+using namespace robims;
+
+static void fill_db(RobimsDBImpl& db, int n) {
+  EXPECT_EQ(0, db.CreateTable("test(id id, age int[1,150], city set, is_child bool)"));
+  EXPECT_EQ(0, db.CreateTable("other(id id, age int[1,150])"));
+  std::vector<std::string> cities = {"sz", "bj", "sh"};
+  for (int i = 0; i < n; i++) {
+    std::string json = "{\"id\":" + std::to_string(i + 1) + ",\"age\":" + std::to_string(i % 100 + 1) +
+                       ",\"city\":[\"" + cities[i % cities.size()] + "\"],\"is_child\":" +
+                       (i % 2 == 0 ? "true" : "false") + "}";
+    EXPECT_EQ(0, db.Put("test", json));
+  }
+}
+
+static int64_t count(RobimsDBImpl& db, const std::string& query) {
+  SelectResult result;
+  EXPECT_EQ(0, db.Select(query, 0, 10, result));
+  return result.total;
+}
+
+static std::string normalized_key(RobimsDBImpl& db, const std::string& query) {
+  RobimsQuery q;
+  EXPECT_EQ(0, q.Init(&db, query));
+  return q.GetNormalizedKey();
+}
+
+// changes a field without bumping the table version, so only an uncached select sees it.
+static void put_city_bypass_version(RobimsDBImpl& db, uint32_t local_id, const std::string& city) {
+  RobimsField* field = db.GetTable("test")->GetField("city");
+  ASSERT_NE(nullptr, field);
+  EXPECT_EQ(0, field->Put(local_id, std::string_view(city)));
+}
+
+TEST(QueryCacheTest, NormalizeQuery) {
+  EXPECT_EQ("test.age>50&&test.city==\"s z\"",
+            normalize_query(" test.age > 50 &&\ttest.city ==  \"s z\"\n"));
+  EXPECT_EQ(normalize_query("test.age>50"), normalize_query("test.age  >  50"));
+  EXPECT_NE(normalize_query("test.city==\"sz\""), normalize_query("test.city==\"s z\""));
+}
+
+TEST(QueryCacheTest, NormalizedKey) {
+  RobimsDBImpl db(SIMPLE_ID_MAPPING);
+  fill_db(db, 10);
+  const std::string base = "test.age > 50 && test.city == \"sz\"";
+  EXPECT_EQ(normalized_key(db, base), normalized_key(db, "test.age>50&&test.city==\"sz\""));
+  // operands of a chain with only '&&' or only '||' are commutative
+  EXPECT_EQ(normalized_key(db, base), normalized_key(db, "test.city == \"sz\" && test.age > 50"));
+  EXPECT_EQ(normalized_key(db, "test.age > 50 || test.city == \"sz\" || test.is_child == 1"),
+            normalized_key(db, "test.is_child == 1 || test.city == \"sz\" || test.age > 50"));
+  EXPECT_EQ(normalized_key(db, "(test.age > 50 || test.city == \"sz\") && test.is_child == 1"),
+            normalized_key(db, "test.is_child == 1 && (test.city == \"sz\" || test.age > 50)"));
+  // order matters for '&&!' and for mixed chains evaluated from left to right
+  EXPECT_NE(normalized_key(db, "test.age > 50 &&! test.city == \"sz\""),
+            normalized_key(db, "test.city == \"sz\" &&! test.age > 50"));
+  EXPECT_NE(normalized_key(db, "test.age > 50 && test.city == \"sz\" || test.is_child == 1"),
+            normalized_key(db, "test.is_child == 1 || test.age > 50 && test.city == \"sz\""));
+  EXPECT_NE(normalized_key(db, "test.age > 50"), normalized_key(db, "test.age > 50.0"));
+  EXPECT_NE(normalized_key(db, "test.age > 50"), normalized_key(db, "test.age >= 50"));
+  EXPECT_NE(normalized_key(db, "test.city == \"sz\""), normalized_key(db, "test.city == \"bj\""));
+}
+
+TEST(QueryCacheTest, ResultCacheHit) {
+  RobimsDBImpl db(SIMPLE_ID_MAPPING);
+  fill_db(db, 300);
+  db.EnableResultCache(16);
+  const std::string query = "test.city == \"sz\" || test.city == \"bj\"";
+  int64_t expected = count(db, query);
+  EXPECT_EQ(200, expected);
+  put_city_bypass_version(db, 100000, "sz");
+  // served from cache, including queries only differ in blanks or operand order
+  EXPECT_EQ(expected, count(db, query));
+  EXPECT_EQ(expected, count(db, "test.city==\"sz\"||test.city==\"bj\""));
+  EXPECT_EQ(expected, count(db, "test.city == \"bj\" || test.city == \"sz\""));
+  // writes to tables not referenced by the query keep the cached result
+  EXPECT_EQ(0, db.Put("other", "{\"id\":1,\"age\":10}"));
+  EXPECT_EQ(expected, count(db, query));
+  // a query not cached yet sees the change
+  EXPECT_EQ(expected + 1, count(db, "test.city == \"sz\" || test.city == \"sh\""));
+  db.DisableResultCache();
+  EXPECT_EQ(expected + 1, count(db, query));
+}
+
+TEST(QueryCacheTest, InvalidateOnWrite) {
+  RobimsDBImpl db(SIMPLE_ID_MAPPING);
+  fill_db(db, 300);
+  db.EnableResultCache(16);
+  const std::string query = "test.city == \"sz\" && test.age > 50";
+  int64_t expected = count(db, query);
+  EXPECT_EQ(50, expected);
+  EXPECT_EQ(0, db.Put("test", "{\"id\":1000,\"age\":60,\"city\":[\"sz\"]}"));
+  EXPECT_EQ(expected + 1, count(db, query));
+  EXPECT_EQ(expected + 1, count(db, "test.age > 50 && test.city == \"sz\""));
+  // update an existing record out of the result
+  EXPECT_EQ(0, db.Put("test", "{\"id\":1000,\"age\":10,\"city\":[\"sz\"]}"));
+  EXPECT_EQ(expected, count(db, query));
+  EXPECT_EQ(0, db.Put("test", "{\"id\":1000,\"age\":60,\"city\":[\"sz\"]}"));
+  EXPECT_EQ(expected + 1, count(db, query));
+  EXPECT_EQ(0, db.Remove("test", "{\"id\":1000}"));
+  EXPECT_EQ(expected, count(db, query));
+  EXPECT_EQ(expected, count(db, "test.age > 50 && test.city == \"sz\""));
+}
@@ -0,0 +1,260 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <sys/stat.h>
+#include <vector>
+#include "robims_db.h"
+#include "robims_wal.h"
+
+using namespace robims;
+static std::string wal_path(const char* name) {
+  std::string path = std::string("/tmp/robims_test_") + name + "_" + std::to_string(getpid()) + ".wal";
+  unlink(path.c_str());
+  return path;
+}
+
+TEST(WALTest, AppendReplay) {
+  std::string path = wal_path("append");
+  {
+    RobimsWAL wal;
+    EXPECT_EQ(0, wal.Open(path, WALOptions(), 0));
+    for (int i = 0; i < 100; i++) {
+      uint64_t lsn = wal.Append(i % 2 == 0 ? WAL_OP_PUT : WAL_OP_REMOVE, "t", std::to_string(i));
+      EXPECT_EQ(i + 1, lsn);
+      EXPECT_EQ(0, wal.Commit(lsn));
+    }
+  }
+  RobimsWAL wal;
+  EXPECT_EQ(0, wal.Open(path, WALOptions(), 0));
+  EXPECT_EQ(100, wal.LastLSN());
+  int count = 0;
+  EXPECT_EQ(0, wal.Replay(50, [&](uint64_t lsn, WALOpType op, const std::string& table,
+                                  const std::string& json) {
+    EXPECT_EQ(lsn, 51 + count);
+    EXPECT_EQ(lsn % 2 == 1 ? WAL_OP_PUT : WAL_OP_REMOVE, op);
+    EXPECT_EQ("t", table);
+    EXPECT_EQ(std::to_string(lsn - 1), json);
+    count++;
+  }));
+  EXPECT_EQ(50, count);
+  unlink(path.c_str());
+}
+
+TEST(WALTest, TornTail) {
+  std::string path = wal_path("torn");
+  {
+    RobimsWAL wal;
+    EXPECT_EQ(0, wal.Open(path, WALOptions(), 0));
+    for (int i = 0; i < 10; i++) {
+      EXPECT_EQ(0, wal.Commit(wal.Append(WAL_OP_PUT, "t", "{\"id\":\"" + std::to_string(i) + "\"}")));
+    }
+  }
+  // simulate a crash in the middle of the last record
+  FILE* fp = fopen(path.c_str(), "r+");
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fclose(fp);
+  EXPECT_EQ(0, truncate(path.c_str(), size - 3));
+
+  RobimsWAL wal;
+  EXPECT_EQ(0, wal.Open(path, WALOptions(), 0));
+  EXPECT_EQ(9, wal.LastLSN());
+  EXPECT_EQ(0, wal.Commit(wal.Append(WAL_OP_PUT, "t", "new")));
+  std::vector<std::string> jsons;
+  EXPECT_EQ(0, wal.Replay(0, [&](uint64_t lsn, WALOpType op, const std::string& table,
+                                 const std::string& json) { jsons.push_back(json); }));
+  EXPECT_EQ(10, jsons.size());
+  EXPECT_EQ("new", jsons.back());
+  unlink(path.c_str());
+}
+
+TEST(WALTest, GroupCommit) {
+  std::string path = wal_path("group");
+  WALOptions options;
+  options.sync_policy = WAL_SYNC_ALWAYS;
+  RobimsWAL wal;
+  EXPECT_EQ(0, wal.Open(path, options, 0));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&wal]() {
+      for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(0, wal.Commit(wal.Append(WAL_OP_PUT, "t", "v")));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(400, wal.LastLSN());
+  EXPECT_EQ(0, wal.Truncate());
+  int count = 0;
+  EXPECT_EQ(0, wal.Replay(0, [&](uint64_t, WALOpType, const std::string&, const std::string&) {
+    count++;
+  }));
+  EXPECT_EQ(0, count);
+  EXPECT_EQ(401, wal.Append(WAL_OP_PUT, "t", "v"));
+  unlink(path.c_str());
+}
+
+TEST(WALTest, IntervalSync) {
+  std::string path = wal_path("interval");
+  WALOptions options;
+  options.sync_policy = WAL_SYNC_INTERVAL;
+  options.sync_interval_ms = 10;
+  RobimsWAL wal;
+  EXPECT_EQ(0, wal.Open(path, options, 0));
+  for (int i = 0; i < 5; i++) {
+    EXPECT_EQ(0, wal.Commit(wal.Append(WAL_OP_PUT, "t", "v")));
+  }
+  // no more commits, the tail is still synced by the timer
+  for (int i = 0; i < 100 && wal.SyncedLSN() < 5; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(5, wal.SyncedLSN());
+  unlink(path.c_str());
+}
+
+TEST(WALTest, AdvanceLSN) {
+  std::string path = wal_path("advance");
+  {
+    RobimsWAL wal;
+    EXPECT_EQ(0, wal.Open(path, WALOptions(), 0));
+    EXPECT_EQ(0, wal.Commit(wal.Append(WAL_OP_PUT, "t", "1")));
+    wal.AdvanceLSN(100);
+    EXPECT_EQ(100, wal.LastLSN());
+    EXPECT_EQ(101, wal.Append(WAL_OP_PUT, "t", "2"));
+    EXPECT_EQ(0, wal.Commit(101));
+    // never moves backward
+    wal.AdvanceLSN(10);
+    EXPECT_EQ(102, wal.Append(WAL_OP_PUT, "t", "3"));
+    EXPECT_EQ(0, wal.Commit(102));
+  }
+  RobimsWAL wal;
+  EXPECT_EQ(0, wal.Open(path, WALOptions(), 0));
+  std::vector<uint64_t> lsns;
+  EXPECT_EQ(0, wal.Replay(0, [&](uint64_t lsn, WALOpType, const std::string&, const std::string&) {
+    lsns.push_back(lsn);
+  }));
+  EXPECT_EQ(std::vector<uint64_t>({1, 101, 102}), lsns);
+  unlink(path.c_str());
+}
+
+static int64_t count_sz(RobimsDB& db) {
+  SelectResult result;
+  EXPECT_EQ(0, db.Select("test.city == \"sz\"", 0, 10, result));
+  return result.total;
+}
+
+TEST(WALTest, LoadKeepsLSNIncreasing) {
+  std::string save = wal_path("lsn_save");
+  std::string wal_a = wal_path("lsn_a");
+  std::string wal_b = wal_path("lsn_b");
+  {
+    RobimsDB db;
+    EXPECT_EQ(0, db.CreateTable("test(id id, city set)"));
+    EXPECT_EQ(0, db.EnableWAL(wal_a));
+    for (int i = 0; i < 50; i++) {
+      EXPECT_EQ(0, db.Put("test", "{\"id\":" + std::to_string(i) + ",\"city\":[\"sz\"]}"));
+    }
+    EXPECT_EQ(0, db.Save(save, false));
+  }
+  {
+    // wal of this db starts from lsn 0, the loaded data is at lsn 50
+    RobimsDB db;
+    EXPECT_EQ(0, db.CreateTable("test(id id, city set)"));
+    EXPECT_EQ(0, db.EnableWAL(wal_b));
+    EXPECT_EQ(0, db.Load(save));
+    EXPECT_EQ(0, db.Put("test", "{\"id\":1000,\"city\":[\"sz\"]}"));
+    EXPECT_EQ(51, count_sz(db));
+  }
+  RobimsDB db;
+  EXPECT_EQ(0, db.Load(save));
+  EXPECT_EQ(0, db.EnableWAL(wal_b));
+  EXPECT_EQ(51, count_sz(db));
+  unlink(save.c_str());
+  unlink(wal_a.c_str());
+  unlink(wal_b.c_str());
+}
+
+TEST(WALTest, CheckpointOnlyChangedFields) {
+  std::string dir = wal_path("ckpt_dir");
+  std::string wal = wal_path("ckpt");
+  mkdir(dir.c_str(), 0755);
+  RobimsDB db;
+  EXPECT_EQ(0, db.CreateTable("test(id id, age int[1,150], city set, score float)"));
+  EXPECT_EQ(0, db.EnableWAL(wal));
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(0, db.Put("test", "{\"id\":" + std::to_string(i) + ",\"age\":10,\"city\":[\"sz\"]}"));
+  }
+  EXPECT_EQ(0, db.Put("test", "{\"id\":1000,\"score\":1.5}"));
+  EXPECT_EQ(0, db.Checkpoint(dir));
+  auto inode_of = [&](const std::string& name) {
+    struct stat st;
+    EXPECT_EQ(0, stat((dir + "/test." + name + ".field").c_str(), &st));
+    return st.st_ino;
+  };
+  ino_t age = inode_of("age"), city = inode_of("city"), score = inode_of("score");
+  // only 'score' holds a value of id 1000
+  EXPECT_EQ(0, db.Remove("test", "{\"id\":1000}"));
+  EXPECT_EQ(0, db.Checkpoint(dir));
+  EXPECT_EQ(age, inode_of("age"));
+  EXPECT_EQ(city, inode_of("city"));
+  EXPECT_NE(score, inode_of("score"));
+  score = inode_of("score");
+  EXPECT_EQ(0, db.Remove("test", "{\"id\":1}"));
+  EXPECT_EQ(0, db.Checkpoint(dir));
+  EXPECT_NE(age, inode_of("age"));
+  EXPECT_NE(city, inode_of("city"));
+  EXPECT_EQ(score, inode_of("score"));
+
+  RobimsDB loaded;
+  EXPECT_EQ(0, loaded.Load(dir));
+  EXPECT_EQ(99, count_sz(loaded));
+  unlink(wal.c_str());
+}
+
+TEST(WALTest, CheckpointWithConcurrentSelect) {
+  std::string dir = wal_path("ckpt_select_dir");
+  std::string wal = wal_path("ckpt_select");
+  RobimsDB db;
+  EXPECT_EQ(0, db.CreateTable("test(id id, age int[1,150], city set)"));
+  EXPECT_EQ(0, db.EnableWAL(wal));
+  const int kCount = 2000;
+  std::atomic<bool> stop{false};
+  std::thread writer([&]() {
+    for (int i = 0; i < kCount; i++) {
+      EXPECT_EQ(0, db.Put("test", "{\"id\":" + std::to_string(i) + ",\"age\":" +
+                                      std::to_string(i % 150 + 1) + ",\"city\":[\"sz\"]}"));
+      if (i % 100 == 0) {
+        EXPECT_EQ(0, db.Checkpoint(dir));
+      }
+    }
+    stop = true;
+  });
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; i++) {
+    readers.emplace_back([&]() {
+      int64_t last = 0;
+      while (!stop) {
+        int64_t total = count_sz(db);
+        // written records never disappear from the view of a select
+        EXPECT_GE(total, last);
+        EXPECT_LE(total, kCount);
+        last = total;
+      }
+    });
+  }
+  writer.join();
+  for (auto& t : readers) {
+    t.join();
+  }
+  EXPECT_EQ(0, db.Checkpoint(dir));
+  EXPECT_EQ(kCount, count_sz(db));
+  RobimsDB loaded;
+  EXPECT_EQ(0, loaded.Load(dir));
+  EXPECT_EQ(kCount, count_sz(loaded));
+  unlink(wal.c_str());
+}
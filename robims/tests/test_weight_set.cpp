@@ -0,0 +1,272 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "robims_bsi.h"
+#include "robims_common.h"
+#include "robims_err.h"
+#include "robims_field.h"
+
+using namespace robims;
+typedef std::map<std::string, std::map<uint32_t, float>> WeightModel;
+
+static std::unique_ptr<RobimsField> new_weight_set_field(int64_t topk_limit) {
+  std::unique_ptr<RobimsField> field(new RobimsWeightSetField);
+  FieldMeta meta;
+  meta.set_name("tags");
+  meta.set_index_type(WEIGHT_SET_INDEX);
+  meta.set_topk_limit(topk_limit);
+  EXPECT_EQ(0, field->Init(nullptr, meta));
+  return field;
+}
+
+static std::set<uint32_t> select_tag(RobimsField* field, const std::string& tag) {
+  std::set<uint32_t> ids;
+  CRoaringBitmapPtr out;
+  if (0 != field->Select(FIELD_OP_EQ, std::string_view(tag), nullptr, out)) {
+    return ids;
+  }
+  std::vector<uint32_t> values(roaring_bitmap_get_cardinality(out.get()));
+  roaring_bitmap_to_uint32_array(out.get(), values.data());
+  ids.insert(values.begin(), values.end());
+  return ids;
+}
+
+static uint64_t model_key(uint32_t id, float weight) {
+  return (static_cast<uint64_t>(float_to_uint32(weight) >> 16) << 32) + id;
+}
+static void evict_model(std::map<uint32_t, float>& weights, size_t topk) {
+  while (weights.size() > topk) {
+    auto min = weights.begin();
+    for (auto it = weights.begin(); it != weights.end(); it++) {
+      if (model_key(it->first, it->second) < model_key(min->first, min->second)) {
+        min = it;
+      }
+    }
+    weights.erase(min);
+  }
+}
+
+// ids kept for a tag when only the 'topk' entries with highest (quantized weight, id) survive.
+static std::set<uint32_t> expected_topk(const std::map<uint32_t, float>& weights, size_t topk) {
+  std::vector<uint64_t> keys;
+  for (auto& pair : weights) {
+    keys.emplace_back(model_key(pair.first, pair.second));
+  }
+  std::sort(keys.begin(), keys.end(), std::greater<uint64_t>());
+  if (topk > 0 && keys.size() > topk) {
+    keys.resize(topk);
+  }
+  std::set<uint32_t> ids;
+  for (uint64_t key : keys) {
+    ids.insert(key & 0xFFFFFFFFull);
+  }
+  return ids;
+}
+
+static std::unique_ptr<RobimsField> save_and_load(RobimsField* field) {
+  FILE* fp = tmpfile();
+  EXPECT_EQ(0, field->DoSave(fp, false));
+  rewind(fp);
+  std::unique_ptr<RobimsField> loaded = new_weight_set_field(field->GetFieldMeta().topk_limit());
+  EXPECT_EQ(0, loaded->DoLoad(fp));
+  fclose(fp);
+  return loaded;
+}
+
+TEST(WeightSetTest, Overlay) {
+  std::unique_ptr<RobimsField> field = new_weight_set_field(0);
+  for (uint32_t id = 0; id < 100; id++) {
+    EXPECT_EQ(0, field->Put(id, id % 2 == 0 ? "even" : "odd", id * 0.5f));
+  }
+  // update weight of existing entries
+  EXPECT_EQ(0, field->Put(2, "even", 100.0f));
+  EXPECT_EQ(0, field->Put(2, "even", 100.0f));
+  EXPECT_EQ(0, field->Put(3, "even", 1.0f));
+  std::set<uint32_t> even = select_tag(field.get(), "even");
+  EXPECT_EQ(51, even.size());
+  EXPECT_EQ(1, even.count(3));
+  EXPECT_EQ(50, select_tag(field.get(), "odd").size());
+  CRoaringBitmapPtr out;
+  EXPECT_EQ(ROBIMS_ERR_NOTFOUND, field->Select(FIELD_OP_EQ, std::string_view("none"), nullptr, out));
+  EXPECT_EQ(ROBIMS_ERR_INVALID_ARGS, field->Select(FIELD_OP_EQ, int64_t(1), nullptr, out));
+}
+
+TEST(WeightSetTest, ReverseIndexRemove) {
+  std::unique_ptr<RobimsField> field = new_weight_set_field(0);
+  for (uint32_t id = 0; id < 100; id++) {
+    EXPECT_EQ(0, field->Put(id, "a", id));
+    if (id % 3 == 0) {
+      EXPECT_EQ(0, field->Put(id, "b", id));
+    }
+  }
+  std::unique_ptr<RobimsField> loaded = save_and_load(field.get());
+  // ids only in the loaded reverse index
+  EXPECT_EQ(0, loaded->Remove(3));
+  EXPECT_EQ(-1, loaded->Remove(3));
+  EXPECT_EQ(0, loaded->Remove(4));
+  EXPECT_EQ(-1, loaded->Remove(1000));
+  // put back a removed id, it must be removable again
+  EXPECT_EQ(0, loaded->Put(3, "a", 3.0f));
+  std::set<uint32_t> a = select_tag(loaded.get(), "a");
+  std::set<uint32_t> b = select_tag(loaded.get(), "b");
+  EXPECT_EQ(99, a.size());
+  EXPECT_EQ(1, a.count(3));
+  EXPECT_EQ(0, a.count(4));
+  EXPECT_EQ(33, b.size());
+  EXPECT_EQ(0, b.count(3));
+  EXPECT_EQ(0, loaded->Remove(3));
+  EXPECT_EQ(0, select_tag(loaded.get(), "a").count(3));
+
+  // removed ids stay removed after another round trip
+  std::unique_ptr<RobimsField> reloaded = save_and_load(loaded.get());
+  a = select_tag(reloaded.get(), "a");
+  EXPECT_EQ(98, a.size());
+  EXPECT_EQ(0, a.count(3));
+  EXPECT_EQ(0, a.count(4));
+  EXPECT_EQ(-1, reloaded->Remove(4));
+  EXPECT_EQ(0, reloaded->Remove(6));
+  EXPECT_EQ(0, select_tag(reloaded.get(), "b").count(6));
+}
+
+TEST(WeightSetTest, EvictMin) {
+  const size_t topk = 50;
+  std::unique_ptr<RobimsField> field = new_weight_set_field(topk);
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> dist(-1000.0f, 1000.0f);
+  std::map<uint32_t, float> model;
+  for (uint32_t id = 0; id < 200; id++) {
+    float w = dist(rng);
+    model[id] = w;
+    EXPECT_EQ(0, field->Put(id, "t", w));
+  }
+  std::set<uint32_t> expected = expected_topk(model, topk);
+  EXPECT_EQ(expected, select_tag(field.get(), "t"));
+
+  // evict from loaded base entries, including stale ones whose weight was updated after load
+  std::unique_ptr<RobimsField> loaded = save_and_load(field.get());
+  EXPECT_EQ(expected, select_tag(loaded.get(), "t"));
+  std::map<uint32_t, float> kept;
+  for (uint32_t id : expected) {
+    kept[id] = model[id];
+  }
+  uint32_t highest = *expected_topk(kept, 1).begin();
+  kept[highest] = -2000.0f;
+  EXPECT_EQ(0, loaded->Put(highest, "t", -2000.0f));
+  for (uint32_t id = 200; id < 260; id++) {
+    float w = dist(rng);
+    kept[id] = w;
+    EXPECT_EQ(0, loaded->Put(id, "t", w));
+    evict_model(kept, topk);
+  }
+  std::set<uint32_t> kept_ids;
+  for (auto& pair : kept) {
+    kept_ids.insert(pair.first);
+  }
+  EXPECT_EQ(topk, kept_ids.size());
+  EXPECT_EQ(0, kept_ids.count(highest));
+  EXPECT_EQ(kept_ids, select_tag(loaded.get(), "t"));
+  EXPECT_EQ(kept_ids, select_tag(save_and_load(loaded.get()).get(), "t"));
+}
+
+TEST(WeightSetTest, CompactTag) {
+  const size_t topk = 3000;
+  std::unique_ptr<RobimsField> field = new_weight_set_field(topk);
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+  std::map<uint32_t, float> model;
+  // enough overlay entries to compact the tag several times while putting
+  for (uint32_t id = 0; id < 10000; id++) {
+    float w = dist(rng);
+    model[id] = w;
+    EXPECT_EQ(0, field->Put(id, "t", w));
+    evict_model(model, topk);
+    if (id % 7 == 0) {
+      uint32_t update = rng() % (id + 1);
+      model[update] = dist(rng);
+      EXPECT_EQ(0, field->Put(update, "t", model[update]));
+    }
+    evict_model(model, topk);
+  }
+  std::set<uint32_t> expected = expected_topk(model, topk);
+  EXPECT_EQ(topk, expected.size());
+  EXPECT_EQ(expected, select_tag(field.get(), "t"));
+  for (uint32_t id : expected) {
+    if (id % 5 == 0) {
+      EXPECT_EQ(0, field->Remove(id));
+      model.erase(id);
+    }
+  }
+  expected = expected_topk(model, topk);
+  EXPECT_EQ(expected, select_tag(field.get(), "t"));
+  EXPECT_EQ(expected, select_tag(save_and_load(field.get()).get(), "t"));
+}
+
+TEST(WeightSetTest, SaveLoad) {
+  std::unique_ptr<RobimsField> field = new_weight_set_field(0);
+  WeightModel model;
+  for (uint32_t id = 0; id < 2000; id++) {
+    std::string tag = "tag" + std::to_string(id % 13);
+    model[tag][id] = id * 0.25f;
+    EXPECT_EQ(0, field->Put(id, tag, id * 0.25f));
+  }
+  std::unique_ptr<RobimsField> loaded = save_and_load(field.get());
+  for (auto& pair : model) {
+    EXPECT_EQ(expected_topk(pair.second, 0), select_tag(loaded.get(), pair.first));
+  }
+  AggregateBuckets buckets;
+  CRoaringBitmapPtr all(roaring_bitmap_from_range(0, 2000, 1));
+  EXPECT_EQ(0, loaded->CountBy(all.get(), buckets));
+  EXPECT_EQ(13, buckets.size());
+  EXPECT_EQ(154, buckets[0].count);
+
+  // unknown format version
+  FILE* fp = tmpfile();
+  file_write_uint32(fp, 0xFFFFFFFF);
+  file_write_uint32(fp, 100);
+  rewind(fp);
+  EXPECT_NE(0, new_weight_set_field(0)->DoLoad(fp));
+  fclose(fp);
+}
+
+TEST(WeightSetTest, LoadLegacyFormat) {
+  // tag count, (name, count, (float weight << 32 | id)[count] desc, bitmap) per tag
+  FILE* fp = tmpfile();
+  EXPECT_EQ(0, file_write_uint32(fp, 1));
+  EXPECT_EQ(0, file_write_string(fp, "legacy"));
+  std::map<uint32_t, float> model;
+  std::vector<uint64_t> weight_ids;
+  RoaringBitmap bitmap;
+  bitmap.NewCRoaringBitmap();
+  for (uint32_t id = 0; id < 100; id++) {
+    // weights differ only in low bits, so they share a quantized weight
+    float w = 1.0f + id * 1e-6f;
+    model[id] = w;
+    weight_ids.emplace_back((static_cast<uint64_t>(float_to_uint32(w)) << 32) | id);
+    bitmap.Put(id);
+  }
+  std::sort(weight_ids.begin(), weight_ids.end(), std::greater<uint64_t>());
+  EXPECT_EQ(0, file_write_uint32(fp, weight_ids.size()));
+  EXPECT_EQ(1, fwrite(weight_ids.data(), weight_ids.size() * sizeof(uint64_t), 1, fp));
+  EXPECT_EQ(0, bitmap.Save(fp, false));
+  rewind(fp);
+
+  std::unique_ptr<RobimsField> field = new_weight_set_field(100);
+  EXPECT_EQ(0, field->DoLoad(fp));
+  fclose(fp);
+  std::set<uint32_t> all = expected_topk(model, 0);
+  EXPECT_EQ(all, select_tag(field.get(), "legacy"));
+  // eviction follows the quantized order, ties are broken by id
+  EXPECT_EQ(0, field->Put(100, "legacy", 1.0f));
+  model[100] = 1.0f;
+  EXPECT_EQ(expected_topk(model, 100), select_tag(field.get(), "legacy"));
+  EXPECT_EQ(0, select_tag(field.get(), "legacy").count(0));
+  EXPECT_EQ(0, field->Remove(99));
+  EXPECT_EQ(0, select_tag(save_and_load(field.get()).get(), "legacy").count(99));
+}
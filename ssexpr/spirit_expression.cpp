@@ -35,6 +35,8 @@ struct Variable : x3::position_tagged {
 
 struct DynamicVariable : x3::position_tagged {
   std::vector<std::string> v;
+
+  const void* handle_ = nullptr;
 };
 
 struct Operand
@@ -83,6 +85,8 @@ struct FuncCall : x3::position_tagged {
   std::vector<Operand> args;
 
   ExprFunction functor_;
+  // compiled string literal args, empty if there is none
+  std::vector<const void*> arg_handles_;
 };
 
 struct Expression : public x3::position_tagged, Expr {
@@ -445,6 +449,18 @@ struct CalcVisitor {
   }
 };
 
+// args of function calls are parsed as expressions, a string literal arg is an expression with no operation
+static const std::string* GetStringLiteral(const Operand& operand) {
+  if (const std::string* literal = boost::get<std::string>(&operand.get())) {
+    return literal;
+  }
+  const x3::forward_ast<Expression>* expr = boost::get<x3::forward_ast<Expression>>(&operand.get());
+  if (nullptr != expr && expr->get().rest.empty()) {
+    return GetStringLiteral(expr->get().first);
+  }
+  return nullptr;
+}
+
 struct Initializer {
   const ExprOptions& opt_;
   Initializer(const ExprOptions& opt) : opt_(opt) {}
@@ -479,7 +495,10 @@ struct Initializer {
     return 0;
   }
   int operator()(DynamicVariable& n) const {
-    if (!opt_.dynamic_var_access) {
+    if (opt_.dynamic_var_compile && opt_.dynamic_handle_access) {
+      n.handle_ = opt_.dynamic_var_compile(n.v);
+    }
+    if (!opt_.dynamic_var_access && nullptr == n.handle_) {
       return ERR_EMPTY_DYNAMIC_VAR_VISITOR;
     }
     return 0;
@@ -490,8 +509,17 @@ struct Initializer {
       return ERR_INVALID_FUNCTION;
     }
     n.functor_ = found->second;
-    for (auto& operand : n.args) {
-      boost::apply_visitor(*this, operand);
+    for (size_t i = 0; i < n.args.size(); i++) {
+      boost::apply_visitor(*this, n.args[i]);
+      const std::string* literal = GetStringLiteral(n.args[i]);
+      if (nullptr == literal || !opt_.function_arg_compile) {
+        continue;
+      }
+      const void* handle = opt_.function_arg_compile(n.func, i, *literal);
+      if (nullptr != handle) {
+        n.arg_handles_.resize(n.args.size(), nullptr);
+        n.arg_handles_[i] = handle;
+      }
     }
     return 0;
   }
@@ -569,6 +597,9 @@ struct Interpreter {
     return v;
   }
   Value operator()(DynamicVariable const& n) const {
+    if (nullptr != n.handle_ && ctx_.dynamic_handle_access) {
+      return ctx_.dynamic_handle_access(ctx_.dynamic_root, n.handle_);
+    }
     if (!ctx_.dynamic_var_access) {
       Error e(ERR_EMPTY_STRUCT_VISITOR, "empty struct visitor");
       Value v = e;
@@ -584,8 +615,12 @@ struct Interpreter {
       return v;
     }
     std::vector<Value> arg_vals;
-    for (auto& operand : n.args) {
-      arg_vals.push_back(boost::apply_visitor(*this, operand));
+    for (size_t i = 0; i < n.args.size(); i++) {
+      if (!n.arg_handles_.empty() && nullptr != n.arg_handles_[i]) {
+        arg_vals.emplace_back(n.arg_handles_[i]);
+        continue;
+      }
+      arg_vals.push_back(boost::apply_visitor(*this, n.args[i]));
     }
     return n.functor_(arg_vals);
   }
@@ -37,11 +37,22 @@ typedef std::function<std::vector<FieldAccessor>(const std::vector<std::string>
 typedef std::function<Value(const std::vector<FieldAccessor> &)> StructMemberVisitFunction;
 typedef std::function<Value(const void *, const std::vector<std::string> &)>
     DynamicVarVisitFunction;
+typedef std::function<const void *(const std::vector<std::string> &)> DynamicVarCompileFunction;
+typedef std::function<Value(const void *, const void *)> DynamicVarHandleVisitFunction;
+typedef std::function<const void *(const std::string &, size_t, const std::string &)> FunctionArgCompileFunction;
 
 struct ExprOptions {
   std::map<std::string, ExprFunction> functions;
   GetStructMemberAccessFunction get_member_access;
   DynamicVarVisitFunction dynamic_var_access;
+  // optional, compiles each dynamic var once in 'Init', the returned handle(owned by the caller) is
+  // passed to 'dynamic_handle_access' instead of the var names on evaluation.
+  DynamicVarCompileFunction dynamic_var_compile;
+  DynamicVarHandleVisitFunction dynamic_handle_access;
+  // optional, compiles each string literal argument of the function calls once in 'Init' with the function
+  // name & the argument index, a non-null handle(owned by the caller) is passed to the function as a
+  // 'const void*' value instead of the literal.
+  FunctionArgCompileFunction function_arg_compile;
 
   template <typename T>
   void Init() {
@@ -57,6 +68,7 @@ struct ExprOptions {
 struct EvalContext {
   StructMemberVisitFunction struct_vistitor;
   DynamicVarVisitFunction dynamic_var_access;
+  DynamicVarHandleVisitFunction dynamic_handle_access;
   const void *dynamic_root = nullptr;
 };
 
@@ -71,12 +83,14 @@ class SpiritExpression {
   Value Eval() {
     EvalContext ctx;
     ctx.dynamic_var_access = options_.dynamic_var_access;
+    ctx.dynamic_handle_access = options_.dynamic_handle_access;
     return DoEval(ctx);
   }
   template <typename T>
   Value EvalDynamic(const T &root_dynamic_obj) {
     EvalContext ctx;
     ctx.dynamic_var_access = options_.dynamic_var_access;
+    ctx.dynamic_handle_access = options_.dynamic_handle_access;
     ctx.dynamic_root = &root_dynamic_obj;
     return DoEval(ctx);
   }
@@ -84,6 +98,7 @@ class SpiritExpression {
   Value Eval(const T &root_obj) {
     EvalContext ctx;
     ctx.dynamic_var_access = options_.dynamic_var_access;
+    ctx.dynamic_handle_access = options_.dynamic_handle_access;
     ctx.struct_vistitor = [&root_obj](const std::vector<FieldAccessor> &accessors) {
       Value v;
       auto field_val = root_obj.GetFieldValue(accessors);
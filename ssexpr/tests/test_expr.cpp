@@ -1,4 +1,8 @@
 #include <gtest/gtest.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 #include "spirit_expression.h"
 using namespace ssexpr;
 DEFINE_EXPR_STRUCT(SubUser, (int32_t)age, (std::string)id)
@@ -127,4 +131,60 @@ TEST(ExprTest, DynamicVar) {
 
   auto val = expr.EvalDynamic(dynamic_vars);
   EXPECT_EQ(201, std::get<int64_t>(val));
-}
\ No newline at end of file
+}
+TEST(ExprTest, CompiledFunctionArg) {
+  ExprOptions opt;
+  std::vector<std::unique_ptr<std::string>> handles;
+  opt.function_arg_compile = [&handles](const std::string& func, size_t idx,
+                                        const std::string& arg) -> const void* {
+    if (func != "has_key" || idx != 0) {
+      return nullptr;
+    }
+    handles.emplace_back(new std::string(arg));
+    return handles.back().get();
+  };
+  std::map<std::string, int64_t> keys = {{"a", 1}, {"b", 2}};
+  opt.functions["has_key"] = [&keys](const std::vector<ssexpr::Value>& args) {
+    Value v;
+    if (const void* const* handle = std::get_if<const void*>(&args[0])) {
+      v = keys.count(*((const std::string*)*handle)) > 0;
+    } else {
+      v = keys.count(std::string(std::get<std::string_view>(args[0]))) > 0;
+    }
+    return v;
+  };
+  SpiritExpression expr;
+  // only the literal args of 'has_key' are compiled, the ones inside other string literals are untouched
+  int rc = expr.Init(R"expr(has_key("a") && !has_key("c") && "has_key(b)" == "has_key(b)")expr", opt);
+  EXPECT_EQ(0, rc);
+  EXPECT_EQ(2, handles.size());
+  auto val = expr.Eval();
+  EXPECT_EQ(true, std::get<bool>(val));
+}
+TEST(ExprTest, CompiledDynamicVar) {
+  ExprOptions opt;
+  std::map<std::string, int64_t> dynamic_vars;
+  dynamic_vars["v1"] = 101;
+  dynamic_vars["v2"] = 5;
+  std::vector<std::unique_ptr<std::string>> handles;
+  opt.dynamic_var_compile = [&handles](const std::vector<std::string>& args) -> const void* {
+    handles.emplace_back(new std::string(args[0]));
+    return handles.back().get();
+  };
+  opt.dynamic_handle_access = [](const void* root, const void* handle) -> ssexpr::Value {
+    const std::map<std::string, int64_t>& dynamic_vars = *((const std::map<std::string, int64_t>*)root);
+    int64_t v = dynamic_vars.at(*((const std::string*)handle));
+    ssexpr::Value r = v;
+    return r;
+  };
+  SpiritExpression expr;
+  int rc = expr.Init("$v1 + $v2", opt);
+  EXPECT_EQ(0, rc);
+  EXPECT_EQ(2, handles.size());
+
+  auto val = expr.EvalDynamic(dynamic_vars);
+  EXPECT_EQ(106, std::get<int64_t>(val));
+  dynamic_vars["v2"] = 10;
+  val = expr.EvalDynamic(dynamic_vars);
+  EXPECT_EQ(111, std::get<int64_t>(val));
+}
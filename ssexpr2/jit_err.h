@@ -11,4 +11,5 @@
 #define ERR_EMPTY_STRUCT_VISITOR 10005
 #define ERR_NIL_EVAL_FUNC 10006
 #define ERR_TOO_MANY_ARGS 10007
-#define ERR_NIL_VAR 10008
\ No newline at end of file
+#define ERR_NIL_VAR 10008
+#define ERR_DIVIDE_BY_ZERO 10009
\ No newline at end of file
@@ -236,17 +236,24 @@ typedef std::function<void(Xbyak::CodeGenerator&)> FieldJitAccessBuilder;
 struct FieldJitAccessBuilderTable;
 struct FieldJitAccessBuilderTable
     : public std::map<std::string, std::variant<FieldJitAccessBuilder,
-                                                std::pair<FieldJitAccessBuilder, FieldJitAccessBuilderTable>>> {};
+                                                std::pair<FieldJitAccessBuilder, FieldJitAccessBuilderTable>>> {
+  // static value type of each field, used by the expression jit to emit typed code
+  std::map<std::string, ValueType> field_types;
+};
 typedef Value GetValue(const void*);
 class ValueAccessor {
  private:
   std::shared_ptr<Xbyak::CodeGenerator> _jit;
   GetValue* _get;
   bool _own_jit;
+  ValueType _type;
 
  public:
-  ValueAccessor(std::shared_ptr<Xbyak::CodeGenerator> jit = nullptr) : _jit(jit), _get(nullptr), _own_jit(false) {}
+  ValueAccessor(std::shared_ptr<Xbyak::CodeGenerator> jit = nullptr)
+      : _jit(jit), _get(nullptr), _own_jit(false), _type(V_UNKNOWN) {}
   bool Valid() const { return nullptr != _get; }
+  ValueType GetType() const { return _type; }
+  void SetType(ValueType type) { _type = type; }
   const GetValue* GetFunc() const { return _get; }
   Xbyak::CodeGenerator& GetJit() { return *_jit; }
   int BeginBuild() {
@@ -340,6 +347,10 @@ ValueAccessor GetFieldAccessors(const std::vector<std::string>& names,
         try {
           FieldJitAccessBuilder builder = std::get<FieldJitAccessBuilder>(found->second);
           builder(accessor.GetJit());
+          auto type_found = table->field_types.find(names[i]);
+          if (type_found != table->field_types.end()) {
+            accessor.SetType(type_found->second);
+          }
           accessor.EndBuild();
           return accessor;
         } catch (const std::bad_variant_access&) {
@@ -426,6 +437,7 @@ ValueAccessor GetFieldAccessors(const std::vector<std::string>& names,
           jit.mov(jit.rdi, jit.rax);                                                                               \
         };                                                                                                         \
       }                                                                                                            \
+      builders.field_types[BOOST_PP_STRINGIZE(JIT_STRUCT_STRIP(elem))] = vtype;                                    \
       if constexpr (ssexpr2::HasInitJitBuilder<FT2>::value) {                                                      \
         FT2::InitJitBuilder();                                                                                     \
         builders[BOOST_PP_STRINGIZE(JIT_STRUCT_STRIP(elem))] =                                                     \
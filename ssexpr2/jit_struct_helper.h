@@ -65,6 +65,7 @@
         jit.mov(jit.rdi, jit.rax);                                                                 \
       }                                                                                            \
     };                                                                                             \
+    builders.field_types[BOOST_PP_STRINGIZE(elem)] = vtype;                                        \
     if constexpr (std::is_same<FT2, char>::value || std::is_same<FT2, bool>::value ||              \
                   std::is_same<FT2, uint8_t>::value || std::is_same<FT2, int16_t>::value ||        \
                   std::is_same<FT2, uint16_t>::value || std::is_same<FT2, int32_t>::value ||       \
@@ -32,9 +32,22 @@ struct Expression;
 struct FuncCall;
 struct CondExpr;
 
+/**
+ * static type of an ast node, inferred before code generation.
+ * typed nodes keep their result in native registers(rax for int64/bool, xmm0 for double),
+ * dynamic nodes return a Value in rax/rdx and are evaluated by the helper functions.
+ */
+enum StaticType {
+  type_dynamic,
+  type_int64,
+  type_double,
+  type_bool,
+};
+
 struct Variable : x3::position_tagged {
   std::vector<std::string> v;
   ValueAccessor accessor_;
+  StaticType type_ = type_dynamic;
 };
 
 struct DynamicVariable : x3::position_tagged {
@@ -72,16 +85,20 @@ struct CondExpr {
   Operand lhs;
   Operand rhs_true;
   Operand rhs_false;
+  StaticType type_ = type_dynamic;
 };
 
 struct Unary {
   Optoken operator_;
   Operand operand_;
+  StaticType type_ = type_dynamic;
 };
 
 struct Operation : x3::position_tagged {
   Optoken operator_;
   Operand operand_;
+  // type of the result after applying this operation to the left hand side
+  StaticType type_ = type_dynamic;
 };
 
 struct FuncCall : x3::position_tagged {
@@ -94,6 +111,7 @@ struct FuncCall : x3::position_tagged {
 struct Expression : public x3::position_tagged, Expr {
   Operand first;
   std::vector<Operation> rest;
+  StaticType type_ = type_dynamic;
 };
 }  // namespace ast
 }  // namespace ssexpr2
@@ -359,6 +377,167 @@ struct Initializer {
   }
 };
 
+static StaticType getFieldStaticType(ValueType type) {
+  switch (type) {
+    case V_CHAR:
+    case V_UINT8:
+    case V_INT16:
+    case V_UINT16:
+    case V_INT32:
+    case V_UINT32:
+    case V_INT64:
+    case V_UINT64:
+    case V_UINT8_VALUE:
+    case V_INT16_VALUE:
+    case V_UINT16_VALUE:
+    case V_INT32_VALUE:
+    case V_UINT32_VALUE:
+    case V_INT64_VALUE:
+    case V_UINT64_VALUE: {
+      return type_int64;
+    }
+    case V_FLOAT:
+    case V_DOUBLE:
+    case V_FLOAT_VALUE:
+    case V_DOUBLE_VALUE: {
+      return type_double;
+    }
+    case V_BOOL:
+    case V_BOOL_VALUE: {
+      return type_bool;
+    }
+    default: {
+      return type_dynamic;
+    }
+  }
+}
+static StaticType getNumericType(StaticType left, StaticType right) {
+  if (left == type_int64 && right == type_int64) {
+    return type_int64;
+  }
+  if ((left == type_int64 || left == type_double) && (right == type_int64 || right == type_double)) {
+    return type_double;
+  }
+  return type_dynamic;
+}
+/**
+ * @brief the native type both operands are converted to before applying the operator, same rules as the helpers
+ * like doAdd/doEq, type_dynamic if the operation must be evaluated by calcPairValue.
+ */
+static StaticType getOperandType(Optoken op, StaticType left, StaticType right) {
+  switch (op) {
+    case op_plus:
+    case op_minus:
+    case op_times:
+    case op_divide: {
+      return getNumericType(left, right);
+    }
+    case op_modulus: {
+      return (left == type_int64 && right == type_int64) ? type_int64 : type_dynamic;
+    }
+    case op_equal:
+    case op_not_equal:
+    case op_less:
+    case op_less_equal:
+    case op_greater:
+    case op_greater_equal: {
+      if (left == type_bool && right == type_bool) {
+        return type_bool;
+      }
+      return getNumericType(left, right);
+    }
+    case op_and:
+    case op_or: {
+      return (left == type_bool && right == type_bool) ? type_bool : type_dynamic;
+    }
+    default: {
+      return type_dynamic;
+    }
+  }
+}
+static StaticType getResultType(Optoken op, StaticType left, StaticType right) {
+  StaticType operand_type = getOperandType(op, left, right);
+  if (operand_type == type_dynamic) {
+    return type_dynamic;
+  }
+  switch (op) {
+    case op_plus:
+    case op_minus:
+    case op_times:
+    case op_divide:
+    case op_modulus: {
+      return operand_type;
+    }
+    default: {
+      return type_bool;
+    }
+  }
+}
+
+struct TypeInferer {
+  StaticType operator()(Nil) const { return type_dynamic; }
+  StaticType operator()(int64_t n) const { return type_int64; }
+  StaticType operator()(bool n) const { return type_bool; }
+  StaticType operator()(double n) const { return type_double; }
+  StaticType operator()(std::string const& n) const { return type_dynamic; }
+  StaticType operator()(Variable& n) const {
+    n.type_ = getFieldStaticType(n.accessor_.GetType());
+    return n.type_;
+  }
+  StaticType operator()(DynamicVariable& n) const { return type_dynamic; }
+  StaticType operator()(FuncCall& n) const {
+    for (auto& operand : n.args) {
+      boost::apply_visitor(*this, operand);
+    }
+    return type_dynamic;
+  }
+  StaticType operator()(CondExpr& n) const {
+    StaticType test_type = boost::apply_visitor(*this, n.lhs);
+    StaticType true_type = boost::apply_visitor(*this, n.rhs_true);
+    StaticType false_type = boost::apply_visitor(*this, n.rhs_false);
+    // branches with different types keep their own result type, so they are boxed at the join point
+    if (test_type == type_bool && true_type == false_type) {
+      n.type_ = true_type;
+    }
+    return n.type_;
+  }
+  StaticType operator()(Unary& n) const {
+    StaticType operand_type = boost::apply_visitor(*this, n.operand_);
+    switch (n.operator_) {
+      case op_positive: {
+        n.type_ = operand_type;
+        break;
+      }
+      case op_negative: {
+        if (operand_type == type_int64 || operand_type == type_double) {
+          n.type_ = operand_type;
+        }
+        break;
+      }
+      case op_not: {
+        if (operand_type == type_bool) {
+          n.type_ = type_bool;
+        }
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+    return n.type_;
+  }
+  StaticType operator()(Expression& x) const {
+    StaticType current = boost::apply_visitor(*this, x.first);
+    for (Operation& oper : x.rest) {
+      StaticType right = boost::apply_visitor(*this, oper.operand_);
+      oper.type_ = getResultType(oper.operator_, current, right);
+      current = oper.type_;
+    }
+    x.type_ = current;
+    return x.type_;
+  }
+};
+
 static Value notValue(Value v) {
   if (v.type != V_BOOL_VALUE && v.type != V_BOOL) {
     v.type = 0;
@@ -391,7 +570,6 @@ static bool fastAndOr(Value v, size_t op) {
   // printf("####Exit fastAndOr %d \n", rv);
   return rv;
 }
-static Value negValue(Value v) { return v; }
 static inline Value normValue(Value v) {
   switch (v.type) {
     case V_CHAR: {
@@ -474,6 +652,18 @@ static inline Value normValue(Value v) {
 
   return v;
 }
+static Value negValue(Value v) {
+  v = normValue(v);
+  if (v.type == V_INT64_VALUE) {
+    v.Set<int64_t>(-v.Get<int64_t>());
+  } else if (v.type == V_DOUBLE_VALUE) {
+    v.Set<double>(-v.Get<double>());
+  } else {
+    v.type = 0;
+    v.val = ERR_INVALID_OPERAND_TYPE;
+  }
+  return v;
+}
 static inline Value doAdd(Value left, Value right) {
   // printf("####add left:%d, rightr:%d\n", left.type, right.type);
   switch (left.type) {
@@ -665,7 +855,14 @@ static inline Value doDivide(Value left, Value right) {
         }
         case V_INT64_VALUE: {
           int64_t rd = right.Get<int64_t>();
-          left.Set<int64_t>(ld / rd);
+          if (0 == rd) {
+            Value err;
+            err.type = 0;
+            err.val = ERR_DIVIDE_BY_ZERO;
+            return err;
+          }
+          // INT64_MIN / -1 overflows(SIGFPE), wrap around as the negation does
+          left.Set<int64_t>(rd == -1 ? (int64_t)(0 - (uint64_t)ld) : ld / rd);
           return left;
         }
         default: {
@@ -692,7 +889,13 @@ static inline Value doModulus(Value left, Value right) {
       switch (right.type) {
         case V_INT64_VALUE: {
           int64_t rd = right.Get<int64_t>();
-          left.Set<int64_t>(ld % rd);
+          if (0 == rd) {
+            Value err;
+            err.type = 0;
+            err.val = ERR_DIVIDE_BY_ZERO;
+            return err;
+          }
+          left.Set<int64_t>(rd == -1 ? 0 : ld % rd);
           return left;
         }
         default: {
@@ -1307,6 +1510,61 @@ static Value find_var_value(const JITEvalContext* ctx, const std::string* name)
   return found->second;
 }
 
+struct CodeGenerator;
+struct StaticTypeOf {
+  StaticType operator()(int64_t n) const { return type_int64; }
+  StaticType operator()(bool n) const { return type_bool; }
+  StaticType operator()(double n) const { return type_double; }
+  StaticType operator()(Variable const& n) const { return n.type_; }
+  StaticType operator()(CondExpr const& n) const { return n.type_; }
+  StaticType operator()(Unary const& n) const { return n.type_; }
+  StaticType operator()(Expression const& n) const { return n.type_; }
+  StaticType operator()(Nil) const { return type_dynamic; }
+  StaticType operator()(std::string const& n) const { return type_dynamic; }
+  StaticType operator()(DynamicVariable const& n) const { return type_dynamic; }
+  StaticType operator()(FuncCall const& n) const { return type_dynamic; }
+};
+/**
+ * emit a typed node with its result converted to the wanted native type, only invoked on nodes
+ * whose inferred type is not type_dynamic.
+ */
+struct TypedCodeGenerator {
+  CodeGenerator& gen_;
+  StaticType want_;
+  TypedCodeGenerator(CodeGenerator& gen, StaticType want) : gen_(gen), want_(want) {}
+  void operator()(int64_t n);
+  void operator()(bool n);
+  void operator()(double n);
+  void operator()(Variable const& n);
+  void operator()(CondExpr const& n);
+  void operator()(Unary const& n);
+  void operator()(Expression const& n);
+  // never typed by TypeInferer
+  void operator()(Nil) {}
+  void operator()(std::string const& n) {}
+  void operator()(DynamicVariable const& n) {}
+  void operator()(FuncCall const& n) {}
+};
+/**
+ * load a literal right hand side operand into rcx/xmm1, returns false if the operand is not a literal.
+ */
+struct LiteralLoader {
+  CodeGenerator& gen_;
+  StaticType want_;
+  LiteralLoader(CodeGenerator& gen, StaticType want) : gen_(gen), want_(want) {}
+  bool operator()(int64_t n);
+  bool operator()(bool n);
+  bool operator()(double n);
+  bool operator()(Nil) { return false; }
+  bool operator()(std::string const& n) { return false; }
+  bool operator()(Variable const& n) { return false; }
+  bool operator()(DynamicVariable const& n) { return false; }
+  bool operator()(CondExpr const& n) { return false; }
+  bool operator()(FuncCall const& n) { return false; }
+  bool operator()(Unary const& n) { return false; }
+  bool operator()(Expression const& n) { return n.rest.empty() && boost::apply_visitor(*this, n.first); }
+};
+
 struct CodeGenerator {
   const ExprOptions& opt_;
   std::shared_ptr<Xbyak::CodeGenerator> _jit_ptr;
@@ -1317,10 +1575,377 @@ struct CodeGenerator {
    * r12: save eval obj
    * r13: save pushed counter
    *
+   * typed values: rax for int64/bool, xmm0 for double, rcx/xmm1 for the right hand side operand
+   *
    * @param jit
    */
   CodeGenerator(const ExprOptions& opt, std::shared_ptr<Xbyak::CodeGenerator> jit)
       : opt_(opt), _jit_ptr(jit), jit_(*jit) {}
+
+  StaticType TypeOf(const Operand& n) const {
+    if (!opt_.typed_codegen) {
+      return type_dynamic;
+    }
+    return boost::apply_visitor(StaticTypeOf(), n);
+  }
+  void Emit(const Operand& n, StaticType want) {
+    if (want == type_dynamic) {
+      boost::apply_visitor(*this, n);
+    } else {
+      TypedCodeGenerator typed(*this, want);
+      boost::apply_visitor(typed, n);
+    }
+  }
+  void LoadDouble(const Xbyak::Reg64& reg, double d) {
+    uint64_t bits = 0;
+    memcpy(&bits, &d, sizeof(d));
+    jit_.mov(reg, bits);
+  }
+  void ConvertTyped(StaticType from, StaticType to) {
+    if (from == type_int64 && to == type_double) {
+      jit_.cvtsi2sd(jit_.xmm0, jit_.rax);
+    }
+  }
+  void BoxTyped(StaticType type) {
+    switch (type) {
+      case type_int64: {
+        jit_.mov(jit_.rdx, V_INT64_VALUE);
+        break;
+      }
+      case type_bool: {
+        jit_.mov(jit_.rdx, V_BOOL_VALUE);
+        break;
+      }
+      case type_double: {
+        jit_.movq(jit_.rax, jit_.xmm0);
+        jit_.mov(jit_.rdx, V_DOUBLE_VALUE);
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+  }
+  /**
+   * convert the field value returned by the accessor(pointer for V_XXX, value for V_XXX_VALUE) into native register.
+   */
+  void LoadField(ValueType type) {
+    switch (type) {
+      case V_CHAR: {
+        jit_.movsx(jit_.rax, jit_.byte[jit_.rax]);
+        break;
+      }
+      case V_BOOL:
+      case V_UINT8: {
+        jit_.movzx(jit_.eax, jit_.byte[jit_.rax]);
+        break;
+      }
+      case V_INT16: {
+        jit_.movsx(jit_.rax, jit_.word[jit_.rax]);
+        break;
+      }
+      case V_UINT16: {
+        jit_.movzx(jit_.eax, jit_.word[jit_.rax]);
+        break;
+      }
+      case V_INT32: {
+        jit_.movsxd(jit_.rax, jit_.dword[jit_.rax]);
+        break;
+      }
+      case V_UINT32: {
+        jit_.mov(jit_.eax, jit_.dword[jit_.rax]);
+        break;
+      }
+      case V_INT64:
+      case V_UINT64: {
+        jit_.mov(jit_.rax, jit_.qword[jit_.rax]);
+        break;
+      }
+      case V_FLOAT: {
+        jit_.cvtss2sd(jit_.xmm0, jit_.dword[jit_.rax]);
+        break;
+      }
+      case V_DOUBLE: {
+        jit_.movsd(jit_.xmm0, jit_.qword[jit_.rax]);
+        break;
+      }
+      case V_BOOL_VALUE:
+      case V_UINT8_VALUE: {
+        jit_.movzx(jit_.eax, jit_.al);
+        break;
+      }
+      case V_INT16_VALUE: {
+        jit_.movsx(jit_.rax, jit_.ax);
+        break;
+      }
+      case V_UINT16_VALUE: {
+        jit_.movzx(jit_.eax, jit_.ax);
+        break;
+      }
+      case V_INT32_VALUE: {
+        jit_.movsxd(jit_.rax, jit_.eax);
+        break;
+      }
+      case V_UINT32_VALUE: {
+        jit_.mov(jit_.eax, jit_.eax);
+        break;
+      }
+      case V_FLOAT_VALUE: {
+        jit_.movd(jit_.xmm0, jit_.eax);
+        jit_.cvtss2sd(jit_.xmm0, jit_.xmm0);
+        break;
+      }
+      case V_DOUBLE_VALUE: {
+        jit_.movq(jit_.xmm0, jit_.rax);
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+  }
+  void EmitTypedCond(CondExpr const& n, StaticType want) {
+    std::string id = std::to_string(cursor++);
+    Emit(n.lhs, type_bool);
+    jit_.test(jit_.rax, jit_.rax);
+    jit_.jz(".typed_cond_false" + id, jit_.T_NEAR);
+    Emit(n.rhs_true, want);
+    jit_.jmp(".typed_cond_exit" + id, jit_.T_NEAR);
+    jit_.L(".typed_cond_false" + id);
+    Emit(n.rhs_false, want);
+    jit_.L(".typed_cond_exit" + id);
+  }
+  void EmitTypedUnary(Unary const& n, StaticType want) {
+    switch (n.operator_) {
+      case op_not: {
+        Emit(n.operand_, type_bool);
+        jit_.xor_(jit_.eax, 1);
+        break;
+      }
+      case op_negative: {
+        Emit(n.operand_, n.type_);
+        if (n.type_ == type_int64) {
+          jit_.neg(jit_.rax);
+        } else {
+          jit_.mov(jit_.rcx, 0x8000000000000000ULL);
+          jit_.movq(jit_.xmm1, jit_.rcx);
+          jit_.xorpd(jit_.xmm0, jit_.xmm1);
+        }
+        ConvertTyped(n.type_, want);
+        break;
+      }
+      default: {
+        Emit(n.operand_, want);
+        break;
+      }
+    }
+  }
+  /**
+   * rax = rax / rcx(or rax % rcx), idiv raises SIGFPE on a zero divisor and on INT64_MIN / -1, so
+   * a zero divisor exits with ERR_DIVIDE_BY_ZERO and -1 is handled without idiv.
+   */
+  void EmitTypedDivide(bool modulus) {
+    std::string id = std::to_string(cursor++);
+    jit_.test(jit_.rcx, jit_.rcx);
+    jit_.jnz(".typed_div_nonzero" + id);
+    jit_.mov(jit_.r10, ERR_DIVIDE_BY_ZERO);
+    jit_.jmp(".err_exit", jit_.T_NEAR);
+    jit_.L(".typed_div_nonzero" + id);
+    jit_.cmp(jit_.rcx, -1);
+    jit_.jne(".typed_div" + id);
+    if (modulus) {
+      jit_.xor_(jit_.eax, jit_.eax);
+    } else {
+      jit_.neg(jit_.rax);
+    }
+    jit_.jmp(".typed_div_exit" + id);
+    jit_.L(".typed_div" + id);
+    jit_.cqo();
+    jit_.idiv(jit_.rcx);
+    if (modulus) {
+      jit_.mov(jit_.rax, jit_.rdx);
+    }
+    jit_.L(".typed_div_exit" + id);
+  }
+  /**
+   * apply a typed operation, the left hand side is already in rax/xmm0 with the operand type.
+   */
+  void EmitTypedOperation(Operation const& x, StaticType operand_type) {
+    if (x.operator_ == op_and || x.operator_ == op_or) {
+      // booleans are always 0/1, so the left hand side is the result when short circuited
+      std::string label = ".typed_and_or" + std::to_string(cursor++);
+      jit_.test(jit_.rax, jit_.rax);
+      if (x.operator_ == op_and) {
+        jit_.jz(label, jit_.T_NEAR);
+      } else {
+        jit_.jnz(label, jit_.T_NEAR);
+      }
+      Emit(x.operand_, type_bool);
+      jit_.L(label);
+      return;
+    }
+    LiteralLoader literal(*this, operand_type);
+    if (!boost::apply_visitor(literal, x.operand_)) {
+      if (operand_type == type_double) {
+        jit_.movq(jit_.rax, jit_.xmm0);
+      }
+      PushRegisters();
+      Emit(x.operand_, operand_type);
+      if (operand_type == type_double) {
+        jit_.movapd(jit_.xmm1, jit_.xmm0);
+      } else {
+        jit_.mov(jit_.rcx, jit_.rax);
+      }
+      PopValue();
+      if (operand_type == type_double) {
+        jit_.movq(jit_.xmm0, jit_.rax);
+      }
+    }
+    if (operand_type == type_double) {
+      switch (x.operator_) {
+        case op_plus: {
+          jit_.addsd(jit_.xmm0, jit_.xmm1);
+          return;
+        }
+        case op_minus: {
+          jit_.subsd(jit_.xmm0, jit_.xmm1);
+          return;
+        }
+        case op_times: {
+          jit_.mulsd(jit_.xmm0, jit_.xmm1);
+          return;
+        }
+        case op_divide: {
+          jit_.divsd(jit_.xmm0, jit_.xmm1);
+          return;
+        }
+        // unordered(NaN) compare sets ZF/PF/CF, 'a'/'ae' conditions are false for it
+        case op_less: {
+          jit_.ucomisd(jit_.xmm1, jit_.xmm0);
+          jit_.seta(jit_.al);
+          break;
+        }
+        case op_less_equal: {
+          jit_.ucomisd(jit_.xmm1, jit_.xmm0);
+          jit_.setae(jit_.al);
+          break;
+        }
+        case op_greater: {
+          jit_.ucomisd(jit_.xmm0, jit_.xmm1);
+          jit_.seta(jit_.al);
+          break;
+        }
+        case op_greater_equal: {
+          jit_.ucomisd(jit_.xmm0, jit_.xmm1);
+          jit_.setae(jit_.al);
+          break;
+        }
+        case op_equal: {
+          jit_.ucomisd(jit_.xmm0, jit_.xmm1);
+          jit_.sete(jit_.al);
+          jit_.setnp(jit_.cl);
+          jit_.and_(jit_.al, jit_.cl);
+          break;
+        }
+        case op_not_equal: {
+          jit_.ucomisd(jit_.xmm0, jit_.xmm1);
+          jit_.setne(jit_.al);
+          jit_.setp(jit_.cl);
+          jit_.or_(jit_.al, jit_.cl);
+          break;
+        }
+        default: {
+          return;
+        }
+      }
+      jit_.movzx(jit_.eax, jit_.al);
+      return;
+    }
+    switch (x.operator_) {
+      case op_plus: {
+        jit_.add(jit_.rax, jit_.rcx);
+        return;
+      }
+      case op_minus: {
+        jit_.sub(jit_.rax, jit_.rcx);
+        return;
+      }
+      case op_times: {
+        jit_.imul(jit_.rax, jit_.rcx);
+        return;
+      }
+      case op_divide:
+      case op_modulus: {
+        EmitTypedDivide(x.operator_ == op_modulus);
+        return;
+      }
+      default: {
+        break;
+      }
+    }
+    jit_.cmp(jit_.rax, jit_.rcx);
+    switch (x.operator_) {
+      case op_equal: {
+        jit_.sete(jit_.al);
+        break;
+      }
+      case op_not_equal: {
+        jit_.setne(jit_.al);
+        break;
+      }
+      case op_less: {
+        jit_.setl(jit_.al);
+        break;
+      }
+      case op_less_equal: {
+        jit_.setle(jit_.al);
+        break;
+      }
+      case op_greater: {
+        jit_.setg(jit_.al);
+        break;
+      }
+      case op_greater_equal: {
+        jit_.setge(jit_.al);
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+    jit_.movzx(jit_.eax, jit_.al);
+  }
+  /**
+   * evaluate the operations from left to right, typed operations keep the value in native registers,
+   * the value is boxed once the first dynamic operation is met.
+   */
+  void EmitExpression(Expression const& x, StaticType want) {
+    if (x.rest.empty()) {
+      Emit(x.first, want);
+      return;
+    }
+    StaticType left = TypeOf(x.first);
+    StaticType current = getOperandType(x.rest[0].operator_, left, TypeOf(x.rest[0].operand_));
+    Emit(x.first, current);
+    for (Operation const& oper : x.rest) {
+      StaticType operand_type = getOperandType(oper.operator_, left, TypeOf(oper.operand_));
+      if (operand_type != type_dynamic) {
+        ConvertTyped(current, operand_type);
+        EmitTypedOperation(oper, operand_type);
+        current = getResultType(oper.operator_, left, TypeOf(oper.operand_));
+      } else {
+        BoxTyped(current);
+        (*this)(oper);
+        current = type_dynamic;
+      }
+      left = current;
+    }
+    if (want == type_dynamic) {
+      BoxTyped(current);
+    } else {
+      ConvertTyped(current, want);
+    }
+  }
   // void PushValue(const Value& v) {
   //   DEBUG_ASM_OP((jit_.push(v.val)));
   //   DEBUG_ASM_OP((jit_.push(v.type)));
@@ -1383,19 +2008,29 @@ struct CodeGenerator {
     // }
   }
   void operator()(CondExpr const& n) {
+    if (n.type_ != type_dynamic) {
+      EmitTypedCond(n, n.type_);
+      BoxTyped(n.type_);
+      return;
+    }
     size_t current_cursor = cursor;
     cursor++;
-    boost::apply_visitor(*this, n.lhs);
-    jit_.cmp(jit_.edx, V_BOOL);
-    jit_.je(".cond_test_ptr" + std::to_string(current_cursor));
-    jit_.cmp(jit_.edx, V_BOOL_VALUE);
-    jit_.je(".cond_test_value" + std::to_string(current_cursor));
-    jit_.mov(jit_.r10, ERR_INVALID_OPERAND_TYPE);
-    jit_.jmp(".err_exit", jit_.T_NEAR);
-    jit_.L(".cond_test_ptr" + std::to_string(current_cursor));
-    jit_.mov(jit_.rdx, V_BOOL_VALUE);
-    jit_.mov(jit_.rax, jit_.ptr[jit_.rax]);
-    jit_.L(".cond_test_value" + std::to_string(current_cursor));
+    if (TypeOf(n.lhs) == type_bool) {
+      // branches have different types, only the test is typed
+      Emit(n.lhs, type_bool);
+    } else {
+      boost::apply_visitor(*this, n.lhs);
+      jit_.cmp(jit_.edx, V_BOOL);
+      jit_.je(".cond_test_ptr" + std::to_string(current_cursor));
+      jit_.cmp(jit_.edx, V_BOOL_VALUE);
+      jit_.je(".cond_test_value" + std::to_string(current_cursor));
+      jit_.mov(jit_.r10, ERR_INVALID_OPERAND_TYPE);
+      jit_.jmp(".err_exit", jit_.T_NEAR);
+      jit_.L(".cond_test_ptr" + std::to_string(current_cursor));
+      jit_.mov(jit_.rdx, V_BOOL_VALUE);
+      jit_.mov(jit_.rax, jit_.ptr[jit_.rax]);
+      jit_.L(".cond_test_value" + std::to_string(current_cursor));
+    }
     jit_.cmp(jit_.rax, 0);
     jit_.je(".cond_test_false" + std::to_string(current_cursor), jit_.T_NEAR);
     jit_.L(".cond_test_true" + std::to_string(current_cursor));
@@ -1468,6 +2103,11 @@ struct CodeGenerator {
   }
 
   void operator()(Unary const& n) {
+    if (n.type_ != type_dynamic && n.operator_ != op_positive) {
+      EmitTypedUnary(n, n.type_);
+      BoxTyped(n.type_);
+      return;
+    }
     boost::apply_visitor(*this, n.operand_);
     if (n.operator_ == op_positive) {
       return;
@@ -1547,13 +2187,49 @@ struct CodeGenerator {
     // DEBUG_ASM_OP((jit_.nop()));
   }
 
-  void operator()(Expression const& x) {
-    boost::apply_visitor(*this, x.first);
-    for (Operation const& oper : x.rest) {
-      (*this)(oper);
-    }
-  }
+  void operator()(Expression const& x) { EmitExpression(x, type_dynamic); }
 };
+
+void TypedCodeGenerator::operator()(int64_t n) {
+  if (want_ == type_double) {
+    gen_.LoadDouble(gen_.jit_.rax, static_cast<double>(n));
+    gen_.jit_.movq(gen_.jit_.xmm0, gen_.jit_.rax);
+  } else {
+    gen_.jit_.mov(gen_.jit_.rax, n);
+  }
+}
+void TypedCodeGenerator::operator()(bool n) { gen_.jit_.mov(gen_.jit_.rax, n ? 1 : 0); }
+void TypedCodeGenerator::operator()(double n) {
+  gen_.LoadDouble(gen_.jit_.rax, n);
+  gen_.jit_.movq(gen_.jit_.xmm0, gen_.jit_.rax);
+}
+void TypedCodeGenerator::operator()(Variable const& n) {
+  gen_(n);
+  gen_.LoadField(n.accessor_.GetType());
+  gen_.ConvertTyped(n.type_, want_);
+}
+void TypedCodeGenerator::operator()(CondExpr const& n) { gen_.EmitTypedCond(n, want_); }
+void TypedCodeGenerator::operator()(Unary const& n) { gen_.EmitTypedUnary(n, want_); }
+void TypedCodeGenerator::operator()(Expression const& n) { gen_.EmitExpression(n, want_); }
+
+bool LiteralLoader::operator()(int64_t n) {
+  if (want_ == type_double) {
+    gen_.LoadDouble(gen_.jit_.rcx, static_cast<double>(n));
+    gen_.jit_.movq(gen_.jit_.xmm1, gen_.jit_.rcx);
+  } else {
+    gen_.jit_.mov(gen_.jit_.rcx, n);
+  }
+  return true;
+}
+bool LiteralLoader::operator()(bool n) {
+  gen_.jit_.mov(gen_.jit_.rcx, n ? 1 : 0);
+  return true;
+}
+bool LiteralLoader::operator()(double n) {
+  gen_.LoadDouble(gen_.jit_.rcx, n);
+  gen_.jit_.movq(gen_.jit_.xmm1, gen_.jit_.rcx);
+  return true;
+}
 }  // namespace ast
 }  // namespace ssexpr2
 
@@ -1585,6 +2261,10 @@ int SpiritExpression::Init(const std::string& expr, const ExprOptions& options)
     delete ast;
     return rc;
   }
+  if (options.typed_codegen) {
+    ssexpr2::ast::TypeInferer infer;
+    infer(*ast);
+  }
   jit_.reset(new Xbyak::CodeGenerator(options.jit_code_size));
   ssexpr2::ast::CodeGenerator gen(options, jit_);
   jit_->inLocalLabel();
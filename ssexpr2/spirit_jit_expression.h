@@ -28,6 +28,9 @@ struct ExprOptions {
   std::map<std::string, ExprFunction> functions;
   GetStructMemberAccessFunction get_member_access;
   int jit_code_size = 8192;
+  // emit native int64/double instructions for statically typed sub expressions,
+  // only the dynamic parts(strings, functions, $vars) are evaluated by the helper functions
+  bool typed_codegen = true;
   template <typename T>
   void Init() {
     T::InitJitBuilder();
@@ -19,14 +19,14 @@ static Value cfunc2(Value arg0) {
 DEFINE_JIT_STRUCT(SubItem1, (double)score, (std::string)id, (int32_t)vv)
 DEFINE_JIT_STRUCT(Item1, (double)score, (std::string)id, (int32_t)vv, (SubItem1)sub)
 
-static void BM_ssexpr_eval(benchmark::State& state) {
-  std::string str =
-      "1 + 2*3.1 - 6/3 + cfunc1() - cfunc2(3) + sub.score + ((vv > 100 || vv < 10) ? 10000 : 0)";
+static void runExprBench(benchmark::State& state, const std::string& str) {
   ssexpr2::SpiritExpression expr;
   ssexpr2::ExprOptions options;
   options.Init<Item1>();
   options.functions["cfunc1"] = (ExprFunction)cfunc1;
   options.functions["cfunc2"] = (ExprFunction)cfunc2;
+  // arg 0: every operation evaluated by the helper functions, arg 1: typed native code
+  options.typed_codegen = state.range(0) != 0;
   int rc = expr.Init(str, options);
   if (0 != rc) {
     printf("Init %s err:%d\n", str.c_str(), rc);
@@ -36,13 +36,34 @@ static void BM_ssexpr_eval(benchmark::State& state) {
   ssexpr2::Value rv;
   for (auto _ : state) {
     Item1 item;
+    item.score = 1.5;
     item.sub.score = 99.2;
     item.vv = 101;
     rv = expr.Eval(item);
+    benchmark::DoNotOptimize(rv);
+  }
+  if (rv.Is<double>()) {
+    printf("Eval result:%.2f\n", rv.Get<double>());
+  } else if (rv.Is<int64_t>()) {
+    printf("Eval result:%lld\n", (long long)rv.Get<int64_t>());
+  } else {
+    printf("Eval result type:%u val:%llu\n", rv.type, (unsigned long long)rv.val);
   }
-  printf("Eval result:%.2f\n", rv.Get<double>());
+}
+
+static void BM_ssexpr_eval(benchmark::State& state) {
+  runExprBench(state,
+               "1 + 2*3.1 - 6/3 + cfunc1() - cfunc2(3) + sub.score + ((vv > 100 || vv < 10) ? 10000 : 0)");
+}
+static void BM_ssexpr_eval_arith(benchmark::State& state) {
+  runExprBench(state, "sub.score * 2 + vv * 3 - score / 4 + (vv % 7) * sub.vv");
+}
+static void BM_ssexpr_eval_logic(benchmark::State& state) {
+  runExprBench(state, "(vv > 100 || vv < 10) && sub.score >= 99.0 && score * 2 != 3.0 ? vv + 1 : vv - 1");
 }
 // Register the function as a benchmark
-BENCHMARK(BM_ssexpr_eval);
+BENCHMARK(BM_ssexpr_eval)->Arg(0)->Arg(1);
+BENCHMARK(BM_ssexpr_eval_arith)->Arg(0)->Arg(1);
+BENCHMARK(BM_ssexpr_eval_logic)->Arg(0)->Arg(1);
 // Run the benchmark
 BENCHMARK_MAIN();
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <limits>
 #include "spirit_jit_expression.h"
 
 using namespace ssexpr2;
@@ -356,4 +357,132 @@ TEST(ExprTest, TestFunc100) {
   auto val = expr.Eval(item);
   // EXPECT_EQ("world", val.Get<std::string_view>());
   EXPECT_DOUBLE_EQ(3.0, val.Get<double>());
-}
\ No newline at end of file
+}
+DEFINE_JIT_STRUCT(TypedItem, (char)c, (bool)flag, (uint8_t)u8, (int16_t)i16, (uint16_t)u16, (int32_t)i32,
+                  (uint32_t)u32, (int64_t)i64, (float)f, (double)d, (std::string)id)
+
+static Value evalTypedItem(const std::string& str, const TypedItem& item, bool typed_codegen) {
+  SpiritExpression expr;
+  ExprOptions opt;
+  opt.Init<TypedItem>();
+  opt.typed_codegen = typed_codegen;
+  opt.functions["cfunc0"] = (ExprFunction)cfunc0;
+  int rc = expr.Init(str, opt);
+  EXPECT_EQ(0, rc) << str;
+  return expr.Eval(item);
+}
+
+TEST(ExprTest, TypedCodegen) {
+  TypedItem item;
+  item.c = 'a';
+  item.flag = true;
+  item.u8 = 255;
+  item.i16 = -300;
+  item.u16 = 60000;
+  item.i32 = -7;
+  item.u32 = 4000000000;
+  item.i64 = 123456789012;
+  item.f = 1.25;
+  item.d = 3.5;
+  item.id = "abc";
+  std::vector<std::string> exprs = {
+      "i32 + i64 * 2 - u16",
+      "i16 * -3 + c",
+      "i64 / 7",
+      "i64 % 7",
+      "-i32 + 1",
+      "-d",
+      "d * 2.5 + f",
+      "i32 / 2.0",
+      "u32 * 2",
+      "u8 + 1 == 256",
+      "i32 < d",
+      "f >= 1.25",
+      "d == 3.5",
+      "d != 3.5",
+      "i32 - 5 >= 0",
+      "!(i32 > 0)",
+      "i64 > 100 && (u32 < 10 || d > 1.0)",
+      "i32 > 0 && i64 / 0 > 1",
+      "i32 < 0 || i64 / 0 > 1",
+      "(i32 + 1) * (i64 - 2) > u32 + 3",
+      "i32 > 0 ? i64 + 1 : i64 - 1",
+      "i32 < 0 ? d : 1",
+      "i32 < 0 ? i64 : 2.5",
+      "1 + 2*3.1 - 6/3",
+      "cfunc0() + i32 * 2",
+      "i32 * 2 + cfunc0()",
+      "id == \"abc\" && i32 < 0",
+  };
+  for (const auto& str : exprs) {
+    Value dynamic = evalTypedItem(str, item, false);
+    Value typed = evalTypedItem(str, item, true);
+    EXPECT_NE(0, typed.type) << str;
+    EXPECT_EQ(dynamic.type, typed.type) << str;
+    EXPECT_EQ(dynamic.val, typed.val) << str;
+  }
+
+  // typed operand with a dynamic one falls back to the helpers
+  Value err = evalTypedItem("i32 + id", item, true);
+  EXPECT_EQ(0, err.type);
+  EXPECT_EQ(ERR_INVALID_OPERAND_TYPE, err.val);
+
+  item.d = std::numeric_limits<double>::quiet_NaN();
+  for (const auto& str : {"d < 1.0", "d <= 1.0", "d > 1.0", "d >= 1.0", "d == d", "d != d"}) {
+    Value dynamic = evalTypedItem(str, item, false);
+    Value typed = evalTypedItem(str, item, true);
+    EXPECT_EQ(V_BOOL_VALUE, typed.type) << str;
+    EXPECT_EQ(dynamic.val, typed.val) << str;
+  }
+}
+
+TEST(ExprTest, TypedCodegenResultType) {
+  TypedItem item;
+  item.flag = true;
+  item.i32 = 10;
+  item.d = 0.5;
+  Value val = evalTypedItem("i32 + 1", item, true);
+  EXPECT_EQ(V_INT64_VALUE, val.type);
+  EXPECT_EQ(11, val.Get<int64_t>());
+  val = evalTypedItem("i32 + d", item, true);
+  EXPECT_EQ(V_DOUBLE_VALUE, val.type);
+  EXPECT_DOUBLE_EQ(10.5, val.Get<double>());
+  // single field keeps the raw accessor value
+  val = evalTypedItem("i32", item, true);
+  EXPECT_EQ(V_INT32, val.type);
+  EXPECT_EQ(10, val.Get<int32_t>());
+  val = evalTypedItem("flag && i32 > 5", item, true);
+  EXPECT_EQ(true, val.Get<bool>());
+  val = evalTypedItem("!flag", item, true);
+  EXPECT_EQ(false, val.Get<bool>());
+  val = evalTypedItem("flag ? i32 : 0", item, true);
+  EXPECT_EQ(10, val.Get<int64_t>());
+}
+
+TEST(ExprTest, IntDivideByZero) {
+  TypedItem item;
+  item.i32 = 0;
+  item.i64 = std::numeric_limits<int64_t>::min();
+  for (bool typed : {false, true}) {
+    for (const auto& str : {"i64 / 0", "i64 % 0", "i64 / i32", "i64 % i32", "7 / i32", "1 + 7 % i32"}) {
+      Value err = evalTypedItem(str, item, typed);
+      EXPECT_EQ(0, err.type) << str;
+      EXPECT_EQ(ERR_DIVIDE_BY_ZERO, err.val) << str;
+    }
+    // the overflowed quotient wraps around, the remainder is 0
+    item.i32 = -1;
+    Value val = evalTypedItem("i64 / -1", item, typed);
+    EXPECT_EQ(V_INT64_VALUE, val.type);
+    EXPECT_EQ(std::numeric_limits<int64_t>::min(), val.Get<int64_t>());
+    val = evalTypedItem("i64 / i32", item, typed);
+    EXPECT_EQ(std::numeric_limits<int64_t>::min(), val.Get<int64_t>());
+    val = evalTypedItem("i64 % i32", item, typed);
+    EXPECT_EQ(V_INT64_VALUE, val.type);
+    EXPECT_EQ(0, val.Get<int64_t>());
+    val = evalTypedItem("(i64 + 1) / i32", item, typed);
+    EXPECT_EQ(std::numeric_limits<int64_t>::max(), val.Get<int64_t>());
+    val = evalTypedItem("-7 % i32 == 0 && 7 / i32 == -7", item, typed);
+    EXPECT_EQ(true, val.Get<bool>());
+    item.i32 = 0;
+  }
+}